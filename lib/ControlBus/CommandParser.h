@@ -0,0 +1,272 @@
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ControlBus.h"
+
+// 零分配的 MQTT 文本指令解析器
+// 直接在 (payload, length) 上分词，关键字通过编译期生成的完美哈希表查找。
+//
+// 语法 (大小写不敏感，空白分隔)：
+//   <verb>                    例: "stop", "kill", "info"
+//   start [n]                 例: "start", "START 30"
+//   start <n>ml               例: "start 500ml" (按量浇水，需要流量计)
+//   zone <n> <verb> [arg]     例: "zone 3 start", "zone 3 start 30"
+//   history [page]            例: "history", "history 2" (第 0 页最新)
+namespace CommandParser
+{
+    enum class Keyword : uint8_t
+    {
+        None,
+        Start,
+        On,
+        Stop,
+        Off,
+        Reset,
+        Kill,
+        Revive,
+        Info,
+        Status,
+        History,
+        Zone
+    };
+
+    struct KeywordDef
+    {
+        const char *text;
+        Keyword keyword;
+    };
+
+    // 新增指令只需在这里加一行，哈希表会在编译期重新生成并校验
+    constexpr KeywordDef KEYWORDS[] = {
+        {"start", Keyword::Start},
+        {"on", Keyword::On},
+        {"stop", Keyword::Stop},
+        {"off", Keyword::Off},
+        {"reset", Keyword::Reset},
+        {"kill", Keyword::Kill},
+        {"revive", Keyword::Revive},
+        {"info", Keyword::Info},
+        {"status", Keyword::Status},
+        {"history", Keyword::History},
+        {"zone", Keyword::Zone},
+    };
+    constexpr size_t KEYWORD_COUNT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+
+    // 最长关键字，超过的 token 直接判为未知
+    constexpr size_t MAX_KEYWORD_LEN = 8;
+
+    constexpr uint8_t TABLE_BITS = 6;
+    constexpr uint8_t TABLE_SIZE = 1 << TABLE_BITS;
+
+    constexpr char lower(char c) { return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c; }
+
+    // FNV-1a (小写化) 再用种子做一次乘法散列，取高位作为槽位
+    constexpr uint8_t slotOf(const char *s, size_t len, uint32_t seed)
+    {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < len; i++)
+            h = (h ^ (uint8_t)lower(s[i])) * 16777619u;
+        return (uint8_t)(((h ^ seed) * 0x9E3779B1u) >> (32 - TABLE_BITS));
+    }
+
+    constexpr size_t constLength(const char *s)
+    {
+        size_t n = 0;
+        while (s[n])
+            n++;
+        return n;
+    }
+
+    constexpr bool seedIsPerfect(uint32_t seed)
+    {
+        bool used[TABLE_SIZE] = {};
+        for (size_t i = 0; i < KEYWORD_COUNT; i++)
+        {
+            uint8_t slot = slotOf(KEYWORDS[i].text, constLength(KEYWORDS[i].text), seed);
+            if (used[slot])
+                return false;
+            used[slot] = true;
+        }
+        return true;
+    }
+
+    // 编译期搜索第一个没有冲突的种子
+    constexpr uint32_t findSeed()
+    {
+        for (uint32_t seed = 0; seed < 4096; seed++)
+            if (seedIsPerfect(seed))
+                return seed;
+        return UINT32_MAX;
+    }
+
+    constexpr uint32_t SEED = findSeed();
+    static_assert(SEED != UINT32_MAX, "CommandParser: no perfect hash seed, enlarge TABLE_BITS");
+
+    // 槽位 -> KEYWORDS 下标 (+1，0 表示空槽)
+    struct SlotTable
+    {
+        uint8_t index[TABLE_SIZE];
+    };
+
+    constexpr SlotTable buildTable()
+    {
+        SlotTable t{};
+        for (size_t i = 0; i < KEYWORD_COUNT; i++)
+            t.index[slotOf(KEYWORDS[i].text, constLength(KEYWORDS[i].text), SEED)] = (uint8_t)(i + 1);
+        return t;
+    }
+
+    constexpr SlotTable TABLE = buildTable();
+
+    // 查表：一次哈希 + 一次定长比较
+    inline Keyword lookup(const uint8_t *s, size_t len)
+    {
+        if (len == 0 || len > MAX_KEYWORD_LEN)
+            return Keyword::None;
+        uint8_t idx = TABLE.index[slotOf((const char *)s, len, SEED)];
+        if (idx == 0)
+            return Keyword::None;
+        const char *text = KEYWORDS[idx - 1].text;
+        for (size_t i = 0; i < len; i++)
+        {
+            if (text[i] != lower((char)s[i]))
+                return Keyword::None;
+        }
+        return text[len] == '\0' ? KEYWORDS[idx - 1].keyword : Keyword::None;
+    }
+
+    enum class Result : uint8_t
+    {
+        Ok,
+        Empty,
+        UnknownCommand,
+        BadArgument
+    };
+
+    // 在原始缓冲区上切出下一个 token (不拷贝)
+    struct Tokenizer
+    {
+        const uint8_t *p;
+        const uint8_t *end;
+
+        static bool isSpace(uint8_t c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+        bool next(const uint8_t *&tok, size_t &len)
+        {
+            while (p < end && isSpace(*p))
+                p++;
+            if (p >= end)
+                return false;
+            tok = p;
+            while (p < end && !isSpace(*p))
+                p++;
+            len = (size_t)(p - tok);
+            return true;
+        }
+    };
+
+    // 非负十进制整数，溢出或含非数字字符返回 false
+    inline bool parseUint(const uint8_t *s, size_t len, int32_t &out)
+    {
+        if (len == 0 || len > 9)
+            return false;
+        int32_t v = 0;
+        for (size_t i = 0; i < len; i++)
+        {
+            if (s[i] < '0' || s[i] > '9')
+                return false;
+            v = v * 10 + (s[i] - '0');
+        }
+        out = v;
+        return true;
+    }
+
+    // 关键字 -> 指令类型
+    inline bool toCommandType(Keyword kw, CommandType &type)
+    {
+        switch (kw)
+        {
+        case Keyword::Start:
+        case Keyword::On:
+            type = CommandType::Start;
+            return true;
+        case Keyword::Stop:
+        case Keyword::Off:
+            type = CommandType::Stop;
+            return true;
+        case Keyword::Reset:
+            type = CommandType::Reset;
+            return true;
+        case Keyword::Kill:
+            type = CommandType::Kill;
+            return true;
+        case Keyword::Revive:
+            type = CommandType::Revive;
+            return true;
+        case Keyword::Info:
+        case Keyword::Status:
+            type = CommandType::Info;
+            return true;
+        case Keyword::History:
+            type = CommandType::History;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // 解析一条指令，全程只使用栈上的几个变量
+    inline Result parse(const uint8_t *payload, size_t length, Command &out)
+    {
+        Tokenizer tk{payload, payload + length};
+        const uint8_t *tok;
+        size_t len;
+
+        out = Command{CommandType::Info, -1, 0};
+
+        if (!tk.next(tok, len))
+            return Result::Empty;
+
+        Keyword kw = lookup(tok, len);
+
+        // 可选前缀：zone <n>
+        if (kw == Keyword::Zone)
+        {
+            int32_t zone;
+            if (!tk.next(tok, len) || !parseUint(tok, len, zone) || zone > INT16_MAX)
+                return Result::BadArgument;
+            out.zone = (int16_t)zone;
+            if (!tk.next(tok, len))
+                return Result::UnknownCommand;
+            kw = lookup(tok, len);
+        }
+
+        if (!toCommandType(kw, out.type))
+            return Result::UnknownCommand;
+
+        // 可选参数 (start：时长秒数，带 ml 后缀时为水量；history：页码)；其余指令不带参数
+        if (tk.next(tok, len))
+        {
+            if (out.type != CommandType::Start && out.type != CommandType::History)
+                return Result::BadArgument;
+            if (out.type == CommandType::Start && len > 2 && lower((char)tok[len - 2]) == 'm' && lower((char)tok[len - 1]) == 'l')
+            {
+                out.type = CommandType::Dose;
+                len -= 2;
+            }
+            if (!parseUint(tok, len, out.arg))
+                return Result::BadArgument;
+            if (out.type == CommandType::Dose && out.arg == 0)
+                return Result::BadArgument;
+            if (out.type == CommandType::Start && out.arg > WATERING_MAX_MANUAL_SEC)
+                return Result::BadArgument;
+            if (tk.next(tok, len))
+                return Result::BadArgument; // 多余的 token
+        }
+        return Result::Ok;
+    }
+}
+
+#endif
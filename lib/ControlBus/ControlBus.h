@@ -0,0 +1,111 @@
+#ifndef CONTROL_BUS_H
+#define CONTROL_BUS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include "SpscQueue.h"
+#include "../WateringCore/RunEvent.h"
+
+// 网络任务 -> 控制任务 的指令
+enum class CommandType : uint8_t
+{
+    Start,  // forceWatering
+    Stop,   // stopWatering
+    Reset,  // resetSystem
+    Kill,   // killSystem
+    Revive, // reviveSystem
+    Info,   // reportDeviceStatus (arg: INFO_BINARY_ONLY = 只要二进制状态帧)
+    History, // reportHistory (只读查询，网络任务直接处理)
+    Dose     // forceWatering 按量 (arg: 毫升，需要流量计)
+};
+
+// Info 的 arg：二进制协议的 info 只回状态帧 (文本指令解析不出负数)
+const int32_t INFO_BINARY_ONLY = -1;
+
+struct Command
+{
+    CommandType type;
+    int16_t zone; // -1 表示未指定 (由控制任务决定默认值)
+    int32_t arg;  // 预留参数 (如时长、水量)
+#ifdef WATERING_METRICS
+    uint32_t receivedUs; // 收到 MQTT 消息时的 micros() (cmd_to_relay 指标的起点)
+#endif
+};
+
+// 控制任务 -> 网络任务 的事件
+enum class EventType : uint8_t
+{
+    Notify, // 状态文本，原样发布到 status topic
+    Report, // 请求网络任务上报完整设备状态 (快照已经拍好，见 SeqLock)
+    ReportBinary, // 同上，只发二进制状态帧
+    Run     // 结构化运行事件 (run 字段)，编码后发布到二进制 status topic
+};
+
+struct Event
+{
+    EventType type;
+    char text[72];
+    RunEvent run;
+};
+
+// 两个任务之间唯一的通信通道：一对 SPSC 队列
+// 网络任务只 push 指令、pop 事件；控制任务只 pop 指令、push 事件
+class ControlBus
+{
+public:
+    static const uint32_t COMMAND_DEPTH = 16;
+    static const uint32_t EVENT_DEPTH = 32;
+
+    SpscQueue<Command, COMMAND_DEPTH> commands;
+    SpscQueue<Event, EVENT_DEPTH> events;
+
+    // 队列满时丢弃的数量 (两端各自只写自己的计数)
+    std::atomic<uint32_t> droppedCommands{0};
+    std::atomic<uint32_t> droppedEvents{0};
+
+    // [网络任务] 投递指令，队列满返回 false
+    bool postCommand(CommandType type, int16_t zone = -1, int32_t arg = 0)
+    {
+        return postCommand(Command{type, zone, arg});
+    }
+
+    bool postCommand(const Command &cmd)
+    {
+        if (commands.push(cmd))
+            return true;
+        droppedCommands.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // [控制任务] 投递事件，text 超长会被截断
+    bool postEvent(EventType type, const char *text = "")
+    {
+        Event ev;
+        ev.type = type;
+        strncpy(ev.text, text ? text : "", sizeof(ev.text) - 1);
+        ev.text[sizeof(ev.text) - 1] = '\0';
+        return pushEvent(ev);
+    }
+
+    // [控制任务] 投递结构化运行事件
+    bool postRun(const RunEvent &run)
+    {
+        Event ev;
+        ev.type = EventType::Run;
+        ev.text[0] = '\0';
+        ev.run = run;
+        return pushEvent(ev);
+    }
+
+private:
+    bool pushEvent(const Event &ev)
+    {
+        if (events.push(ev))
+            return true;
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef PERIODIC_TASK_H
+#define PERIODIC_TASK_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_task_wdt.h>
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+// 周期任务：固定节拍反复调用 body()
+// - ESP32：FreeRTOS 任务，绑定到指定核心，可选自动注册/喂看门狗
+// - native：std::thread 实现，接口相同，方便在电脑上做并发压测
+class PeriodicTask
+{
+public:
+    typedef std::function<void(void)> Body;
+
+private:
+    Body body = nullptr;
+    uint32_t periodMs = 10;
+    bool watchdog = true;
+    std::atomic<bool> running{false};
+
+#ifdef ARDUINO
+    TaskHandle_t handle = nullptr;
+
+    static void trampoline(void *arg)
+    {
+        PeriodicTask *self = static_cast<PeriodicTask *>(arg);
+        if (self->watchdog)
+            esp_task_wdt_add(NULL);
+
+        TickType_t lastWake = xTaskGetTickCount();
+        while (self->running.load())
+        {
+            if (self->watchdog)
+                esp_task_wdt_reset();
+            self->body();
+
+            if (self->periodMs == 0)
+                taskYIELD();
+            else
+                vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(self->periodMs));
+        }
+
+        if (self->watchdog)
+            esp_task_wdt_delete(NULL);
+        self->handle = nullptr;
+        vTaskDelete(NULL);
+    }
+#else
+    std::thread worker;
+#endif
+
+public:
+    PeriodicTask() {}
+    PeriodicTask(const PeriodicTask &) = delete;
+    PeriodicTask &operator=(const PeriodicTask &) = delete;
+    ~PeriodicTask() { stop(); }
+
+    // 启动任务；stackBytes / priority / core 只在 ESP32 上生效
+    bool start(const char *name, Body fn, uint32_t period, uint32_t stackBytes,
+               uint8_t priority, int core, bool useWatchdog = true)
+    {
+        if (running.load() || !fn)
+            return false;
+
+        body = fn;
+        periodMs = period;
+        watchdog = useWatchdog;
+        running.store(true);
+
+#ifdef ARDUINO
+        BaseType_t ok = xTaskCreatePinnedToCore(trampoline, name, stackBytes, this,
+                                                priority, &handle, core);
+        if (ok != pdPASS)
+        {
+            running.store(false);
+            return false;
+        }
+#else
+        (void)name;
+        (void)stackBytes;
+        (void)priority;
+        (void)core;
+        worker = std::thread([this]()
+                             {
+            while (running.load()) {
+                body();
+                if (periodMs == 0)
+                    std::this_thread::yield();
+                else
+                    std::this_thread::sleep_for(std::chrono::milliseconds(periodMs));
+            } });
+#endif
+        return true;
+    }
+
+    // 请求停止；native 下等待线程退出
+    void stop()
+    {
+        running.store(false);
+#ifndef ARDUINO
+        if (worker.joinable())
+            worker.join();
+#endif
+    }
+
+    bool isRunning() const { return running.load(); }
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SEQ_LOCK_H
+#define SEQ_LOCK_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+// 单写者的顺序锁：写者原地改一份数据，读者拷一份完整的出去
+// - 写之前序号变奇数，写完变偶数；读者拷贝前后序号一致且为偶数，才算拷到了完整的一份
+// - 写者从不等待读者 (控制任务不会被网络任务拖住)；读者在写者一直在改时重试，次数用完放弃
+// - T 必须可以按字节拷贝，不做堆内存分配
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock payload must be trivially copyable");
+
+private:
+    std::atomic<uint32_t> seq{0}; // 0 = 还没写过
+    T value;
+
+public:
+    // 写者 (只能有一个任务)：fill(T&) 原地填写，不经过栈上的副本
+    template <typename Fill>
+    void write(Fill fill)
+    {
+        uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        fill(value);
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    // 读者：拷到 out；还没写过、或 tries 次都撞上写者时返回 false (out 内容无效)
+    bool read(T &out, uint16_t tries = 64) const
+    {
+        while (tries--)
+        {
+            uint32_t before = seq.load(std::memory_order_acquire);
+            if (before == 0)
+                return false;
+            if (before & 1)
+                continue;
+            memcpy((void *)&out, (const void *)&value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == before)
+                return true;
+        }
+        return false;
+    }
+
+    // 写过几次 (统计 / 测试用)
+    uint32_t writes() const { return seq.load(std::memory_order_acquire) / 2; }
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+// 有界、无锁的单生产者/单消费者环形队列
+// - 只允许一个任务 push、另一个任务 pop
+// - 槽位在对象内静态分配，不做堆内存分配
+// - 容量 N 必须是 2 的幂 (下标用位与代替取模)
+template <typename T, uint32_t N>
+class SpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+private:
+    T slots[N];
+    // head 只由消费者写，tail 只由生产者写；计数自由增长，溢出后相减仍正确
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+
+public:
+    // 生产者：满了返回 false (不阻塞，由调用方决定丢弃策略)
+    bool push(const T &item)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= N)
+            return false;
+        slots[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者：空了返回 false
+    bool pop(T &out)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        out = slots[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 近似值 (另一端可能同时在改)，仅用于统计
+    uint32_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+    static constexpr uint32_t capacity() { return N; }
+};
+
+#endif
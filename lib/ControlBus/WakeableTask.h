@@ -0,0 +1,158 @@
+#ifndef WAKEABLE_TASK_H
+#define WAKEABLE_TASK_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_task_wdt.h>
+#include "../Metrics/HeapStats.h" // 任务栈记在 Heap::Tasks 名下
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// 事件驱动任务：body() 返回 "下一次最晚什么时候再叫我" (毫秒)，
+// 任务就阻塞到那个时刻，或者被别的任务 wake() 提前叫醒
+// - ESP32：FreeRTOS 任务通知 (ulTaskNotifyTake)，阻塞期间 CPU 可以进入 light sleep
+// - native：std::condition_variable 实现，接口相同
+// 与 PeriodicTask 的区别：没有固定节拍，空闲时不会每 10ms 醒一次
+class WakeableTask
+{
+public:
+    typedef std::function<uint32_t(void)> Body;
+    static const uint32_t FOREVER = UINT32_MAX;
+
+private:
+    Body body = nullptr;
+    uint32_t maxSleepMs = FOREVER; // 看门狗要求的最长阻塞时间
+    bool watchdog = true;
+    std::atomic<bool> running{false};
+    std::atomic<uint32_t> wakeups{0}; // 被 wake() 叫醒的次数
+
+    uint32_t clampWait(uint32_t ms) const { return ms < maxSleepMs ? ms : maxSleepMs; }
+
+#ifdef ARDUINO
+    TaskHandle_t handle = nullptr;
+    uint32_t stackSize = 0;
+
+    static void trampoline(void *arg)
+    {
+        WakeableTask *self = static_cast<WakeableTask *>(arg);
+        if (self->watchdog)
+            esp_task_wdt_add(NULL);
+
+        while (self->running.load())
+        {
+            if (self->watchdog)
+                esp_task_wdt_reset();
+            uint32_t wait = self->clampWait(self->body());
+
+            if (wait == 0)
+                taskYIELD();
+            else
+                ulTaskNotifyTake(pdTRUE, wait == FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(wait));
+        }
+
+        if (self->watchdog)
+            esp_task_wdt_delete(NULL);
+        Heap::noteFree(Heap::Tasks, self->stackSize); // 栈由 idle 任务随后释放
+        self->handle = nullptr;
+        vTaskDelete(NULL);
+    }
+#else
+    std::thread worker;
+    std::mutex m;
+    std::condition_variable cv;
+    bool pending = false;
+#endif
+
+public:
+    WakeableTask() {}
+    WakeableTask(const WakeableTask &) = delete;
+    WakeableTask &operator=(const WakeableTask &) = delete;
+    ~WakeableTask() { stop(); }
+
+    // 启动任务；maxSleep 是单次最长阻塞时间 (要小于看门狗超时)
+    // stackBytes / priority / core 只在 ESP32 上生效
+    bool start(const char *name, Body fn, uint32_t maxSleep, uint32_t stackBytes,
+               uint8_t priority, int core, bool useWatchdog = true)
+    {
+        if (running.load() || !fn)
+            return false;
+
+        body = fn;
+        maxSleepMs = maxSleep;
+        watchdog = useWatchdog;
+        running.store(true);
+
+#ifdef ARDUINO
+        stackSize = stackBytes;
+        BaseType_t ok = xTaskCreatePinnedToCore(trampoline, name, stackBytes, this,
+                                                priority, &handle, core);
+        Heap::note(Heap::Tasks, stackBytes, ok == pdPASS);
+        if (ok != pdPASS)
+        {
+            running.store(false);
+            return false;
+        }
+#else
+        (void)name;
+        (void)stackBytes;
+        (void)priority;
+        (void)core;
+        worker = std::thread([this]()
+                             {
+            while (running.load()) {
+                uint32_t wait = clampWait(body());
+                std::unique_lock<std::mutex> lk(m);
+                if (wait == FOREVER)
+                    cv.wait(lk, [this] { return pending || !running.load(); });
+                else
+                    cv.wait_for(lk, std::chrono::milliseconds(wait), [this] { return pending || !running.load(); });
+                pending = false;
+            } });
+#endif
+        return true;
+    }
+
+    // 从其它任务叫醒它 (例如投递了新指令)；可以重复调用，多次唤醒会合并
+    void wake()
+    {
+        wakeups.fetch_add(1, std::memory_order_relaxed);
+#ifdef ARDUINO
+        if (handle)
+            xTaskNotifyGive(handle);
+#else
+        {
+            std::lock_guard<std::mutex> lk(m);
+            pending = true;
+        }
+        cv.notify_one();
+#endif
+    }
+
+    // 请求停止；native 下等待线程退出
+    void stop()
+    {
+        running.store(false);
+#ifdef ARDUINO
+        if (handle)
+            xTaskNotifyGive(handle);
+#else
+        cv.notify_one();
+        if (worker.joinable())
+            worker.join();
+#endif
+    }
+
+    bool isRunning() const { return running.load(); }
+
+    uint32_t wakeCount() const { return wakeups.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef FLOW_METER_H
+#define FLOW_METER_H
+
+#include <stdint.h>
+#include "../Hal/Hal.h" // MockPulseCounter 用 millis() / digitalRead()
+
+#ifdef ARDUINO
+#include <driver/pcnt.h>
+#endif
+
+// 流量计脉冲计数器：只提供一个单调递增的 32 位累计脉冲数
+// 读数由 FlowDose 做差，回绕不影响；谁来计数 (硬件 / 模拟) 对上层透明
+class PulseCounter
+{
+public:
+    virtual ~PulseCounter() {}
+    virtual uint32_t pulses() = 0;
+};
+
+// 模拟流量计 (native 测试 / 仿真)：继电器引脚为低 (水泵在转) 时按设定流速产生脉冲
+// 在虚拟时钟上积分，读得越稀疏结果也一样，不会丢掉零头
+class MockPulseCounter : public PulseCounter
+{
+private:
+    int relayPin;
+    uint32_t milliPulsesPerSec; // 流速 (脉冲/秒 × 1000)
+    uint32_t count = 0;
+    uint32_t residue = 0; // 不足一个脉冲的零头 (脉冲 × 1e6)
+    uint32_t lastMs;
+
+    void integrate()
+    {
+        uint32_t now = (uint32_t)millis();
+        uint32_t dt = now - lastMs;
+        lastMs = now;
+        if (relayPin >= 0 && digitalRead(relayPin) != LOW)
+            return;
+        uint64_t acc = (uint64_t)milliPulsesPerSec * dt + residue;
+        count += (uint32_t)(acc / 1000000);
+        residue = (uint32_t)(acc % 1000000);
+    }
+
+public:
+    // relayPin < 0：不看继电器，一直按流速计数
+    explicit MockPulseCounter(int relayPin = -1, uint32_t milliPulsesPerSec = 0)
+        : relayPin(relayPin), milliPulsesPerSec(milliPulsesPerSec), lastMs((uint32_t)millis()) {}
+
+    // 改变流速 (水压变化 / 水箱见底)：之前的时间按旧流速结算
+    void setFlow(uint32_t milliPps)
+    {
+        integrate();
+        milliPulsesPerSec = milliPps;
+    }
+
+    // 直接加脉冲 (不依赖时钟的单元测试)
+    void inject(uint32_t n)
+    {
+        integrate();
+        count += n;
+    }
+
+    uint32_t pulses() override
+    {
+        integrate();
+        return count;
+    }
+};
+
+#ifdef ARDUINO
+// PCNT 硬件计数器的溢出点：计到这里硬件自动清零并触发一次中断
+#ifndef FLOW_PCNT_LIMIT
+#define FLOW_PCNT_LIMIT 30000
+#endif
+
+// ESP32 PCNT 硬件计数：脉冲由外设累加，CPU 不进中断
+// 1. 只数上升沿，带毛刺滤波 (短于约 12us 的抖动不计)
+// 2. 计数器只有 16 位：每 FLOW_PCNT_LIMIT 个脉冲一次溢出中断，把高位记在 wraps 里
+//    (10 L/min 时约 7 分钟一次)；大流量也不会给 CPU 增加中断负担
+// 3. pulses() = wraps × LIMIT + 当前计数，读的时候防溢出中断插进来，并保证单调
+class PcntCounter : public PulseCounter
+{
+private:
+    pcnt_unit_t unit = PCNT_UNIT_0;
+    volatile uint32_t wraps = 0;
+    uint32_t last = 0;
+
+    static void IRAM_ATTR onLimit(void *arg)
+    {
+        PcntCounter *self = (PcntCounter *)arg;
+        self->wraps = self->wraps + 1;
+    }
+
+public:
+    // pin：流量计信号脚 (开漏输出，需要上拉)；unit：PCNT 单元 (ESP32-S3 有 4 个)
+    bool begin(int pin, uint8_t unitIndex)
+    {
+        unit = (pcnt_unit_t)unitIndex;
+        pinMode(pin, INPUT_PULLUP);
+
+        pcnt_config_t cfg = {};
+        cfg.pulse_gpio_num = pin;
+        cfg.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+        cfg.channel = PCNT_CHANNEL_0;
+        cfg.unit = unit;
+        cfg.pos_mode = PCNT_COUNT_INC;
+        cfg.neg_mode = PCNT_COUNT_DIS;
+        cfg.lctrl_mode = PCNT_MODE_KEEP;
+        cfg.hctrl_mode = PCNT_MODE_KEEP;
+        cfg.counter_h_lim = FLOW_PCNT_LIMIT;
+        cfg.counter_l_lim = 0;
+        if (pcnt_unit_config(&cfg) != ESP_OK)
+            return false;
+
+        pcnt_set_filter_value(unit, 1023); // APB 时钟周期数 (80MHz 下约 12.8us)
+        pcnt_filter_enable(unit);
+        pcnt_event_enable(unit, PCNT_EVT_H_LIM);
+        pcnt_counter_pause(unit);
+        pcnt_counter_clear(unit);
+
+        // 中断服务可能已经被别的单元装过
+        esp_err_t r = pcnt_isr_service_install(0);
+        if (r != ESP_OK && r != ESP_ERR_INVALID_STATE)
+            return false;
+        if (pcnt_isr_handler_add(unit, onLimit, this) != ESP_OK)
+            return false;
+        return pcnt_counter_resume(unit) == ESP_OK;
+    }
+
+    uint32_t pulses() override
+    {
+        uint32_t w;
+        int16_t c = 0;
+        do
+        {
+            w = wraps;
+            pcnt_get_counter_value(unit, &c);
+        } while (w != wraps);
+        uint32_t v = w * FLOW_PCNT_LIMIT + (uint32_t)c;
+        // 计数器刚清零、溢出中断还没执行时读数会小一圈：沿用上一次，保持单调
+        if ((int32_t)(v - last) < 0)
+            v = last;
+        last = v;
+        return v;
+    }
+};
+#endif
+
+#endif
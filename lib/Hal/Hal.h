@@ -0,0 +1,15 @@
+#ifndef HAL_H
+#define HAL_H
+
+// 硬件抽象层：业务代码只通过 Arduino 风格的 API 访问时间、GPIO、Preferences 和 Serial
+// - ESP32：直接使用 Arduino 框架，零开销
+// - native：HostHal.h 里的主机实现，时间由虚拟时钟驱动 (delay() 立即返回并拨快时钟)，
+//   WateringSystem 因此可以整体在主机上编译，测试和多年仿真不用真的等待
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <Preferences.h>
+#else
+#include "HostHal.h"
+#endif
+
+#endif
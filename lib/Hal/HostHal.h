@@ -0,0 +1,246 @@
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+// Hal.h 的主机实现 (native 环境)：提供 WateringSystem 用到的 Arduino API 子集
+// - 时间：虚拟时钟，只有 delay() / HostHal::advanceMs() 会让它前进
+// - GPIO：记录电平，统计每个引脚拉低 (继电器吸合) 的次数和累计时长
+// - Preferences：进程内的键值表，重新 begin() 能读到之前写的值 (模拟 NVS 掉电保持)
+// - Serial：默认静默，HostHal::setSerialEcho(true) 后输出到 stdout
+// 状态按线程隔离 (thread_local)：每个线程就是一台独立的设备，仿真可以多线程并行；
+// 换设备前调用 HostHal::reset()
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+namespace HostHal
+{
+    // 虚拟时钟 (微秒，64 位不会溢出；millis() 仍按 32 位回绕，和真机一致)
+    class VirtualClock
+    {
+    private:
+        uint64_t nowUs = 0;
+
+    public:
+        uint64_t micros64() const { return nowUs; }
+        uint64_t millis64() const { return nowUs / 1000; }
+        void advanceUs(uint64_t us) { nowUs += us; }
+        void reset() { nowUs = 0; }
+    };
+
+    // GPIO：低电平触发的继电器吸合时，统计下降沿次数和低电平累计时长
+    class Gpio
+    {
+    public:
+        static const uint8_t PIN_COUNT = 64;
+
+    private:
+        uint8_t level[PIN_COUNT];
+        uint8_t mode[PIN_COUNT];
+        uint64_t lowSinceUs[PIN_COUNT];
+        uint64_t lowTotalUs[PIN_COUNT];
+        uint32_t falling[PIN_COUNT];
+
+    public:
+        Gpio() { reset(); }
+
+        void reset()
+        {
+            memset(level, HIGH, sizeof(level));
+            memset(mode, INPUT, sizeof(mode));
+            memset(lowSinceUs, 0, sizeof(lowSinceUs));
+            memset(lowTotalUs, 0, sizeof(lowTotalUs));
+            memset(falling, 0, sizeof(falling));
+        }
+
+        void setMode(uint8_t pin, uint8_t m)
+        {
+            if (pin < PIN_COUNT)
+                mode[pin] = m;
+        }
+
+        void write(uint8_t pin, uint8_t v, uint64_t nowUs)
+        {
+            if (pin >= PIN_COUNT)
+                return;
+            v = v ? HIGH : LOW;
+            if (v == level[pin])
+                return;
+            if (v == LOW)
+            {
+                falling[pin]++;
+                lowSinceUs[pin] = nowUs;
+            }
+            else
+            {
+                lowTotalUs[pin] += nowUs - lowSinceUs[pin];
+            }
+            level[pin] = v;
+        }
+
+        uint8_t read(uint8_t pin) const { return pin < PIN_COUNT ? level[pin] : LOW; }
+        uint8_t getMode(uint8_t pin) const { return pin < PIN_COUNT ? mode[pin] : INPUT; }
+
+        // 断电：所有引脚释放 (继电器断开)，结算低电平时长；统计值保留
+        void powerOff(uint64_t nowUs)
+        {
+            for (uint8_t pin = 0; pin < PIN_COUNT; pin++)
+            {
+                write(pin, HIGH, nowUs);
+                mode[pin] = INPUT;
+            }
+        }
+
+        uint32_t fallingEdges(uint8_t pin) const { return pin < PIN_COUNT ? falling[pin] : 0; }
+
+        // 累计低电平时长 (正处于低电平的引脚算到 nowUs 为止)
+        uint64_t lowTimeUs(uint8_t pin, uint64_t nowUs) const
+        {
+            if (pin >= PIN_COUNT)
+                return 0;
+            return lowTotalUs[pin] + (level[pin] == LOW ? nowUs - lowSinceUs[pin] : 0);
+        }
+    };
+
+    // Preferences 的存储：命名空间 -> (键 -> 值)，值统一按 int32 保存
+    typedef std::map<std::string, int32_t> NvsNamespace;
+
+    struct State
+    {
+        VirtualClock clock;
+        Gpio gpio;
+        std::map<std::string, NvsNamespace> nvs;
+        bool serialEcho = false;
+    };
+
+    inline State &state()
+    {
+        static thread_local State s;
+        return s;
+    }
+
+    // 换一台设备：时钟归零、引脚复位、NVS 清空
+    inline void reset()
+    {
+        State &s = state();
+        s.clock.reset();
+        s.gpio.reset();
+        s.nvs.clear();
+    }
+
+    inline void advanceMs(uint64_t ms) { state().clock.advanceUs(ms * 1000); }
+    inline uint64_t nowMs() { return state().clock.millis64(); }
+    inline Gpio &gpio() { return state().gpio; }
+    inline void setSerialEcho(bool on) { state().serialEcho = on; }
+}
+
+inline unsigned long millis() { return (uint32_t)HostHal::state().clock.millis64(); }
+inline unsigned long micros() { return (uint32_t)HostHal::state().clock.micros64(); }
+inline void delay(unsigned long ms) { HostHal::advanceMs(ms); }
+inline void delayMicroseconds(unsigned int us) { HostHal::state().clock.advanceUs(us); }
+inline void yield() {}
+
+inline void pinMode(uint8_t pin, uint8_t mode) { HostHal::state().gpio.setMode(pin, mode); }
+inline void digitalWrite(uint8_t pin, uint8_t val)
+{
+    HostHal::State &s = HostHal::state();
+    s.gpio.write(pin, val, s.clock.micros64());
+}
+inline int digitalRead(uint8_t pin) { return HostHal::state().gpio.read(pin); }
+
+class HostSerial
+{
+public:
+    void begin(unsigned long) {}
+
+    size_t print(const char *s)
+    {
+        if (!HostHal::state().serialEcho)
+            return 0;
+        return fputs(s, stdout) < 0 ? 0 : strlen(s);
+    }
+
+    size_t println(const char *s = "")
+    {
+        if (!HostHal::state().serialEcho)
+            return 0;
+        size_t n = print(s);
+        fputc('\n', stdout);
+        return n + 1;
+    }
+
+    // 静默时不做格式化，仿真里的日志开销接近 0
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+    {
+        if (!HostHal::state().serialEcho)
+            return 0;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vprintf(fmt, ap);
+        va_end(ap);
+        return n > 0 ? (size_t)n : 0;
+    }
+};
+
+inline HostSerial Serial;
+
+// 与 Arduino-ESP32 的 Preferences 接口一致 (只实现本项目用到的部分)
+class Preferences
+{
+private:
+    HostHal::NvsNamespace *ns = nullptr;
+    bool readOnly = false;
+
+    bool writable() const { return ns && !readOnly; }
+
+public:
+    bool begin(const char *name, bool _readOnly = false)
+    {
+        ns = &HostHal::state().nvs[name];
+        readOnly = _readOnly;
+        return true;
+    }
+
+    void end() { ns = nullptr; }
+
+    bool clear()
+    {
+        if (!writable())
+            return false;
+        ns->clear();
+        return true;
+    }
+
+    bool remove(const char *key) { return writable() && ns->erase(key) > 0; }
+    bool isKey(const char *key) const { return ns && ns->count(key) > 0; }
+
+    int32_t getInt(const char *key, int32_t defaultValue = 0) const
+    {
+        if (!ns)
+            return defaultValue;
+        HostHal::NvsNamespace::const_iterator it = ns->find(key);
+        return it == ns->end() ? defaultValue : it->second;
+    }
+
+    size_t putInt(const char *key, int32_t value)
+    {
+        if (!writable())
+            return 0;
+        (*ns)[key] = value;
+        return sizeof(value);
+    }
+
+    bool getBool(const char *key, bool defaultValue = false) const { return getInt(key, defaultValue ? 1 : 0) != 0; }
+    size_t putBool(const char *key, bool value) { return putInt(key, value ? 1 : 0) ? 1 : 0; }
+};
+
+#endif
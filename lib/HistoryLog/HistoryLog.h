@@ -0,0 +1,405 @@
+#ifndef HISTORY_LOG_H
+#define HISTORY_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+
+// 一次浇水的触发来源
+enum class RunTrigger : uint8_t
+{
+    Auto = 0,   // 定时计划
+    Manual = 1  // MQTT start 指令
+};
+
+// 一次浇水运行的记录 (解码后的形式)
+struct RunRecord
+{
+    int64_t start = 0;        // 开始时刻 (本地 epoch 秒，0 表示当时还没同步时间)
+    uint32_t durationSec = 0; // 实际运行时长
+    uint16_t zone = 0;
+    bool aborted = false;
+    RunTrigger trigger = RunTrigger::Auto;
+};
+
+// 浇水历史：Flash 上的环形日志，每条记录差分编码后只有 6~8 字节
+//
+// 存储布局：与 StateJournal 相同的 Flash 接口，一组扇区轮流使用
+//   扇区头 [magic][seq][~seq]  12 字节，擦除后立即写入
+//   记录   [len][flags][zone varint][Δstart zigzag varint][duration varint][crc8]
+// - 每个扇区的第一条记录的 Δstart 以 0 为基准 (即绝对时间)，扇区可以独立解码
+// - 写满时擦除最旧的扇区继续写，历史自动滚动
+// - 追加来自控制任务，查询来自网络任务，内部用互斥锁保护 (临界区只有几次 Flash 读写)
+template <typename Flash, uint16_t MAX_SECTORS = 64>
+class HistoryLog
+{
+public:
+    struct Stats
+    {
+        uint32_t records;     // 当前保存的记录数
+        uint32_t sectors;     // 使用中的扇区数
+        uint32_t bytesUsed;   // 记录占用的字节
+        uint32_t evicted;     // 被滚动覆盖掉的记录数
+        uint32_t corruptTails; // begin() 发现的断尾次数
+    };
+
+private:
+    static const uint32_t SECTOR_MAGIC = 0x31485357; // "WSH1"
+    static const uint32_t HEADER_SIZE = 12;
+    static const uint8_t MAX_PAYLOAD = 1 + 3 + 10 + 5; // flags + zone + Δstart + duration
+    static const uint32_t NO_SECTOR = 0xFFFFFFFF;
+
+    Flash &flash;
+    std::mutex lock;
+    bool ready = false;
+
+    uint32_t sectors = 0;
+    uint16_t countOf[MAX_SECTORS]; // 每个扇区的记录数 (无效扇区为 0)
+    uint32_t seqOf[MAX_SECTORS];
+    bool validOf[MAX_SECTORS];
+
+    uint32_t head = NO_SECTOR; // 正在写入的 (最新的) 扇区
+    uint32_t writePos = 0;
+    int64_t prevStart = 0;     // head 扇区里上一条记录的开始时刻 (差分基准)
+    uint32_t total = 0;
+    Stats stats = {};
+
+    // CRC-8 (多项式 0x07)，半字节查表：begin() 要逐条校验整个分区
+    static uint8_t crc8(const uint8_t *p, size_t n)
+    {
+        static const uint8_t table[16] = {0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+                                          0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D};
+        uint8_t crc = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            crc ^= p[i];
+            crc = (uint8_t)(crc << 4) ^ table[crc >> 4];
+            crc = (uint8_t)(crc << 4) ^ table[crc >> 4];
+        }
+        return crc;
+    }
+
+    static size_t putVarint(uint8_t *p, uint64_t v)
+    {
+        size_t n = 0;
+        while (v >= 0x80)
+        {
+            p[n++] = (uint8_t)(v | 0x80);
+            v >>= 7;
+        }
+        p[n++] = (uint8_t)v;
+        return n;
+    }
+
+    static bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t &v)
+    {
+        v = 0;
+        for (int shift = 0; p < end && shift < 64; shift += 7)
+        {
+            uint8_t b = *p++;
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    static uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+    static int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+    static void put32(uint8_t *p, uint32_t v)
+    {
+        for (int i = 0; i < 4; i++)
+            p[i] = (uint8_t)(v >> (8 * i));
+    }
+    static uint32_t get32(const uint8_t *p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    // 编码一条记录 (含长度和校验字节)，返回总字节数
+    static size_t encode(const RunRecord &r, int64_t base, uint8_t *out)
+    {
+        uint8_t *p = out + 1;
+        *p++ = (uint8_t)((r.aborted ? 1 : 0) | ((uint8_t)r.trigger << 1));
+        p += putVarint(p, r.zone);
+        p += putVarint(p, zigzag(r.start - base));
+        p += putVarint(p, r.durationSec);
+        out[0] = (uint8_t)(p - out - 1);
+        *p = crc8(out, (size_t)(p - out));
+        return (size_t)(p - out) + 1;
+    }
+
+    // 读取 sector 内 pos 处的一条记录；返回 0 表示空白，-1 表示损坏，否则为记录长度
+    int decodeAt(uint32_t sector, uint32_t pos, int64_t base, RunRecord &r)
+    {
+        const uint32_t ss = flash.sectorSize();
+        uint8_t buf[MAX_PAYLOAD + 2];
+        if (pos >= ss || !flash.read(sector * ss + pos, buf, 1))
+            return -1;
+        if (buf[0] == 0xFF)
+            return 0;
+        uint32_t len = buf[0];
+        if (len == 0 || len > MAX_PAYLOAD || pos + len + 2 > ss)
+            return -1;
+        if (!flash.read(sector * ss + pos, buf, len + 2) || crc8(buf, len + 1) != buf[len + 1])
+            return -1;
+
+        const uint8_t *p = buf + 1;
+        const uint8_t *end = buf + 1 + len;
+        uint8_t flags = *p++;
+        uint64_t zone, delta, duration;
+        if (!getVarint(p, end, zone) || !getVarint(p, end, delta) || !getVarint(p, end, duration))
+            return -1;
+        r.aborted = flags & 1;
+        r.trigger = (RunTrigger)((flags >> 1) & 0x07);
+        r.zone = (uint16_t)zone;
+        r.start = base + unzigzag(delta);
+        r.durationSec = (uint32_t)duration;
+        return (int)(len + 2);
+    }
+
+    bool readHeader(uint32_t sector, uint32_t &seq)
+    {
+        uint8_t h[HEADER_SIZE];
+        if (!flash.read(sector * flash.sectorSize(), h, HEADER_SIZE))
+            return false;
+        if (get32(h) != SECTOR_MAGIC || get32(h + 8) != ~get32(h + 4))
+            return false;
+        seq = get32(h + 4);
+        return true;
+    }
+
+    // 扫描一个扇区：统计记录数，返回 false 表示有断尾
+    bool scan(uint32_t sector, uint16_t &count, uint32_t &endPos, int64_t &last)
+    {
+        uint32_t pos = HEADER_SIZE;
+        int64_t base = 0;
+        count = 0;
+        RunRecord r;
+        for (;;)
+        {
+            int n = decodeAt(sector, pos, base, r);
+            if (n <= 0)
+            {
+                endPos = pos;
+                last = base;
+                return n == 0 || pos + 2 > flash.sectorSize();
+            }
+            base = r.start;
+            pos += (uint32_t)n;
+            count++;
+        }
+    }
+
+    // 擦除下一个扇区 (丢掉最旧的记录) 并写入扇区头
+    bool rotate()
+    {
+        uint32_t next = head == NO_SECTOR ? 0 : (head + 1) % sectors;
+        uint32_t seq = head == NO_SECTOR ? 1 : seqOf[head] + 1;
+
+        if (validOf[next])
+        {
+            stats.evicted += countOf[next];
+            total -= countOf[next];
+        }
+        validOf[next] = false;
+        countOf[next] = 0;
+        if (!flash.eraseSector(next))
+            return false;
+
+        uint8_t h[HEADER_SIZE];
+        put32(h, SECTOR_MAGIC);
+        put32(h + 4, seq);
+        put32(h + 8, ~seq);
+        if (!flash.write(next * flash.sectorSize(), h, HEADER_SIZE))
+            return false;
+
+        validOf[next] = true;
+        seqOf[next] = seq;
+        head = next;
+        writePos = HEADER_SIZE;
+        prevStart = 0;
+        return true;
+    }
+
+    // 从最旧到最新的第 i 个有效扇区 (有效扇区在环上是连续的，以 head 结尾)
+    uint32_t sectorAtAge(uint32_t i, uint32_t used) const
+    {
+        return (head + sectors - (used - 1 - i)) % sectors;
+    }
+
+    uint32_t usedSectors() const
+    {
+        if (head == NO_SECTOR)
+            return 0;
+        uint32_t n = 1;
+        while (n < sectors)
+        {
+            uint32_t s = (head + sectors - n) % sectors;
+            if (!validOf[s] || seqOf[s] != seqOf[head] - n)
+                break;
+            n++;
+        }
+        return n;
+    }
+
+public:
+    explicit HistoryLog(Flash &_flash) : flash(_flash) {}
+
+    // 挂载并扫描全部扇区
+    bool begin()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ready = false;
+        head = NO_SECTOR;
+        total = 0;
+        stats = {};
+
+        if (!flash.begin() || flash.sectorCount() < 2)
+            return false;
+        sectors = flash.sectorCount() < MAX_SECTORS ? flash.sectorCount() : MAX_SECTORS;
+
+        for (uint32_t s = 0; s < sectors; s++)
+        {
+            countOf[s] = 0;
+            validOf[s] = readHeader(s, seqOf[s]);
+            if (validOf[s] && (head == NO_SECTOR || (int32_t)(seqOf[s] - seqOf[head]) > 0))
+                head = s;
+        }
+        ready = true;
+        if (head == NO_SECTOR)
+            return true;
+
+        // 只统计与 head 连续的扇区，更旧的残留扇区视为无效
+        uint32_t used = usedSectors();
+        for (uint32_t s = 0; s < sectors; s++)
+            validOf[s] = false;
+        for (uint32_t i = 0; i < used; i++)
+        {
+            uint32_t s = sectorAtAge(i, used);
+            uint32_t endPos;
+            int64_t last;
+            validOf[s] = true;
+            bool clean = scan(s, countOf[s], endPos, last);
+            total += countOf[s];
+            if (s == head)
+            {
+                writePos = clean ? endPos : flash.sectorSize(); // 断尾：下一条写到新扇区
+                prevStart = last;
+                if (!clean)
+                    stats.corruptTails++;
+            }
+        }
+        return true;
+    }
+
+    bool isReady() const { return ready; }
+
+    // 追加一条记录 (控制任务调用，一次几字节的 Flash 写入；写满时多一次扇区擦除)
+    bool append(const RunRecord &r)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!ready)
+            return false;
+
+        uint8_t buf[MAX_PAYLOAD + 2];
+        size_t len = encode(r, prevStart, buf);
+        if (head == NO_SECTOR || writePos + len > flash.sectorSize())
+        {
+            if (!rotate())
+                return false;
+            len = encode(r, prevStart, buf); // 新扇区的差分基准是 0
+        }
+
+        if (!flash.write(head * flash.sectorSize() + writePos, buf, (uint32_t)len))
+        {
+            writePos = flash.sectorSize(); // 这个位置不可信了
+            return false;
+        }
+        writePos += (uint32_t)len;
+        prevStart = r.start;
+        countOf[head]++;
+        total++;
+        return true;
+    }
+
+    uint32_t size()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return total;
+    }
+
+    // 按页读取，第 0 页是最新的 pageSize 条；out[0] 是该页里最新的一条
+    // 返回实际读到的条数
+    uint16_t readPage(uint32_t page, uint16_t pageSize, RunRecord *out)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!ready || pageSize == 0 || (uint64_t)page * pageSize >= total)
+            return 0;
+
+        // 本页覆盖的下标区间 [first, last] (0 = 最旧)
+        uint32_t last = total - 1 - page * pageSize;
+        uint32_t first = last + 1 >= pageSize ? last + 1 - pageSize : 0;
+        uint16_t n = (uint16_t)(last - first + 1);
+
+        uint32_t used = usedSectors();
+        uint32_t index = 0; // 当前扇区第一条记录的下标
+        for (uint32_t i = 0; i < used && index <= last; i++)
+        {
+            uint32_t s = sectorAtAge(i, used);
+            if (index + countOf[s] <= first)
+            {
+                index += countOf[s]; // 整个扇区都在本页之前，跳过
+                continue;
+            }
+
+            uint32_t pos = HEADER_SIZE;
+            int64_t base = 0;
+            for (uint16_t k = 0; k < countOf[s] && index <= last; k++, index++)
+            {
+                RunRecord r;
+                int len = decodeAt(s, pos, base, r);
+                if (len <= 0)
+                    return 0;
+                pos += (uint32_t)len;
+                base = r.start;
+                if (index >= first)
+                    out[last - index] = r;
+            }
+        }
+        return n;
+    }
+
+    // 清空全部历史
+    bool clear()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        head = NO_SECTOR;
+        total = 0;
+        if (!ready)
+            return false;
+        for (uint32_t s = 0; s < sectors; s++)
+        {
+            validOf[s] = false;
+            countOf[s] = 0;
+            if (!flash.eraseSector(s))
+                return false;
+        }
+        return true;
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        Stats s = stats;
+        s.records = total;
+        s.sectors = usedSectors();
+        s.bytesUsed = 0;
+        if (head != NO_SECTOR)
+            s.bytesUsed = (s.sectors - 1) * flash.sectorSize() + writePos;
+        return s;
+    }
+};
+
+#endif
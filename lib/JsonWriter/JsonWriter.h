@@ -0,0 +1,249 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// 输出目标：JsonWriter 产生的字节都流向这里
+// 可以是计数器、调用方提供的定长缓冲区，或者直接是网络连接
+class JsonSink
+{
+public:
+    virtual ~JsonSink() {}
+    virtual void write(const char *data, size_t len) = 0;
+};
+
+// 只数字节，不存内容 (用于 "先算长度、再流式发送" 的第一遍)
+class CountingSink : public JsonSink
+{
+public:
+    size_t count = 0;
+    void write(const char *, size_t len) override { count += len; }
+};
+
+// 写入调用方提供的定长缓冲区，始终以 '\0' 结尾；放不下时截断并标记 overflow
+class BufferSink : public JsonSink
+{
+private:
+    char *buf;
+    size_t cap;
+    size_t len = 0;
+    bool overflowed = false;
+
+public:
+    BufferSink(char *_buf, size_t _cap) : buf(_buf), cap(_cap)
+    {
+        if (cap > 0)
+            buf[0] = '\0';
+    }
+
+    void write(const char *data, size_t n) override
+    {
+        if (cap == 0)
+        {
+            overflowed = overflowed || n > 0;
+            return;
+        }
+        size_t room = cap - 1 - len;
+        if (n > room)
+        {
+            n = room;
+            overflowed = true;
+        }
+        memcpy(buf + len, data, n);
+        len += n;
+        buf[len] = '\0';
+    }
+
+    const char *c_str() const { return buf; }
+    size_t length() const { return len; }
+    bool overflow() const { return overflowed; }
+};
+
+// 流式 JSON 写入器：边序列化边输出，不构造任何中间字符串，不做堆分配
+// 逗号、冒号由写入器根据嵌套状态自动补齐，调用方只需按顺序写 key / value
+//
+//   JsonWriter w(sink);
+//   w.beginObject();
+//   w.field("status", "ACTIVE");
+//   w.beginArray("zones"); ... w.endArray();
+//   w.endObject();
+class JsonWriter
+{
+private:
+    static const uint8_t MAX_DEPTH = 31;
+
+    JsonSink &sink;
+    uint32_t firstMask = 1; // 第 d 位：当前层还没写过元素
+    uint8_t depth = 0;
+    bool afterKey = false;  // 刚写完 key，下一个值前不加逗号
+    size_t total = 0;
+
+    void put(const char *s, size_t n)
+    {
+        sink.write(s, n);
+        total += n;
+    }
+    void put(char c) { put(&c, 1); }
+
+    // 在元素之间补逗号
+    void separator()
+    {
+        if (afterKey)
+        {
+            afterKey = false;
+            return;
+        }
+        uint32_t bit = 1UL << depth;
+        if (!(firstMask & bit))
+            put(',');
+        firstMask &= ~bit;
+    }
+
+    void open(char c)
+    {
+        separator();
+        put(c);
+        if (depth < MAX_DEPTH)
+            depth++;
+        firstMask |= 1UL << depth;
+    }
+
+    void close(char c)
+    {
+        if (depth > 0)
+            depth--;
+        put(c);
+    }
+
+    // 带转义的字符串 (控制字符用 \u00XX，其余 UTF-8 原样输出)
+    void quoted(const char *s)
+    {
+        put('"');
+        const char *run = s;
+        for (; *s; s++)
+        {
+            unsigned char c = (unsigned char)*s;
+            if (c >= 0x20 && c != '"' && c != '\\')
+                continue;
+            put(run, (size_t)(s - run));
+            run = s + 1;
+            switch (c)
+            {
+            case '"': put("\\\"", 2); break;
+            case '\\': put("\\\\", 2); break;
+            case '\n': put("\\n", 2); break;
+            case '\r': put("\\r", 2); break;
+            case '\t': put("\\t", 2); break;
+            default:
+            {
+                static const char HEX_DIGITS[] = "0123456789abcdef";
+                char esc[6] = {'\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0xF]};
+                put(esc, 6);
+            }
+            }
+        }
+        put(run, (size_t)(s - run));
+        put('"');
+    }
+
+    void unsignedDigits(unsigned long long v, bool negative)
+    {
+        char tmp[21];
+        int i = sizeof(tmp);
+        do
+        {
+            tmp[--i] = (char)('0' + v % 10);
+            v /= 10;
+        } while (v);
+        if (negative)
+            tmp[--i] = '-';
+        put(tmp + i, sizeof(tmp) - i);
+    }
+
+public:
+    explicit JsonWriter(JsonSink &_sink) : sink(_sink) {}
+
+    void beginObject() { open('{'); }
+    void endObject() { close('}'); }
+    void beginArray() { open('['); }
+    void endArray() { close(']'); }
+
+    void beginObject(const char *k)
+    {
+        key(k);
+        beginObject();
+    }
+    void beginArray(const char *k)
+    {
+        key(k);
+        beginArray();
+    }
+
+    void key(const char *k)
+    {
+        separator();
+        quoted(k);
+        put(':');
+        afterKey = true;
+    }
+
+    void value(const char *s)
+    {
+        separator();
+        if (s)
+            quoted(s);
+        else
+            put("null", 4);
+    }
+    void value(bool b)
+    {
+        separator();
+        if (b)
+            put("true", 4);
+        else
+            put("false", 5);
+    }
+    // 整数：long long / unsigned long long 是核心实现，其余宽度转发过来
+    // (int64_t 在不同平台上是 long 或 long long，这样写两边都不会重载冲突)
+    void value(long long v)
+    {
+        separator();
+        unsignedDigits(v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v, v < 0);
+    }
+    void value(unsigned long long v)
+    {
+        separator();
+        unsignedDigits(v, false);
+    }
+    void value(int v) { value((long long)v); }
+    void value(long v) { value((long long)v); }
+    void value(unsigned int v) { value((unsigned long long)v); }
+    void value(unsigned long v) { value((unsigned long long)v); }
+
+    // 已经是合法 JSON 的片段 (如预先序列化好的对象)，原样输出
+    void raw(const char *json)
+    {
+        separator();
+        put(json, strlen(json));
+    }
+
+    void nullValue()
+    {
+        separator();
+        put("null", 4);
+    }
+
+    template <typename T>
+    void field(const char *k, T v)
+    {
+        key(k);
+        value(v);
+    }
+
+    // 到目前为止输出的字节数
+    size_t written() const { return total; }
+};
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef MEMORY_POOL_H
+#define MEMORY_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include "../Metrics/HeapStats.h"     // 分区的整块内存记在 Heap::Arenas 名下
+#include "../JsonWriter/JsonWriter.h" // 用量 JSON
+
+// 内存分区：大块、冷的缓冲区放 PSRAM，热的控制数据留在内部 RAM
+// - MemArena：启动时向堆要一整块 (优先 PSRAM，没有时退回内部 RAM 的一小块)，之后只往前切、从不归还；
+//   给生命周期和程序一样长的缓冲区用 (MQTT 断线缓存 / 发送缓冲区、拉取升级的解压和补丁缓冲)
+// - SlotPool：从分区里切出 N 个等长的槽，借还都是 O(1)；槽长固定，反复借还也不会产生碎片
+//   (历史页这类用完就还的临时缓冲区)
+// 两者都不加锁：一个分区在启动阶段切完，一个池只在一个任务里借还
+// 调度表、控制总线队列、水泵状态机、跟踪环形缓冲这些每个节拍都要碰的数据不走这里，仍是内部 RAM 的静态变量
+
+class MemArena
+{
+private:
+    const char *label = "?";
+    uint8_t *base = nullptr;
+    uint32_t cap = 0;
+    uint32_t used = 0;
+    uint32_t failed = 0; // 切不出来的次数
+    Heap::Where where = Heap::Where::Internal;
+
+public:
+    MemArena() {}
+    MemArena(const MemArena &) = delete;
+    MemArena &operator=(const MemArena &) = delete;
+    ~MemArena() { end(); }
+
+    // 申请整块：where 要不到时 (没有 PSRAM / PSRAM 不够) 退回内部 RAM 的 fallbackBytes，0 表示不退
+    bool begin(const char *name, uint32_t bytes, Heap::Where prefer, uint32_t fallbackBytes = 0)
+    {
+        end();
+        label = name;
+        base = (uint8_t *)Heap::alloc(Heap::Arenas, bytes, prefer);
+        where = prefer;
+        cap = bytes;
+        if (!base && prefer == Heap::Where::Psram && fallbackBytes > 0)
+        {
+            base = (uint8_t *)Heap::alloc(Heap::Arenas, fallbackBytes, Heap::Where::Internal);
+            where = Heap::Where::Internal;
+            cap = fallbackBytes;
+        }
+        if (!base)
+            cap = 0;
+        return base != nullptr;
+    }
+
+    void end()
+    {
+        Heap::release(Heap::Arenas, base, cap, where);
+        base = nullptr;
+        cap = used = 0;
+    }
+
+    // 切一段 (align 必须是 2 的幂)；不够时返回 nullptr
+    void *take(uint32_t bytes, uint32_t align = alignof(max_align_t))
+    {
+        uint32_t at = (used + align - 1) & ~(align - 1);
+        if (!base || at > cap || bytes > cap - at)
+        {
+            failed++;
+            return nullptr;
+        }
+        used = at + bytes;
+        return base + at;
+    }
+
+    // 在分区里构造一个对象 (析构函数不会被调用，只放生命周期和程序一样长的对象)
+    template <typename T, typename... Args>
+    T *make(Args &&...args)
+    {
+        void *p = take(sizeof(T), alignof(T));
+        return p ? new (p) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    bool inPsram() const { return base && where == Heap::Where::Psram; }
+    uint32_t capacity() const { return cap; }
+    uint32_t usedBytes() const { return used; }
+    uint32_t remaining() const { return cap - used; }
+    uint32_t failures() const { return failed; }
+
+    void write(JsonWriter &w) const
+    {
+        w.beginObject();
+        w.field("name", label);
+        w.field("where", inPsram() ? "psram" : "internal");
+        w.field("bytes", (long)cap);
+        w.field("used", (long)used);
+        w.field("failed", (long)failed);
+        w.endObject();
+    }
+};
+
+class SlotPool
+{
+private:
+    static const uint16_t END = 0xFFFF;
+    static const uint16_t BORROWED = 0xFFFE; // 借出的槽：next[] 里的标记，重复归还据此识别
+
+    const char *label = "?";
+    uint8_t *slots = nullptr;
+    uint16_t *next = nullptr; // 空闲链表 (槽的下标)，不写进槽里：归还的数据保持原样
+    uint32_t slotSize = 0;
+    uint16_t count = 0;
+    uint16_t freeHead = END;
+    uint16_t borrowed = 0;
+    uint16_t peak = 0;
+    uint32_t failed = 0;     // 槽用完的次数
+    uint32_t badRelease = 0; // 归还了不属于本池 / 已经归还过的指针
+
+public:
+    // 从 arena 切出 n 个 slotBytes 长的槽 (按 8 字节对齐)；arena 不够时返回 false
+    bool begin(const char *name, MemArena &arena, uint32_t slotBytes, uint16_t n)
+    {
+        label = name;
+        slotSize = (slotBytes + 7) & ~7u;
+        slots = n > 0 && n < BORROWED && slotSize > 0 ? (uint8_t *)arena.take(slotSize * n, 8) : nullptr;
+        next = slots ? (uint16_t *)arena.take(sizeof(uint16_t) * n, alignof(uint16_t)) : nullptr;
+        if (!next)
+        {
+            slots = nullptr;
+            count = 0;
+            freeHead = END;
+            return false;
+        }
+        count = n;
+        for (uint16_t i = 0; i < n; i++)
+            next[i] = i + 1 < n ? i + 1 : END;
+        freeHead = 0;
+        borrowed = peak = 0;
+        return true;
+    }
+
+    // 借一个槽；用完时返回 nullptr
+    void *acquire()
+    {
+        if (freeHead == END)
+        {
+            failed++;
+            return nullptr;
+        }
+        uint16_t i = freeHead;
+        freeHead = next[i];
+        next[i] = BORROWED;
+        if (++borrowed > peak)
+            peak = borrowed;
+        return slots + (uint32_t)i * slotSize;
+    }
+
+    // 归还；不是本池借出的指针 (或重复归还) 返回 false，池不受影响
+    bool release(void *p)
+    {
+        if (!p || !slots || (uint8_t *)p < slots)
+        {
+            badRelease++;
+            return false;
+        }
+        uint32_t off = (uint32_t)((uint8_t *)p - slots);
+        uint32_t i = off / slotSize;
+        if (i >= count || off % slotSize != 0 || next[i] != BORROWED)
+        {
+            badRelease++;
+            return false;
+        }
+        next[i] = freeHead;
+        freeHead = (uint16_t)i;
+        borrowed--;
+        return true;
+    }
+
+    uint32_t slotBytes() const { return slotSize; }
+    uint16_t capacity() const { return count; }
+    uint16_t inUse() const { return borrowed; }
+    uint16_t peakInUse() const { return peak; }
+    uint32_t failures() const { return failed; }
+    uint32_t badReleases() const { return badRelease; }
+
+    void write(JsonWriter &w) const
+    {
+        w.beginObject();
+        w.field("name", label);
+        w.field("slot", (long)slotSize);
+        w.field("slots", count);
+        w.field("used", borrowed);
+        w.field("peak", peak);
+        w.field("failed", (long)failed);
+        w.endObject();
+    }
+};
+
+// 作用域内借一个槽，离开作用域归还
+class PoolSlot
+{
+private:
+    SlotPool &pool;
+    void *p;
+
+public:
+    explicit PoolSlot(SlotPool &_pool) : pool(_pool), p(_pool.acquire()) {}
+    PoolSlot(const PoolSlot &) = delete;
+    PoolSlot &operator=(const PoolSlot &) = delete;
+    ~PoolSlot()
+    {
+        if (p)
+            pool.release(p);
+    }
+
+    template <typename T>
+    T *as() const { return (T *)p; }
+    bool ok() const { return p != nullptr; }
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef HEAP_COUNT_NEW_H
+#define HEAP_COUNT_NEW_H
+
+#include <stdlib.h>
+#include <new>
+#include "HeapStats.h"
+
+// 替换全局 operator new / delete，每次分配累加 Heap::newCalls()
+// 只能在整个程序的一个 .cpp 里包含 (固件：main.cpp；测试：各自的入口)
+// 只统计 C++ 的 new (std::function / String / 容器)，WiFi / lwIP 内部的 malloc 不经过这里
+
+void *operator new(size_t size)
+{
+    Heap::newCalls().fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p)
+    {
+#if defined(__cpp_exceptions)
+        throw std::bad_alloc();
+#else
+        abort();
+#endif
+    }
+    return p;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+#endif
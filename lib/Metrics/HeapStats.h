@@ -0,0 +1,260 @@
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include "../Hal/Hal.h"
+#include "../JsonWriter/JsonWriter.h" // 内存 JSON
+#ifdef ARDUINO
+#include <esp_heap_caps.h>
+#endif
+
+// 内存遥测：整体堆状态 + 按模块的分配计数
+// - 整体：内部 RAM 的空闲字节、最大连续块、开机以来的最低空闲 (碎片化的早期信号：空闲还多但最大块越来越小)
+// - 按模块：本项目自己的长期缓冲区都经 Heap::alloc() 申请 (大块经 MemoryPool 的分区)，记下次数 / 在用字节 / 峰值 / 失败
+// - operator new 调用次数：包含 HeapCountNew.h 的程序才统计 (固件在 WATERING_METRICS 下、测试总是统计)，
+//   稳态运行时这个数不应该再涨
+// native 下没有真实的堆：空闲字节按 HEAP_HOST_BYTES (内部 RAM) / HEAP_HOST_PSRAM_BYTES 减去各模块在用字节模拟，只用于测试
+#ifndef HEAP_HOST_BYTES
+#define HEAP_HOST_BYTES (320 * 1024)
+#endif
+#ifndef HEAP_HOST_PSRAM_BYTES
+#define HEAP_HOST_PSRAM_BYTES (8 * 1024 * 1024)
+#endif
+
+namespace Heap
+{
+    enum Module : uint8_t
+    {
+        Arenas, // MemoryPool 的分区 (MQTT 缓冲区、升级缓冲区、历史页都从这里切)
+        Tasks,  // 工作任务的栈 (xTaskCreate 从堆上分配)
+        Other,
+        COUNT
+    };
+
+    inline const char *name(Module m)
+    {
+        static const char *const names[COUNT] = {"arenas", "tasks", "other"};
+        return m < COUNT ? names[m] : "?";
+    }
+
+    // 放在哪：PSRAM 没有或满了时由调用方决定要不要退回内部 RAM
+    enum class Where : uint8_t
+    {
+        Internal,
+        Psram
+    };
+
+    struct ModuleStats
+    {
+        std::atomic<uint32_t> allocs{0};
+        std::atomic<uint32_t> frees{0};
+        std::atomic<uint32_t> failed{0};
+        std::atomic<uint32_t> liveBytes{0};
+        std::atomic<uint32_t> peakBytes{0};
+        std::atomic<uint32_t> psramBytes{0}; // liveBytes 中在 PSRAM 里的部分
+    };
+
+    inline ModuleStats &stats(Module m)
+    {
+        static ModuleStats all[COUNT];
+        return all[m < COUNT ? m : Other];
+    }
+
+    // operator new 调用次数 (HeapCountNew.h 负责累加)
+    inline std::atomic<uint32_t> &newCalls()
+    {
+        static std::atomic<uint32_t> calls{0};
+        return calls;
+    }
+
+    // 记一笔 (不经过 alloc() 的分配，如任务栈)
+    inline void note(Module m, uint32_t bytes, bool ok, Where where = Where::Internal)
+    {
+        ModuleStats &s = stats(m);
+        if (!ok)
+        {
+            s.failed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        s.allocs.fetch_add(1, std::memory_order_relaxed);
+        if (where == Where::Psram)
+            s.psramBytes.fetch_add(bytes, std::memory_order_relaxed);
+        uint32_t live = s.liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        uint32_t peak = s.peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !s.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    inline void noteFree(Module m, uint32_t bytes, Where where = Where::Internal)
+    {
+        ModuleStats &s = stats(m);
+        s.frees.fetch_add(1, std::memory_order_relaxed);
+        s.liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+        if (where == Where::Psram)
+            s.psramBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    struct Snapshot
+    {
+        uint32_t freeBytes = 0;    // 内部 RAM 空闲
+        uint32_t largestBlock = 0; // 最大可分配的连续块
+        uint32_t minFree = 0;      // 开机以来的最低空闲
+        uint32_t psramFree = 0;    // 没有 PSRAM 时为 0
+    };
+
+#ifndef ARDUINO
+    // native：模拟的堆，只跟踪经过本模块的分配
+    inline std::atomic<uint32_t> &hostMinFree()
+    {
+        static std::atomic<uint32_t> minFree{HEAP_HOST_BYTES};
+        return minFree;
+    }
+
+    inline uint32_t hostUsed(bool psram)
+    {
+        uint32_t used = 0;
+        for (uint8_t i = 0; i < COUNT; i++)
+        {
+            const ModuleStats &m = stats((Module)i);
+            uint32_t inPsram = m.psramBytes.load(std::memory_order_relaxed);
+            used += psram ? inPsram : m.liveBytes.load(std::memory_order_relaxed) - inPsram;
+        }
+        return used;
+    }
+
+    inline uint32_t hostFree()
+    {
+        uint32_t used = hostUsed(false);
+        return used >= HEAP_HOST_BYTES ? 0 : HEAP_HOST_BYTES - used;
+    }
+
+    inline uint32_t hostPsramFree()
+    {
+        uint32_t used = hostUsed(true);
+        return used >= HEAP_HOST_PSRAM_BYTES ? 0 : HEAP_HOST_PSRAM_BYTES - used;
+    }
+#endif
+
+    inline Snapshot snapshot()
+    {
+        Snapshot s;
+#ifdef ARDUINO
+        s.freeBytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        s.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        s.minFree = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        s.psramFree = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+#else
+        s.freeBytes = hostFree();
+        s.largestBlock = s.freeBytes;
+        s.minFree = hostMinFree().load(std::memory_order_relaxed);
+        s.psramFree = hostPsramFree();
+#endif
+        return s;
+    }
+
+    // 长期缓冲区：记在 m 名下；Psram 时没有 PSRAM 或 PSRAM 满了返回 nullptr (不自动退回内部 RAM)
+    inline void *alloc(Module m, uint32_t bytes, Where where = Where::Internal)
+    {
+        void *p = nullptr;
+#ifdef ARDUINO
+        p = heap_caps_malloc(bytes, where == Where::Psram ? MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT : MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+        if (bytes > (where == Where::Psram ? hostPsramFree() : hostFree()))
+            p = nullptr;
+        else
+            p = malloc(bytes ? bytes : 1);
+#endif
+        note(m, bytes, p != nullptr, where);
+#ifndef ARDUINO
+        uint32_t now = hostFree();
+        uint32_t low = hostMinFree().load(std::memory_order_relaxed);
+        while (now < low && !hostMinFree().compare_exchange_weak(low, now, std::memory_order_relaxed))
+        {
+        }
+#endif
+        return p;
+    }
+
+    inline void release(Module m, void *p, uint32_t bytes, Where where = Where::Internal)
+    {
+        if (!p)
+            return;
+#ifdef ARDUINO
+        heap_caps_free(p);
+#else
+        free(p);
+#endif
+        noteFree(m, bytes, where);
+    }
+
+    // 一次取齐的快照：流式 JSON 要写两遍，两遍必须看到同样的数 (空闲字节随时在变)
+    struct Report
+    {
+        struct Counts
+        {
+            uint32_t allocs, frees, bytes, peak, psram, failed;
+        };
+
+        Snapshot heap;
+        uint32_t newCalls = 0;
+        Counts modules[COUNT];
+
+        void take()
+        {
+            heap = snapshot();
+            newCalls = Heap::newCalls().load(std::memory_order_relaxed);
+            for (uint8_t i = 0; i < COUNT; i++)
+            {
+                const ModuleStats &m = stats((Module)i);
+                modules[i] = {m.allocs.load(std::memory_order_relaxed), m.frees.load(std::memory_order_relaxed),
+                              m.liveBytes.load(std::memory_order_relaxed), m.peakBytes.load(std::memory_order_relaxed),
+                              m.psramBytes.load(std::memory_order_relaxed), m.failed.load(std::memory_order_relaxed)};
+            }
+        }
+
+        // 状态 JSON 里的 "heap" 对象
+        void write(JsonWriter &w) const
+        {
+            w.beginObject();
+            w.field("free", (long)heap.freeBytes);
+            w.field("largest", (long)heap.largestBlock);
+            w.field("min_free", (long)heap.minFree);
+            if (heap.psramFree)
+                w.field("psram_free", (long)heap.psramFree);
+            w.field("new_calls", (long)newCalls);
+            w.key("modules");
+            w.beginObject();
+            for (uint8_t i = 0; i < COUNT; i++)
+            {
+                const Counts &m = modules[i];
+                w.key(name((Module)i));
+                w.beginObject();
+                w.field("allocs", (long)m.allocs);
+                w.field("frees", (long)m.frees);
+                w.field("bytes", (long)m.bytes);
+                w.field("peak", (long)m.peak);
+                w.field("psram", (long)m.psram);
+                w.field("failed", (long)m.failed);
+                w.endObject();
+            }
+            w.endObject();
+            w.endObject();
+        }
+    };
+
+    // 作用域内的 operator new 调用次数 (稳态零分配测试)；只在包含了 HeapCountNew.h 的程序里有意义
+    class NewScope
+    {
+    private:
+        uint32_t start;
+
+    public:
+        NewScope() : start(newCalls().load(std::memory_order_relaxed)) {}
+        uint32_t count() const { return newCalls().load(std::memory_order_relaxed) - start; }
+    };
+}
+
+#endif
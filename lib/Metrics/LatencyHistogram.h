@@ -0,0 +1,118 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <atomic>
+
+// 固定桶的延迟直方图 (HDR 风格的对数-线性分桶，单位微秒)
+// - 0..7us 每微秒一个桶；之后每个 2 的幂区间再等分 8 个子桶，相对误差 <= 12.5%
+// - 最大到 2^26us (约 67 秒)，更大的值计入最后一个桶，max 仍然精确
+// - record() 只做一次 clz 和一次原子加法，不加锁、不分配内存，任何任务都可以调用
+// - takeSnapshot() 把计数逐桶交换成 0 (读取并清零)，与并发的 record() 之间不会丢计数
+class LatencyHistogram
+{
+public:
+    static const uint8_t SUB_BITS = 3;
+    static const uint8_t SUB_COUNT = 1 << SUB_BITS; // 8
+    static const uint8_t MAX_EXP = 25;              // 最后一个完整区间 [2^25, 2^26)
+    static const uint16_t BUCKETS = (MAX_EXP - SUB_BITS + 2) * SUB_COUNT; // 192
+
+    // 一个统计窗口的结果 (全部为微秒)
+    struct Summary
+    {
+        uint32_t count = 0;
+        uint32_t p50 = 0;
+        uint32_t p90 = 0;
+        uint32_t p99 = 0;
+        uint32_t max = 0;
+    };
+
+private:
+    std::atomic<uint32_t> counts[BUCKETS];
+    std::atomic<uint32_t> maxUs{0};
+
+public:
+    LatencyHistogram() { reset(); }
+    LatencyHistogram(const LatencyHistogram &) = delete;
+    LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+    static uint16_t bucketOf(uint32_t us)
+    {
+        if (us < SUB_COUNT)
+            return (uint16_t)us;
+        int e = 31 - __builtin_clz(us); // us 落在 [2^e, 2^(e+1))
+        if (e > MAX_EXP)
+            return BUCKETS - 1;
+        uint32_t sub = (us >> (e - SUB_BITS)) & (SUB_COUNT - 1);
+        return (uint16_t)((e - SUB_BITS + 1) * SUB_COUNT + sub);
+    }
+
+    // 桶的下界 (含)
+    static uint32_t bucketLow(uint16_t b)
+    {
+        if (b < SUB_COUNT)
+            return b;
+        int e = b / SUB_COUNT + SUB_BITS - 1;
+        return (uint32_t)(SUB_COUNT + b % SUB_COUNT) << (e - SUB_BITS);
+    }
+
+    // 桶的上界 (含)；百分位报告上界，宁可偏大
+    static uint32_t bucketHigh(uint16_t b)
+    {
+        return b + 1 < BUCKETS ? bucketLow(b + 1) - 1 : UINT32_MAX;
+    }
+
+    void record(uint32_t us)
+    {
+        counts[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+        uint32_t m = maxUs.load(std::memory_order_relaxed);
+        while (us > m && !maxUs.compare_exchange_weak(m, us, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void reset()
+    {
+        for (uint16_t i = 0; i < BUCKETS; i++)
+            counts[i].store(0, std::memory_order_relaxed);
+        maxUs.store(0, std::memory_order_relaxed);
+    }
+
+    // 读取并清零，返回这个窗口的摘要 (逐桶扫描，只在发布时调用)
+    Summary takeSnapshot()
+    {
+        uint32_t snap[BUCKETS];
+        Summary s;
+        for (uint16_t i = 0; i < BUCKETS; i++)
+        {
+            snap[i] = counts[i].exchange(0, std::memory_order_relaxed);
+            s.count += snap[i];
+        }
+        s.max = maxUs.exchange(0, std::memory_order_relaxed);
+        if (s.count == 0)
+            return s;
+
+        // 第 ceil(q * count) 个样本所在的桶
+        const uint32_t rank50 = (s.count + 1) / 2;
+        const uint32_t rank90 = (uint32_t)(((uint64_t)s.count * 90 + 99) / 100);
+        const uint32_t rank99 = (uint32_t)(((uint64_t)s.count * 99 + 99) / 100);
+        uint32_t seen = 0;
+        for (uint16_t i = 0; i < BUCKETS; i++)
+        {
+            if (!snap[i])
+                continue;
+            uint32_t before = seen;
+            seen += snap[i];
+            uint32_t high = bucketHigh(i) < s.max ? bucketHigh(i) : s.max;
+            if (before < rank50 && seen >= rank50)
+                s.p50 = high;
+            if (before < rank90 && seen >= rank90)
+                s.p90 = high;
+            if (before < rank99 && seen >= rank99)
+                s.p99 = high;
+        }
+        return s;
+    }
+};
+
+#endif
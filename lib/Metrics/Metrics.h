@@ -0,0 +1,128 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include "LatencyHistogram.h"
+#include "../Hal/Hal.h"               // micros()
+#include "../JsonWriter/JsonWriter.h" // 指标 JSON
+
+// 运行时延迟指标：几个固定的测量点各一个直方图，由网络任务定期发布到 metrics topic
+// 在 build_flags 里定义 WATERING_METRICS 才生效；否则下面的宏全部展开成空语句，
+// 测量点不产生任何代码，直方图也不会被实例化
+namespace Metrics
+{
+    enum Id : uint8_t
+    {
+        CmdToRelay,    // MQTT 收到 start / stop -> 继电器动作 (跨两个任务)
+        YieldInterval, // 网络任务一次连续运行多久才让出 CPU (OTA / MQTT / 重连)
+        LoopLate,      // 控制任务比计划的醒来时刻晚了多久 (无固定节拍，用迟到量代替周期抖动)
+        MqttPublish,   // 一次 MQTT 发布 (含流式 JSON) 的耗时
+        NvsCommit,     // 一次状态日志提交 (Flash 写) 的耗时
+        COUNT
+    };
+
+    inline const char *name(Id id)
+    {
+        static const char *const names[COUNT] = {"cmd_to_relay", "yield_interval", "loop_late", "mqtt_publish", "nvs_commit"};
+        return id < COUNT ? names[id] : "?";
+    }
+
+    inline LatencyHistogram &histogram(Id id)
+    {
+        static LatencyHistogram all[COUNT];
+        return all[id < COUNT ? id : 0];
+    }
+
+    // 作用域计时：析构时记录经过的微秒数
+    class ScopedTimer
+    {
+    private:
+        Id id;
+        uint32_t startUs;
+
+    public:
+        explicit ScopedTimer(Id _id) : id(_id), startUs((uint32_t)micros()) {}
+        ~ScopedTimer() { histogram(id).record((uint32_t)micros() - startUs); }
+    };
+
+    // 醒来迟到量：睡前 arm(计划睡多久)，醒来 onWake()
+    // 被 wake() 提前叫醒的不算 (那不是迟到)
+    class WakeLateness
+    {
+    private:
+        Id id;
+        uint32_t dueUs = 0;
+        bool armed = false;
+
+    public:
+        explicit WakeLateness(Id _id) : id(_id) {}
+
+        void onWake()
+        {
+            if (!armed)
+                return;
+            armed = false;
+            int32_t late = (int32_t)((uint32_t)micros() - dueUs);
+            if (late >= 0)
+                histogram(id).record((uint32_t)late);
+        }
+
+        void arm(uint32_t sleepMs)
+        {
+            dueUs = (uint32_t)micros() + sleepMs * 1000UL;
+            armed = sleepMs < 2000000UL; // 超出 32 位微秒的一半就不测了
+        }
+    };
+
+    // 写出一个统计窗口并清零：{"window_ms":..,"cmd_to_relay":{"n":..,"p50":..,"p90":..,"p99":..,"max":..},...}
+    // publishJson 会调用两次 fill，所以先取快照，再写 JSON
+    struct Report
+    {
+        uint32_t windowMs = 0;
+        LatencyHistogram::Summary items[COUNT];
+
+        void take(uint32_t window)
+        {
+            windowMs = window;
+            for (uint8_t i = 0; i < COUNT; i++)
+                items[i] = histogram((Id)i).takeSnapshot();
+        }
+
+        void write(JsonWriter &w) const
+        {
+            w.beginObject();
+            writeFields(w);
+            w.endObject();
+        }
+
+        // 只写字段 (调用方在同一个对象里追加别的内容，如内存遥测)
+        void writeFields(JsonWriter &w) const
+        {
+            w.field("window_ms", windowMs);
+            for (uint8_t i = 0; i < COUNT; i++)
+            {
+                const LatencyHistogram::Summary &s = items[i];
+                w.key(name((Id)i));
+                w.beginObject();
+                w.field("n", s.count);
+                w.field("p50", s.p50);
+                w.field("p90", s.p90);
+                w.field("p99", s.p99);
+                w.field("max", s.max);
+                w.endObject();
+            }
+        }
+    };
+}
+
+#ifdef WATERING_METRICS
+#define METRIC_RECORD(id, us) Metrics::histogram(Metrics::id).record(us)
+#define METRIC_SINCE(id, startUs) METRIC_RECORD(id, (uint32_t)micros() - (uint32_t)(startUs))
+#define METRIC_SCOPE(id) Metrics::ScopedTimer metricScope_##id(Metrics::id)
+#else
+#define METRIC_RECORD(id, us) ((void)0)
+#define METRIC_SINCE(id, startUs) ((void)0)
+#define METRIC_SCOPE(id) ((void)0)
+#endif
+
+#endif
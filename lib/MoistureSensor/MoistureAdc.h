@@ -0,0 +1,177 @@
+#ifndef MOISTURE_ADC_H
+#define MOISTURE_ADC_H
+
+#include <stdint.h>
+#include <atomic>
+#include "MoistureFilter.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <driver/adc.h>
+#endif
+
+// 最多几个探头 (ADC1 的通道)
+#ifndef MOISTURE_MAX_CHANNELS
+#define MOISTURE_MAX_CHANNELS 8
+#endif
+
+// 每轮每个通道采多少个样本 (5 的倍数，正好分成中值组)
+#ifndef MOISTURE_BURST_SAMPLES
+#define MOISTURE_BURST_SAMPLES 60
+#endif
+
+// 连续模式的总转换速率 (所有通道轮流)
+#ifndef MOISTURE_SAMPLE_HZ
+#define MOISTURE_SAMPLE_HZ 2000
+#endif
+
+// 一轮采样最多等多久 (ms)；超时就用已经采到的
+#ifndef MOISTURE_BURST_TIMEOUT_MS
+#define MOISTURE_BURST_TIMEOUT_MS 500
+#endif
+
+// 土壤湿度采样：ADC 连续模式 (DMA) 按通道模式表轮流转换，一轮采够就停
+// 1. sampleBurst()：启动 DMA，任务阻塞在读 DMA 缓冲区上 (转换由硬件完成，CPU 不轮询)，
+//    每个样本按通道分拣到块缓冲区，所有通道收满或超时后停止 ADC
+// 2. flush()：每个通道的整块样本一次过滤波器，结果写进原子量
+// 3. 控制任务随时 permille() 读最新值，不需要锁
+// 湿度变化以小时计，采样任务每分钟跑一轮，其余时间 ADC 关闭、任务睡眠
+// collect / flush 是纯逻辑，native 测试直接喂合成的样本
+class MoistureAdc
+{
+private:
+    uint8_t channels[MOISTURE_MAX_CHANNELS]; // 下标 -> ADC1 通道号
+    uint8_t count = 0;
+    MoistureFilter filters[MOISTURE_MAX_CHANNELS];
+    std::atomic<int16_t> values[MOISTURE_MAX_CHANNELS];
+    uint16_t block[MOISTURE_MAX_CHANNELS][MOISTURE_BURST_SAMPLES];
+    uint16_t blockLen[MOISTURE_MAX_CHANNELS];
+    uint32_t bursts = 0;
+    uint32_t shortBursts = 0; // 超时没采满的轮数
+
+public:
+    MoistureAdc()
+    {
+        for (uint8_t i = 0; i < MOISTURE_MAX_CHANNELS; i++)
+        {
+            values[i].store(MoistureFilter::UNKNOWN);
+            blockLen[i] = 0;
+        }
+    }
+
+    // 添加一个探头，返回下标 (和区域编号对应)；满了返回 -1
+    // 必须在 begin() 之前调用
+    int addChannel(uint8_t adcChannel, const MoistureFilter::Config &cfg = MoistureFilter::Config())
+    {
+        if (count >= MOISTURE_MAX_CHANNELS)
+            return -1;
+        channels[count] = adcChannel;
+        filters[count].configure(cfg);
+        return count++;
+    }
+
+    uint8_t channelCount() const { return count; }
+
+    // 分拣一个样本；不认识的通道、已经收满的通道直接丢掉
+    void collect(uint8_t adcChannel, uint16_t raw)
+    {
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (channels[i] != adcChannel)
+                continue;
+            if (blockLen[i] < MOISTURE_BURST_SAMPLES)
+                block[i][blockLen[i]++] = raw;
+            return;
+        }
+    }
+
+    bool full() const
+    {
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (blockLen[i] < MOISTURE_BURST_SAMPLES)
+                return false;
+        }
+        return true;
+    }
+
+    // 一轮结束：整块滤波，发布结果；这一轮一个样本都没有的通道变为 UNKNOWN
+    void flush()
+    {
+        bursts++;
+        if (!full())
+            shortBursts++;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            filters[i].process(block[i], blockLen[i]);
+            values[i].store(blockLen[i] > 0 ? filters[i].permille() : MoistureFilter::UNKNOWN);
+            blockLen[i] = 0;
+        }
+    }
+
+    // 最新的千分比湿度 (任意任务可读)；没有探头 / 故障时为 UNKNOWN
+    int16_t permille(uint8_t i) const { return i < count ? values[i].load() : MoistureFilter::UNKNOWN; }
+
+    const MoistureFilter &filter(uint8_t i) const { return filters[i]; }
+    uint32_t burstCount() const { return bursts; }
+    uint32_t shortBurstCount() const { return shortBursts; }
+
+#ifdef ARDUINO
+    // 配置 ADC1 连续模式：每个探头一个模式表项，11dB 衰减 (量程约 0 ~ 3.1V)
+    bool begin()
+    {
+        if (count == 0)
+            return false;
+        adc_digi_init_config_t init = {};
+        init.max_store_buf_size = 1024;
+        init.conv_num_each_intr = 256; // 每 64 个结果 (4 字节) 一次 DMA 中断
+        for (uint8_t i = 0; i < count; i++)
+            init.adc1_chan_mask |= 1u << channels[i];
+        if (adc_digi_initialize(&init) != ESP_OK)
+            return false;
+
+        adc_digi_pattern_config_t pattern[MOISTURE_MAX_CHANNELS] = {};
+        for (uint8_t i = 0; i < count; i++)
+        {
+            pattern[i].atten = ADC_ATTEN_DB_11;
+            pattern[i].channel = channels[i];
+            pattern[i].unit = 0; // ADC1
+            pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+        }
+        adc_digi_configuration_t dig = {};
+        dig.conv_limit_en = false;
+        dig.pattern_num = count;
+        dig.adc_pattern = pattern;
+        dig.sample_freq_hz = MOISTURE_SAMPLE_HZ;
+        dig.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+        dig.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+        return adc_digi_controller_configure(&dig) == ESP_OK;
+    }
+
+    // [采样任务] 采一轮并滤波；阻塞在 DMA 读上，最长 MOISTURE_BURST_TIMEOUT_MS
+    void sampleBurst()
+    {
+        uint8_t frame[256];
+        uint32_t start = millis();
+        adc_digi_start();
+        while (!full() && millis() - start < MOISTURE_BURST_TIMEOUT_MS)
+        {
+            uint32_t got = 0;
+            esp_err_t r = adc_digi_read_bytes(frame, sizeof(frame), &got, 50);
+            // ESP_ERR_INVALID_STATE：驱动的环形缓冲区溢出过，读到的数据仍然有效
+            if (r != ESP_OK && r != ESP_ERR_INVALID_STATE)
+                continue;
+            for (uint32_t k = 0; k + SOC_ADC_DIGI_RESULT_BYTES <= got; k += SOC_ADC_DIGI_RESULT_BYTES)
+            {
+                const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)&frame[k];
+                if (p->type2.unit == 0)
+                    collect((uint8_t)p->type2.channel, (uint16_t)p->type2.data);
+            }
+        }
+        adc_digi_stop();
+        flush();
+    }
+#endif
+};
+
+#endif
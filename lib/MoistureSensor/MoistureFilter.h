@@ -0,0 +1,154 @@
+#ifndef MOISTURE_FILTER_H
+#define MOISTURE_FILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 电容式土壤湿度探头的标定 (12 位 ADC 原始值)：越湿读数越低
+// 探头插在干土 / 水里各读一次，填到 build_flags 里
+#ifndef MOISTURE_DRY_RAW
+#define MOISTURE_DRY_RAW 2900
+#endif
+#ifndef MOISTURE_WET_RAW
+#define MOISTURE_WET_RAW 1300
+#endif
+
+// 土壤湿度滤波 (纯定点，没有浮点 / 堆分配)：
+// 1. 每 5 个原始样本取中值：水泵启停、继电器的脉冲干扰是孤立的尖峰，中值直接丢掉
+// 2. 中值进一阶 EMA (Q8 定点，系数 1/2^emaShift)，压掉探头的白噪声
+// 3. 按干 / 湿两点标定换算成千分比 (0 = 全干，1000 = 泡在水里)
+// process() 一次吃一整块样本 (DMA 一轮采到的)，块在哪里切开结果都一样
+// 中值超出 [faultLow, faultHigh] (探头断线 / 短路) 连续 maxFaults 次，读数变为 UNKNOWN，直到恢复
+class MoistureFilter
+{
+public:
+    static const uint8_t MEDIAN = 5;
+    static const int16_t UNKNOWN = -1;
+
+    struct Config
+    {
+        uint16_t dryRaw = MOISTURE_DRY_RAW;
+        uint16_t wetRaw = MOISTURE_WET_RAW;
+        uint8_t emaShift = 3;      // EMA 系数 1/8：约 8 个中值 (40 个样本) 的记忆
+        uint16_t faultLow = 64;    // 低于这个：探头短路
+        uint16_t faultHigh = 4031; // 高于这个：探头断线 (输入悬空时读满量程)
+        uint8_t maxFaults = 3;
+    };
+
+private:
+    Config cfg;
+    uint16_t pending[MEDIAN]; // 凑够 5 个再取中值 (跨块保留)
+    uint8_t pendingLen = 0;
+    int32_t ema = 0; // Q8
+    bool primed = false;
+    uint8_t faultRun = 0;
+    uint32_t medians = 0;
+    uint32_t faults = 0;
+
+    static void sort2(uint16_t &a, uint16_t &b)
+    {
+        uint16_t lo = a < b ? a : b;
+        b = a < b ? b : a;
+        a = lo;
+    }
+
+    // 5 个数的中值：8 次比较交换的排序网络，没有依赖数据的分支和循环
+    static uint16_t median5(uint16_t a, uint16_t b, uint16_t c, uint16_t d, uint16_t e)
+    {
+        sort2(a, b);
+        sort2(d, e);
+        sort2(a, c);
+        sort2(b, c);
+        sort2(a, d);
+        sort2(c, d);
+        sort2(b, e);
+        sort2(b, c);
+        return c;
+    }
+
+    void push(uint16_t m)
+    {
+        medians++;
+        if (m < cfg.faultLow || m > cfg.faultHigh)
+        {
+            faults++;
+            if (faultRun < 255)
+                faultRun++;
+            if (faultRun >= cfg.maxFaults)
+                primed = false; // 恢复后从新读数重新开始，不和故障前的状态混在一起
+            return;
+        }
+        faultRun = 0;
+        int32_t x = (int32_t)m << 8;
+        if (!primed)
+        {
+            ema = x;
+            primed = true;
+            return;
+        }
+        ema += (x - ema) >> cfg.emaShift;
+    }
+
+public:
+    MoistureFilter() {}
+    explicit MoistureFilter(const Config &c) : cfg(c) {}
+
+    void configure(const Config &c)
+    {
+        cfg = c;
+        reset();
+    }
+
+    void reset()
+    {
+        pendingLen = 0;
+        ema = 0;
+        primed = false;
+        faultRun = 0;
+        medians = faults = 0;
+    }
+
+    // 处理一块原始样本 (12 位)；不足 5 个的尾巴留到下一块
+    void process(const uint16_t *raw, size_t n)
+    {
+        size_t i = 0;
+        // 1. 先把上一块剩下的凑满
+        while (pendingLen > 0 && i < n)
+        {
+            pending[pendingLen++] = raw[i++];
+            if (pendingLen == MEDIAN)
+            {
+                push(median5(pending[0], pending[1], pending[2], pending[3], pending[4]));
+                pendingLen = 0;
+            }
+        }
+        // 2. 整组直接从块里取
+        for (; i + MEDIAN <= n; i += MEDIAN)
+            push(median5(raw[i], raw[i + 1], raw[i + 2], raw[i + 3], raw[i + 4]));
+        // 3. 尾巴 (不足一组)
+        for (; i < n && pendingLen < MEDIAN - 1; i++)
+            pending[pendingLen++] = raw[i];
+    }
+
+    bool valid() const { return primed; }
+
+    // 滤波后的原始值 (四舍五入)；无效时为 0
+    uint16_t level() const { return primed ? (uint16_t)((ema + 128) >> 8) : 0; }
+
+    // 千分比湿度，无效时为 UNKNOWN
+    int16_t permille() const
+    {
+        if (!primed)
+            return UNKNOWN;
+        int32_t span = (int32_t)cfg.dryRaw - (int32_t)cfg.wetRaw;
+        if (span == 0)
+            return UNKNOWN;
+        int32_t p = ((int32_t)cfg.dryRaw * 256 - ema) * 1000 / (span * 256);
+        return (int16_t)(p < 0 ? 0 : (p > 1000 ? 1000 : p));
+    }
+
+    uint32_t medianCount() const { return medians; }
+    uint32_t faultCount() const { return faults; }
+};
+
+#endif
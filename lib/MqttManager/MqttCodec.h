@@ -0,0 +1,317 @@
+#ifndef MQTT_CODEC_H
+#define MQTT_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// MQTT 3.1.1 报文编解码 (纯逻辑，不依赖 Arduino)
+// - 只实现客户端用到的报文：CONNECT / PUBLISH / PUBACK / SUBSCRIBE / PINGREQ / DISCONNECT，
+//   以及 broker 发来的 CONNACK / PUBLISH / PUBACK / SUBACK / PINGRESP
+// - 编码写进调用方的定长缓冲区；PUBLISH 可以只编码报文头，负载由调用方随后流式追加
+// - 解码是增量的：TCP 收到多少喂多少，凑满一个报文才返回；超过缓冲区的报文整个跳过
+namespace Mqtt
+{
+    enum PacketType : uint8_t
+    {
+        CONNECT = 1,
+        CONNACK = 2,
+        PUBLISH = 3,
+        PUBACK = 4,
+        SUBSCRIBE = 8,
+        SUBACK = 9,
+        PINGREQ = 12,
+        PINGRESP = 13,
+        DISCONNECT = 14
+    };
+
+    // 剩余长度字段 (变长整数) 占几个字节
+    inline size_t varLenSize(uint32_t n)
+    {
+        return n < 128 ? 1 : n < 16384 ? 2 : n < 2097152 ? 3 : 4;
+    }
+
+    // 写进定长缓冲区；放不下时 ok = false，len 不再增长
+    struct Writer
+    {
+        uint8_t *buf;
+        size_t cap;
+        size_t len = 0;
+        bool ok = true;
+
+        Writer(uint8_t *b, size_t c) : buf(b), cap(c) {}
+
+        void bytes(const void *p, size_t n)
+        {
+            if (!ok || cap - len < n)
+            {
+                ok = false;
+                return;
+            }
+            memcpy(buf + len, p, n);
+            len += n;
+        }
+        void u8(uint8_t v) { bytes(&v, 1); }
+        void u16(uint16_t v)
+        {
+            uint8_t b[2] = {(uint8_t)(v >> 8), (uint8_t)v};
+            bytes(b, 2);
+        }
+        void str(const char *s, size_t n)
+        {
+            u16((uint16_t)n);
+            bytes(s, n);
+        }
+        void str(const char *s) { str(s, strlen(s)); }
+        void varLen(uint32_t n)
+        {
+            do
+            {
+                uint8_t b = n % 128;
+                n /= 128;
+                u8(n ? (uint8_t)(b | 0x80) : b);
+            } while (n);
+        }
+    };
+
+    struct ConnectOptions
+    {
+        const char *clientId = "";
+        const char *user = nullptr; // nullptr 或 "" 表示不带
+        const char *pass = nullptr;
+        uint16_t keepAliveSec = 60;
+        bool cleanSession = false;
+        const char *willTopic = nullptr; // 遗嘱：连接异常断开时 broker 代发
+        const char *willPayload = nullptr;
+        bool willRetain = false;
+    };
+
+    inline bool hasText(const char *s) { return s && *s; }
+
+    inline bool encodeConnect(Writer &w, const ConnectOptions &o)
+    {
+        bool will = hasText(o.willTopic);
+        uint32_t body = 10 + 2 + strlen(o.clientId);
+        if (will)
+            body += 2 + strlen(o.willTopic) + 2 + (o.willPayload ? strlen(o.willPayload) : 0);
+        if (hasText(o.user))
+            body += 2 + strlen(o.user);
+        if (hasText(o.user) && o.pass)
+            body += 2 + strlen(o.pass);
+
+        uint8_t flags = o.cleanSession ? 0x02 : 0;
+        if (will)
+            flags |= 0x04 | 0x08 /* will QoS1 */ | (o.willRetain ? 0x20 : 0);
+        if (hasText(o.user))
+            flags |= 0x80 | (o.pass ? 0x40 : 0);
+
+        w.u8(CONNECT << 4);
+        w.varLen(body);
+        w.str("MQTT");
+        w.u8(4); // 协议级别 3.1.1
+        w.u8(flags);
+        w.u16(o.keepAliveSec);
+        w.str(o.clientId);
+        if (will)
+        {
+            w.str(o.willTopic);
+            w.str(o.willPayload ? o.willPayload : "");
+        }
+        if (hasText(o.user))
+        {
+            w.str(o.user);
+            if (o.pass)
+                w.str(o.pass);
+        }
+        return w.ok;
+    }
+
+    // PUBLISH 报文头 (固定头 + topic + 报文标识)；负载 payloadLen 字节由调用方紧接着写
+    inline size_t publishHeaderSize(const char *topic, size_t payloadLen, uint8_t qos)
+    {
+        uint32_t body = 2 + strlen(topic) + (qos ? 2 : 0) + payloadLen;
+        return 1 + varLenSize(body) + body - payloadLen;
+    }
+
+    inline bool encodePublishHeader(Writer &w, const char *topic, size_t payloadLen, uint8_t qos, bool retained, bool dup, uint16_t packetId)
+    {
+        uint32_t body = 2 + strlen(topic) + (qos ? 2 : 0) + payloadLen;
+        w.u8((uint8_t)(PUBLISH << 4 | (dup ? 0x08 : 0) | (qos << 1) | (retained ? 1 : 0)));
+        w.varLen(body);
+        w.str(topic);
+        if (qos)
+            w.u16(packetId);
+        return w.ok;
+    }
+
+    inline bool encodeAck(Writer &w, PacketType type, uint16_t packetId)
+    {
+        w.u8(type << 4);
+        w.u8(2);
+        w.u16(packetId);
+        return w.ok;
+    }
+
+    inline bool encodeSubscribe(Writer &w, uint16_t packetId, const char *topic, uint8_t qos)
+    {
+        w.u8(SUBSCRIBE << 4 | 0x02);
+        w.varLen(2 + 2 + strlen(topic) + 1);
+        w.u16(packetId);
+        w.str(topic);
+        w.u8(qos);
+        return w.ok;
+    }
+
+    inline bool encodeEmpty(Writer &w, PacketType type)
+    {
+        w.u8(type << 4);
+        w.u8(0);
+        return w.ok;
+    }
+
+    // 收到的 PUBLISH (指针指向解码器的缓冲区，下一次 feed 之前有效)
+    struct Publish
+    {
+        const char *topic;
+        uint16_t topicLen;
+        const uint8_t *payload;
+        size_t payloadLen;
+        uint8_t qos;
+        bool retained;
+        bool dup;
+        uint16_t packetId;
+    };
+
+    // 增量解码器：capacity 是单个报文体的上限
+    template <size_t CAPACITY>
+    class Decoder
+    {
+    public:
+        enum class Result : uint8_t
+        {
+            NeedMore, // 数据用完了，报文还没收全
+            Packet,   // 收到一个完整报文 (type() / body())
+            Skipped,  // 报文超过 CAPACITY，已丢弃
+            Error     // 剩余长度字段非法，连接应当断开
+        };
+
+    private:
+        enum class Stage : uint8_t
+        {
+            Header,
+            Length,
+            Body
+        };
+        uint8_t buf[CAPACITY];
+        Stage stage = Stage::Header;
+        uint8_t header = 0;
+        uint32_t remaining = 0; // 报文体总长
+        uint32_t multiplier = 1;
+        uint32_t got = 0;
+
+    public:
+        void reset()
+        {
+            stage = Stage::Header;
+            got = 0;
+        }
+
+        // 从 data 里读，最多凑出一个报文；consumed 返回用掉的字节数
+        Result feed(const uint8_t *data, size_t len, size_t &consumed)
+        {
+            consumed = 0;
+            while (consumed < len)
+            {
+                uint8_t b = data[consumed];
+                if (stage == Stage::Header)
+                {
+                    header = b;
+                    remaining = 0;
+                    multiplier = 1;
+                    got = 0;
+                    stage = Stage::Length;
+                    consumed++;
+                }
+                else if (stage == Stage::Length)
+                {
+                    consumed++;
+                    remaining += (b & 0x7F) * multiplier;
+                    if (b & 0x80)
+                    {
+                        multiplier *= 128;
+                        if (multiplier > 128 * 128 * 128)
+                        {
+                            reset();
+                            return Result::Error;
+                        }
+                        continue;
+                    }
+                    stage = Stage::Body;
+                    if (remaining == 0)
+                    {
+                        stage = Stage::Header;
+                        return Result::Packet;
+                    }
+                }
+                else
+                {
+                    size_t n = len - consumed;
+                    if (n > remaining - got)
+                        n = remaining - got;
+                    if (got < CAPACITY) // 超长的报文也留下开头 (topic + 报文标识)，好回确认
+                        memcpy(buf + got, data + consumed, n < CAPACITY - got ? n : CAPACITY - got);
+                    got += n;
+                    consumed += n;
+                    if (got == remaining)
+                    {
+                        stage = Stage::Header;
+                        return remaining <= CAPACITY ? Result::Packet : Result::Skipped;
+                    }
+                }
+            }
+            return Result::NeedMore;
+        }
+
+        uint8_t type() const { return header >> 4; }
+        uint8_t flags() const { return header & 0x0F; }
+        const uint8_t *body() const { return buf; }
+        uint32_t bodyLen() const { return remaining; }
+
+        // PUBACK / SUBACK 的报文标识
+        uint16_t packetId() const { return remaining >= 2 ? (uint16_t)(buf[0] << 8 | buf[1]) : 0; }
+
+        // 刚跳过的 QoS1 PUBLISH 的报文标识 (0 = 不是 QoS1 PUBLISH，或 topic 长到开头放不下报文标识)
+        uint16_t skippedPacketId() const
+        {
+            if (type() != PUBLISH || ((flags() >> 1) & 0x03) != 1)
+                return 0;
+            uint32_t at = 2 + (uint32_t)(buf[0] << 8 | buf[1]);
+            return at + 2 <= CAPACITY ? (uint16_t)(buf[at] << 8 | buf[at + 1]) : 0;
+        }
+
+        bool parsePublish(Publish &p) const
+        {
+            if (remaining < 2)
+                return false;
+            p.qos = (flags() >> 1) & 0x03;
+            p.retained = flags() & 0x01;
+            p.dup = flags() & 0x08;
+            p.topicLen = (uint16_t)(buf[0] << 8 | buf[1]);
+            uint32_t at = 2 + p.topicLen;
+            if (p.qos > 1 || at + (p.qos ? 2 : 0) > remaining) // 不订阅 QoS2，收到就当格式错误
+                return false;
+            p.topic = (const char *)buf + 2;
+            p.packetId = 0;
+            if (p.qos)
+            {
+                p.packetId = (uint16_t)(buf[at] << 8 | buf[at + 1]);
+                at += 2;
+            }
+            p.payload = buf + at;
+            p.payloadLen = remaining - at;
+            return true;
+        }
+    };
+}
+
+#endif
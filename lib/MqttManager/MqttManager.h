@@ -3,82 +3,385 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <PubSubClient.h>
+#include "JsonWriter.h"
+#include "WireProtocol.h"
+#include "OutboundQueue.h"
+#include "MqttSession.h"
+#include "SocketTransport.h"
+#include "Metrics.h"
+#include "MemoryPool.h"
+#include "Trace.h"
 
+// 断线缓存容量：有 PSRAM 时用大缓冲撑过长时间断网，否则只在内部 RAM 留一小块
+#ifndef MQTT_OUTBOX_BYTES
+#define MQTT_OUTBOX_BYTES 4096
+#endif
+#ifndef MQTT_OUTBOX_PSRAM_BYTES
+#define MQTT_OUTBOX_PSRAM_BYTES (256 * 1024)
+#endif
+
+// 发送缓冲区的大小：整条发布的 QoS0 消息 (历史页、metrics) 要一次放得下；状态快照分段发布，不受它限制
+#ifndef MQTT_TX_BYTES
+#define MQTT_TX_BYTES 4096
+#endif
+#ifndef MQTT_KEEPALIVE_SEC
+#define MQTT_KEEPALIVE_SEC 60
+#endif
+
+#ifndef MQTT_TOPIC_CMD
+#define MQTT_TOPIC_CMD "watering/cmd"
+#endif
+#ifndef MQTT_TOPIC_STATUS
+#define MQTT_TOPIC_STATUS "watering/status"
+#endif
+
+// 把 JsonWriter 的输出写进发送缓冲区里预留好的负载区
+// 严格按预留的长度输出：多了截断、少了补空格，保证 MQTT 帧完整
+// skip > 0 时先丢掉前 skip 字节 (分段发布：每段都从头序列化，只留这一段)
+class MqttPayloadSink : public JsonSink {
+private:
+    uint8_t *out;
+    size_t remaining;
+    size_t skip;
+
+public:
+    MqttPayloadSink(uint8_t *_out, size_t length, size_t _skip = 0) : out(_out), remaining(length), skip(_skip) {}
+
+    void write(const char *data, size_t len) override {
+        if (skip) {
+            size_t n = len < skip ? len : skip;
+            data += n;
+            len -= n;
+            skip -= n;
+        }
+        if (len > remaining) len = remaining;
+        memcpy(out, data, len);
+        out += len;
+        remaining -= len;
+    }
+
+    void finish() {
+        memset(out, ' ', remaining);
+        out += remaining;
+        remaining = 0;
+    }
+};
+
+// MQTT 客户端：非阻塞会话 (MqttSession) + 断线缓存 (OutboundQueue)
+// - 固定的 client id (MAC) + 持久会话：离线期间 broker 替我们保存 QoS1 指令，重连后补发
+// - publish() 的消息都是 QoS1，先进缓存，收到 PUBACK 才出队；最多 8 条同时在途
+// - publishJson() / publishBinary() 是 QoS0，整条直接写进发送缓冲区 (放不下就丢，下次再报)
+// - streamJson() / streamBinary() 是 QoS0 分段发布 (状态快照)：整条不必放进发送缓冲区，随 socket 的进度写出
+// - 异常掉线时 broker 代发遗嘱 "Offline"
 class MqttManager {
 private:
-    WiFiClient espClient;
-    PubSubClient client;
+    SocketTransport net;
+    MqttSession session;
     const char* server;
-    int port;
+    uint16_t port;
     const char* user;
     const char* pass;
-    
+    char clientId[32];
+
+    // QoS0 快照没发出去的次数：发送缓冲区暂时被占着 / 整条都放不下 (后者另外发一条错误通知)
+    uint32_t txDropped = 0;
+    uint32_t txTooLarge = 0;
+
+    // 断线期间的出站缓存 + 重连后的限速刷新
+    OutboundQueue outbox;
+    FlushPacer pacer;
+    bool wasConnected = false;
+
+    // 按 pacer 限额把缓存填进发送窗口
+    void pump(uint32_t now, bool readSocket) {
+        uint16_t budget = pacer.budget(now);
+        uint16_t sent = readSocket ? session.loop(now, budget) : session.sendPending(now, budget);
+        while (sent--) pacer.consume();
+    }
+
+    // 分段发布的数据源：每段都让 source 从头写一遍，只留 [offset, offset + len)
+    template <typename Source>
+    static void jsonSlice(const void* ctx, uint8_t* out, size_t offset, size_t len) {
+        MqttPayloadSink sink(out, len, offset);
+        {
+            JsonWriter w(sink);
+            static_cast<const Source*>(ctx)->write(w);
+        }
+        sink.finish();
+    }
+
+    template <typename Source>
+    static void binarySlice(const void* ctx, uint8_t* out, size_t offset, size_t len) {
+        Wire::Encoder e(out, len, offset);
+        static_cast<const Source*>(ctx)->write(e);
+        while (e.length() < offset + len) e.u8(0); // 比第一遍短时补 0 (解码方忽略帧尾多余字节)
+    }
+
+    // QoS0 快照进不了发送缓冲区：暂时被占着就等下次再报；整条都放不下是配置问题，发一条 QoS1 错误通知
+    void dropSnapshot(const char* topic, size_t len) {
+        size_t need = Mqtt::publishHeaderSize(topic, len, 0) + len;
+        if (need <= session.txCapacity()) {
+            txDropped++;
+            TRACE_W("[MQTT] Tx buffer busy, dropped %u bytes", (uint32_t)len);
+            return;
+        }
+        txTooLarge++;
+        TRACE_E("[MQTT] Snapshot of %u bytes exceeds the %u-byte tx buffer", (uint32_t)len, (uint32_t)session.txCapacity());
+        char msg[72];
+        snprintf(msg, sizeof(msg), "Error: %u-byte snapshot exceeds %u-byte tx buffer", (unsigned)len,
+                 (unsigned)session.txCapacity());
+        publish(MQTT_TOPIC_STATUS, msg);
+    }
+
     // 定义收到消息时的回调类型
     typedef std::function<void(char*, uint8_t*, unsigned int)> MqttCallback;
 
 public:
-    MqttManager(const char* _server, int _port, const char* _user, const char* _pass) 
-        : client(espClient), server(_server), port(_port), user(_user), pass(_pass) {}
+    MqttManager(const char* _server, int _port, const char* _user, const char* _pass)
+        : session(net), server(_server), port((uint16_t)_port), user(_user), pass(_pass) {
+        clientId[0] = '\0';
+    }
+
+    // arena：断线缓存和发送缓冲区从这里切 (分区在 PSRAM 里时断线缓存用大尺寸)
+    // txBytes：整条发布的最大一条 QoS0 消息 (加报文头) 的长度
+    void begin(MqttCallback callback, MemArena& arena, uint32_t txBytes = MQTT_TX_BYTES) {
+        // 固定的 client id：broker 靠它找回上次的会话
+        uint8_t mac[6];
+        WiFi.macAddress(mac);
+        snprintf(clientId, sizeof(clientId), "ESP32-Watering-%02X%02X%02X%02X%02X%02X",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 
-    void begin(MqttCallback callback) {
-        client.setServer(server, port);
-        client.setCallback(callback); // 设置收到指令时的处理函数
+        // 断线缓存和发送缓冲区：冷的大块，放在 PSRAM 分区
+        uint32_t bytes = arena.inPsram() ? MQTT_OUTBOX_PSRAM_BYTES : MQTT_OUTBOX_BYTES;
+        uint8_t* storage = (uint8_t*)arena.take(bytes);
+        outbox.attach(storage, storage ? bytes : 0);
+        uint8_t* tx = (uint8_t*)arena.take(txBytes);
+        if (!tx) txBytes = 0;
 
-        // 默认只有 256，发长 JSON 会失败
-        client.setBufferSize(512);
+        MqttSession::Config cfg;
+        cfg.host = server;
+        cfg.port = port;
+        cfg.connect.clientId = clientId;
+        cfg.connect.user = user;
+        cfg.connect.pass = pass;
+        cfg.connect.keepAliveSec = MQTT_KEEPALIVE_SEC;
+        cfg.connect.cleanSession = false;
+        cfg.connect.willTopic = MQTT_TOPIC_STATUS;
+        cfg.connect.willPayload = "Offline";
+        session.begin(cfg, tx, txBytes, &outbox, callback);
+        session.subscribe(MQTT_TOPIC_CMD, 1); // 每次连上都重发 (broker 那边幂等)
 
-        // 新增：设置心跳为 60 秒 (默认是 15 秒)
-        // 这样服务器会更宽容，允许最长 90 秒的静默
-        client.setKeepAlive(60);
+        Serial.printf("[MQTT] Client %s, outbox %u bytes, tx %u bytes\n", clientId,
+                      (unsigned)outbox.getStats().capacity, (unsigned)txBytes);
     }
 
+    // 额外的订阅 (begin() 之后调用，最多 MQTT_MAX_SUBSCRIPTIONS 个)；topic 必须是静态字符串
+    bool subscribe(const char* topic, uint8_t qos = 1) {
+        return session.subscribe(topic, qos);
+    }
+
+    // 满了之后丢最旧还是丢最新 (默认丢最旧)
+    void setOverflowPolicy(OutboundQueue::OverflowPolicy policy) {
+        outbox.setPolicy(policy);
+    }
+
+    // 重连后每 intervalMs 最多补发 burst 条
+    void setFlushPacing(uint32_t intervalMs, uint16_t burst) {
+        pacer.configure(intervalMs, burst);
+    }
+
+    // 开始连接 (立即返回；之后由 loop() 推进，失败按指数退避自动重试)
     void connect() {
-        // 如果已经连接，直接返回
-        if (client.connected()) return;
-
-        Serial.println("[MQTT] Connecting...");
-        // 生成唯一的 Client ID
-        String clientId = "ESP32-Watering-" + String(random(0xffff), HEX);
-
-        // 尝试连接
-        if (client.connect(clientId.c_str(), user, pass)) {
-            Serial.println("Connected!");
-            // 连接成功后，重新订阅指令 Topic
-            #ifdef MQTT_TOPIC_CMD
-                client.subscribe(MQTT_TOPIC_CMD);
-                Serial.println("[MQTT] Subscribed to: " MQTT_TOPIC_CMD);
-            #else
-                client.subscribe("watering/cmd");
-                Serial.println("[MQTT] Subscribed to: watering/cmd");
-            #endif
-            #ifdef MQTT_TOPIC_STATUS
-                publish(MQTT_TOPIC_STATUS, "Online");
-            #else
-                publish("watering/status", "Online");
-            #endif
-        } else {
-            Serial.print("Failed, rc=");
-            Serial.print(client.state());
-            Serial.println(" try again in 5 seconds");
-            // 这里不阻塞，由 main loop 控制重试频率
+        if (session.state() == MqttSession::State::Idle) TRACE_I("[MQTT] Connecting...");
+        session.start(millis());
+    }
+
+    // 启动阶段用：最多等 timeoutMs 直到握手完成
+    bool waitConnected(uint32_t timeoutMs) {
+        uint32_t start = millis();
+        connect();
+        while (!isConnected() && millis() - start < timeoutMs) {
+            loop();
+            delay(10);
         }
+        return isConnected();
     }
 
     void loop() {
-        client.loop(); // 必须频繁调用以保持心跳
+        uint32_t now = millis();
+        pump(now, true);
+
+        bool connected = session.isConnected();
+        if (connected != wasConnected) {
+            const MqttSession::Stats& s = session.stats();
+            if (connected)
+                TRACE_I("[MQTT] Connected (%u of %u sessions resumed, %u in flight)", s.resumed, s.connects, (uint32_t)session.inflight());
+            else
+                TRACE_W("[MQTT] Disconnected (%u failures)", s.failures);
+        }
+        if (connected && !wasConnected) {
+            pacer.reset(now); // 刚重连：新的限速窗口
+            publish(MQTT_TOPIC_STATUS, "Online");
+        }
+        wasConnected = connected;
     }
 
     bool isConnected() {
-        return client.connected();
+        return session.isConnected();
+    }
+
+    // 正在握手、或者还有消息没发完 / 没确认 (网络任务据此决定要不要快速轮询)
+    bool isBusy() const {
+        MqttSession::State st = session.state();
+        return st == MqttSession::State::TcpConnecting || st == MqttSession::State::Handshake ||
+               (st == MqttSession::State::Connected && (!outbox.empty() || session.pendingTxBytes() > 0 || session.streaming()));
+    }
+
+    // 分段发布还没写完 (这期间 streamJson / streamBinary 返回 false，source 还在被读)
+    bool streaming() const {
+        return session.streaming();
+    }
+
+    // 流式发布 JSON (QoS0)：fill(JsonWriter&) 会被调用两次，
+    // 第一次只数长度，第二次直接写进发送缓冲区预留的负载区，不经过 String
+    // fill 两次的输出应当一致 (状态在两次之间变化也不会破坏 MQTT 帧)
+    template <typename Fill>
+    bool publishJson(const char* topic, Fill fill, bool retained = false) {
+        if (!session.isConnected()) return false;
+        METRIC_SCOPE(MqttPublish);
+
+        CountingSink counter;
+        {
+            JsonWriter w(counter);
+            fill(w);
+        }
+
+        uint8_t* payload = session.beginPublish(topic, counter.count, retained);
+        if (!payload) {
+            dropSnapshot(topic, counter.count);
+            return false;
+        }
+        MqttPayloadSink out(payload, counter.count);
+        {
+            JsonWriter w(out);
+            fill(w);
+        }
+        out.finish();
+        TRACE_D("[MQTT] Send: %u bytes (streamed)", (uint32_t)counter.count);
+        return session.endPublish(millis());
+    }
+
+    // 流式发布二进制帧 (QoS0)：和 publishJson 一样，fill(Wire::Encoder&) 第一次只数长度，第二次直接写进发送缓冲区
+    template <typename Fill>
+    bool publishBinary(const char* topic, Fill fill, bool retained = false) {
+        if (!session.isConnected()) return false;
+        METRIC_SCOPE(MqttPublish);
+
+        Wire::Encoder counter;
+        fill(counter);
+
+        uint8_t* payload = session.beginPublish(topic, counter.length(), retained);
+        if (!payload) {
+            dropSnapshot(topic, counter.length());
+            return false;
+        }
+        Wire::Encoder out(payload, counter.length());
+        fill(out);
+        while (out.length() < counter.length()) out.u8(0); // 两次长度不一致时补 0 (解码方忽略帧尾多余字节)
+        TRACE_D("[MQTT] Send: %u bytes (binary)", (uint32_t)counter.length());
+        return session.endPublish(millis());
     }
 
-    void publish(const char* topic, const char* payload) {
-        if (client.connected()) {
-            client.publish(topic, payload);
-            Serial.printf("[MQTT] Send [%s]: %s\n", topic, payload);
+    // 分段发布 JSON (QoS0)：先数一遍长度，之后每当 socket 收走一段，就让 source.write(JsonWriter&) 从头再写一遍、只取那一段
+    // source 要活到 streaming() 变回 false，而且每一遍的输出必须完全相同 (数据先拍成快照)
+    // 没连上、或上一条还没写完时返回 false (调用方下次再试)
+    template <typename Source>
+    bool streamJson(const char* topic, const Source& source, bool retained = false) {
+        if (!session.isConnected() || session.streaming()) return false;
+        METRIC_SCOPE(MqttPublish);
+        CountingSink counter;
+        {
+            JsonWriter w(counter);
+            source.write(w);
+        }
+        TRACE_D("[MQTT] Stream: %u bytes", (uint32_t)counter.count);
+        return session.beginStream(millis(), topic, counter.count, retained, &jsonSlice<Source>, &source);
+    }
+
+    // 分段发布二进制帧 (QoS0)：同上，source.write(Wire::Encoder&)
+    template <typename Source>
+    bool streamBinary(const char* topic, const Source& source, bool retained = false) {
+        if (!session.isConnected() || session.streaming()) return false;
+        METRIC_SCOPE(MqttPublish);
+        Wire::Encoder counter;
+        source.write(counter);
+        TRACE_D("[MQTT] Stream: %u bytes (binary)", (uint32_t)counter.length());
+        return session.beginStream(millis(), topic, counter.length(), retained, &binarySlice<Source>, &source);
+    }
+
+    // QoS1：先进缓存，保证消息按产生顺序送达；连着的话立刻填进发送窗口
+    // topic 必须是静态字符串 (缓存里只保存指针)
+    // 这里不读 socket，可以在收消息的回调里调用
+    void publish(const char* topic, const char* payload, bool retained = false) {
+        publish(topic, (const uint8_t*)payload, strlen(payload), retained);
+    }
+
+    // 同上，二进制负载 (二进制协议的事件 / 应答)
+    void publish(const char* topic, const uint8_t* payload, size_t len, bool retained = false) {
+        METRIC_SCOPE(MqttPublish);
+        if (len > MQTT_MAX_MESSAGE) len = MQTT_MAX_MESSAGE;
+        if (!outbox.push(topic, payload, (uint16_t)len, retained)) {
+            TRACE_W("[MQTT] Dropped: %u bytes", (uint32_t)len);
+            return;
+        }
+        if (session.isConnected()) {
+            pump(millis(), false);
+            TRACE_D("[MQTT] Send: %u bytes (%u in flight)", (uint32_t)len, (uint32_t)session.inflight());
+        } else {
+            TRACE_I("[MQTT] Queued: %u bytes (%u pending)", (uint32_t)len, (uint32_t)outbox.size());
         }
     }
+
+    // 还有没发出去的缓存消息 (网络任务据此决定要不要快速轮询)
+    bool hasBacklog() const {
+        return !outbox.empty();
+    }
+
+    OutboundQueue::Stats getOutboxStats() const {
+        return outbox.getStats();
+    }
+
+    // 缓存状态，嵌进状态 JSON
+    void writeOutboxStats(JsonWriter& w) const {
+        OutboundQueue::Stats s = outbox.getStats();
+        w.beginObject();
+        w.field("depth", s.depth);
+        w.field("bytes", s.bytes);
+        w.field("capacity", s.capacity);
+        w.field("high_water", s.highWater);
+        w.field("sent", s.sent);
+        w.field("dropped", s.dropped);
+        w.field("in_flight", (uint32_t)session.inflight());
+        w.endObject();
+    }
+
+    // 会话统计，嵌进状态 JSON
+    void writeSessionStats(JsonWriter& w) const {
+        const MqttSession::Stats& s = session.stats();
+        w.beginObject();
+        w.field("client_id", clientId);
+        w.field("connects", s.connects);
+        w.field("resumed", s.resumed);
+        w.field("failures", s.failures);
+        w.field("published", s.published);
+        w.field("acked", s.acked);
+        w.field("retransmits", s.retransmits);
+        w.field("received", s.received);
+        w.field("oversized", s.oversized);
+        w.field("tx_dropped", txDropped);
+        w.field("tx_too_large", txTooLarge);
+        w.endObject();
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,672 @@
+#ifndef MQTT_SESSION_H
+#define MQTT_SESSION_H
+
+#include <stdint.h>
+#include <string.h>
+#include <functional>
+#include "MqttCodec.h"
+#include "OutboundQueue.h"
+
+// 单条报文体的上限 (收到的指令 / 缓存里的一条消息)
+#ifndef MQTT_RX_BYTES
+#define MQTT_RX_BYTES 1024
+#endif
+#ifndef MQTT_MAX_MESSAGE
+#define MQTT_MAX_MESSAGE 512
+#endif
+// QoS1 发送窗口的上限 (Config::maxInflight 不能超过它)
+#ifndef MQTT_MAX_INFLIGHT
+#define MQTT_MAX_INFLIGHT 16
+#endif
+#ifndef MQTT_MAX_SUBSCRIPTIONS
+#define MQTT_MAX_SUBSCRIPTIONS 4
+#endif
+
+// 非阻塞字节流 (TCP)。所有调用都立即返回
+class MqttTransport
+{
+public:
+    enum class Status : uint8_t
+    {
+        Closed,
+        Connecting,
+        Open
+    };
+
+    virtual ~MqttTransport() {}
+    // 开始连接；返回 false 表示立即失败 (解析不了地址等)
+    virtual bool open(const char *host, uint16_t port) = 0;
+    virtual Status status() = 0;
+    // 返回写入 / 读到的字节数 (可以是 0)，< 0 表示连接已断开
+    virtual int write(const uint8_t *data, size_t len) = 0;
+    virtual int read(uint8_t *data, size_t len) = 0;
+    virtual void close() = 0;
+};
+
+// MQTT 客户端会话 (纯逻辑，传输层由调用方提供)
+// - 不阻塞：TCP 连接、CONNECT 握手、发送、接收全部在 loop() 里一点点推进
+// - 持久会话：固定的 client id + cleanSession = false，broker 在设备离线时替它保存订阅和 QoS1 指令；
+//   每次 CONNACK 之后都重新订阅 (SUBSCRIBE 是幂等的；broker 保留的旧会话里没有升级后新加的主题)
+// - QoS1 发布：消息来自 OutboundQueue，队首最多 maxInflight 条同时在途 (不等前一条确认就发下一条)，
+//   收到 PUBACK 才出队；断线重连后在途的消息带 DUP 标志重发 (至少一次)
+// - 收到的 QoS1 消息先交给回调，再回 PUBACK；只从 socket 读发送缓冲区回得过来确认的量，
+//   确认的位置预留好，回调里发的消息挤不掉它 (没回确认的指令重连后会被 broker 重发、再执行一遍)；
+//   超过 MQTT_RX_BYTES 被丢弃的 QoS1 报文也回确认，不然每次重连都会再来
+// - QoS0 长报文 (状态 JSON) 分段发布：整条不必放进发送缓冲区，socket 收走多少就从数据源补多少；
+//   写完之前不读 socket、不插别的报文 (一个报文在线路上必须连续)
+// - 连接失败按指数退避 + 抖动重试；心跳超时视为断线
+class MqttSession
+{
+public:
+    typedef std::function<void(char *, uint8_t *, unsigned int)> MessageCallback;
+    // 分段发布的数据源：把负载里 [offset, offset + len) 这一段写进 out；同一段每次都要给出同样的字节
+    typedef void (*StreamSource)(const void *ctx, uint8_t *out, size_t offset, size_t len);
+
+    enum class State : uint8_t
+    {
+        Idle,          // 还没 start()，或 stop() 之后
+        TcpConnecting,
+        Handshake,     // CONNECT 已发出，等 CONNACK
+        Connected,
+        Backoff        // 等待重试
+    };
+
+    struct Config
+    {
+        const char *host = nullptr;
+        uint16_t port = 1883;
+        Mqtt::ConnectOptions connect;
+        uint8_t maxInflight = 8;
+        uint32_t connectTimeoutMs = 10000; // TCP + 握手
+        uint32_t retryBaseMs = 1000;
+        uint32_t retryCapMs = 60000;
+    };
+
+    struct Stats
+    {
+        uint32_t connects = 0;
+        uint32_t resumed = 0;     // broker 保留了会话的次数
+        uint32_t failures = 0;    // 连接失败或断线
+        uint32_t published = 0;   // 发出的 QoS1 报文 (含重发)
+        uint32_t acked = 0;
+        uint32_t retransmits = 0;
+        uint32_t received = 0;
+        uint32_t oversized = 0;   // 超过 MQTT_RX_BYTES 被丢弃的报文
+    };
+
+private:
+    MqttTransport &net;
+    Config cfg;
+    OutboundQueue *outbox = nullptr;
+    MessageCallback onMessage = nullptr;
+
+    uint8_t *tx = nullptr;
+    size_t txCap = 0;
+    size_t txLen = 0;
+    Mqtt::Decoder<MQTT_RX_BYTES> rx;
+    uint8_t msgBuf[MQTT_MAX_MESSAGE];
+
+    State st = State::Idle;
+    uint32_t stateAtMs = 0;
+    uint32_t retryAtMs = 0;
+    uint32_t lastTxMs = 0;
+    uint32_t lastRxMs = 0;
+    bool pingOutstanding = false;
+    uint8_t failStreak = 0;
+    uint32_t rng = 1;
+    uint16_t nextPid = 1;
+
+    // 在途窗口：与 outbox 队首的 inflightCount 条一一对应
+    uint16_t inflightPid[MQTT_MAX_INFLIGHT];
+    bool inflightAcked[MQTT_MAX_INFLIGHT];
+    uint8_t inflightCount = 0;
+
+    const char *subTopic[MQTT_MAX_SUBSCRIPTIONS];
+    uint8_t subQos[MQTT_MAX_SUBSCRIPTIONS];
+    uint8_t subCount = 0;
+    uint8_t subSent = 0; // 本次连接已经发出 SUBSCRIBE 的个数
+
+    // 正在分段发布的 QoS0 报文 (streamSrc 为空 = 没有)
+    StreamSource streamSrc = nullptr;
+    const void *streamCtx = nullptr;
+    const char *streamTopic = nullptr;
+    size_t streamLen = 0;
+    size_t streamAt = 0; // 已经写进发送缓冲区的负载字节数
+    bool streamRetained = false;
+    bool streamHeader = false; // 报文头已经写进发送缓冲区
+
+    Stats s;
+
+    // 读一段输入之前，给其中可能有的 QoS1 PUBLISH 预留的确认字节 (回调不能占用)
+    static const size_t ACK_BYTES = 4;         // 一个 PUBACK
+    static const size_t MIN_PUBLISH_BYTES = 6; // 最短的 QoS1 PUBLISH (空 topic、空负载)
+    size_t ackReserve = 0;
+
+    static bool reached(uint32_t nowMs, uint32_t atMs) { return (int32_t)(nowMs - atMs) >= 0; }
+
+    uint16_t packetId()
+    {
+        uint16_t id = nextPid++;
+        if (nextPid == 0)
+            nextPid = 1;
+        return id;
+    }
+
+    size_t txFree() const { return txCap - txLen - ackReserve; }
+
+    void setState(State next, uint32_t nowMs)
+    {
+        st = next;
+        stateAtMs = nowMs;
+    }
+
+    // 把发送缓冲区尽量写进 socket；连接断开返回 false
+    bool flushTx(uint32_t nowMs)
+    {
+        while (txLen > 0)
+        {
+            int n = net.write(tx, txLen);
+            if (n < 0)
+                return false;
+            if (n == 0)
+                break;
+            memmove(tx, tx + n, txLen - n);
+            txLen -= n;
+            lastTxMs = nowMs;
+        }
+        return true;
+    }
+
+    void fail(uint32_t nowMs)
+    {
+        net.close();
+        rx.reset();
+        txLen = 0; // 半截报文对新连接没有意义；QoS1 消息还在 outbox 里
+        streamSrc = nullptr;
+        pingOutstanding = false;
+        s.failures++;
+
+        // 退避窗口 [w/2, w]，w = base * 2^streak (有上限)
+        uint32_t w = cfg.retryBaseMs;
+        for (uint8_t i = 0; i < failStreak && w < cfg.retryCapMs; i++)
+            w *= 2;
+        if (w > cfg.retryCapMs)
+            w = cfg.retryCapMs;
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        retryAtMs = nowMs + w / 2 + rng % (w / 2 + 1);
+        if (failStreak < 255)
+            failStreak++;
+        setState(State::Backoff, nowMs);
+    }
+
+    void startConnect(uint32_t nowMs)
+    {
+        rx.reset();
+        txLen = 0;
+        if (!cfg.host || !net.open(cfg.host, cfg.port))
+        {
+            fail(nowMs);
+            return;
+        }
+        setState(State::TcpConnecting, nowMs);
+    }
+
+    // 编码第 index 条在途消息 (来自 outbox)；发送缓冲区放不下返回 false
+    bool encodeInflight(uint8_t index, bool dup)
+    {
+        const char *topic;
+        uint16_t len;
+        bool retained;
+        if (!outbox || !outbox->peek(index, topic, msgBuf, sizeof(msgBuf), len, retained))
+            return false;
+        if (txFree() < Mqtt::publishHeaderSize(topic, len, 1) + len)
+            return false;
+        Mqtt::Writer w(tx + txLen, txFree());
+        Mqtt::encodePublishHeader(w, topic, len, 1, retained, dup, inflightPid[index]);
+        w.bytes(msgBuf, len);
+        txLen += w.len;
+        s.published++;
+        return true;
+    }
+
+    // 重连后重发还没确认的在途消息；放不下的退回 "未发送"
+    void resendInflight(bool dup)
+    {
+        for (uint8_t i = 0; i < inflightCount; i++)
+        {
+            if (inflightAcked[i])
+                continue;
+            if (!encodeInflight(i, dup))
+            {
+                inflightCount = i;
+                break;
+            }
+            s.retransmits++;
+        }
+        if (outbox)
+            outbox->setPinned(inflightCount);
+    }
+
+    void onAck(uint16_t pid)
+    {
+        for (uint8_t i = 0; i < inflightCount; i++)
+        {
+            if (inflightPid[i] == pid)
+            {
+                inflightAcked[i] = true;
+                break;
+            }
+        }
+        // broker 按顺序确认；万一乱序，等队首也确认了再一起出队
+        while (inflightCount > 0 && inflightAcked[0])
+        {
+            if (outbox)
+                outbox->pop();
+            for (uint8_t i = 1; i < inflightCount; i++)
+            {
+                inflightPid[i - 1] = inflightPid[i];
+                inflightAcked[i - 1] = inflightAcked[i];
+            }
+            inflightCount--;
+            s.acked++;
+        }
+        if (outbox)
+            outbox->setPinned(inflightCount);
+    }
+
+    // 发出还没发的 SUBSCRIBE (发送缓冲区放不下的留到下一次 loop)
+    void sendSubscriptions()
+    {
+        while (subSent < subCount && !streamSrc)
+        {
+            Mqtt::Writer w(tx + txLen, txFree());
+            if (!Mqtt::encodeSubscribe(w, packetId(), subTopic[subSent], subQos[subSent]))
+                break;
+            txLen += w.len;
+            subSent++;
+        }
+    }
+
+    // 分段发布：把报文头和负载尽量填进发送缓冲区，socket 收走了就接着填，直到整条进了缓冲区或 socket 暂时不收
+    bool advanceStream(uint32_t nowMs)
+    {
+        for (int round = 0; round < 8 && streamSrc; round++) // 每次 loop 最多 8 个缓冲区，不饿死别的工作
+        {
+            if (!streamHeader)
+            {
+                Mqtt::Writer w(tx + txLen, txFree());
+                if (!Mqtt::encodePublishHeader(w, streamTopic, streamLen, 0, streamRetained, false, 0))
+                    return true; // 前面的报文还没写出去，等下一次
+                txLen += w.len;
+                streamHeader = true;
+            }
+            size_t n = streamLen - streamAt;
+            if (n > txFree())
+                n = txFree();
+            if (n > 0)
+            {
+                streamSrc(streamCtx, tx + txLen, streamAt, n);
+                txLen += n;
+                streamAt += n;
+            }
+            if (streamAt == streamLen)
+                streamSrc = nullptr; // 整条都进了发送缓冲区
+            if (!flushTx(nowMs))
+                return false;
+            if (txLen > 0)
+                break; // socket 暂时不收了
+        }
+        return true;
+    }
+
+    void onConnack(uint32_t nowMs)
+    {
+        if (rx.bodyLen() < 2 || rx.body()[1] != 0)
+        {
+            fail(nowMs); // 拒绝连接 (认证失败等)，按退避重试
+            return;
+        }
+        bool sessionPresent = rx.body()[0] & 0x01;
+        setState(State::Connected, nowMs);
+        failStreak = 0;
+        s.connects++;
+        if (sessionPresent)
+            s.resumed++;
+        subSent = 0;
+        sendSubscriptions();
+        resendInflight(sessionPresent);
+    }
+
+    // 回 PUBACK：用 readInput 预留的位置
+    void sendAck(uint16_t pid)
+    {
+        ackReserve = ackReserve > ACK_BYTES ? ackReserve - ACK_BYTES : 0;
+        Mqtt::Writer w(tx + txLen, txFree());
+        if (Mqtt::encodeAck(w, Mqtt::PUBACK, pid))
+            txLen += w.len;
+    }
+
+    void onPublish()
+    {
+        Mqtt::Publish p;
+        if (!rx.parsePublish(p))
+            return;
+        s.received++;
+        char topic[128];
+        if (p.topicLen < sizeof(topic) && onMessage)
+        {
+            memcpy(topic, p.topic, p.topicLen);
+            topic[p.topicLen] = '\0';
+            onMessage(topic, const_cast<uint8_t *>(p.payload), (unsigned int)p.payloadLen);
+        }
+        if (p.qos == 1)
+            sendAck(p.packetId);
+    }
+
+    void handlePacket(uint32_t nowMs)
+    {
+        lastRxMs = nowMs;
+        switch (rx.type())
+        {
+        case Mqtt::CONNACK:
+            if (st == State::Handshake)
+                onConnack(nowMs);
+            break;
+        case Mqtt::PUBLISH:
+            if (st == State::Connected)
+                onPublish();
+            break;
+        case Mqtt::PUBACK:
+            onAck(rx.packetId());
+            break;
+        case Mqtt::PINGRESP:
+            pingOutstanding = false;
+            break;
+        default:
+            break; // SUBACK 等：无需处理
+        }
+    }
+
+    // 读 socket 并处理收到的报文；连接断开返回 false
+    bool readInput(uint32_t nowMs)
+    {
+        uint8_t chunk[256];
+        for (int round = 0; round < 8; round++) // 每次 loop 最多读 2KB，不饿死别的工作
+        {
+            // 读到的每 MIN_PUBLISH_BYTES 字节 (加上已经收了一半的那个报文) 最多要回一个 PUBACK：
+            // 发送缓冲区回不过来时先不读，数据留在 socket 里，等缓冲区写出去再说
+            size_t acks = (txCap - txLen) / ACK_BYTES;
+            if (acks < 2)
+                break;
+            size_t want = (acks - 1) * MIN_PUBLISH_BYTES;
+            if (want > sizeof(chunk))
+                want = sizeof(chunk);
+            int n = net.read(chunk, want);
+            if (n < 0)
+                return false;
+            if (n == 0)
+                break;
+            ackReserve = ACK_BYTES * (1 + (size_t)n / MIN_PUBLISH_BYTES);
+            size_t at = 0;
+            while (at < (size_t)n)
+            {
+                size_t used = 0;
+                Mqtt::Decoder<MQTT_RX_BYTES>::Result r = rx.feed(chunk + at, n - at, used);
+                at += used;
+                if (r == Mqtt::Decoder<MQTT_RX_BYTES>::Result::Packet)
+                    handlePacket(nowMs);
+                else if (r == Mqtt::Decoder<MQTT_RX_BYTES>::Result::Skipped)
+                {
+                    s.oversized++;
+                    uint16_t pid = rx.skippedPacketId();
+                    if (pid && st == State::Connected)
+                        sendAck(pid);
+                }
+                else if (r == Mqtt::Decoder<MQTT_RX_BYTES>::Result::Error)
+                {
+                    ackReserve = 0;
+                    return false;
+                }
+                if (st != State::Handshake && st != State::Connected)
+                {
+                    ackReserve = 0;
+                    return true; // CONNACK 拒绝后已经断开
+                }
+            }
+            ackReserve = 0;
+        }
+        return true;
+    }
+
+public:
+    explicit MqttSession(MqttTransport &transport) : net(transport) {}
+    MqttSession(const MqttSession &) = delete;
+    MqttSession &operator=(const MqttSession &) = delete;
+
+    // buffer：发送缓冲区 (beginPublish 的 QoS0 报文要整条放得下，分段发布不受它限制)，可以放在 PSRAM
+    void begin(const Config &c, uint8_t *buffer, size_t capacity, OutboundQueue *queue, MessageCallback cb)
+    {
+        cfg = c;
+        if (cfg.maxInflight > MQTT_MAX_INFLIGHT)
+            cfg.maxInflight = MQTT_MAX_INFLIGHT;
+        if (cfg.maxInflight == 0)
+            cfg.maxInflight = 1;
+        tx = buffer;
+        txCap = buffer ? capacity : 0;
+        txLen = 0;
+        outbox = queue;
+        onMessage = cb;
+        // 抖动种子：client id 的 FNV 哈希 (每台设备不同，且不需要硬件随机数)
+        rng = 2166136261u;
+        for (const char *p = cfg.connect.clientId; p && *p; p++)
+            rng = (rng ^ (uint8_t)*p) * 16777619u;
+        if (!rng)
+            rng = 1;
+    }
+
+    // 订阅 (每次连接成功后自动发送；已连着时立即发送)
+    bool subscribe(const char *topic, uint8_t qos)
+    {
+        if (subCount >= MQTT_MAX_SUBSCRIPTIONS)
+            return false;
+        subTopic[subCount] = topic;
+        subQos[subCount] = qos > 1 ? 1 : qos;
+        subCount++;
+        if (st == State::Connected)
+            sendSubscriptions();
+        return true;
+    }
+
+    // 开始连接 (已经在连 / 在退避中时什么都不做)
+    void start(uint32_t nowMs)
+    {
+        if (st == State::Idle)
+            startConnect(nowMs);
+    }
+
+    // 主动断开 (发 DISCONNECT，broker 不会发遗嘱；分段发布写到一半时直接断开)
+    void stop(uint32_t nowMs)
+    {
+        if (st == State::Connected && !streamSrc)
+        {
+            Mqtt::Writer w(tx + txLen, txFree());
+            if (Mqtt::encodeEmpty(w, Mqtt::DISCONNECT))
+                txLen += w.len;
+            flushTx(nowMs);
+        }
+        net.close();
+        txLen = 0;
+        streamSrc = nullptr;
+        setState(State::Idle, nowMs);
+    }
+
+    // 推进会话；budget = 本次最多新发出几条 QoS1 消息。返回新发出的条数
+    uint16_t loop(uint32_t nowMs, uint16_t budget = 0xFFFF)
+    {
+        switch (st)
+        {
+        case State::Idle:
+            return 0;
+        case State::Backoff:
+            if (reached(nowMs, retryAtMs))
+                startConnect(nowMs);
+            return 0;
+        case State::TcpConnecting:
+        {
+            MqttTransport::Status ts = net.status();
+            if (ts == MqttTransport::Status::Closed || reached(nowMs, stateAtMs + cfg.connectTimeoutMs))
+            {
+                fail(nowMs);
+                return 0;
+            }
+            if (ts == MqttTransport::Status::Connecting)
+                return 0;
+            Mqtt::Writer w(tx, txCap);
+            if (!Mqtt::encodeConnect(w, cfg.connect))
+            {
+                fail(nowMs);
+                return 0;
+            }
+            txLen = w.len;
+            setState(State::Handshake, stateAtMs); // 超时从发起 TCP 连接算起
+            lastRxMs = nowMs;
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (st == State::Connected && !advanceStream(nowMs))
+        {
+            fail(nowMs);
+            return 0;
+        }
+        if (!streamSrc && !readInput(nowMs)) // 分段发布写完之前不读：收到的 QoS1 要回确认，会插进报文中间
+        {
+            fail(nowMs);
+            return 0;
+        }
+        if (st == State::Handshake && reached(nowMs, stateAtMs + cfg.connectTimeoutMs))
+        {
+            fail(nowMs);
+            return 0;
+        }
+
+        uint16_t sent = 0;
+        if (st == State::Connected)
+        {
+            // 心跳：一个心跳周期没发过东西就 PING；1.5 个周期没收到任何东西视为断线
+            uint32_t keepAliveMs = (uint32_t)cfg.connect.keepAliveSec * 1000;
+            if (keepAliveMs && reached(nowMs, lastRxMs + keepAliveMs + keepAliveMs / 2))
+            {
+                fail(nowMs);
+                return 0;
+            }
+        }
+        if (st == State::Connected && !streamSrc)
+        {
+            uint32_t keepAliveMs = (uint32_t)cfg.connect.keepAliveSec * 1000;
+            if (keepAliveMs && !pingOutstanding && reached(nowMs, lastTxMs + keepAliveMs) && txFree() >= 2)
+            {
+                Mqtt::Writer w(tx + txLen, txFree());
+                Mqtt::encodeEmpty(w, Mqtt::PINGREQ);
+                txLen += w.len;
+                pingOutstanding = true;
+            }
+            sendSubscriptions();
+            sent = sendPending(nowMs, budget);
+        }
+
+        if (st != State::Idle && st != State::Backoff && !flushTx(nowMs))
+            fail(nowMs);
+        return sent;
+    }
+
+    // 把 outbox 里还没发出的消息填进发送窗口 (不读 socket，可以在回调之外随时调用)
+    uint16_t sendPending(uint32_t nowMs, uint16_t budget = 0xFFFF)
+    {
+        if (st != State::Connected || !outbox || streamSrc)
+            return 0;
+        uint16_t sent = 0;
+        while (sent < budget && inflightCount < cfg.maxInflight && inflightCount < outbox->size())
+        {
+            inflightPid[inflightCount] = packetId();
+            inflightAcked[inflightCount] = false;
+            if (!encodeInflight(inflightCount, false))
+                break;
+            inflightCount++;
+            sent++;
+        }
+        outbox->setPinned(inflightCount);
+        if (!flushTx(nowMs))
+            fail(nowMs);
+        return sent;
+    }
+
+    // QoS0 发布：先写报文头，返回负载在发送缓冲区里的位置，调用方写满 payloadLen 字节后 endPublish()
+    // 未连接、正在分段发布或缓冲区放不下返回 nullptr
+    uint8_t *beginPublish(const char *topic, size_t payloadLen, bool retained)
+    {
+        if (st != State::Connected || streamSrc)
+            return nullptr;
+        size_t need = Mqtt::publishHeaderSize(topic, payloadLen, 0) + payloadLen;
+        if (txFree() < need)
+            return nullptr;
+        Mqtt::Writer w(tx + txLen, txFree());
+        Mqtt::encodePublishHeader(w, topic, payloadLen, 0, retained, false, 0);
+        txLen += w.len;
+        uint8_t *payload = tx + txLen;
+        txLen += payloadLen;
+        return payload;
+    }
+
+    bool endPublish(uint32_t nowMs)
+    {
+        if (flushTx(nowMs))
+            return true;
+        fail(nowMs);
+        return false;
+    }
+
+    bool publishNow(uint32_t nowMs, const char *topic, const uint8_t *payload, size_t len, bool retained)
+    {
+        uint8_t *at = beginPublish(topic, len, retained);
+        if (!at)
+            return false;
+        memcpy(at, payload, len);
+        return endPublish(nowMs);
+    }
+
+    // QoS0 分段发布：负载由 src(ctx, ...) 按段给出，在这里和之后的 loop() 里随 socket 的进度写进发送缓冲区
+    // topic、ctx 要活到 streaming() 变回 false；未连接或上一条还没写完时返回 false
+    bool beginStream(uint32_t nowMs, const char *topic, size_t payloadLen, bool retained, StreamSource src, const void *ctx)
+    {
+        if (st != State::Connected || streamSrc || !src)
+            return false;
+        streamSrc = src;
+        streamCtx = ctx;
+        streamTopic = topic;
+        streamLen = payloadLen;
+        streamAt = 0;
+        streamRetained = retained;
+        streamHeader = false;
+        if (advanceStream(nowMs))
+            return true;
+        fail(nowMs);
+        return false;
+    }
+
+    // 分段发布还没整条写进发送缓冲区
+    bool streaming() const { return streamSrc != nullptr; }
+
+    State state() const { return st; }
+    bool isConnected() const { return st == State::Connected; }
+    uint8_t inflight() const { return inflightCount; }
+    size_t pendingTxBytes() const { return txLen; }
+    size_t txCapacity() const { return txCap; }
+    const Stats &stats() const { return s; }
+};
+
+#endif
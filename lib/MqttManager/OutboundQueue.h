@@ -0,0 +1,261 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// 断线期间的 MQTT 出站消息缓存 (纯逻辑，不依赖 Arduino)
+// - 变长记录的字节环形缓冲区，存储区由调用方提供 (可以放在 PSRAM)
+// - topic 只保存指针，要求是静态字符串 (MQTT_TOPIC_* 宏)
+// - 满了按溢出策略处理，并记录丢弃数量
+class OutboundQueue
+{
+public:
+    enum class OverflowPolicy : uint8_t
+    {
+        DropOldest, // 挤掉最旧的消息 (默认：最新状态更有价值)
+        DropNewest  // 拒绝新消息 (保留最早的事件序列)
+    };
+
+    struct Stats
+    {
+        uint32_t depth;    // 当前排队的消息数
+        uint32_t bytes;    // 当前占用字节
+        uint32_t capacity; // 总字节容量
+        uint32_t enqueued; // 累计入队
+        uint32_t sent;     // 累计发出
+        uint32_t dropped;  // 累计因溢出丢弃
+        uint32_t highWater; // 历史最大排队数
+    };
+
+private:
+    struct Header
+    {
+        const char *topic;
+        uint16_t len;
+        uint8_t retained;
+    };
+
+    uint8_t *buf = nullptr;
+    uint32_t cap = 0;
+    uint32_t head = 0; // 最旧记录的起点
+    uint32_t used = 0;
+    uint32_t count = 0;
+    uint32_t pinned = 0; // 队首已发出、等待确认的条数：溢出时不能挤掉它们
+    OverflowPolicy policy;
+    Stats stats = {};
+
+    void copyIn(uint32_t at, const void *src, uint32_t n)
+    {
+        at %= cap;
+        uint32_t first = cap - at < n ? cap - at : n;
+        memcpy(buf + at, src, first);
+        memcpy(buf, (const uint8_t *)src + first, n - first);
+    }
+
+    void copyOut(uint32_t at, void *dst, uint32_t n) const
+    {
+        at %= cap;
+        uint32_t first = cap - at < n ? cap - at : n;
+        memcpy(dst, buf + at, first);
+        memcpy((uint8_t *)dst + first, buf, n - first);
+    }
+
+    Header peekHeader() const
+    {
+        Header h;
+        copyOut(head, &h, sizeof(h));
+        return h;
+    }
+
+    void dropFront()
+    {
+        Header h = peekHeader();
+        uint32_t size = sizeof(Header) + h.len;
+        head = (head + size) % cap;
+        used -= size;
+        count--;
+    }
+
+    // 丢掉在途消息之后最旧的一条：把队首 pinned 条整体后移，覆盖掉它
+    // 逐字节搬运 (环形、可能重叠)；只在溢出时发生，在途最多十几条
+    void dropOldestUnpinned()
+    {
+        uint32_t prefix = 0;
+        Header h;
+        for (uint32_t i = 0; i < pinned; i++)
+        {
+            copyOut(head + prefix, &h, sizeof(h));
+            prefix += sizeof(Header) + h.len;
+        }
+        copyOut(head + prefix, &h, sizeof(h));
+        uint32_t size = sizeof(Header) + h.len;
+        for (uint32_t i = prefix; i-- > 0;)
+            buf[(head + size + i) % cap] = buf[(head + i) % cap];
+        head = (head + size) % cap;
+        used -= size;
+        count--;
+    }
+
+public:
+    explicit OutboundQueue(OverflowPolicy p = OverflowPolicy::DropOldest) : policy(p) {}
+
+    // 绑定存储区 (丢弃已有内容)
+    void attach(uint8_t *storage, uint32_t capacity)
+    {
+        buf = storage;
+        cap = storage ? capacity : 0;
+        head = used = count = pinned = 0;
+        stats.capacity = cap;
+        stats.depth = stats.bytes = 0;
+    }
+
+    void setPolicy(OverflowPolicy p) { policy = p; }
+
+    // 入队；返回 false 表示这条消息被丢弃 (DropNewest 满了或单条超过容量)
+    bool push(const char *topic, const uint8_t *payload, uint16_t len, bool retained = false)
+    {
+        uint32_t size = sizeof(Header) + len;
+        if (size > cap)
+        {
+            stats.dropped++;
+            return false;
+        }
+        while (cap - used < size)
+        {
+            if (policy == OverflowPolicy::DropNewest || count <= pinned)
+            {
+                stats.dropped++;
+                return false;
+            }
+            if (pinned)
+                dropOldestUnpinned();
+            else
+                dropFront();
+            stats.dropped++;
+        }
+
+        Header h{topic, len, (uint8_t)(retained ? 1 : 0)};
+        uint32_t tail = (head + used) % cap;
+        copyIn(tail, &h, sizeof(h));
+        copyIn(tail + sizeof(h), payload, len);
+        used += size;
+        count++;
+
+        stats.enqueued++;
+        if (count > stats.highWater)
+            stats.highWater = count;
+        return true;
+    }
+
+    bool push(const char *topic, const char *payload, bool retained = false)
+    {
+        size_t n = strlen(payload);
+        return push(topic, (const uint8_t *)payload, (uint16_t)(n > 0xFFFF ? 0xFFFF : n), retained);
+    }
+
+    // 读出最旧的一条 (不出队)；out 至少 outCap 字节，超长时截断
+    // 返回 false 表示队列为空
+    bool front(const char *&topic, uint8_t *out, uint16_t outCap, uint16_t &len, bool &retained) const
+    {
+        if (count == 0)
+            return false;
+        Header h = peekHeader();
+        topic = h.topic;
+        len = h.len < outCap ? h.len : outCap;
+        retained = h.retained != 0;
+        copyOut(head + sizeof(Header), out, len);
+        return true;
+    }
+
+    // 读出第 index 条 (0 = 最旧)，不出队；用于 QoS1 发送窗口里的第 2..N 条
+    bool peek(uint32_t index, const char *&topic, uint8_t *out, uint16_t outCap, uint16_t &len, bool &retained) const
+    {
+        if (index >= count)
+            return false;
+        uint32_t at = head;
+        Header h;
+        for (;;)
+        {
+            copyOut(at, &h, sizeof(h));
+            if (index-- == 0)
+                break;
+            at = (at + sizeof(Header) + h.len) % cap;
+        }
+        topic = h.topic;
+        len = h.len < outCap ? h.len : outCap;
+        retained = h.retained != 0;
+        copyOut(at + sizeof(Header), out, len);
+        return true;
+    }
+
+    // 发送成功后再出队，发送失败的消息留在队首下次重试
+    void pop()
+    {
+        if (count == 0)
+            return;
+        dropFront();
+        if (pinned)
+            pinned--;
+        stats.sent++;
+    }
+
+    // 标记队首 n 条为 "已发出未确认"：DropOldest 溢出时宁可丢新消息也不挤掉它们
+    void setPinned(uint32_t n) { pinned = n < count ? n : count; }
+
+    bool empty() const { return count == 0; }
+    uint32_t size() const { return count; }
+
+    Stats getStats() const
+    {
+        Stats s = stats;
+        s.depth = count;
+        s.bytes = used;
+        return s;
+    }
+};
+
+// 重连后的限速刷新：每个时间窗最多放行 burst 条，避免重连瞬间的发布风暴
+class FlushPacer
+{
+private:
+    uint32_t intervalMs;
+    uint16_t burst;
+    uint32_t windowStart = 0;
+    uint16_t usedInWindow = 0;
+    bool started = false;
+
+public:
+    FlushPacer(uint32_t _intervalMs = 100, uint16_t _burst = 5) : intervalMs(_intervalMs), burst(_burst) {}
+
+    void configure(uint32_t _intervalMs, uint16_t _burst)
+    {
+        intervalMs = _intervalMs;
+        burst = _burst > 0 ? _burst : 1;
+    }
+
+    // 连接恢复时调用：第一个窗口从现在开始
+    void reset(uint32_t now)
+    {
+        windowStart = now;
+        usedInWindow = 0;
+        started = true;
+    }
+
+    // 当前还能发几条
+    uint16_t budget(uint32_t now)
+    {
+        if (!started || now - windowStart >= intervalMs)
+        {
+            windowStart = now;
+            usedInWindow = 0;
+            started = true;
+        }
+        return burst - usedInWindow;
+    }
+
+    void consume() { usedInWindow++; }
+};
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef SOCKET_TRANSPORT_H
+#define SOCKET_TRANSPORT_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "MqttSession.h"
+
+#ifdef ARDUINO
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// 非阻塞 TCP (BSD socket API：ESP32 上是 lwIP，host 上是 POSIX，同一份代码)
+// - connect() 立即返回 EINPROGRESS，status() 用 select + SO_ERROR 查询是否连上
+// - 关掉 Nagle：PUBACK / PINGREQ 这种小包不该等 200ms
+// - 域名解析 (getaddrinfo) 是阻塞的：只在第一次解析，之后重连都用缓存的地址；IP 字面量不查 DNS
+class SocketTransport : public MqttTransport
+{
+private:
+    int fd = -1;
+    Status st = Status::Closed;
+    const char *cachedHost = nullptr;
+    uint16_t cachedPort = 0;
+    struct sockaddr_in addr;
+
+    bool resolve(const char *host, uint16_t port)
+    {
+        if (cachedHost == host && cachedPort == port)
+            return true;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+        {
+            struct addrinfo hints;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_INET;
+            hints.ai_socktype = SOCK_STREAM;
+            struct addrinfo *res = nullptr;
+            if (getaddrinfo(host, nullptr, &hints, &res) != 0 || !res)
+                return false;
+            addr.sin_addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+            freeaddrinfo(res);
+        }
+        cachedHost = host;
+        cachedPort = port;
+        return true;
+    }
+
+public:
+    ~SocketTransport() { close(); }
+
+    bool open(const char *host, uint16_t port) override
+    {
+        close();
+        if (!resolve(host, port))
+            return false;
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+            st = Status::Open;
+        else if (errno == EINPROGRESS)
+            st = Status::Connecting;
+        else
+        {
+            close();
+            cachedHost = nullptr; // 地址可能变了，下次重新解析
+            return false;
+        }
+        return true;
+    }
+
+    Status status() override
+    {
+        if (st != Status::Connecting)
+            return st;
+        fd_set wr;
+        FD_ZERO(&wr);
+        FD_SET(fd, &wr);
+        struct timeval tv = {0, 0};
+        if (select(fd + 1, nullptr, &wr, nullptr, &tv) <= 0)
+            return st;
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0)
+        {
+            close();
+            cachedHost = nullptr;
+            return st;
+        }
+        st = Status::Open;
+        return st;
+    }
+
+    int write(const uint8_t *data, size_t len) override
+    {
+        if (st != Status::Open)
+            return -1;
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n >= 0)
+            return (int)n;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        close();
+        return -1;
+    }
+
+    int read(uint8_t *data, size_t len) override
+    {
+        if (st != Status::Open)
+            return -1;
+        ssize_t n = recv(fd, data, len, 0);
+        if (n > 0)
+            return (int)n;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        close(); // n == 0：对端关闭
+        return -1;
+    }
+
+    void close() override
+    {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+        st = Status::Closed;
+    }
+};
+
+#endif
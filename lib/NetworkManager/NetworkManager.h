@@ -1,61 +1,139 @@
+#ifndef NETWORK_MANAGER_H
+#define NETWORK_MANAGER_H
+
 #include <WiFi.h>
+#include <atomic>
+#include <functional>
+#include "JsonWriter.h"
+#include "Trace.h"
+#include "WifiLink.h"
+
+// 非阻塞 WiFi 管理：连接结果来自 WiFi 事件，重连节奏由 WifiLink (指数退避 + 抖动) 决定
+// - 事件回调跑在系统事件任务里，只置标志并叫醒网络任务；所有 WiFi 调用都在网络任务的 loop() 里
+// - 关掉驱动自带的自动重连，否则它会绕开退避立刻重试
 class NetworkManager
 {
 private:
     const char *ssid;
     const char *password;
+    WifiLink link;
 
-    // 新增：记录上次尝试连接的时间
-    unsigned long lastConnectAttempt = 0;
-    // 新增：冷却时间 (比如 60秒)
-    const unsigned long RECONNECT_INTERVAL = 60000;
-
-public:
-    NetworkManager(const char *_ssid, const char *_pwd) : ssid(_ssid), password(_pwd) {}
+    static const uint8_t EVT_GOT_IP = 0x01;
+    static const uint8_t EVT_DISCONNECTED = 0x02;
+    std::atomic<uint8_t> pending{0};
+    std::function<void()> onEvent = nullptr;
 
-    void connect()
+    void handleEvents(uint32_t now)
     {
-        // 1. 如果已经连上了，直接返回
-        if (WiFi.status() == WL_CONNECTED)
-            return;
-
-        // 2. [关键修改] 检查是否还在冷却期
-        // 如果距离上次尝试还不到 60秒，直接跳过，不要频繁骚扰 WiFi 芯片
-        if (millis() - lastConnectAttempt < RECONNECT_INTERVAL && lastConnectAttempt != 0)
+        uint8_t evts = pending.exchange(0);
+        // 两个都有时按 "先断后连" 处理：最后的状态以 WiFi.status() 为准
+        if (evts & EVT_DISCONNECTED)
         {
-            return;
+            bool wasUp = link.isConnected();
+            link.onDisconnected(now);
+            if (wasUp)
+                TRACE_W("[Network] Link lost, retry in %u ms", link.msUntilAction(now));
+            else if (link.state() == WifiLink::State::Waiting)
+                TRACE_I("[Network] Attempt failed (%u in a row), retry in %u ms", link.failureStreak(), link.msUntilAction(now));
         }
+        if ((evts & EVT_GOT_IP) && WiFi.status() == WL_CONNECTED)
+        {
+            link.onConnected(now, WiFi.channel(), WiFi.BSSID());
+            const WifiLink::Stats &s = link.stats();
+            TRACE_I("[Network] Connected in %u ms (channel %d, outage %u ms)", s.lastConnectMs, (int32_t)WiFi.channel(), s.lastOutageMs);
+        }
+    }
+
+public:
+    NetworkManager(const char *_ssid, const char *_pwd) : ssid(_ssid), password(_pwd) {}
 
-        // 更新尝试时间
-        lastConnectAttempt = millis();
+    // onChange：WiFi 状态变化时调用 (一般是叫醒网络任务)，在事件任务里执行，必须很快返回
+    void begin(std::function<void()> onChange = nullptr)
+    {
+        onEvent = onChange;
 
-        Serial.printf("\n[Network] Connecting to %s ", ssid);
+        // 每台设备的抖动序列不同：MAC 低位 + 硬件随机数
+        uint8_t mac[6];
+        WiFi.macAddress(mac);
+        link.reseed(((uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5]) ^ esp_random());
 
-        // 建议：先断开旧连接，清理状态
-        WiFi.disconnect();
+        WiFi.persistent(false);
         WiFi.mode(WIFI_STA); // 确保是 Station 模式
-        WiFi.begin(ssid, password);
+        WiFi.setAutoReconnect(false);
+        WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t)
+                     {
+            if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
+                pending.fetch_or(EVT_GOT_IP);
+            else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED)
+                pending.fetch_or(EVT_DISCONNECTED);
+            else
+                return;
+            if (onEvent)
+                onEvent(); });
+    }
 
-        int timeout = 20;
-        while (WiFi.status() != WL_CONNECTED && timeout > 0)
-        {
-            delay(500);
-            Serial.print(".");
-            timeout--;
-        }
+    // [网络任务] 推进状态机，从不阻塞；返回距离下一次需要调用的毫秒数
+    uint32_t loop()
+    {
+        uint32_t now = millis();
+        handleEvents(now);
 
-        if (WiFi.status() == WL_CONNECTED)
+        switch (link.poll(now))
         {
-            Serial.println("\n[Network] Connected!");
+        case WifiLink::Action::Connect:
+            TRACE_I("[Network] Connecting (attempt %u, full scan)...", link.stats().attempts);
+            WiFi.begin(ssid, password);
+            break;
+        case WifiLink::Action::ConnectFast:
+            TRACE_I("[Network] Connecting (attempt %u, channel %d)...", link.stats().attempts, link.hint().channel);
+            WiFi.begin(ssid, password, link.hint().channel, link.hint().bssid);
+            break;
+        case WifiLink::Action::Abort:
+            TRACE_W("[Network] Attempt timed out (%u in a row), retry in %u ms", link.failureStreak(), link.msUntilAction(now));
+            WiFi.disconnect();
+            break;
+        case WifiLink::Action::None:
+            break;
         }
-        else
+        return link.msUntilAction(now);
+    }
+
+    // 启动阶段用：最多等 timeoutMs 直到连上 (之后的重连全部异步)
+    bool waitConnected(uint32_t timeoutMs)
+    {
+        uint32_t start = millis();
+        while (millis() - start < timeoutMs)
         {
-            Serial.println("\n[Network] Connection failed (timeout). Will retry later.");
+            loop();
+            if (isConnected())
+                return true;
+            delay(50);
         }
+        return isConnected();
     }
 
     bool isConnected()
     {
         return WiFi.status() == WL_CONNECTED;
     }
-};
\ No newline at end of file
+
+    // 连接统计 (状态 JSON 的 "wifi" 字段)
+    void writeStats(JsonWriter &w) const
+    {
+        const WifiLink::Stats &s = link.stats();
+        w.beginObject();
+        w.field("attempts", s.attempts);
+        w.field("connects", s.connects);
+        w.field("fast_connects", s.fastConnects);
+        w.field("failures", s.failures);
+        w.field("disconnects", s.disconnects);
+        w.field("last_connect_ms", s.lastConnectMs);
+        w.field("avg_connect_ms", link.avgConnectMs());
+        w.field("max_connect_ms", s.maxConnectMs);
+        w.field("last_outage_ms", s.lastOutageMs);
+        w.field("max_outage_ms", s.maxOutageMs);
+        w.endObject();
+    }
+};
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef WIFI_LINK_H
+#define WIFI_LINK_H
+
+#include <stdint.h>
+#include <string.h>
+
+// WiFi 重连状态机 (纯逻辑，不依赖 Arduino)
+// - 不阻塞：poll() 只告诉调用方 "现在该发起连接 / 放弃这次尝试 / 什么都不做"，
+//   连接结果由 WiFi 事件通过 onConnected() / onDisconnected() 送进来
+// - 指数退避 + 抖动：第 n 次连续失败后等待 [w/2, w]，w = min(capMs, baseMs * 2^(n-1))；
+//   掉线后的第一次尝试也在 [0, baseMs] 里随机推迟。路由器重启时整栋楼的设备不会在同一时刻一起重试
+// - 记住上次连上的信道和 BSSID：掉线后先走快速重连 (跳过全信道扫描)，失败一次就忘掉，改回完整扫描
+// - 统计连接耗时 (发起到拿到 IP) 和掉线时长 (掉线到重新拿到 IP)
+// 时间参数都是 millis()，按 32 位回绕安全地比较
+class WifiLink
+{
+public:
+    static const uint32_t FOREVER = UINT32_MAX;
+
+    enum class State : uint8_t
+    {
+        Idle,       // 还没开始
+        Connecting, // 已发起，等结果
+        Connected,
+        Waiting     // 退避中
+    };
+
+    enum class Action : uint8_t
+    {
+        None,
+        Connect,     // 完整扫描后连接
+        ConnectFast, // 用记住的信道 / BSSID 直连
+        Abort        // 本次尝试超时：断开，进入退避
+    };
+
+    struct Config
+    {
+        uint32_t baseMs = 2000;           // 第一次失败后的退避窗口
+        uint32_t capMs = 300000;          // 退避上限 (5 分钟)
+        uint32_t attemptTimeoutMs = 15000; // 单次尝试最长等待
+    };
+
+    struct ApHint
+    {
+        bool valid = false;
+        int32_t channel = 0;
+        uint8_t bssid[6] = {};
+    };
+
+    struct Stats
+    {
+        uint32_t attempts = 0;
+        uint32_t connects = 0;
+        uint32_t fastConnects = 0; // 快速重连成功的次数
+        uint32_t failures = 0;
+        uint32_t disconnects = 0;  // 连上之后掉线的次数
+        uint32_t lastConnectMs = 0;
+        uint32_t maxConnectMs = 0;
+        uint32_t totalConnectMs = 0;
+        uint32_t lastOutageMs = 0;
+        uint32_t maxOutageMs = 0;
+    };
+
+private:
+    Config cfg;
+    State st = State::Idle;
+    ApHint ap;
+    Stats s;
+    uint32_t rng;
+    uint8_t failStreak = 0;    // 连续失败次数
+    uint32_t timedConnects = 0; // 有发起时刻的连接成功次数 (平均耗时的分母)
+    bool fastAttempt = false;  // 当前尝试是否是快速重连
+    bool lostLink = false;     // 是否处在掉线后的恢复中 (统计掉线时长)
+    uint32_t attemptAtMs = 0;
+    uint32_t retryAtMs = 0;
+    uint32_t lostAtMs = 0;
+
+    uint32_t random()
+    {
+        // xorshift32：每台设备的种子不同 (MAC / 硬件随机数)，抖动才会错开
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    }
+
+    static bool reached(uint32_t nowMs, uint32_t atMs) { return (int32_t)(nowMs - atMs) >= 0; }
+
+    void scheduleRetry(uint32_t nowMs)
+    {
+        retryAtMs = nowMs + retryDelayMs(failStreak);
+        st = State::Waiting;
+    }
+
+    void fail(uint32_t nowMs)
+    {
+        s.failures++;
+        if (failStreak < 255)
+            failStreak++;
+        if (fastAttempt)
+            ap.valid = false; // AP 可能换了信道：下次完整扫描
+        scheduleRetry(nowMs);
+    }
+
+public:
+    explicit WifiLink(uint32_t seed = 1) : rng(seed ? seed : 0x9E3779B9u) {}
+    WifiLink(uint32_t seed, const Config &c) : cfg(c), rng(seed ? seed : 0x9E3779B9u) {}
+
+    void reseed(uint32_t seed) { rng = seed ? seed : 0x9E3779B9u; }
+
+    // 第 streak 次连续失败后的等待时间 (streak = 0：掉线后的第一次尝试)
+    uint32_t retryDelayMs(uint8_t streak)
+    {
+        if (streak == 0)
+            return random() % (cfg.baseMs + 1);
+        uint32_t window = cfg.baseMs;
+        for (uint8_t i = 1; i < streak && window < cfg.capMs; i++)
+            window *= 2;
+        if (window > cfg.capMs)
+            window = cfg.capMs;
+        return window / 2 + random() % (window / 2 + 1);
+    }
+
+    // 在网络任务里调用：返回要执行的动作
+    Action poll(uint32_t nowMs)
+    {
+        switch (st)
+        {
+        case State::Idle:
+            break;
+        case State::Connecting:
+            if (!reached(nowMs, attemptAtMs + cfg.attemptTimeoutMs))
+                return Action::None;
+            fail(nowMs);
+            return Action::Abort;
+        case State::Waiting:
+            if (!reached(nowMs, retryAtMs))
+                return Action::None;
+            break;
+        case State::Connected:
+            return Action::None;
+        }
+
+        st = State::Connecting;
+        attemptAtMs = nowMs;
+        s.attempts++;
+        fastAttempt = ap.valid;
+        return fastAttempt ? Action::ConnectFast : Action::Connect;
+    }
+
+    // 拿到 IP (bssid 可以为 nullptr)
+    void onConnected(uint32_t nowMs, int32_t channel, const uint8_t *bssid)
+    {
+        if (st == State::Connected)
+            return;
+        if (st == State::Connecting)
+        {
+            uint32_t ms = nowMs - attemptAtMs;
+            s.lastConnectMs = ms;
+            s.totalConnectMs += ms;
+            if (ms > s.maxConnectMs)
+                s.maxConnectMs = ms;
+            timedConnects++;
+            if (fastAttempt)
+                s.fastConnects++;
+        }
+        if (lostLink)
+        {
+            s.lastOutageMs = nowMs - lostAtMs;
+            if (s.lastOutageMs > s.maxOutageMs)
+                s.maxOutageMs = s.lastOutageMs;
+            lostLink = false;
+        }
+        s.connects++;
+        failStreak = 0;
+        st = State::Connected;
+        if (bssid && channel > 0)
+        {
+            ap.valid = true;
+            ap.channel = channel;
+            memcpy(ap.bssid, bssid, sizeof(ap.bssid));
+        }
+    }
+
+    // 连接失败或掉线
+    void onDisconnected(uint32_t nowMs)
+    {
+        if (st == State::Connecting)
+        {
+            fail(nowMs);
+        }
+        else if (st == State::Connected)
+        {
+            s.disconnects++;
+            lostLink = true;
+            lostAtMs = nowMs;
+            failStreak = 0;
+            scheduleRetry(nowMs);
+        }
+        // Idle / Waiting：Abort 之后驱动自己报上来的断开，忽略
+    }
+
+    // 距离下一次需要 poll() 还有多久 (网络任务据此决定睡多久)
+    uint32_t msUntilAction(uint32_t nowMs) const
+    {
+        if (st == State::Idle)
+            return 0;
+        if (st == State::Connected)
+            return FOREVER;
+        uint32_t at = st == State::Connecting ? attemptAtMs + cfg.attemptTimeoutMs : retryAtMs;
+        return reached(nowMs, at) ? 0 : at - nowMs;
+    }
+
+    State state() const { return st; }
+    bool isConnected() const { return st == State::Connected; }
+    uint8_t failureStreak() const { return failStreak; }
+    const ApHint &hint() const { return ap; }
+    const Stats &stats() const { return s; }
+    uint32_t avgConnectMs() const { return timedConnects ? s.totalConnectMs / timedConnects : 0; }
+};
+
+#endif
@@ -0,0 +1,481 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include "Sha256.h"
+
+// 差分补丁格式 "WDP1"：新固件 = 正在运行的固件 + 补丁 (思路同 bsdiff)
+// 头部 44 字节：'W' 'D' 'P' '1' + 新镜像长度 (u32 小端) + 旧镜像长度 (u32 小端) + 旧镜像 SHA-256
+// 之后是一串操作，每个操作以 varint (LEB128) 开头：值 = n << 2 | 类型
+//   0 COPY   n：拷贝旧镜像 n 字节 (旧位置前进 n)
+//   1 ADD    n + n 字节：新字节 = 旧字节 + 差值 (按字节取模，旧位置前进 n)；地址整体平移后的指针、跳转偏移落在这里
+//   2 INSERT n + n 字节：旧镜像里没有的新内容 (旧位置不动)
+//   3 SEEK   n：旧位置 += zigzag 解码后的 n (代码块挪了位置)
+// 补丁整体再用 WLZ1 压缩 (Lzss.h)；生成见 tools/ota_pack.py diff，下面的 Encoder 是同一算法 (测试用)
+namespace Delta
+{
+    const size_t HEADER_BYTES = 44;
+
+    enum class Op : uint8_t
+    {
+        Copy,
+        Add,
+        Insert,
+        Seek
+    };
+
+    // 旧镜像 (ESP32 上是正在运行的 app 分区)：随机读
+    class OldImage
+    {
+    public:
+        virtual ~OldImage() {}
+        virtual uint32_t size() const = 0;
+        virtual bool read(uint32_t offset, uint8_t *buf, size_t len) = 0;
+    };
+
+    enum class Status : uint8_t
+    {
+        More,
+        Done,
+        BadFormat,    // 操作越界、超出新镜像长度、尾部多余数据
+        BaseMismatch, // 设备上跑的不是补丁对应的旧版本
+        ReadFailed,
+        SinkFailed
+    };
+
+    // 流式应用补丁：补丁字节可以在任意位置切开；输出和 Lzss::Decoder 一样每满 4KB emit 一次
+    // 内存固定：4KB 输出块 + 256 字节旧镜像读缓存
+    class Applier
+    {
+    public:
+        static const uint16_t BLOCK = 4096;
+
+    private:
+        enum class St : uint8_t
+        {
+            Header,
+            OpCode,
+            Body, // ADD / INSERT 的数据字节
+            Done,
+            Failed
+        };
+
+        OldImage *base = nullptr;
+        St st = St::Header;
+        Status failure = Status::BadFormat;
+        uint8_t header[HEADER_BYTES];
+        uint8_t headerLen = 0;
+        uint32_t newSize = 0;
+        uint32_t oldSize = 0;
+        uint32_t oldPos = 0;
+        uint32_t produced = 0;
+
+        uint32_t varint = 0;
+        uint8_t shift = 0;
+        Op op = Op::Copy;
+        uint32_t left = 0; // 当前 ADD / INSERT 还差多少字节
+
+        uint8_t out[BLOCK];
+        uint16_t outLen = 0;
+        uint8_t cache[256];
+        uint32_t cacheStart = 0;
+        uint16_t cacheLen = 0;
+
+        Status fail(Status s)
+        {
+            st = St::Failed;
+            failure = s;
+            return s;
+        }
+
+        bool oldAt(uint32_t pos, uint8_t &b)
+        {
+            if (pos < cacheStart || pos >= cacheStart + cacheLen)
+            {
+                uint32_t n = oldSize - pos < sizeof(cache) ? oldSize - pos : (uint32_t)sizeof(cache);
+                if (!base->read(pos, cache, n))
+                    return false;
+                cacheStart = pos;
+                cacheLen = (uint16_t)n;
+            }
+            b = cache[pos - cacheStart];
+            return true;
+        }
+
+        template <class Emit>
+        bool put(uint8_t b, Emit &emit)
+        {
+            out[outLen++] = b;
+            produced++;
+            if (outLen < BLOCK)
+                return true;
+            outLen = 0;
+            return emit((const uint8_t *)out, (size_t)BLOCK);
+        }
+
+        // 头部读完：校验旧镜像，运行中的固件不是补丁的基线就拒绝
+        Status checkBase()
+        {
+            if (memcmp(header, "WDP1", 4) != 0)
+                return fail(Status::BadFormat);
+            newSize = (uint32_t)header[4] | (uint32_t)header[5] << 8 | (uint32_t)header[6] << 16 | (uint32_t)header[7] << 24;
+            oldSize = (uint32_t)header[8] | (uint32_t)header[9] << 8 | (uint32_t)header[10] << 16 | (uint32_t)header[11] << 24;
+            if (newSize == 0)
+                return fail(Status::BadFormat);
+            if (!base || oldSize > base->size())
+                return fail(Status::BaseMismatch);
+            Sha256 sha;
+            for (uint32_t pos = 0; pos < oldSize;)
+            {
+                uint32_t n = oldSize - pos < sizeof(cache) ? oldSize - pos : (uint32_t)sizeof(cache);
+                if (!base->read(pos, cache, n))
+                    return fail(Status::ReadFailed);
+                sha.update(cache, n);
+                pos += n;
+            }
+            cacheLen = 0;
+            uint8_t got[Sha256::DIGEST_BYTES];
+            sha.finish(got);
+            if (memcmp(got, header + 12, sizeof(got)) != 0)
+                return fail(Status::BaseMismatch);
+            return Status::More;
+        }
+
+        // 一个操作结束：新镜像够了就交出最后一块
+        template <class Emit>
+        bool opDone(Emit &emit)
+        {
+            st = St::OpCode;
+            if (produced < newSize)
+                return true;
+            st = St::Done;
+            return outLen == 0 || emit((const uint8_t *)out, (size_t)outLen);
+        }
+
+    public:
+        void reset(OldImage *image)
+        {
+            base = image;
+            st = St::Header;
+            headerLen = 0;
+            newSize = oldSize = oldPos = produced = 0;
+            varint = 0;
+            shift = 0;
+            outLen = 0;
+            cacheLen = 0;
+        }
+
+        template <class Emit>
+        Status feed(const uint8_t *data, size_t len, Emit &&emit)
+        {
+            for (size_t i = 0; i < len; i++)
+            {
+                uint8_t c = data[i];
+                switch (st)
+                {
+                case St::Header:
+                    header[headerLen++] = c;
+                    if (headerLen == HEADER_BYTES && checkBase() != Status::More)
+                        return failure;
+                    if (headerLen == HEADER_BYTES)
+                        st = St::OpCode;
+                    break;
+
+                case St::OpCode:
+                {
+                    if (shift > 28)
+                        return fail(Status::BadFormat);
+                    varint |= (uint32_t)(c & 0x7F) << shift;
+                    shift += 7;
+                    if (c & 0x80)
+                        break;
+                    op = (Op)(varint & 3);
+                    uint32_t n = varint >> 2;
+                    varint = 0;
+                    shift = 0;
+
+                    if (op == Op::Seek)
+                    {
+                        int32_t delta = (int32_t)(n >> 1) ^ -(int32_t)(n & 1);
+                        int64_t to = (int64_t)oldPos + delta;
+                        if (to < 0 || to > (int64_t)oldSize)
+                            return fail(Status::BadFormat);
+                        oldPos = (uint32_t)to;
+                        break;
+                    }
+                    if (n == 0 || n > newSize - produced || (op != Op::Insert && n > oldSize - oldPos))
+                        return fail(Status::BadFormat);
+                    if (op == Op::Copy)
+                    {
+                        // 不需要输入：直接从旧镜像拷贝
+                        for (uint32_t k = 0; k < n; k++)
+                        {
+                            uint8_t b;
+                            if (!oldAt(oldPos++, b))
+                                return fail(Status::ReadFailed);
+                            if (!put(b, emit))
+                                return fail(Status::SinkFailed);
+                        }
+                        if (!opDone(emit))
+                            return fail(Status::SinkFailed);
+                        break;
+                    }
+                    left = n;
+                    st = St::Body;
+                    break;
+                }
+
+                case St::Body:
+                {
+                    uint8_t b = c;
+                    if (op == Op::Add)
+                    {
+                        uint8_t o;
+                        if (!oldAt(oldPos++, o))
+                            return fail(Status::ReadFailed);
+                        b = (uint8_t)(o + c);
+                    }
+                    if (!put(b, emit))
+                        return fail(Status::SinkFailed);
+                    if (--left == 0 && !opDone(emit))
+                        return fail(Status::SinkFailed);
+                    break;
+                }
+
+                case St::Done:
+                    return fail(Status::BadFormat);
+
+                case St::Failed:
+                    return failure;
+                }
+            }
+            return st == St::Done ? Status::Done : (st == St::Failed ? failure : Status::More);
+        }
+
+        // 头部读完之前是 0
+        uint32_t size() const { return newSize; }
+        uint32_t written() const { return produced; }
+        bool done() const { return st == St::Done; }
+    };
+
+    // 补丁生成 (主机测试用；tools/ota_pack.py diff 是同一算法)
+    // bsdiff 的主循环，最长匹配用 8 字节哈希索引代替后缀数组：
+    // 1. 沿新镜像扫描，找旧镜像里的精确匹配；当前对齐方式下仍然 "大致相同" 就不切换
+    // 2. 切换时把上一段向前、这一段向后做近似扩展 (一半以上字节相同)，差值进 ADD，其余进 INSERT
+    // 3. 差值里连续的 0 (没变的字节) 写成 COPY，所以只改了几 KB 的版本补丁很小
+    class Encoder
+    {
+    private:
+        static const uint8_t KEY = 8;
+        const uint8_t *oldData = nullptr;
+        const uint8_t *newData = nullptr;
+        uint32_t oldSize = 0, newSize = 0;
+        std::vector<int32_t> table;
+        uint32_t mask = 0;
+        std::vector<uint8_t> *out = nullptr;
+
+        static uint32_t hashKey(const uint8_t *p)
+        {
+            uint64_t v = 0;
+            memcpy(&v, p, KEY);
+            return (uint32_t)((v * 0x9E3779B97F4A7C15ull) >> 32);
+        }
+
+        void search(uint32_t scan, uint32_t &len, uint32_t &pos) const
+        {
+            len = 0;
+            if (scan + KEY > newSize)
+                return;
+            int32_t p = table[hashKey(newData + scan) & mask];
+            if (p < 0 || memcmp(oldData + p, newData + scan, KEY) != 0)
+                return;
+            uint32_t l = KEY;
+            while (p + l < oldSize && scan + l < newSize && oldData[p + l] == newData[scan + l])
+                l++;
+            len = l;
+            pos = (uint32_t)p;
+        }
+
+        void putVarint(uint32_t v)
+        {
+            while (v >= 0x80)
+            {
+                out->push_back((uint8_t)(v | 0x80));
+                v >>= 7;
+            }
+            out->push_back((uint8_t)v);
+        }
+
+        void putOp(Op op, uint32_t n) { putVarint(n << 2 | (uint32_t)op); }
+
+        // 差值区：连续 >= 4 个 0 写成 COPY，其余写成 ADD
+        void putDiff(uint32_t newStart, uint32_t oldStart, uint32_t len)
+        {
+            uint32_t i = 0;
+            while (i < len)
+            {
+                uint32_t z = i;
+                while (z < len && newData[newStart + z] == oldData[oldStart + z])
+                    z++;
+                if (z - i >= 4 || z == len)
+                {
+                    if (z > i)
+                        putOp(Op::Copy, z - i);
+                    i = z;
+                    continue;
+                }
+                // ADD 一直延伸到下一段 >= 4 的 0
+                uint32_t e = z, zeros = 0;
+                while (e < len && zeros < 4)
+                {
+                    zeros = newData[newStart + e] == oldData[oldStart + e] ? zeros + 1 : 0;
+                    e++;
+                }
+                if (zeros == 4)
+                    e -= 4;
+                putOp(Op::Add, e - i);
+                for (uint32_t k = i; k < e; k++)
+                    out->push_back((uint8_t)(newData[newStart + k] - oldData[oldStart + k]));
+                i = e;
+            }
+        }
+
+    public:
+        void diff(const uint8_t *oldImg, uint32_t oldLen, const uint8_t *newImg, uint32_t newLen, std::vector<uint8_t> &patch)
+        {
+            oldData = oldImg;
+            newData = newImg;
+            oldSize = oldLen;
+            newSize = newLen;
+            out = &patch;
+            patch.clear();
+
+            // 头部
+            const uint8_t magic[4] = {'W', 'D', 'P', '1'};
+            patch.insert(patch.end(), magic, magic + 4);
+            for (uint8_t k = 0; k < 4; k++)
+                patch.push_back((uint8_t)(newLen >> (8 * k)));
+            for (uint8_t k = 0; k < 4; k++)
+                patch.push_back((uint8_t)(oldLen >> (8 * k)));
+            uint8_t sha[Sha256::DIGEST_BYTES];
+            Sha256 s;
+            s.update(oldImg, oldLen);
+            s.finish(sha);
+            patch.insert(patch.end(), sha, sha + sizeof(sha));
+
+            // 旧镜像每个位置的 8 字节哈希 -> 位置 (后出现的覆盖先出现的)
+            uint32_t bits = 10;
+            while ((1u << bits) < oldLen * 2u && bits < 26)
+                bits++;
+            table.assign((size_t)1 << bits, -1);
+            mask = (1u << bits) - 1;
+            for (uint32_t i = 0; i + KEY <= oldLen; i++)
+                table[hashKey(oldImg + i) & mask] = (int32_t)i;
+
+            // bsdiff 主循环
+            uint32_t scan = 0, len = 0, pos = 0, lastscan = 0, lastpos = 0;
+            int64_t lastoffset = 0;
+            while (scan < newSize)
+            {
+                uint32_t oldscore = 0;
+                scan += len;
+                uint32_t scsc = scan;
+                for (; scan < newSize; scan++)
+                {
+                    search(scan, len, pos);
+                    for (; scsc < scan + len; scsc++)
+                    {
+                        int64_t o = scsc + lastoffset;
+                        if (o >= 0 && o < oldSize && oldData[o] == newData[scsc])
+                            oldscore++;
+                    }
+                    if ((len == oldscore && len != 0) || len > oldscore + 8)
+                        break;
+                    int64_t o = scan + lastoffset;
+                    if (o >= 0 && o < oldSize && oldData[o] == newData[scan])
+                        oldscore--;
+                }
+
+                if (len != oldscore || scan == newSize)
+                {
+                    // 上一段向前近似扩展
+                    int32_t s = 0, sf = 0;
+                    uint32_t lenf = 0;
+                    for (uint32_t i = 0; lastscan + i < scan && lastpos + i < oldSize;)
+                    {
+                        if (oldData[lastpos + i] == newData[lastscan + i])
+                            s++;
+                        i++;
+                        if (s * 2 - (int32_t)i > sf * 2 - (int32_t)lenf)
+                        {
+                            sf = s;
+                            lenf = i;
+                        }
+                    }
+                    // 这一段向后近似扩展
+                    uint32_t lenb = 0;
+                    if (scan < newSize)
+                    {
+                        int32_t sb = 0;
+                        s = 0;
+                        for (uint32_t i = 1; scan >= lastscan + i && pos >= i; i++)
+                        {
+                            if (oldData[pos - i] == newData[scan - i])
+                                s++;
+                            if (s * 2 - (int32_t)i > sb * 2 - (int32_t)lenb)
+                            {
+                                sb = s;
+                                lenb = i;
+                            }
+                        }
+                    }
+                    // 两段重叠：找最好的分界
+                    if (lastscan + lenf > scan - lenb)
+                    {
+                        uint32_t overlap = (lastscan + lenf) - (scan - lenb);
+                        int32_t ss = 0;
+                        uint32_t lens = 0;
+                        s = 0;
+                        for (uint32_t i = 0; i < overlap; i++)
+                        {
+                            if (newData[lastscan + lenf - overlap + i] == oldData[lastpos + lenf - overlap + i])
+                                s++;
+                            if (newData[scan - lenb + i] == oldData[pos - lenb + i])
+                                s--;
+                            if (s > ss)
+                            {
+                                ss = s;
+                                lens = i + 1;
+                            }
+                        }
+                        lenf += lens - overlap;
+                        lenb -= lens;
+                    }
+
+                    putDiff(lastscan, lastpos, lenf);
+                    uint32_t extra = (scan - lenb) - (lastscan + lenf);
+                    if (extra > 0)
+                    {
+                        putOp(Op::Insert, extra);
+                        patch.insert(patch.end(), newImg + lastscan + lenf, newImg + scan - lenb);
+                    }
+                    if (scan < newSize)
+                    {
+                        int64_t seek = (int64_t)(pos - lenb) - (int64_t)(lastpos + lenf);
+                        if (seek != 0)
+                            putOp(Op::Seek, (uint32_t)((seek << 1) ^ (seek >> 63)));
+                    }
+
+                    lastscan = scan - lenb;
+                    lastpos = pos - lenb;
+                    lastoffset = (int64_t)pos - scan;
+                }
+            }
+        }
+    };
+}
+
+#endif
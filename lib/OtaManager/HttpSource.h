@@ -0,0 +1,296 @@
+#ifndef HTTP_SOURCE_H
+#define HTTP_SOURCE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "PullOta.h"
+
+#ifdef ARDUINO
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// 连接 / 读超时：要比看门狗 (30s) 短得多，卡住的连接按失败处理后续传
+#ifndef OTA_HTTP_TIMEOUT_MS
+#define OTA_HTTP_TIMEOUT_MS 10000
+#endif
+
+// 最简 HTTP/1.1 GET 客户端，只用来拉固件 (BSD socket：ESP32 上是 lwIP，host 上是 POSIX)
+// - open(offset) 发 "Range: bytes=<offset>-"；服务器回 206 时核对 Content-Range，
+//   回 200 (不支持 Range) 时丢掉前 offset 个字节，续传照样正确，只是多下载一段
+// - 阻塞 socket + SO_RCVTIMEO：它只跑在 OTA 任务里，阻塞不影响别的任务
+// - 只支持 http://，不支持 chunked 编码 (静态文件服务器不会用)；完整性靠 SHA-256 保证
+class HttpSource : public Ota::Source
+{
+private:
+    char host[64];
+    char path[OTA_URL_MAX];
+    uint16_t port = 80;
+    int fd = -1;
+    uint32_t remaining = 0; // 本次响应还没读的 body 字节
+    uint8_t head[512];      // 响应头；头后面多读到的 body 先从这里给出
+    size_t headLen = 0;
+    size_t headPos = 0;
+
+    static bool startsWithNoCase(const char *s, const char *prefix)
+    {
+        for (; *prefix; s++, prefix++)
+        {
+            char c = *s;
+            if (c >= 'A' && c <= 'Z')
+                c = (char)(c + ('a' - 'A'));
+            if (c != *prefix)
+                return false;
+        }
+        return true;
+    }
+
+    // 在响应头里找某一行 (name 小写，带冒号)，返回值的起点
+    const char *headerValue(const char *name) const
+    {
+        const char *p = (const char *)head;
+        const char *end = p + headPos; // 只看头部，不看后面已经读到的 body
+        while ((p = strstr(p, "\r\n")) != nullptr && p + 2 < end)
+        {
+            p += 2;
+            if (startsWithNoCase(p, name))
+            {
+                p += strlen(name);
+                while (*p == ' ')
+                    p++;
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    bool connectTo()
+    {
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo *res = nullptr;
+        if (getaddrinfo(host, nullptr, &hints, &res) != 0 || !res)
+            return false;
+        struct sockaddr_in addr = *(struct sockaddr_in *)res->ai_addr;
+        freeaddrinfo(res);
+        addr.sin_port = htons(port);
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+
+        // 1. 非阻塞 connect + select：连不上的地址不会卡住几十秒
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            if (errno != EINPROGRESS)
+                return false;
+            fd_set wr;
+            FD_ZERO(&wr);
+            FD_SET(fd, &wr);
+            struct timeval tv = {OTA_HTTP_TIMEOUT_MS / 1000, (OTA_HTTP_TIMEOUT_MS % 1000) * 1000};
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (select(fd + 1, nullptr, &wr, nullptr, &tv) <= 0 ||
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0)
+                return false;
+        }
+
+        // 2. 之后用阻塞读写，超时交给 SO_RCVTIMEO / SO_SNDTIMEO
+        fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+        struct timeval tv = {OTA_HTTP_TIMEOUT_MS / 1000, (OTA_HTTP_TIMEOUT_MS % 1000) * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        return true;
+    }
+
+    bool sendAll(const char *data, size_t len)
+    {
+        while (len > 0)
+        {
+            ssize_t n = send(fd, data, len, 0);
+            if (n <= 0)
+                return false;
+            data += n;
+            len -= (size_t)n;
+        }
+        return true;
+    }
+
+    // 读到空行为止；返回 false 表示头太长或连接断了
+    bool readHead()
+    {
+        headLen = headPos = 0;
+        for (;;)
+        {
+            if (headLen >= sizeof(head) - 1)
+                return false;
+            ssize_t n = recv(fd, head + headLen, sizeof(head) - 1 - headLen, 0);
+            if (n <= 0)
+                return false;
+            headLen += (size_t)n;
+            head[headLen] = '\0';
+            const char *end = strstr((const char *)head, "\r\n\r\n");
+            if (end)
+            {
+                headPos = (size_t)(end + 4 - (const char *)head);
+                return true;
+            }
+        }
+    }
+
+    // body 的原始读取 (先给头缓冲区里剩下的)
+    int readBody(uint8_t *buf, size_t len)
+    {
+        if (remaining == 0)
+            return 0;
+        if (len > remaining)
+            len = remaining;
+        ssize_t n;
+        if (headPos < headLen)
+        {
+            n = (ssize_t)(headLen - headPos < len ? headLen - headPos : len);
+            memcpy(buf, head + headPos, (size_t)n);
+            headPos += (size_t)n;
+        }
+        else
+        {
+            n = recv(fd, buf, len, 0);
+            if (n <= 0)
+                return -1; // 超时或提前断开：调用方续传
+        }
+        remaining -= (uint32_t)n;
+        return (int)n;
+    }
+
+public:
+    ~HttpSource() { close(); }
+
+    // "http://host[:port]/path"
+    bool setUrl(const char *url)
+    {
+        if (strncmp(url, "http://", 7) != 0)
+            return false;
+        const char *h = url + 7;
+        const char *slash = strchr(h, '/');
+        const char *hostEnd = slash ? slash : h + strlen(h);
+        const char *colon = (const char *)memchr(h, ':', (size_t)(hostEnd - h));
+        size_t hostLen = (size_t)((colon ? colon : hostEnd) - h);
+        if (hostLen == 0 || hostLen >= sizeof(host))
+            return false;
+        memcpy(host, h, hostLen);
+        host[hostLen] = '\0';
+        port = 80;
+        if (colon)
+        {
+            long p = strtol(colon + 1, nullptr, 10);
+            if (p <= 0 || p > 65535)
+                return false;
+            port = (uint16_t)p;
+        }
+        const char *pth = slash ? slash : "/";
+        if (strlen(pth) >= sizeof(path))
+            return false;
+        strcpy(path, pth);
+        return true;
+    }
+
+    bool open(uint32_t offset, uint32_t &total) override
+    {
+        close();
+        if (!connectTo())
+        {
+            close();
+            return false;
+        }
+
+        // 1. 请求
+        char req[OTA_URL_MAX + 160];
+        int n = snprintf(req, sizeof(req),
+                         "GET %s HTTP/1.1\r\nHost: %s\r\nRange: bytes=%lu-\r\nConnection: close\r\nUser-Agent: esp32-watering\r\n\r\n",
+                         path, host, (unsigned long)offset);
+        if (n <= 0 || (size_t)n >= sizeof(req) || !sendAll(req, (size_t)n) || !readHead())
+        {
+            close();
+            return false;
+        }
+
+        // 2. 状态码：206 从 offset 开始；200 是整个文件
+        int status = 0;
+        if (sscanf((const char *)head, "HTTP/1.%*d %d", &status) != 1 || (status != 200 && status != 206) ||
+            headerValue("transfer-encoding:") != nullptr)
+        {
+            close();
+            return false;
+        }
+        const char *cl = headerValue("content-length:");
+        if (!cl)
+        {
+            close();
+            return false;
+        }
+        remaining = (uint32_t)strtoul(cl, nullptr, 10);
+
+        if (status == 206)
+        {
+            unsigned long first = 0, last = 0, size = 0;
+            const char *cr = headerValue("content-range:");
+            if (!cr || sscanf(cr, "bytes %lu-%lu/%lu", &first, &last, &size) != 3 || first != offset || last + 1 != size ||
+                remaining != size - first)
+            {
+                close();
+                return false;
+            }
+            total = (uint32_t)size;
+            return true;
+        }
+
+        // 3. 200：跳过已经有的部分
+        total = remaining;
+        uint8_t skip[256];
+        while (offset > 0)
+        {
+            int r = readBody(skip, offset < sizeof(skip) ? offset : sizeof(skip));
+            if (r <= 0)
+            {
+                close();
+                return false;
+            }
+            offset -= (uint32_t)r;
+        }
+        return true;
+    }
+
+    int read(uint8_t *buf, size_t len) override
+    {
+        if (fd < 0)
+            return -1;
+        return readBody(buf, len);
+    }
+
+    void close() override
+    {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+        remaining = 0;
+        headLen = headPos = 0;
+    }
+};
+
+#endif
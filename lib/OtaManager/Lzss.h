@@ -0,0 +1,269 @@
+#ifndef LZSS_H
+#define LZSS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// 固件镜像压缩格式 "WLZ1" (LZSS)：解压只需要一个 4KB 窗口，没有堆分配
+// 头部 8 字节：'W' 'L' 'Z' '1' + 原始长度 (u32 小端)
+// 之后是若干组：1 个标志字节 (低位先用)，每一位对应后面的一项
+//   1 = 字面量，1 字节
+//   0 = 回溯，2 字节：b0 = (距离-1) 低 8 位，b1 = (距离-1) 高 4 位 << 4 | (长度-3)
+//   距离 1..4096，长度 3..18
+// 主机上用 tools/ota_pack.py 压缩；下面的 Encoder 输出同样的格式 (测试用)
+namespace Lzss
+{
+    const uint16_t WINDOW = 4096;
+    const uint8_t MIN_MATCH = 3;
+    const uint8_t MAX_MATCH = 18;
+    const size_t HEADER_BYTES = 8;
+
+    enum class Status : uint8_t
+    {
+        More,      // 还要更多输入
+        Done,      // 原始长度全部输出完
+        BadFormat, // 魔数错、回溯越界、超出原始长度、尾部多余数据
+        SinkFailed // emit 返回了 false
+    };
+
+    // 流式解压：输入可以在任意字节处切开，状态留在对象里
+    // 输出每满 4KB (正好一个 Flash 扇区) 调用一次 emit(data, len)，最后不满的一块在结束时给出
+    class Decoder
+    {
+    private:
+        enum class St : uint8_t
+        {
+            Header,
+            Flags,
+            Item,
+            Match, // 已读回溯的第一个字节
+            Done,
+            Failed
+        };
+
+        uint8_t window[WINDOW];
+        uint8_t header[HEADER_BYTES];
+        uint8_t headerLen = 0;
+        St st = St::Header;
+        Status failure = Status::BadFormat;
+        uint8_t flags = 0;
+        uint8_t bitsLeft = 0;
+        uint8_t lowByte = 0;
+        uint16_t head = 0; // 窗口里下一个写入位置，写满一圈就 emit 整个窗口
+        uint32_t rawSize = 0;
+        uint32_t produced = 0;
+
+        Status fail(Status s)
+        {
+            st = St::Failed;
+            failure = s;
+            return s;
+        }
+
+        template <class Emit>
+        bool put(uint8_t c, Emit &emit)
+        {
+            window[head++] = c;
+            produced++;
+            if (head < WINDOW)
+                return true;
+            head = 0;
+            return emit((const uint8_t *)window, (size_t)WINDOW);
+        }
+
+        // 一项处理完：换下一个标志位；输出够了就把窗口里剩下的交出去
+        template <class Emit>
+        bool itemDone(Emit &emit)
+        {
+            flags >>= 1;
+            st = --bitsLeft ? St::Item : St::Flags;
+            if (produced < rawSize)
+                return true;
+            st = St::Done;
+            return head == 0 || emit((const uint8_t *)window, (size_t)head);
+        }
+
+    public:
+        void reset()
+        {
+            headerLen = 0;
+            st = St::Header;
+            head = 0;
+            rawSize = 0;
+            produced = 0;
+        }
+
+        template <class Emit>
+        Status feed(const uint8_t *data, size_t len, Emit &&emit)
+        {
+            for (size_t i = 0; i < len; i++)
+            {
+                uint8_t c = data[i];
+                switch (st)
+                {
+                case St::Header:
+                    header[headerLen++] = c;
+                    if (headerLen < HEADER_BYTES)
+                        break;
+                    if (memcmp(header, "WLZ1", 4) != 0)
+                        return fail(Status::BadFormat);
+                    rawSize = (uint32_t)header[4] | (uint32_t)header[5] << 8 | (uint32_t)header[6] << 16 | (uint32_t)header[7] << 24;
+                    if (rawSize == 0)
+                        return fail(Status::BadFormat);
+                    st = St::Flags;
+                    break;
+
+                case St::Flags:
+                    flags = c;
+                    bitsLeft = 8;
+                    st = St::Item;
+                    break;
+
+                case St::Item:
+                    if (flags & 1)
+                    {
+                        if (!put(c, emit) || !itemDone(emit))
+                            return fail(Status::SinkFailed);
+                    }
+                    else
+                    {
+                        lowByte = c;
+                        st = St::Match;
+                    }
+                    break;
+
+                case St::Match:
+                {
+                    uint32_t dist = ((uint32_t)(c >> 4) << 8 | lowByte) + 1;
+                    uint8_t n = (uint8_t)((c & 0x0F) + MIN_MATCH);
+                    if (dist > produced || produced + n > rawSize)
+                        return fail(Status::BadFormat);
+                    // 逐字节复制：距离小于长度时 (重复模式) 读到的是刚写进去的字节
+                    for (uint8_t k = 0; k < n; k++)
+                    {
+                        if (!put(window[(uint16_t)(head - dist) & (WINDOW - 1)], emit))
+                            return fail(Status::SinkFailed);
+                    }
+                    if (!itemDone(emit))
+                        return fail(Status::SinkFailed);
+                    break;
+                }
+
+                case St::Done:
+                    return fail(Status::BadFormat); // 输出已经够了还有数据
+
+                case St::Failed:
+                    return failure;
+                }
+            }
+            return st == St::Done ? Status::Done : (st == St::Failed ? failure : Status::More);
+        }
+
+        // 头部读完之前是 0
+        uint32_t size() const { return rawSize; }
+        uint32_t written() const { return produced; }
+        bool done() const { return st == St::Done; }
+    };
+
+    // 贪心 + 哈希链编码器 (主机测试用，固件里不需要)
+    class Encoder
+    {
+    private:
+        static const uint16_t HASH_SIZE = 1024;
+        int32_t headTab[HASH_SIZE];
+        int32_t prevTab[WINDOW];
+
+        static uint16_t hash(const uint8_t *p) { return (uint16_t)(((uint16_t)p[0] << 6 ^ (uint16_t)p[1] << 3 ^ p[2]) & (HASH_SIZE - 1)); }
+
+        void insert(const uint8_t *in, size_t n, size_t pos)
+        {
+            if (pos + MIN_MATCH > n)
+                return;
+            uint16_t h = hash(in + pos);
+            prevTab[pos & (WINDOW - 1)] = headTab[h];
+            headTab[h] = (int32_t)pos;
+        }
+
+    public:
+        // 返回写入 out 的字节数；out 不够大返回 0 (最坏 8 + n + n / 8 + 1)
+        size_t compress(const uint8_t *in, size_t n, uint8_t *out, size_t cap, uint16_t maxChain = 64)
+        {
+            if (cap < HEADER_BYTES || n == 0)
+                return 0;
+            memcpy(out, "WLZ1", 4);
+            for (uint8_t k = 0; k < 4; k++)
+                out[4 + k] = (uint8_t)(n >> (8 * k));
+            for (uint16_t k = 0; k < HASH_SIZE; k++)
+                headTab[k] = -1;
+
+            size_t o = HEADER_BYTES;
+            size_t flagPos = 0;
+            uint8_t bit = 8;
+            size_t i = 0;
+            while (i < n)
+            {
+                if (bit == 8)
+                {
+                    if (o >= cap)
+                        return 0;
+                    flagPos = o;
+                    out[o++] = 0;
+                    bit = 0;
+                }
+
+                // 1. 沿哈希链找窗口内最长的匹配
+                size_t bestLen = 0, bestPos = 0;
+                if (i + MIN_MATCH <= n)
+                {
+                    size_t limit = n - i < MAX_MATCH ? n - i : MAX_MATCH;
+                    int32_t cand = headTab[hash(in + i)];
+                    uint16_t chain = maxChain;
+                    while (cand >= 0 && i - (size_t)cand <= WINDOW && chain--)
+                    {
+                        size_t l = 0;
+                        while (l < limit && in[cand + l] == in[i + l])
+                            l++;
+                        if (l > bestLen)
+                        {
+                            bestLen = l;
+                            bestPos = (size_t)cand;
+                            if (l == limit)
+                                break;
+                        }
+                        int32_t next = prevTab[cand & (WINDOW - 1)];
+                        if (next >= cand)
+                            break;
+                        cand = next;
+                    }
+                }
+
+                // 2. 输出一项
+                if (bestLen >= MIN_MATCH)
+                {
+                    if (o + 2 > cap)
+                        return 0;
+                    size_t d = i - bestPos - 1;
+                    out[o++] = (uint8_t)(d & 0xFF);
+                    out[o++] = (uint8_t)((d >> 8) << 4 | (bestLen - MIN_MATCH));
+                    for (size_t k = 0; k < bestLen; k++)
+                        insert(in, n, i + k);
+                    i += bestLen;
+                }
+                else
+                {
+                    if (o >= cap)
+                        return 0;
+                    out[flagPos] |= (uint8_t)(1 << bit);
+                    out[o++] = in[i];
+                    insert(in, n, i);
+                    i++;
+                }
+                bit++;
+            }
+            return o;
+        }
+    };
+}
+
+#endif
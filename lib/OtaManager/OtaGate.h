@@ -0,0 +1,159 @@
+#ifndef OTA_GATE_H
+#define OTA_GATE_H
+
+#include <stdint.h>
+#include <atomic>
+
+// OTA 任务、控制任务、网络任务之间的握手 (纯逻辑，只用原子变量)
+// 1. OTA 任务收到升级请求：request()，然后等 granted()
+// 2. 控制任务看到 holdWanted()：通过水泵状态机正常停泵、暂停新的运行，全部停稳后 grant()
+// 3. OTA 任务写 Flash，progress() 报进度；结束时 finish(ok)。失败后 holdWanted() 变回 false，浇水恢复
+// 4. 网络任务用 poll() 取变化，发布到 MQTT
+// 阶段 / 进度 / 序号打包在一个 32 位原子量里，读到的永远是一致的快照
+class OtaGate
+{
+public:
+    enum class Phase : uint8_t
+    {
+        Idle,
+        Requested, // 等控制任务停泵
+        Granted,   // 水泵已停，可以写 Flash
+        Receiving,
+        Done,      // 写完校验通过，即将重启
+        Failed
+    };
+
+private:
+    // [31:16] 序号  [15:8] 阶段  [7:0] 百分比
+    std::atomic<uint32_t> word{0};
+
+    static uint32_t pack(uint16_t seq, Phase p, uint8_t pct) { return (uint32_t)seq << 16 | (uint32_t)p << 8 | pct; }
+    static Phase phaseOf(uint32_t w) { return (Phase)(w >> 8 & 0xFF); }
+
+    // 只有 from 阶段 (fromAny = true 时任意阶段) 才切换；返回是否切换了
+    bool transition(Phase to, uint8_t pct, bool fromAny, Phase from = Phase::Idle)
+    {
+        uint32_t cur = word.load();
+        for (;;)
+        {
+            if (!fromAny && phaseOf(cur) != from)
+                return false;
+            uint32_t next = pack((uint16_t)((cur >> 16) + 1), to, pct);
+            if (word.compare_exchange_weak(cur, next))
+                return true;
+        }
+    }
+
+public:
+    // [OTA 任务]
+    void request() { transition(Phase::Requested, 0, true); }
+    bool granted() const
+    {
+        Phase p = phase();
+        return p == Phase::Granted || p == Phase::Receiving;
+    }
+    void progress(uint8_t pct)
+    {
+        uint32_t cur = word.load();
+        Phase p = phaseOf(cur);
+        if ((p == Phase::Granted || p == Phase::Receiving) && (p != Phase::Receiving || (cur & 0xFF) != pct))
+            transition(Phase::Receiving, pct, true);
+    }
+    void finish(bool ok) { transition(ok ? Phase::Done : Phase::Failed, ok ? 100 : (uint8_t)(word.load() & 0xFF), true); }
+
+    // [控制任务] 升级进行中 (包括已写完、等待重启)：不许启动水泵
+    bool holdWanted() const
+    {
+        Phase p = phase();
+        return p != Phase::Idle && p != Phase::Failed;
+    }
+    void grant() { transition(Phase::Granted, 0, false, Phase::Requested); }
+
+    // [网络任务] 有变化时返回 true；seen 保存上次看到的序号
+    bool poll(uint16_t &seen, Phase &p, uint8_t &pct) const
+    {
+        uint32_t w = word.load();
+        if ((uint16_t)(w >> 16) == seen)
+            return false;
+        seen = (uint16_t)(w >> 16);
+        p = phaseOf(w);
+        pct = (uint8_t)(w & 0xFF);
+        return true;
+    }
+
+    Phase phase() const { return phaseOf(word.load()); }
+
+    static const char *phaseName(Phase p)
+    {
+        switch (p)
+        {
+        case Phase::Requested:
+            return "stopping pumps";
+        case Phase::Granted:
+            return "started";
+        case Phase::Receiving:
+            return "receiving";
+        case Phase::Done:
+            return "done, rebooting";
+        case Phase::Failed:
+            return "failed";
+        default:
+            return "idle";
+        }
+    }
+};
+
+// Flash 写入限速：每个数据块之后睡一会儿，把平均速率压在 maxBytesPerSec 以下
+// ESP32 擦写 Flash 时两个核的 cache 都会暂停 (一次扇区擦除几十毫秒)，
+// 连续写会把控制任务挤成一段段的长停顿；隔开写入让它在两次擦写之间按时运行
+class OtaThrottle
+{
+public:
+    struct Config
+    {
+        uint32_t maxBytesPerSec = 48 * 1024;
+        uint32_t minGapMs = 2;       // 每块之后至少让出这么久
+        uint8_t reportStepPct = 5;   // 进度每前进这么多才报告一次
+    };
+
+private:
+    Config cfg;
+    uint32_t startMs = 0;
+    uint8_t lastPct = 0;
+    bool reported = false;
+
+public:
+    OtaThrottle() {}
+    explicit OtaThrottle(const Config &c) : cfg(c) {}
+
+    void start(uint32_t nowMs)
+    {
+        startMs = nowMs;
+        lastPct = 0;
+        reported = false;
+    }
+
+    // 已写入 written 字节 (累计)；返回这之后应该睡多久
+    uint32_t onChunk(uint32_t nowMs, uint32_t written) const
+    {
+        uint32_t due = cfg.maxBytesPerSec ? (uint32_t)((uint64_t)written * 1000 / cfg.maxBytesPerSec) : 0;
+        uint32_t elapsed = nowMs - startMs;
+        uint32_t wait = due > elapsed ? due - elapsed : 0;
+        return wait > cfg.minGapMs ? wait : cfg.minGapMs;
+    }
+
+    // 进度到了下一个台阶返回 true (第一次和 100% 一定报)
+    bool stepReached(uint32_t written, uint32_t total, uint8_t &pct)
+    {
+        pct = total ? (uint8_t)((uint64_t)written * 100 / total) : 0;
+        if (reported && pct < 100 && pct < lastPct + cfg.reportStepPct)
+            return false;
+        if (reported && pct == lastPct)
+            return false;
+        reported = true;
+        lastPct = pct;
+        return true;
+    }
+};
+
+#endif
@@ -3,20 +3,246 @@
 
 #include <Arduino.h>
 #include <ArduinoOTA.h>
+#include <esp_task_wdt.h>
+#include <esp_ota_ops.h>
+#include <atomic>
+#include <functional>
+#include "OtaGate.h"
+#include "PullOta.h"
+#include "HttpSource.h"
+#include "MemoryPool.h"
+#include "Trace.h"
 
+// 空闲时多久检查一次升级请求 (ArduinoOTA 靠轮询 UDP 端口发现上传)
+#ifndef OTA_POLL_MS
+#define OTA_POLL_MS 250
+#endif
+
+// Flash 写入限速 (字节/秒)
+#ifndef OTA_MAX_BYTES_PER_SEC
+#define OTA_MAX_BYTES_PER_SEC (48 * 1024)
+#endif
+// 等控制任务停泵的最长时间
+#ifndef OTA_HOLD_TIMEOUT_MS
+#define OTA_HOLD_TIMEOUT_MS 5000
+#endif
+// 写完之后留给网络任务发布 "done" 的时间，然后重启
+#ifndef OTA_REBOOT_DELAY_MS
+#define OTA_REBOOT_DELAY_MS 2000
+#endif
+
+// 拉取升级写入的目标：下一个 OTA 分区 (esp_ota_*)
+// OTA_WITH_SEQUENTIAL_WRITES 写到哪擦到哪，擦除和写入一样被 OtaThrottle 隔开；esp_ota_end 再校验一遍镜像格式
+class FlashOtaSink : public Ota::Sink
+{
+private:
+    const esp_partition_t *part = nullptr;
+    esp_ota_handle_t handle = 0;
+    bool opened = false;
+    std::function<bool()> beforeWrite;
+
+public:
+    // ready：第一次写 Flash 之前调用 (停泵握手)，返回 false 就不写
+    explicit FlashOtaSink(std::function<bool()> ready) : beforeWrite(ready) {}
+
+    uint32_t capacity() const override
+    {
+        const esp_partition_t *p = esp_ota_get_next_update_partition(nullptr);
+        return p ? p->size : 0;
+    }
+
+    bool begin(uint32_t size) override
+    {
+        (void)size; // 顺序写模式不需要预先擦除整个镜像大小
+        part = esp_ota_get_next_update_partition(nullptr);
+        if (!part || (beforeWrite && !beforeWrite()))
+            return false;
+        opened = esp_ota_begin(part, OTA_WITH_SEQUENTIAL_WRITES, &handle) == ESP_OK;
+        return opened;
+    }
+
+    bool write(const uint8_t *data, size_t len) override
+    {
+        return opened && esp_ota_write(handle, data, len) == ESP_OK;
+    }
+
+    bool commit() override
+    {
+        if (!opened)
+            return false;
+        opened = false;
+        return esp_ota_end(handle) == ESP_OK && esp_ota_set_boot_partition(part) == ESP_OK;
+    }
+
+    void abort() override
+    {
+        if (opened)
+            esp_ota_abort(handle);
+        opened = false;
+    }
+};
+
+// 差分补丁的基线：正在运行的 app 分区 (只读；新镜像写在另一个分区，两者互不覆盖)
+class RunningImage : public Delta::OldImage
+{
+private:
+    const esp_partition_t *part = nullptr;
+
+    const esp_partition_t *partition()
+    {
+        if (!part)
+            part = esp_ota_get_running_partition();
+        return part;
+    }
+
+public:
+    uint32_t size() const override
+    {
+        const esp_partition_t *p = part ? part : esp_ota_get_running_partition();
+        return p ? p->size : 0;
+    }
+
+    bool read(uint32_t offset, uint8_t *buf, size_t len) override
+    {
+        const esp_partition_t *p = partition();
+        return p && esp_partition_read(p, offset, buf, len) == ESP_OK;
+    }
+};
+
+// ArduinoOTA 封装，在自己的低优先级任务里运行 (handle() 由 OTA 任务调用)
+// - 一次上传在 handle() 里从头跑到尾：只阻塞 OTA 任务，网络任务和控制任务照常运行
+// - 开始前通过 OtaGate 请控制任务停泵，等它确认；不再直接拉引脚
+// - 每个数据块之后按 OtaThrottle 睡一会儿，Flash 擦写不会连成长时间的停顿
+// - 进度写进 OtaGate，由网络任务发布到 MQTT；成功后延迟重启，让 "done" 先发出去
+// - 也可以由 MQTT 指令触发，自己从 HTTP 服务器拉取压缩镜像 (PullOta.h)：下载期间水泵照常，
+//   第一次写 Flash 之前才停泵；断线续传、SHA-256 校验，失败不影响当前固件
+//   镜像也可以是针对当前固件的差分补丁 (DeltaPatch.h)，只下载变化的部分
 class OtaManager
 {
 private:
     const char *hostname;
     const char *password;
+    OtaGate &gate;
+    std::function<void()> onChange = nullptr;
+    OtaThrottle throttle;
+    std::atomic<bool> started{false};
+    uint32_t doneAtMs = 0;
+
+    // 拉取升级：网络任务填好 pullJob 后置 pullPending，OTA 任务执行完清零
+    Ota::Request pullJob;
+    std::atomic<bool> pullPending{false};
+    std::atomic<uint8_t> pullResult{(uint8_t)Ota::Result::Ok};
+    Ota::PullUpdater *puller = nullptr; // 解压窗口 + 补丁缓冲约 10KB，只在升级时用：放在 PSRAM 分区 (reserve())
+    HttpSource *http = nullptr;
+    RunningImage running;
+    FlashOtaSink flash{[this]()
+                       {
+                           negotiateHold();
+                           return gate.granted();
+                       }};
+
+    void notify()
+    {
+        if (onChange)
+            onChange();
+    }
+
+    // [OTA 任务] 请控制任务停泵，最多等 OTA_HOLD_TIMEOUT_MS
+    void negotiateHold()
+    {
+        gate.request();
+        notify();
+        uint32_t start = millis();
+        while (!gate.granted() && millis() - start < OTA_HOLD_TIMEOUT_MS)
+        {
+            esp_task_wdt_reset();
+            delay(10);
+        }
+        if (gate.granted())
+            TRACE_I("[OTA] Pumps stopped after %u ms", (uint32_t)(millis() - start));
+        else
+            TRACE_E("[OTA] Control task did not confirm pump stop in %u ms", (uint32_t)OTA_HOLD_TIMEOUT_MS);
+    }
+
+    // [OTA 任务] 限速 + 进度 + 喂狗，和 ArduinoOTA 的 onProgress 一样
+    void onFlashed(uint32_t written, uint32_t total)
+    {
+        uint8_t pct;
+        if (throttle.stepReached(written, total, pct))
+        {
+            TRACE_I("[OTA] Progress: %u%%", pct);
+            gate.progress(pct);
+            notify();
+        }
+        esp_task_wdt_reset();
+        delay(throttle.onChunk(millis(), written));
+    }
+
+    // [OTA 任务] 执行一次拉取升级
+    void runPull()
+    {
+        TRACE_I("[OTA] Pull start");
+        throttle.start(millis());
+        Ota::Result r = Ota::Result::SourceFailed;
+        if (http->setUrl(pullJob.url))
+        {
+            Ota::Hooks hooks;
+            hooks.block = [this](uint32_t written, uint32_t total)
+            { onFlashed(written, total); };
+            hooks.sleep = [](uint32_t ms)
+            {
+                // 退避等待可能长于看门狗的一半，分段喂狗
+                while (ms > 0)
+                {
+                    uint32_t step = ms < 1000 ? ms : 1000;
+                    esp_task_wdt_reset();
+                    delay(step);
+                    ms -= step;
+                }
+            };
+            r = puller->run(*http, flash, pullJob.sha256, hooks);
+        }
+
+        const Ota::Stats &st = puller->stats();
+        TRACE_I("[OTA] Pull result %u: %u compressed bytes -> %u bytes, %u connects", (uint32_t)r, st.compressedBytes, st.rawBytes, (uint32_t)st.connects);
+        if (st.delta)
+            TRACE_I("[OTA] Image was a delta patch against the running firmware");
+        pullResult = (uint8_t)r;
+        gate.finish(r == Ota::Result::Ok);
+        if (r == Ota::Result::Ok)
+            doneAtMs = millis();
+        notify();
+    }
 
 public:
-    // 构造函数：需要主机名和密码
-    OtaManager(const char *_hostname, const char *_password = nullptr)
-        : hostname(_hostname), password(_password) {}
+    // 构造函数：需要主机名、密码和与控制 / 网络任务共享的 gate
+    OtaManager(const char *_hostname, const char *_password, OtaGate &_gate)
+        : hostname(_hostname), password(_password), gate(_gate)
+    {
+        OtaThrottle::Config c;
+        c.maxBytesPerSec = OTA_MAX_BYTES_PER_SEC;
+        throttle = OtaThrottle(c);
+    }
 
-    void begin()
+    // [setup] 从 arena 切出拉取升级用的缓冲区；切不出来时拉取升级不可用 (推送升级不受影响)
+    bool reserve(MemArena &arena)
     {
+        puller = arena.make<Ota::PullUpdater>();
+        http = arena.make<HttpSource>();
+        if (!puller || !http)
+        {
+            puller = nullptr;
+            return false;
+        }
+        puller->setBase(&running);
+        return true;
+    }
+
+    // [网络任务] 联网后调用一次；changed：gate 状态变化时调用 (叫醒控制 / 网络任务)
+    void begin(std::function<void()> changed = nullptr)
+    {
+        onChange = changed;
+
         // 1. 设置主机名 (方便在路由器或IDE里识别)
         ArduinoOTA.setHostname(hostname);
 
@@ -26,45 +252,78 @@ public:
             ArduinoOTA.setPassword(password);
         }
 
-        // 3. 定义回调函数 (用于串口调试)
+        // 3. 重启由 OTA 任务在进度发布之后执行
+        ArduinoOTA.setRebootOnSuccess(false);
+
+        // 4. 定义回调函数 (都在 OTA 任务里执行)
         ArduinoOTA
-            .onStart([]()
+            .onStart([this]()
                      {
-                         String type;
-                         if (ArduinoOTA.getCommand() == U_FLASH)
-                             type = "sketch";
-                         else
-                             type = "filesystem";
-                         Serial.println("[OTA] Start updating " + type);
-
-                         // 在这里可以加代码关闭所有继电器
-                         // 但由于这是静态回调，很难访问 waterSys 对象
-                         // 简单粗暴的方法：直接操作寄存器或引脚
-                         digitalWrite(SYSTEM_WATERING_PIN, HIGH); // 强制关闭水泵 (假设4是水泵引脚)
-                     })
-            .onEnd([]()
-                   { Serial.println("\n[OTA] End"); })
-            .onProgress([](unsigned int progress, unsigned int total)
-                        { Serial.printf("[OTA] Progress: %u%%\r", (progress / (total / 100))); })
-            .onError([](ota_error_t error)
+                TRACE_I("[OTA] Start updating (%u: 0 = firmware, else filesystem)", (uint32_t)ArduinoOTA.getCommand());
+                pullResult = (uint8_t)Ota::Result::Ok;
+                negotiateHold();
+                throttle.start(millis()); })
+            .onEnd([this]()
+                   {
+                TRACE_I("[OTA] End");
+                gate.finish(true);
+                doneAtMs = millis();
+                notify(); })
+            .onProgress([this](unsigned int progress, unsigned int total)
+                        {
+                uint8_t pct;
+                if (throttle.stepReached(progress, total, pct))
+                {
+                    TRACE_I("[OTA] Progress: %u%%", pct);
+                    gate.progress(pct);
+                    notify();
+                }
+                // 让出 CPU 和 Flash：控制任务在两次擦写之间运行
+                esp_task_wdt_reset();
+                delay(throttle.onChunk(millis(), progress)); })
+            .onError([this](ota_error_t error)
                      {
-                Serial.printf("Error[%u]: ", error);
-                if (error == OTA_AUTH_ERROR) Serial.println("Auth Failed");
-                else if (error == OTA_BEGIN_ERROR) Serial.println("Begin Failed");
-                else if (error == OTA_CONNECT_ERROR) Serial.println("Connect Failed");
-                else if (error == OTA_RECEIVE_ERROR) Serial.println("Receive Failed");
-                else if (error == OTA_END_ERROR) Serial.println("End Failed"); });
-
-        // 4. 启动服务
+                TRACE_E("[OTA] Error %u (auth 0, begin 1, connect 2, receive 3, end 4)", (uint32_t)error);
+                gate.finish(false);
+                notify(); });
+
+        // 5. 启动服务
         ArduinoOTA.begin();
+        started = true;
         Serial.printf("[OTA] Service Ready. Hostname: %s\n", hostname);
     }
 
-    // 必须在 loop() 里频繁调用
-    void handle()
+    // [网络任务] 收到 "ota <url> <sha256>"；已经有升级在进行 (或没有 reserve() 缓冲区) 时返回 false
+    bool requestPull(const Ota::Request &req)
+    {
+        if (!puller || pullPending.load() || gate.holdWanted())
+            return false;
+        pullJob = req;
+        pullPending.store(true); // 之后 pullJob 归 OTA 任务
+        return true;
+    }
+
+    // [网络任务] 最近一次拉取升级失败的原因 (推送升级或成功时是 Ok)
+    Ota::Result lastPullResult() const { return (Ota::Result)pullResult.load(); }
+
+    // [OTA 任务] 返回距离下一次需要调用的毫秒数
+    uint32_t handle()
     {
-        ArduinoOTA.handle();
+        if (pullPending.load())
+        {
+            runPull();
+            pullPending.store(false);
+        }
+        if (started.load())
+            ArduinoOTA.handle();
+        if (gate.phase() == OtaGate::Phase::Done)
+        {
+            if (millis() - doneAtMs >= OTA_REBOOT_DELAY_MS)
+                ESP.restart();
+            return 100;
+        }
+        return OTA_POLL_MS;
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,309 @@
+#ifndef PULL_OTA_H
+#define PULL_OTA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <functional>
+#include "Lzss.h"
+#include "Sha256.h"
+#include "DeltaPatch.h"
+
+// URL 最长长度 (含结尾 0)
+#ifndef OTA_URL_MAX
+#define OTA_URL_MAX 160
+#endif
+// 每次从连接里读的字节数
+#ifndef OTA_PULL_CHUNK
+#define OTA_PULL_CHUNK 1024
+#endif
+
+// 设备主动拉取固件 (MQTT 指令 "ota <url> <sha256>" 触发，不再需要同一局域网里的电脑推送)
+// 1. Source 从某个偏移开始读压缩镜像 (HTTP 用 Range 头)；断线后从已经消费的字节处续传，不从零开始
+// 2. 边下载边解压 (Lzss)，每满 4KB 顺序写一次 Sink (ESP32 上是非活动 OTA 分区)，同时对原始镜像算 SHA-256
+// 3. 全部写完且哈希一致才 commit (切换启动分区)；不一致就 abort，正在运行的固件不受影响
+// 解压出来的是差分补丁 ("WDP1"，DeltaPatch.h) 时，再和正在运行的镜像合成新镜像；指令格式不变，哈希仍是新镜像的
+// 解压器和哈希的中间状态都在内存里：续传只在本次启动内有效，重启后从头下载
+namespace Ota
+{
+    // 压缩镜像的来源
+    class Source
+    {
+    public:
+        virtual ~Source() {}
+        // 从 offset 处开始读；total 返回整个文件的长度
+        virtual bool open(uint32_t offset, uint32_t &total) = 0;
+        // >0：读到的字节数；0：这次连接的数据读完了；<0：出错 (超时 / 断线)
+        virtual int read(uint8_t *buf, size_t len) = 0;
+        virtual void close() = 0;
+    };
+
+    // 解压后镜像的去处 (只会顺序写)
+    class Sink
+    {
+    public:
+        virtual ~Sink() {}
+        virtual uint32_t capacity() const = 0;
+        virtual bool begin(uint32_t size) = 0;
+        virtual bool write(const uint8_t *data, size_t len) = 0;
+        virtual bool commit() = 0; // 校验通过：设为下次启动的镜像
+        virtual void abort() = 0;
+    };
+
+    enum class Result : uint8_t
+    {
+        Ok,
+        SourceFailed, // 连续多次连不上 / 没有进展
+        BadFormat,    // 不是 WLZ1、数据损坏或被截断
+        TooLarge,     // 超过 OTA 分区大小
+        WriteFailed,
+        HashMismatch,
+        BaseMismatch, // 差分补丁的基线不是设备上正在运行的固件
+        ReadFailed    // 读正在运行的镜像出错
+    };
+
+    inline const char *resultName(Result r)
+    {
+        switch (r)
+        {
+        case Result::Ok:
+            return "ok";
+        case Result::SourceFailed:
+            return "download failed";
+        case Result::BadFormat:
+            return "bad image";
+        case Result::TooLarge:
+            return "image too large";
+        case Result::WriteFailed:
+            return "flash write failed";
+        case Result::HashMismatch:
+            return "sha256 mismatch";
+        case Result::BaseMismatch:
+            return "delta base mismatch";
+        case Result::ReadFailed:
+            return "flash read failed";
+        }
+        return "?";
+    }
+
+    struct Config
+    {
+        uint8_t maxAttempts = 8;      // 连续这么多次连接都没有新数据就放弃 (有进展就重新计数)
+        uint32_t retryBaseMs = 1000;  // 重试等待：base * 2^n，封顶 cap
+        uint32_t retryCapMs = 20000;
+    };
+
+    struct Hooks
+    {
+        std::function<void(uint32_t written, uint32_t total)> block; // 每写一块之后 (限速、进度、喂狗)
+        std::function<void(uint32_t ms)> sleep;                       // 重试前的等待
+    };
+
+    struct Stats
+    {
+        uint32_t compressedBytes = 0; // 实际消费的压缩字节 (不含重复下载)
+        uint32_t rawBytes = 0;
+        uint16_t connects = 0;
+        uint16_t resumes = 0; // 从非零偏移重新打开的次数
+        bool delta = false;   // 下载的是差分补丁
+    };
+
+    // "ota <url> <sha256 十六进制>"
+    struct Request
+    {
+        char url[OTA_URL_MAX];
+        uint8_t sha256[Sha256::DIGEST_BYTES];
+    };
+
+    enum class ParseResult : uint8_t
+    {
+        NotOta, // 不是 ota 指令，交给 CommandParser
+        Ok,
+        BadArgument
+    };
+
+    // 直接在 payload 上解析，不分配内存
+    inline ParseResult parseRequest(const uint8_t *payload, size_t len, Request &out)
+    {
+        const uint8_t *p = payload, *end = payload + len;
+        const uint8_t *tok[4];
+        size_t tokLen[4];
+        uint8_t n = 0;
+        while (n < 4)
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+                p++;
+            if (p >= end)
+                break;
+            tok[n] = p;
+            while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+                p++;
+            tokLen[n] = (size_t)(p - tok[n]);
+            n++;
+        }
+        if (n == 0 || tokLen[0] != 3 || (tok[0][0] | 0x20) != 'o' || (tok[0][1] | 0x20) != 't' || (tok[0][2] | 0x20) != 'a')
+            return ParseResult::NotOta;
+        if (n != 3 || tokLen[1] >= OTA_URL_MAX || tokLen[1] < 8 || memcmp(tok[1], "http://", 7) != 0)
+            return ParseResult::BadArgument;
+        if (!Sha256::parseHex((const char *)tok[2], tokLen[2], out.sha256))
+            return ParseResult::BadArgument;
+        memcpy(out.url, tok[1], tokLen[1]);
+        out.url[tokLen[1]] = '\0';
+        return ParseResult::Ok;
+    }
+
+    // 下载 -> 解压 -> 哈希 -> 写入，断线从已消费的位置续传
+    // 对象里有 4KB 解压窗口和 4KB 补丁输出块，放在全局 / 静态存储里，不要放在任务栈上
+    class PullUpdater
+    {
+    private:
+        Config cfg;
+        Lzss::Decoder dec;
+        Delta::Applier patch;
+        Delta::OldImage *base = nullptr;
+        Sha256 sha;
+        uint8_t buf[OTA_PULL_CHUNK];
+        Stats st;
+
+        Result finish(Sink &sink, bool begun, Result r)
+        {
+            if (r != Result::Ok && begun)
+                sink.abort();
+            st.rawBytes = st.delta ? patch.written() : dec.written();
+            return r;
+        }
+
+    public:
+        PullUpdater() {}
+        explicit PullUpdater(const Config &c) : cfg(c) {}
+
+        // 差分补丁的基线 (正在运行的镜像)；不设置时只接受完整镜像
+        void setBase(Delta::OldImage *image) { base = image; }
+
+        Result run(Source &src, Sink &sink, const uint8_t expected[Sha256::DIGEST_BYTES], const Hooks &hooks = Hooks())
+        {
+            dec.reset();
+            sha.begin();
+            st = Stats();
+            uint32_t total = 0;
+            uint8_t failures = 0;
+            bool begun = false;
+            bool modeKnown = false;
+            Result stageError = Result::WriteFailed; // emit 返回 false 的原因
+
+            // 新镜像：第一块到来时长度已知，这时才打开 Sink
+            auto write = [&](const uint8_t *data, size_t len) -> bool
+            {
+                uint32_t size = st.delta ? patch.size() : dec.size();
+                if (!begun)
+                {
+                    if (size > sink.capacity())
+                    {
+                        stageError = Result::TooLarge;
+                        return false;
+                    }
+                    if (!sink.begin(size))
+                        return false;
+                    begun = true;
+                }
+                sha.update(data, len);
+                if (!sink.write(data, len))
+                    return false;
+                if (hooks.block)
+                    hooks.block(st.delta ? patch.written() : dec.written(), size);
+                return true;
+            };
+
+            // 解压输出：以 "WDP1" 开头就是补丁，经过 Applier 合成新镜像；否则就是镜像本身
+            auto emit = [&](const uint8_t *data, size_t len) -> bool
+            {
+                if (!modeKnown)
+                {
+                    modeKnown = true;
+                    st.delta = len >= 4 && memcmp(data, "WDP1", 4) == 0;
+                    patch.reset(base);
+                }
+                if (!st.delta)
+                    return write(data, len);
+                switch (patch.feed(data, len, write))
+                {
+                case Delta::Status::More:
+                case Delta::Status::Done:
+                    return true;
+                case Delta::Status::BaseMismatch:
+                    stageError = Result::BaseMismatch;
+                    return false;
+                case Delta::Status::ReadFailed:
+                    stageError = Result::ReadFailed;
+                    return false;
+                case Delta::Status::BadFormat:
+                    stageError = Result::BadFormat;
+                    return false;
+                default:
+                    return false; // SinkFailed：write 已经记下原因
+                }
+            };
+
+            for (;;)
+            {
+                uint32_t before = st.compressedBytes;
+                uint32_t t = 0;
+                if (src.open(st.compressedBytes, t))
+                {
+                    st.connects++;
+                    if (st.compressedBytes > 0)
+                        st.resumes++;
+                    // 1. 两次连接之间服务器上的文件变了：已写入的内容作废
+                    if (total != 0 && t != total)
+                    {
+                        src.close();
+                        return finish(sink, begun, Result::BadFormat);
+                    }
+                    total = t;
+
+                    // 2. 读到连接结束、出错或解压器给出结果
+                    Lzss::Status ds = Lzss::Status::More;
+                    while (ds == Lzss::Status::More)
+                    {
+                        int n = src.read(buf, sizeof(buf));
+                        if (n <= 0)
+                            break;
+                        ds = dec.feed(buf, (size_t)n, emit);
+                        st.compressedBytes += (uint32_t)n;
+                    }
+                    src.close();
+
+                    // 3. 解压完成：校验哈希后提交
+                    if (ds == Lzss::Status::Done && st.delta && !patch.done())
+                        return finish(sink, begun, Result::BadFormat); // 补丁没写完整
+                    if (ds == Lzss::Status::Done)
+                    {
+                        uint8_t got[Sha256::DIGEST_BYTES];
+                        sha.finish(got);
+                        if (memcmp(got, expected, sizeof(got)) != 0)
+                            return finish(sink, begun, Result::HashMismatch);
+                        if (!sink.commit())
+                            return finish(sink, begun, Result::WriteFailed);
+                        return finish(sink, begun, Result::Ok);
+                    }
+                    if (ds == Lzss::Status::SinkFailed)
+                        return finish(sink, begun, stageError);
+                    if (ds == Lzss::Status::BadFormat || st.compressedBytes >= total)
+                        return finish(sink, begun, Result::BadFormat); // 文件读完了还没解压完：被截断
+                }
+
+                // 4. 有进展就重新计数，否则退避后重试
+                failures = st.compressedBytes > before ? 1 : failures + 1;
+                if (failures >= cfg.maxAttempts)
+                    return finish(sink, begun, Result::SourceFailed);
+                uint32_t wait = cfg.retryBaseMs << (failures - 1 < 16 ? failures - 1 : 16);
+                if (hooks.sleep)
+                    hooks.sleep(wait < cfg.retryCapMs ? wait : cfg.retryCapMs);
+            }
+        }
+
+        const Stats &stats() const { return st; }
+    };
+}
+
+#endif
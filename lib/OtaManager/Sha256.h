@@ -0,0 +1,154 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// SHA-256 (FIPS 180-4)，纯软件实现，host 和 ESP32 上是同一份代码
+// 用来校验拉取到的固件：每 4KB 解压输出 update 一次，速度远高于 Flash 写入，不是瓶颈
+class Sha256
+{
+public:
+    static const size_t DIGEST_BYTES = 32;
+
+private:
+    uint32_t h[8];
+    uint8_t block[64];
+    uint8_t blockLen = 0;
+    uint64_t totalBytes = 0;
+
+    static uint32_t rotr(uint32_t x, uint8_t n) { return (x >> n) | (x << (32 - n)); }
+
+    void compress(const uint8_t *p)
+    {
+        static const uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+        uint32_t w[64];
+        for (uint8_t i = 0; i < 16; i++)
+            w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 | (uint32_t)p[i * 4 + 2] << 8 | p[i * 4 + 3];
+        for (uint8_t i = 16; i < 64; i++)
+        {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+        for (uint8_t i = 0; i < 64; i++)
+        {
+            uint32_t t1 = k + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            k = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+        h[5] += f;
+        h[6] += g;
+        h[7] += k;
+    }
+
+public:
+    Sha256() { begin(); }
+
+    void begin()
+    {
+        static const uint32_t H0[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+        memcpy(h, H0, sizeof(h));
+        blockLen = 0;
+        totalBytes = 0;
+    }
+
+    void update(const uint8_t *data, size_t len)
+    {
+        totalBytes += len;
+        while (len > 0)
+        {
+            // 整块直接压缩，不经过缓冲区
+            if (blockLen == 0 && len >= 64)
+            {
+                compress(data);
+                data += 64;
+                len -= 64;
+                continue;
+            }
+            size_t room = (size_t)(64 - blockLen);
+            size_t n = room < len ? room : len;
+            memcpy(block + blockLen, data, n);
+            blockLen += (uint8_t)n;
+            data += n;
+            len -= n;
+            if (blockLen == 64)
+            {
+                compress(block);
+                blockLen = 0;
+            }
+        }
+    }
+
+    void finish(uint8_t out[DIGEST_BYTES])
+    {
+        uint64_t bits = totalBytes * 8;
+        uint8_t pad = 0x80;
+        update(&pad, 1);
+        pad = 0;
+        while (blockLen != 56)
+            update(&pad, 1);
+        uint8_t len[8];
+        for (uint8_t i = 0; i < 8; i++)
+            len[i] = (uint8_t)(bits >> (56 - 8 * i));
+        update(len, 8);
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            out[i * 4] = (uint8_t)(h[i] >> 24);
+            out[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+            out[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+            out[i * 4 + 3] = (uint8_t)h[i];
+        }
+    }
+
+    // 64 个十六进制字符 -> 32 字节 (大小写都行)
+    static bool parseHex(const char *hex, size_t len, uint8_t out[DIGEST_BYTES])
+    {
+        if (len != DIGEST_BYTES * 2)
+            return false;
+        for (size_t i = 0; i < len; i++)
+        {
+            char c = hex[i];
+            uint8_t v;
+            if (c >= '0' && c <= '9')
+                v = (uint8_t)(c - '0');
+            else if (c >= 'a' && c <= 'f')
+                v = (uint8_t)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F')
+                v = (uint8_t)(c - 'A' + 10);
+            else
+                return false;
+            if (i % 2 == 0)
+                out[i / 2] = (uint8_t)(v << 4);
+            else
+                out[i / 2] |= v;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,409 @@
+#ifndef POWER_LEASE_H
+#define POWER_LEASE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <atomic>
+#include <functional>
+#include "../Trace/Trace.h"
+
+// 机队共用一条供电回路时的水泵名额 (租约)
+// 每台设备在 <POWER_LEASE_TOPIC>/<设备 id> 上发布一条保留消息 (retained)，订阅 <POWER_LEASE_TOPIC>/+ 看到所有人：
+//   "<申请时刻> <到期时刻> W"  排队中      "<申请时刻> <到期时刻> R"  水泵在转      空消息  释放
+// 所有设备看到的是同一组消息，按同一个规则排序，所以不需要协调者：
+// 1. 没到期的 R 全部算在前面；W 按 (申请时刻, 设备 id) 排队
+// 2. 自己的申请从 broker 回显、再等 settleSec (期间晚到的更早申请都能看到)，
+//    排在前面的 (R + 更早的 W) 少于 slots 个才开泵，并把消息改成 R
+// 3. 租约每 leaseSec / 3 续一次；掉线的设备不再续约，别人到期后把它当作不存在
+//    自己这边：最近一次回显的到期时刻前 settleSec 还没续上，就主动交还名额 (停泵)
+// 4. 断线期间的申请不算数：重连后按新的申请时刻重新排队，不会插到已经开泵的设备前面
+// 时间是各设备 NTP 对时后的本地 epoch 秒；要求 broker 转发延迟和设备间的时钟差都小于 settleSec
+
+#ifndef POWER_LEASE_TOPIC
+#define POWER_LEASE_TOPIC "watering/power"
+#endif
+
+// 租约有效期 (秒)：设备掉线后最多这么久别人才能接手它的名额
+#ifndef POWER_LEASE_SEC
+#define POWER_LEASE_SEC 90
+#endif
+
+// 申请回显后等多久才按队列决定 (秒)
+#ifndef POWER_LEASE_SETTLE_SEC
+#define POWER_LEASE_SETTLE_SEC 3
+#endif
+
+// 连不上 broker 时等多久就自己开泵 (秒，另加按设备 id 错开的 0 ~ 5 分钟)；0 = 永远等
+#ifndef POWER_LEASE_OFFLINE_SEC
+#define POWER_LEASE_OFFLINE_SEC 900
+#endif
+
+// 最多记住多少台别的设备
+#ifndef POWER_LEASE_MAX_PEERS
+#define POWER_LEASE_MAX_PEERS 32
+#endif
+
+#define POWER_LEASE_ID_LEN 16
+
+// 控制任务和网络任务之间的握手 (只用原子变量)
+// 控制任务：want(有区域在排队或在运行)，granted() 为 true 才开泵；网络任务：wanted() 决定是否申请，grant() 给出结果
+class PowerGate
+{
+private:
+    std::atomic<bool> wantFlag{false};
+    std::atomic<bool> grantFlag{false};
+
+public:
+    // [控制任务] 返回是否有变化 (有变化时叫醒网络任务)
+    bool want(bool on) { return wantFlag.exchange(on) != on; }
+    bool granted() const { return grantFlag.load(); }
+
+    // [网络任务] 返回是否有变化 (有变化时叫醒控制任务)
+    bool wanted() const { return wantFlag.load(); }
+    bool grant(bool on) { return grantFlag.exchange(on) != on; }
+};
+
+class PowerLease
+{
+public:
+    struct Config
+    {
+        uint8_t slots = 1; // 整个机队同时运行的水泵上限
+        uint32_t leaseSec = POWER_LEASE_SEC;
+        uint32_t settleSec = POWER_LEASE_SETTLE_SEC;
+        uint32_t offlineGrantSec = POWER_LEASE_OFFLINE_SEC;
+    };
+
+    enum class State : uint8_t
+    {
+        Idle,
+        Waiting, // 已申请，排队中
+        Holding, // 拿到名额 (已发布 R)
+        Local    // 连不上 broker，超时后自己放行
+    };
+
+    // 发布自己的保留消息 (空字符串 = 释放)
+    typedef std::function<void(const char *payload)> Publish;
+
+    struct Stats
+    {
+        uint32_t grants = 0;
+        uint32_t localGrants = 0;
+        uint32_t lost = 0;      // 持有期间没续上约、被迫交还的次数
+        uint32_t maxWaitSec = 0; // 最长排队时间
+        uint32_t tableFull = 0; // 设备太多、记不下的消息数
+    };
+
+private:
+    struct Entry
+    {
+        char id[POWER_LEASE_ID_LEN];
+        int64_t since;
+        int64_t expires;
+        bool running;
+    };
+
+    Config cfg;
+    char self[POWER_LEASE_ID_LEN];
+    uint32_t stagger = 0; // 离线放行时按 id 错开的秒数
+    Entry peers[POWER_LEASE_MAX_PEERS];
+    uint8_t peerCount = 0;
+
+    State st = State::Idle;
+    int64_t since = 0;      // 本次申请时刻
+    int64_t wantSince = 0;  // 开始想要名额的时刻
+    int64_t offlineSince = 0; // 断线的时刻 (0 = 连着)
+    int64_t echoedAt = 0;   // 本次申请第一次回显的时刻 (0 = 还没回显)
+    int64_t validUntil = 0; // 最近一次回显的到期时刻
+    int64_t renewAt = 0;    // 下一次续约的时刻
+    bool wasConnected = false;
+    bool staleOwn = false;  // broker 上还留着自己上一次 (重启前) 的保留消息
+    Stats stats;
+
+    static bool parse(const uint8_t *p, size_t len, int64_t &s, int64_t &e, bool &running)
+    {
+        char buf[48];
+        if (len == 0 || len >= sizeof(buf))
+            return false;
+        memcpy(buf, p, len);
+        buf[len] = '\0';
+        long long a = 0, b = 0;
+        char c = 0;
+        if (sscanf(buf, "%lld %lld %c", &a, &b, &c) != 3 || (c != 'R' && c != 'W'))
+            return false;
+        s = a;
+        e = b;
+        running = c == 'R';
+        return true;
+    }
+
+    void send(const Publish &pub, bool running, int64_t now)
+    {
+        char msg[48];
+        snprintf(msg, sizeof(msg), "%lld %lld %c", (long long)since, (long long)(now + cfg.leaseSec), running ? 'R' : 'W');
+        pub(msg);
+        renewAt = now + cfg.leaseSec / 3;
+    }
+
+    Entry *find(const char *id, size_t len)
+    {
+        for (uint8_t i = 0; i < peerCount; i++)
+        {
+            if (strncmp(peers[i].id, id, len) == 0 && peers[i].id[len] == '\0')
+                return &peers[i];
+        }
+        return nullptr;
+    }
+
+    void remove(Entry *e) { *e = peers[--peerCount]; }
+
+    // 排在自己前面的设备数 (没到期的 R 全算，W 按申请时刻 + id)
+    uint8_t ahead(int64_t now) const
+    {
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < peerCount; i++)
+        {
+            const Entry &e = peers[i];
+            if (e.expires <= now)
+                continue;
+            if (e.running || e.since < since || (e.since == since && strcmp(e.id, self) < 0))
+                n++;
+        }
+        return n;
+    }
+
+    void toIdle(const Publish &pub, bool connected)
+    {
+        if (connected && (st == State::Waiting || st == State::Holding))
+            pub(""); // 删掉保留消息
+        st = State::Idle;
+        echoedAt = 0;
+    }
+
+public:
+    PowerLease() { self[0] = '\0'; }
+
+    void begin(const char *deviceId, const Config &c)
+    {
+        cfg = c;
+        if (cfg.slots == 0)
+            cfg.slots = 1;
+        if (cfg.leaseSec < cfg.settleSec * 3)
+            cfg.leaseSec = cfg.settleSec * 3;
+        strncpy(self, deviceId, sizeof(self) - 1);
+        self[sizeof(self) - 1] = '\0';
+        uint32_t h = 2166136261u;
+        for (const char *p = self; *p; p++)
+            h = (h ^ (uint8_t)*p) * 16777619u;
+        stagger = h % 300;
+    }
+
+    // [网络任务] <POWER_LEASE_TOPIC>/<id> 上收到的消息；id 是主题的最后一段
+    void onMessage(const char *id, size_t idLen, const uint8_t *payload, size_t len, int64_t now)
+    {
+        if (idLen == 0 || idLen >= POWER_LEASE_ID_LEN)
+            return;
+        int64_t s = 0, e = 0;
+        bool running = false;
+        bool valid = parse(payload, len, s, e, running);
+
+        if (idLen == strlen(self) && strncmp(id, self, idLen) == 0)
+        {
+            // 自己的回显：只认本次申请的；别的 (重启前留下的 R) 要删掉，否则别人会一直把它算进去
+            if (valid && (st == State::Waiting || st == State::Holding) && s == since)
+            {
+                if (echoedAt == 0)
+                    echoedAt = now;
+                validUntil = e;
+            }
+            else
+                staleOwn = valid && st != State::Waiting && st != State::Holding;
+            return;
+        }
+
+        Entry *entry = find(id, idLen);
+        if (!valid)
+        {
+            if (entry)
+                remove(entry); // 释放 (或看不懂的消息：当作不存在)
+            return;
+        }
+        if (!entry)
+        {
+            if (peerCount >= POWER_LEASE_MAX_PEERS)
+            {
+                // 先腾出到期的位置；还是满的话记不下
+                for (uint8_t i = 0; i < peerCount;)
+                {
+                    if (peers[i].expires <= now)
+                        remove(&peers[i]);
+                    else
+                        i++;
+                }
+                if (peerCount >= POWER_LEASE_MAX_PEERS)
+                {
+                    stats.tableFull++;
+                    return;
+                }
+            }
+            entry = &peers[peerCount++];
+            memcpy(entry->id, id, idLen);
+            entry->id[idLen] = '\0';
+        }
+        entry->since = s;
+        entry->expires = e;
+        entry->running = running;
+    }
+
+    // [网络任务] 推进状态；wanted 来自 PowerGate，connected 为 MQTT 是否连着
+    // 返回是否允许开泵，nextSec 为最晚多少秒后再调用
+    bool tick(int64_t now, bool wanted, bool connected, const Publish &pub, uint32_t &nextSec)
+    {
+        nextSec = UINT32_MAX;
+        bool reconnected = connected && !wasConnected;
+        wasConnected = connected;
+        if (connected)
+            offlineSince = 0;
+        else if (offlineSince == 0)
+            offlineSince = now;
+
+        if (!wanted)
+        {
+            if (st != State::Idle)
+                TRACE_I("[Power] Released (%d)", (int)st);
+            if (connected && staleOwn && st != State::Waiting && st != State::Holding)
+            {
+                pub("");
+                staleOwn = false;
+            }
+            toIdle(pub, connected);
+            wantSince = 0;
+            return false;
+        }
+        if (wantSince == 0)
+            wantSince = now;
+
+        // 1. 断线：排队作废；持有的名额撑到租约到期前，之后交还
+        if (!connected)
+        {
+            if (st == State::Waiting)
+            {
+                st = State::Idle;
+                echoedAt = 0;
+            }
+            if (st == State::Holding && now >= validUntil - (int64_t)cfg.settleSec)
+            {
+                stats.lost++;
+                TRACE_W("[Power] Lease lost while offline");
+                st = State::Idle;
+                echoedAt = 0;
+            }
+            if (st == State::Idle && cfg.offlineGrantSec > 0)
+            {
+                // 从 "既想要名额、又连不上" 的那一刻算起
+                int64_t at = (wantSince > offlineSince ? wantSince : offlineSince) + cfg.offlineGrantSec + stagger;
+                if (now >= at)
+                {
+                    st = State::Local;
+                    stats.localGrants++;
+                    TRACE_W("[Power] Broker unreachable for %ds, running without lease", (int32_t)(now - offlineSince));
+                }
+                else
+                    nextSec = (uint32_t)(at - now);
+            }
+            if (st == State::Holding)
+                nextSec = (uint32_t)(validUntil - (int64_t)cfg.settleSec - now);
+            return st == State::Holding || st == State::Local;
+        }
+
+        // 2. 连着：申请 (本地放行中的设备重连后直接以 R 公布，别人会把它算进去)
+        if (st == State::Idle || st == State::Local || reconnected)
+        {
+            bool local = st == State::Local || st == State::Holding;
+            since = now;
+            echoedAt = 0;
+            validUntil = now + cfg.leaseSec;
+            st = local ? State::Holding : State::Waiting;
+            send(pub, local, now);
+            staleOwn = false;
+            TRACE_I("[Power] Requested slot (%d peers known)", peerCount);
+        }
+
+        // 3. 排队：回显 + settle 之后，前面不足 slots 个就开泵
+        if (st == State::Waiting && echoedAt != 0)
+        {
+            int64_t ready = echoedAt + cfg.settleSec;
+            if (now < ready)
+                nextSec = (uint32_t)(ready - now);
+            else if (ahead(now) < cfg.slots)
+            {
+                st = State::Holding;
+                stats.grants++;
+                uint32_t waited = (uint32_t)(now - wantSince);
+                if (waited > stats.maxWaitSec)
+                    stats.maxWaitSec = waited;
+                TRACE_I("[Power] Slot granted after %ds", (int32_t)waited);
+                send(pub, true, now);
+            }
+        }
+
+        // 4. 持有：续约；续不上 (broker 不回显) 就交还
+        if (st == State::Holding && now >= validUntil - (int64_t)cfg.settleSec)
+        {
+            stats.lost++;
+            TRACE_W("[Power] Lease not renewed, giving up slot");
+            toIdle(pub, true);
+            return false;
+        }
+        if ((st == State::Waiting || st == State::Holding) && now >= renewAt)
+            send(pub, st == State::Holding, now);
+
+        if (st == State::Waiting || st == State::Holding)
+        {
+            uint32_t toRenew = renewAt > now ? (uint32_t)(renewAt - now) : 0;
+            if (toRenew < nextSec)
+                nextSec = toRenew;
+        }
+        if (st == State::Waiting && nextSec > 1)
+            nextSec = 1; // 排队时每秒看一次队列 (别人释放是收到消息才知道的)
+        return st == State::Holding;
+    }
+
+    State state() const { return st; }
+    const Stats &getStats() const { return stats; }
+    const char *id() const { return self; }
+
+    // 当前持有名额的设备数 (自己看到的)
+    uint8_t holders(int64_t now) const
+    {
+        uint8_t n = st == State::Holding ? 1 : 0;
+        for (uint8_t i = 0; i < peerCount; i++)
+        {
+            if (peers[i].expires > now && peers[i].running)
+                n++;
+        }
+        return n;
+    }
+
+    // 排在自己前面的设备数 (含正在运行的)，小于 slots 时就轮到自己；不在排队时为 -1
+    int position(int64_t now) const { return st == State::Waiting ? (int)ahead(now) : -1; }
+
+    static const char *stateName(State s)
+    {
+        switch (s)
+        {
+        case State::Waiting:
+            return "waiting";
+        case State::Holding:
+            return "holding";
+        case State::Local:
+            return "local";
+        default:
+            return "idle";
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_pm.h>
+
+// 空闲省电：两个任务都阻塞时让芯片降频 / 自动 light sleep，WiFi 在 DTIM 间隔之间关闭射频
+// - DFS (动态调频) 和自动 light sleep 需要 sdkconfig 里打开 CONFIG_PM_ENABLE /
+//   CONFIG_FREERTOS_USE_TICKLESS_IDLE；框架不支持时退化为只开 DFS 或什么都不做，打印原因
+// - 继电器吸合期间持有 NO_LIGHT_SLEEP 锁：浇水时不睡，保证 GPIO 和计时精确
+#ifndef POWER_MAX_FREQ_MHZ
+#define POWER_MAX_FREQ_MHZ 240
+#endif
+#ifndef POWER_MIN_FREQ_MHZ
+#define POWER_MIN_FREQ_MHZ 80 // WiFi 要求最低 80MHz
+#endif
+
+class PowerManager
+{
+private:
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t awakeLock = nullptr;
+#endif
+    bool held = false;
+    bool lightSleep = false;
+
+#if CONFIG_PM_ENABLE
+    static esp_err_t configure(bool sleep)
+    {
+#if CONFIG_IDF_TARGET_ESP32S3
+        esp_pm_config_esp32s3_t cfg;
+#else
+        esp_pm_config_esp32_t cfg;
+#endif
+        cfg.max_freq_mhz = POWER_MAX_FREQ_MHZ;
+        cfg.min_freq_mhz = POWER_MIN_FREQ_MHZ;
+        cfg.light_sleep_enable = sleep;
+        return esp_pm_configure(&cfg);
+    }
+#endif
+
+public:
+    void begin(bool enableLightSleep = true)
+    {
+#if CONFIG_PM_ENABLE
+        esp_err_t err = configure(enableLightSleep);
+        if (err != ESP_OK && enableLightSleep)
+        {
+            // 框架没开 tickless idle：只保留动态调频
+            Serial.printf("[Power] Light sleep unavailable (err %d), DFS only.\n", (int)err);
+            err = configure(false);
+        }
+        else
+        {
+            lightSleep = enableLightSleep;
+        }
+        if (err != ESP_OK)
+            Serial.printf("[Power] esp_pm_configure failed (err %d).\n", (int)err);
+
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "relay", &awakeLock);
+#else
+        (void)enableLightSleep;
+        Serial.println("[Power] CONFIG_PM_ENABLE is off, DFS / light sleep unavailable.");
+#endif
+        Serial.printf("[Power] DFS %d-%d MHz, light sleep: %s\n", POWER_MIN_FREQ_MHZ, POWER_MAX_FREQ_MHZ, lightSleep ? "ON" : "OFF");
+    }
+
+    // WiFi 连上之后调用：modem sleep，射频只在 DTIM 信标时醒来
+    void enableModemSleep()
+    {
+        WiFi.setSleep(WIFI_PS_MIN_MODEM);
+    }
+
+    // 有水泵在跑时保持清醒 (可以每拍调用，只在状态变化时加/解锁)
+    void holdAwake(bool busy)
+    {
+        if (busy == held)
+            return;
+        held = busy;
+#if CONFIG_PM_ENABLE
+        if (!awakeLock)
+            return;
+        if (busy)
+            esp_pm_lock_acquire(awakeLock);
+        else
+            esp_pm_lock_release(awakeLock);
+#endif
+    }
+
+    bool isLightSleepEnabled() const { return lightSleep; }
+};
+
+#endif
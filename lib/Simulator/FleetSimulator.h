@@ -0,0 +1,237 @@
+#ifndef FLEET_SIMULATOR_H
+#define FLEET_SIMULATOR_H
+
+#ifdef ARDUINO
+#error "FleetSimulator runs on the host (native env) only"
+#endif
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../Hal/Hal.h"
+#include "../WateringSystem/WateringSystem.h"
+#include "../WateringCore/WakePlanner.h"
+
+// 机队仿真：用 HostHal 的虚拟时钟把真实的 WateringSystem 快进若干年
+// - 每个工作线程依次仿真一台台设备 (HostHal / PartitionFlash 的状态按线程隔离)，结果与线程数无关
+// - 控制循环和 main.cpp 的 controlTick 一样：loop() → update(now) → 睡到 WakePlanner 给出的下一个截止时刻；
+//   睡眠就是拨快时钟，所以一台设备 5 年只需要几千次唤醒
+// - 故障注入：随机断电 (运行中的水泵被切断，重启后从 Flash 恢复)，上电后要过一段时间才能对时
+// - 统计：启动次数 (继电器下降沿)、设备报告的错过次数、继电器累计吸合时间
+//   启动 + 错过 + 切断应与无故障时的启动次数一致：每个计划都被结算过，没有悄悄漏掉的
+
+struct FleetSimConfig
+{
+    uint32_t devices = 10000;
+    uint16_t years = 5;
+    uint32_t seed = 1;
+    uint8_t maxZones = 4;           // 每台设备随机 1..maxZones 个区域
+    bool storage = true;            // 状态日志 / 历史 (关掉后重启会丢计数)
+    uint16_t outagesPerYear = 6;    // 平均每年断电次数，0 = 不注入故障
+    uint32_t maxOutageSec = 12 * 3600;
+    uint32_t maxSyncDelaySec = 600; // 上电到对时成功的最长时间
+    uint16_t threads = 0;           // 工作线程数，0 = CPU 核数
+    MissedFirePolicy policy = MissedFirePolicy::RunLate;
+    uint32_t runLateSec = WATERING_RUN_LATE_SEC;
+};
+
+struct FleetSimReport
+{
+    uint64_t fires = 0;     // 水泵启动次数 (继电器下降沿)
+    uint64_t misses = 0;    // 设备自己报告的错过次数 (断电 / 未对时期间的计划，超出补跑窗口)
+    uint64_t cutRuns = 0;   // 运行中被断电切断 (已经启动过，不再补跑)
+    uint64_t reboots = 0;
+    uint64_t wakeups = 0;   // 控制循环被唤醒的次数
+    uint64_t relayOnMs = 0; // 所有继电器累计吸合时间
+    uint64_t deviceDays = 0;
+    double wallMs = 0;
+    uint16_t threads = 0;
+
+    void add(const FleetSimReport &o)
+    {
+        fires += o.fires;
+        misses += o.misses;
+        cutRuns += o.cutRuns;
+        reboots += o.reboots;
+        wakeups += o.wakeups;
+        relayOnMs += o.relayOnMs;
+        deviceDays += o.deviceDays;
+    }
+};
+
+// 一台设备的区域配置 (由种子决定，测试可以用同样的种子复现)
+struct SimZone
+{
+    uint8_t pin;
+    int durationSec;
+    int hour;
+    int minute;
+    int intervalDays;
+};
+
+class FleetSimulator
+{
+public:
+    static const int MAX_CYCLES = 1000000;        // 仿真期内不会用完
+    static const uint32_t MAX_SLEEP_MS = 86400000; // 单次最长睡一天 (真机为看门狗 10 秒)
+    static const uint8_t FIRST_PIN = 4;
+
+    // splitmix64：可复现、够快
+    struct Rng
+    {
+        uint64_t s;
+        explicit Rng(uint64_t seed) : s(seed) {}
+        uint64_t next()
+        {
+            uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+        // [lo, hi]
+        uint32_t range(uint32_t lo, uint32_t hi) { return lo + (uint32_t)(next() % (uint64_t)(hi - lo + 1)); }
+    };
+
+    // 仿真起点：2024-01-01 00:00 (本地 epoch)
+    static int64_t startEpoch() { return (int64_t)EpochTime::daysFromCivil(2024, 1, 1) * EpochTime::SECONDS_PER_DAY; }
+
+    static uint8_t makeZones(const FleetSimConfig &cfg, Rng &rng, SimZone *out)
+    {
+        uint8_t n = (uint8_t)rng.range(1, cfg.maxZones ? cfg.maxZones : 1);
+        for (uint8_t i = 0; i < n; i++)
+        {
+            out[i].pin = (uint8_t)(FIRST_PIN + i);
+            out[i].durationSec = (int)rng.range(30, 600);
+            out[i].hour = (int)rng.range(1, 21); // 避开跨午夜，排队的区域仍在同一天完成
+            out[i].minute = (int)rng.range(0, 59);
+            out[i].intervalDays = (int)rng.range(1, 3);
+        }
+        return n;
+    }
+
+    // 参考模型：从 from 到 to (本地 epoch 秒) 之间按计划应该触发的次数
+    static uint32_t expectedFires(const SimZone &z, int64_t from, int64_t to, int count = 0,
+                                  int32_t lastDay = WateringLogic::NEVER_WATERED)
+    {
+        WateringLogic logic(z.hour, z.minute, z.intervalDays, MAX_CYCLES);
+        uint32_t n = 0;
+        for (int64_t f = logic.nextFireTime(from, count, lastDay); f != WateringLogic::NEVER && f + 60 <= to;
+             f = logic.nextFireTime(f + 60, count, lastDay))
+        {
+            n++;
+            count++;
+            lastDay = EpochTime::dayOf(f);
+        }
+        return n;
+    }
+
+    // 仿真一台设备，结果累加到 report
+    static void runDevice(const FleetSimConfig &cfg, uint32_t id, FleetSimReport &report)
+    {
+        HostHal::reset();
+        PartitionFlash::hostWipeAll();
+
+        Rng rng((uint64_t)cfg.seed * 0x100000001B3ULL + id);
+        SimZone zones[WATERING_MAX_ZONES];
+        uint8_t zoneCount = makeZones(cfg, rng, zones);
+
+        const int64_t epoch0 = startEpoch();
+        const uint64_t endMs = (uint64_t)cfg.years * 365 * EpochTime::SECONDS_PER_DAY * 1000;
+        const uint64_t outageGapMs = cfg.outagesPerYear ? 365ULL * EpochTime::SECONDS_PER_DAY * 1000 / cfg.outagesPerYear : 0;
+        uint64_t nextOutage = outageGapMs ? rng.next() % (2 * outageGapMs) : UINT64_MAX;
+
+        while (HostHal::nowMs() < endMs)
+        {
+            std::unique_ptr<WateringSystem> sys(new WateringSystem(cfg.storage));
+            for (uint8_t i = 0; i < zoneCount; i++)
+                sys->addZone(zones[i].pin, zones[i].durationSec, zones[i].hour, zones[i].minute, zones[i].intervalDays, MAX_CYCLES);
+            sys->setMissedFirePolicy(cfg.policy, cfg.runLateSec);
+            sys->begin();
+
+            uint64_t stopAt = nextOutage < endMs ? nextOutage : endMs;
+            uint64_t syncAt = HostHal::nowMs() + (uint64_t)rng.range(1, cfg.maxSyncDelaySec ? cfg.maxSyncDelaySec : 1) * 1000;
+
+            if (syncAt < stopAt)
+            {
+                HostHal::advanceMs(syncAt - HostHal::nowMs());
+
+                // 控制循环 (同 controlTick)；对时后第一次 update() 从检查点补算断电期间的计划
+                for (;;)
+                {
+                    uint64_t nowMs = HostHal::nowMs();
+                    int64_t now = epoch0 + (int64_t)(nowMs / 1000);
+                    sys->loop();
+                    sys->update(now);
+                    report.wakeups++;
+
+                    uint32_t wait = WakePlanner::sleepMs(true, now, (uint16_t)(nowMs % 1000), sys->getNextFireTime(),
+                                                         sys->msUntilPumpDeadline(), MAX_SLEEP_MS);
+                    if (nowMs + wait >= stopAt)
+                        break;
+                    HostHal::advanceMs(wait);
+                }
+            }
+            HostHal::advanceMs(stopAt - HostHal::nowMs());
+            report.misses += sys->getMissedCount(); // 计数在 RAM 里，断电前收集
+            if (stopAt >= endMs)
+                break;
+
+            // 断电：继电器释放，正在跑的水泵被切断，RAM 状态全部丢失
+            for (uint8_t i = 0; i < zoneCount; i++)
+            {
+                if (sys->isRelayOn(i))
+                    report.cutRuns++;
+            }
+            HostHal::gpio().powerOff(HostHal::state().clock.micros64());
+            sys.reset();
+            report.reboots++;
+
+            HostHal::advanceMs((uint64_t)rng.range(1, cfg.maxOutageSec ? cfg.maxOutageSec : 1) * 1000);
+            nextOutage = HostHal::nowMs() + rng.next() % (2 * outageGapMs);
+        }
+
+        uint64_t nowUs = HostHal::state().clock.micros64();
+        for (uint8_t i = 0; i < zoneCount; i++)
+        {
+            report.fires += HostHal::gpio().fallingEdges(zones[i].pin);
+            report.relayOnMs += HostHal::gpio().lowTimeUs(zones[i].pin, nowUs) / 1000;
+        }
+        report.deviceDays += (uint64_t)cfg.years * 365;
+    }
+
+    static FleetSimReport run(const FleetSimConfig &cfg)
+    {
+        using namespace std::chrono;
+        steady_clock::time_point t0 = steady_clock::now();
+
+        uint32_t threads = cfg.threads ? cfg.threads : std::thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+        if (threads > cfg.devices)
+            threads = cfg.devices ? cfg.devices : 1;
+
+        std::atomic<uint32_t> nextId{0};
+        std::vector<FleetSimReport> partial(threads);
+        std::vector<std::thread> workers;
+        for (uint32_t t = 0; t < threads; t++)
+            workers.emplace_back([&cfg, &nextId, &partial, t]()
+                                 {
+                for (uint32_t id = nextId++; id < cfg.devices; id = nextId++)
+                    runDevice(cfg, id, partial[t]); });
+
+        FleetSimReport report;
+        for (uint32_t t = 0; t < threads; t++)
+        {
+            workers[t].join();
+            report.add(partial[t]);
+        }
+        report.threads = (uint16_t)threads;
+        report.wallMs = (double)duration_cast<microseconds>(steady_clock::now() - t0).count() / 1000.0;
+        return report;
+    }
+};
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef FLASH_SIM_H
+#define FLASH_SIM_H
+
+#include <stdint.h>
+#include <string.h>
+
+// 内存里的 NOR Flash 模拟器 (给 StateJournal 做测试和寿命估算)
+// - 擦除后全 0xFF，写入只能把 1 变成 0 (按位与)，违反时计数
+// - 统计每个扇区的擦除次数
+// - 可以设定 "再写 N 字节就掉电"：第 N 字节之后的写入/擦除全部丢失，直到 powerCycle()
+class FlashSim
+{
+private:
+    uint8_t *mem;
+    uint32_t secSize;
+    uint32_t secCount;
+    uint32_t *erases;
+
+    bool powered = true;
+    bool cutArmed = false;
+    uint32_t budget = 0; // 掉电前还能写入的字节数
+
+public:
+    uint32_t norViolations = 0; // 试图把 0 写回 1 的次数
+    uint64_t bytesWritten = 0;
+
+    FlashSim(uint32_t sectorSize = 4096, uint32_t sectors = 16)
+        : secSize(sectorSize), secCount(sectors)
+    {
+        mem = new uint8_t[(size_t)secSize * secCount];
+        erases = new uint32_t[secCount];
+        memset(mem, 0xFF, (size_t)secSize * secCount);
+        memset(erases, 0, sizeof(uint32_t) * secCount);
+    }
+
+    ~FlashSim()
+    {
+        delete[] mem;
+        delete[] erases;
+    }
+
+    FlashSim(const FlashSim &) = delete;
+    FlashSim &operator=(const FlashSim &) = delete;
+
+    bool begin() { return true; }
+    uint32_t sectorSize() const { return secSize; }
+    uint32_t sectorCount() const { return secCount; }
+
+    bool read(uint32_t addr, void *buf, uint32_t len)
+    {
+        if (!powered || addr + len > secSize * secCount)
+            return false;
+        memcpy(buf, mem + addr, len);
+        return true;
+    }
+
+    bool write(uint32_t addr, const void *buf, uint32_t len)
+    {
+        if (!powered || addr + len > secSize * secCount)
+            return false;
+        const uint8_t *src = (const uint8_t *)buf;
+        for (uint32_t i = 0; i < len; i++)
+        {
+            if (cutArmed && budget-- == 0)
+            {
+                powered = false; // 掉电：这一字节及之后都没写进去
+                return false;
+            }
+            if (src[i] & ~mem[addr + i])
+                norViolations++;
+            mem[addr + i] &= src[i];
+            bytesWritten++;
+        }
+        return true;
+    }
+
+    // 擦除按字节消耗掉电预算：预算不够时只擦掉扇区开头的一部分
+    bool eraseSector(uint32_t sector)
+    {
+        if (!powered || sector >= secCount)
+            return false;
+        uint8_t *p = mem + (size_t)sector * secSize;
+        erases[sector]++;
+        if (cutArmed && budget < secSize)
+        {
+            memset(p, 0xFF, budget);
+            budget = 0;
+            powered = false;
+            return false;
+        }
+        if (cutArmed)
+            budget -= secSize;
+        memset(p, 0xFF, secSize);
+        return true;
+    }
+
+    // 再写 bytes 字节后掉电
+    void cutPowerAfter(uint32_t bytes)
+    {
+        cutArmed = true;
+        budget = bytes;
+    }
+
+    // 重新上电 (内容保留)
+    void powerCycle()
+    {
+        powered = true;
+        cutArmed = false;
+    }
+
+    bool isPowered() const { return powered; }
+
+    uint32_t eraseCount(uint32_t sector) const { return sector < secCount ? erases[sector] : 0; }
+
+    uint32_t maxEraseCount() const
+    {
+        uint32_t m = 0;
+        for (uint32_t i = 0; i < secCount; i++)
+            if (erases[i] > m)
+                m = erases[i];
+        return m;
+    }
+
+    uint32_t minEraseCount() const
+    {
+        uint32_t m = erases[0];
+        for (uint32_t i = 1; i < secCount; i++)
+            if (erases[i] < m)
+                m = erases[i];
+        return m;
+    }
+
+    uint64_t totalErases() const
+    {
+        uint64_t t = 0;
+        for (uint32_t i = 0; i < secCount; i++)
+            t += erases[i];
+        return t;
+    }
+
+    void resetCounters()
+    {
+        memset(erases, 0, sizeof(uint32_t) * secCount);
+        bytesWritten = 0;
+        norViolations = 0;
+    }
+};
+
+#endif
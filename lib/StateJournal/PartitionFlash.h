@@ -0,0 +1,138 @@
+#ifndef PARTITION_FLASH_H
+#define PARTITION_FLASH_H
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_partition.h>
+#else
+#include <map>
+#include <memory>
+#include <string>
+#include "FlashSim.h"
+#endif
+
+// 专用分区的大小 (分区表里没有对应分区时，从 spiffs 分区末尾借用同样大小)
+#ifndef JOURNAL_FALLBACK_BYTES
+#define JOURNAL_FALLBACK_BYTES (64 * 1024)
+#endif
+#ifndef HISTORY_FALLBACK_BYTES
+#define HISTORY_FALLBACK_BYTES (128 * 1024)
+#endif
+
+// StateJournal / HistoryLog 在 ESP32 上的存储后端：直接读写一个数据分区
+// 优先使用分区表里同名的分区 (见 partitions_16MB_journal.csv)；
+// 通过 OTA 升级的旧设备分区表不会变，这时借用 spiffs 分区末尾的一段 (本项目不使用 SPIFFS)：
+//   [ ... spiffs ... | history 128KB | journal 64KB ]
+#ifdef ARDUINO
+class PartitionFlash
+{
+private:
+    static const uint32_t SECTOR_SIZE = 4096;
+
+    const char *label;
+    uint32_t fallbackBytes;
+    uint32_t fallbackTail; // 借用区域距 spiffs 末尾的偏移
+
+    const esp_partition_t *part = nullptr;
+    uint32_t base = 0;
+    uint32_t size = 0;
+
+public:
+    PartitionFlash(const char *_label = "journal", uint32_t _fallbackBytes = JOURNAL_FALLBACK_BYTES, uint32_t _fallbackTail = 0)
+        : label(_label), fallbackBytes(_fallbackBytes), fallbackTail(_fallbackTail) {}
+
+    bool begin()
+    {
+        if (part)
+            return true;
+
+        part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+        if (part)
+        {
+            base = 0;
+            size = part->size;
+        }
+        else
+        {
+            part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
+            if (!part || part->size < fallbackTail + fallbackBytes)
+            {
+                part = nullptr;
+                Serial.printf("[Flash] No '%s' partition found.\n", label);
+                return false;
+            }
+            base = part->size - fallbackTail - fallbackBytes;
+            size = fallbackBytes;
+            Serial.printf("[Flash] '%s' uses tail of spiffs partition.\n", label);
+        }
+        return true;
+    }
+
+    uint32_t sectorSize() const { return SECTOR_SIZE; }
+    uint32_t sectorCount() const { return size / SECTOR_SIZE; }
+
+    bool read(uint32_t addr, void *buf, uint32_t len)
+    {
+        return esp_partition_read(part, base + addr, buf, len) == ESP_OK;
+    }
+
+    bool write(uint32_t addr, const void *buf, uint32_t len)
+    {
+        return esp_partition_write(part, base + addr, buf, len) == ESP_OK;
+    }
+
+    bool eraseSector(uint32_t sector)
+    {
+        return esp_partition_erase_range(part, base + sector * SECTOR_SIZE, SECTOR_SIZE) == ESP_OK;
+    }
+};
+#else
+// native：每个分区名对应一块 FlashSim，重新构造对象 (模拟重启) 数据还在
+// 和 HostHal 一样按线程隔离，一个线程就是一台设备
+class PartitionFlash
+{
+private:
+    static const uint32_t SECTOR_SIZE = 4096;
+
+    const char *label;
+    uint32_t bytes;
+    FlashSim *chip = nullptr;
+
+    static std::map<std::string, std::unique_ptr<FlashSim>> &chips()
+    {
+        static thread_local std::map<std::string, std::unique_ptr<FlashSim>> c;
+        return c;
+    }
+
+public:
+    PartitionFlash(const char *_label = "journal", uint32_t _fallbackBytes = JOURNAL_FALLBACK_BYTES, uint32_t _fallbackTail = 0)
+        : label(_label), bytes(_fallbackBytes) { (void)_fallbackTail; }
+
+    bool begin()
+    {
+        std::unique_ptr<FlashSim> &c = chips()[label];
+        if (!c)
+            c.reset(new FlashSim(SECTOR_SIZE, bytes / SECTOR_SIZE));
+        chip = c.get();
+        return true;
+    }
+
+    uint32_t sectorSize() const { return SECTOR_SIZE; }
+    uint32_t sectorCount() const { return bytes / SECTOR_SIZE; }
+    bool read(uint32_t addr, void *buf, uint32_t len) { return chip->read(addr, buf, len); }
+    bool write(uint32_t addr, const void *buf, uint32_t len) { return chip->write(addr, buf, len); }
+    bool eraseSector(uint32_t sector) { return chip->eraseSector(sector); }
+
+    // 查看某个分区的模拟芯片 (擦除次数、掉电注入)；还没 begin() 过返回 nullptr
+    static FlashSim *hostChip(const char *name)
+    {
+        std::map<std::string, std::unique_ptr<FlashSim>>::iterator it = chips().find(name);
+        return it == chips().end() ? nullptr : it->second.get();
+    }
+
+    // 换一台设备：丢掉所有分区内容 (下次 begin() 重新得到全新的芯片)
+    static void hostWipeAll() { chips().clear(); }
+};
+#endif
+
+#endif
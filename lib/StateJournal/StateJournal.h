@@ -0,0 +1,406 @@
+#ifndef STATE_JOURNAL_H
+#define STATE_JOURNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// 追加写的状态日志 (纯逻辑，通过 Flash 模板参数访问存储)
+//
+// 存储布局：一组 4KB 扇区轮流使用
+//   扇区头 [magic][seq][~seq]               12 字节，最后写入，写完才算有效
+//   记录   [tag][flags][count][key,value]*n[crc32]   4 字节对齐
+//
+// - 状态是一张 key(uint16) -> value(int32) 的表，完整副本常驻 RAM
+// - commit() 把暂存的多个字段写成一条记录，CRC 覆盖整条：要么全生效，要么全不生效
+// - 当前扇区写满时换到下一个扇区，先写一份全量快照再写扇区头 (即压缩)；
+//   旧扇区原样保留，掉电时最多丢失正在写的那一条
+// - begin() 只重放 seq 最大的有效扇区，遇到断尾 (CRC 错 / 空白区有脏数据) 就停下，
+//   下一次写入直接换扇区，不在不干净的位置上继续写
+//
+// Flash 需要提供：
+//   bool begin();
+//   uint32_t sectorSize() const;  uint32_t sectorCount() const;
+//   bool read(uint32_t addr, void *buf, uint32_t len);
+//   bool write(uint32_t addr, const void *buf, uint32_t len);   // NOR 语义：只能把 1 写成 0
+//   bool eraseSector(uint32_t sector);                         // 整扇区写回 0xFF
+template <typename Flash, uint16_t MAX_KEYS = 64>
+class StateJournal
+{
+public:
+    struct Stats
+    {
+        uint32_t commits;     // 实际写入的记录数
+        uint32_t skipped;     // 值没变化、省掉的提交
+        uint32_t bytesWritten;
+        uint32_t compactions; // 换扇区 (擦除) 次数
+        uint32_t replayed;    // begin() 重放的记录数
+        uint32_t corruptTails; // begin() 发现的断尾次数
+    };
+
+private:
+    static const uint32_t SECTOR_MAGIC = 0x314A5357; // "WSJ1"
+    static const uint32_t HEADER_SIZE = 12;
+    static const uint8_t RECORD_TAG = 0x5A;
+    static const uint32_t FIELD_SIZE = 6;
+    static const uint32_t RECORD_OVERHEAD = 8; // 4 字节头 + 4 字节 CRC
+    static const uint32_t NO_SECTOR = 0xFFFFFFFF;
+
+    Flash &flash;
+    bool ready = false;
+
+    // RAM 中的当前状态
+    uint16_t keys[MAX_KEYS];
+    int32_t values[MAX_KEYS];
+    uint16_t used = 0;
+
+    // 暂存区 (下一次 commit 的字段)
+    uint16_t pendKeys[MAX_KEYS];
+    int32_t pendValues[MAX_KEYS];
+    uint16_t pendCount = 0;
+
+    uint32_t active = NO_SECTOR; // 当前写入的扇区
+    uint32_t seq = 0;
+    uint32_t writePos = 0;       // 扇区内的下一个写入位置
+
+    uint8_t rec[RECORD_OVERHEAD + FIELD_SIZE * MAX_KEYS];
+    Stats stats = {};
+
+    static uint32_t align4(uint32_t n) { return (n + 3) & ~3u; }
+
+    static uint32_t recordSize(uint16_t count) { return RECORD_OVERHEAD + FIELD_SIZE * count; }
+
+    static void put16(uint8_t *p, uint16_t v)
+    {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+    }
+    static void put32(uint8_t *p, uint32_t v)
+    {
+        for (int i = 0; i < 4; i++)
+            p[i] = (uint8_t)(v >> (8 * i));
+    }
+    static uint16_t get16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+    static uint32_t get32(const uint8_t *p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    int find(uint16_t key) const
+    {
+        for (uint16_t i = 0; i < used; i++)
+            if (keys[i] == key)
+                return i;
+        return -1;
+    }
+
+    bool apply(uint16_t key, int32_t value)
+    {
+        int i = find(key);
+        if (i >= 0)
+        {
+            values[i] = value;
+            return true;
+        }
+        if (used >= MAX_KEYS)
+            return false;
+        keys[used] = key;
+        values[used] = value;
+        used++;
+        return true;
+    }
+
+    // 编码一条记录到 rec，返回字节数
+    uint32_t encode(const uint16_t *k, const int32_t *v, uint16_t n)
+    {
+        rec[0] = RECORD_TAG;
+        rec[1] = 0;
+        put16(rec + 2, n);
+        uint8_t *p = rec + 4;
+        for (uint16_t i = 0; i < n; i++, p += FIELD_SIZE)
+        {
+            put16(p, k[i]);
+            put32(p + 2, (uint32_t)v[i]);
+        }
+        uint32_t len = recordSize(n);
+        put32(rec + len - 4, crc32(rec, len - 4));
+        return len;
+    }
+
+    bool readHeader(uint32_t sector, uint32_t &outSeq)
+    {
+        uint8_t h[HEADER_SIZE];
+        if (!flash.read(sector * flash.sectorSize(), h, HEADER_SIZE))
+            return false;
+        if (get32(h) != SECTOR_MAGIC || get32(h + 8) != ~get32(h + 4))
+            return false;
+        outSeq = get32(h + 4);
+        return true;
+    }
+
+    // 重放一个扇区，返回 false 表示遇到断尾
+    bool replay(uint32_t sector)
+    {
+        const uint32_t ss = flash.sectorSize();
+        const uint32_t base = sector * ss;
+        uint32_t pos = HEADER_SIZE;
+
+        while (pos + RECORD_OVERHEAD <= ss)
+        {
+            if (!flash.read(base + pos, rec, 4))
+                return false;
+
+            if (rec[0] == 0xFF)
+            {
+                // 空白区：确认剩下的都是 0xFF (被打断的写入可能只写了后半段)
+                writePos = pos;
+                uint8_t chunk[32];
+                for (uint32_t p = pos; p < ss; p += sizeof(chunk))
+                {
+                    uint32_t n = ss - p < sizeof(chunk) ? ss - p : sizeof(chunk);
+                    if (!flash.read(base + p, chunk, n))
+                        return false;
+                    for (uint32_t i = 0; i < n; i++)
+                        if (chunk[i] != 0xFF)
+                            return false;
+                }
+                return true;
+            }
+
+            uint16_t n = get16(rec + 2);
+            uint32_t len = recordSize(n);
+            if (rec[0] != RECORD_TAG || n > MAX_KEYS || pos + len > ss)
+                return false;
+            if (!flash.read(base + pos, rec, len) || get32(rec + len - 4) != crc32(rec, len - 4))
+                return false;
+
+            const uint8_t *p = rec + 4;
+            for (uint16_t i = 0; i < n; i++, p += FIELD_SIZE)
+                apply(get16(p), (int32_t)get32(p + 2));
+            stats.replayed++;
+            pos += align4(len);
+        }
+        writePos = ss; // 正好写满
+        return true;
+    }
+
+    // 换到下一个扇区：擦除 -> 写全量快照 -> 最后写扇区头
+    // 扇区头写完之前掉电，begin() 仍然会用上一个扇区
+    bool rotate()
+    {
+        const uint32_t ss = flash.sectorSize();
+        uint32_t next = active == NO_SECTOR ? 0 : (active + 1) % flash.sectorCount();
+        uint32_t base = next * ss;
+
+        if (!flash.eraseSector(next))
+            return false;
+        stats.compactions++;
+
+        uint32_t pos = HEADER_SIZE;
+        if (used > 0)
+        {
+            uint32_t len = encode(keys, values, used);
+            if (!flash.write(base + pos, rec, len))
+                return false;
+            stats.bytesWritten += len;
+            pos += align4(len);
+        }
+
+        uint8_t h[HEADER_SIZE];
+        put32(h, SECTOR_MAGIC);
+        put32(h + 4, seq + 1);
+        put32(h + 8, ~(seq + 1));
+        if (!flash.write(base, h, HEADER_SIZE))
+            return false;
+        stats.bytesWritten += HEADER_SIZE;
+
+        active = next;
+        seq++;
+        writePos = pos;
+        return true;
+    }
+
+public:
+    explicit StateJournal(Flash &_flash) : flash(_flash) {}
+
+    // CRC-32 (IEEE)，半字节查表
+    static uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0)
+    {
+        static const uint32_t TABLE[16] = {
+            0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+            0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+        crc = ~crc;
+        for (size_t i = 0; i < len; i++)
+        {
+            crc = TABLE[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+            crc = TABLE[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+        }
+        return ~crc;
+    }
+
+    // 挂载并恢复：找 seq 最大的有效扇区并重放
+    // 返回 false 表示存储不可用 (分区不存在 / 太小)
+    bool begin()
+    {
+        ready = false;
+        stats = {};
+        used = 0;
+        pendCount = 0;
+        active = NO_SECTOR;
+        seq = 0;
+        writePos = 0;
+
+        if (!flash.begin() || flash.sectorCount() < 2 ||
+            flash.sectorSize() < HEADER_SIZE + align4(recordSize(MAX_KEYS)))
+            return false;
+        ready = true;
+
+        for (uint32_t s = 0; s < flash.sectorCount(); s++)
+        {
+            uint32_t sq;
+            if (readHeader(s, sq) && (active == NO_SECTOR || (int32_t)(sq - seq) > 0))
+            {
+                active = s;
+                seq = sq;
+            }
+        }
+        if (active == NO_SECTOR)
+            return true; // 全新的分区
+
+        if (!replay(active))
+        {
+            // 断尾：已重放的部分有效，下一次提交换新扇区
+            stats.corruptTails++;
+            writePos = flash.sectorSize();
+        }
+        return true;
+    }
+
+    bool isReady() const { return ready; }
+
+    // 分区里还没有任何有效数据 (首次启动 / 刚格式化)
+    bool isBlank() const { return active == NO_SECTOR; }
+
+    bool lookup(uint16_t key, int32_t &value) const
+    {
+        int i = find(key);
+        if (i < 0)
+            return false;
+        value = values[i];
+        return true;
+    }
+
+    int32_t get(uint16_t key, int32_t fallback) const
+    {
+        int32_t v;
+        return lookup(key, v) ? v : fallback;
+    }
+
+    // 暂存一个字段，commit() 时和其它暂存字段一起原子写入
+    bool stage(uint16_t key, int32_t value)
+    {
+        for (uint16_t i = 0; i < pendCount; i++)
+        {
+            if (pendKeys[i] == key)
+            {
+                pendValues[i] = value;
+                return true;
+            }
+        }
+        if (pendCount >= MAX_KEYS)
+            return false;
+        pendKeys[pendCount] = key;
+        pendValues[pendCount] = value;
+        pendCount++;
+        return true;
+    }
+
+    // 把暂存字段写成一条记录；值没变的字段不写，全都没变就不碰 Flash
+    bool commit()
+    {
+        if (!ready)
+        {
+            pendCount = 0;
+            return false;
+        }
+
+        // 1. 过滤掉没变化的字段，并确认新键放得下
+        uint16_t n = 0;
+        uint16_t newKeys = 0;
+        for (uint16_t i = 0; i < pendCount; i++)
+        {
+            int j = find(pendKeys[i]);
+            if (j >= 0 && values[j] == pendValues[i])
+                continue;
+            if (j < 0)
+                newKeys++;
+            pendKeys[n] = pendKeys[i];
+            pendValues[n] = pendValues[i];
+            n++;
+        }
+        pendCount = 0;
+        if (n == 0)
+        {
+            stats.skipped++;
+            return true;
+        }
+        if (used + newKeys > MAX_KEYS)
+            return false;
+
+        for (uint16_t i = 0; i < n; i++)
+            apply(pendKeys[i], pendValues[i]);
+        stats.commits++;
+
+        // 2. 当前扇区放不下 (或没有扇区)：换扇区，快照里已经包含这次的改动
+        uint32_t len = recordSize(n);
+        if (active == NO_SECTOR || writePos + len > flash.sectorSize())
+            return rotate();
+
+        // 3. 追加一条记录
+        encode(pendKeys, pendValues, n);
+        if (!flash.write(active * flash.sectorSize() + writePos, rec, len))
+        {
+            // 写失败时这个位置已不可信，换扇区重写全量
+            writePos = flash.sectorSize();
+            return rotate();
+        }
+        stats.bytesWritten += len;
+        writePos += align4(len);
+        return true;
+    }
+
+    bool set(uint16_t key, int32_t value)
+    {
+        stage(key, value);
+        return commit();
+    }
+
+    // 立即压缩到新扇区
+    bool compact()
+    {
+        return ready && rotate();
+    }
+
+    // 擦除全部扇区，清空状态
+    bool format()
+    {
+        used = 0;
+        pendCount = 0;
+        active = NO_SECTOR;
+        writePos = 0;
+        if (!ready)
+            return false;
+        for (uint32_t s = 0; s < flash.sectorCount(); s++)
+        {
+            if (!flash.eraseSector(s))
+                return false;
+        }
+        return true;
+    }
+
+    uint16_t keyCount() const { return used; }
+
+    Stats getStats() const { return stats; }
+};
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 #include "time.h"
+#include <sys/time.h>
+#include "../WateringCore/EpochTime.h"
 
 class TimeManager {
 private:
@@ -21,18 +23,39 @@ public:
 
     // 尝试获取时间，成功返回 true，失败返回 false
     // 这里的 t 是引用传递，会将获取到的时间填入 t
+    // 超时传 0：未同步时立即返回，避免主循环被 getLocalTime 默认的 5 秒等待卡住
     bool getTime(struct tm &t) {
-        if(!getLocalTime(&t)){
+        if(!getLocalTime(&t, 0)){
             return false;
         }
         return true;
     }
     
-    // 阻塞直到时间同步成功 (用于 setup)
-    void waitForSync() {
+    // 当前本地 epoch 秒，以及这一秒里已经过去的毫秒 (控制任务据此对齐到整秒醒来)
+    // 未同步时返回 false
+    bool getEpoch(int64_t &localEpoch, uint16_t &msIntoSecond) {
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        time_t sec = tv.tv_sec;
+        struct tm t;
+        localtime_r(&sec, &t);
+        if (t.tm_year < (2016 - 1900)) return false; // 与 getLocalTime 的判断一致
+        localEpoch = EpochTime::toLocalEpoch(t);
+        msIntoSecond = (uint16_t)(tv.tv_usec / 1000);
+        return true;
+    }
+
+    // 等待时间同步 (用于 setup)，最多 timeoutMs，超时返回 false
+    // 不会无限等下去：NTP 不通时照常启动，控制任务拿到时间后再从检查点补算错过的计划
+    bool waitForSync(uint32_t timeoutMs = 10000) {
         Serial.print("[Time] Syncing");
         struct tm t;
+        uint32_t start = millis();
         while (!getTime(t)) {
+            if ((uint32_t)millis() - start >= timeoutMs) {
+                Serial.println("\n[Time] Sync timed out, continuing without time.");
+                return false;
+            }
             Serial.print(".");
             delay(500);
         }
@@ -40,6 +63,7 @@ public:
         Serial.printf("[Time] Current time: %04d-%02d-%02d %02d:%02d:%02d\n", 
             t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, 
             t.tm_hour, t.tm_min, t.tm_sec);
+        return true;
     }
 };
 
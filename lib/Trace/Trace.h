@@ -0,0 +1,325 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+#include "../Hal/Hal.h" // micros()
+
+// 延迟写出的二进制跟踪日志：热路径上不再同步 Serial.printf
+// - 调用点只写一条 28 字节的记录 (时间戳 + 格式串哈希 + 最多 4 个整数参数) 到无锁环形缓冲区，
+//   不格式化、不碰 UART，耗时与日志内容无关
+// - 格式串本身不进固件：哈希在编译期算好，主机上的 tools/trace_decode.py 扫描源码里的
+//   TRACE_x("...") 重建 哈希 -> 格式串 的表，把串口收到的二进制帧还原成文本
+// - 低优先级的 drain 任务把记录编码成帧 (A5 5A + 记录 + CRC8) 写到串口，慢 UART 只会拖慢它自己
+// - 级别在编译期裁剪 (TRACE_LEVEL)，低于阈值的调用点不生成任何代码
+// - 参数只能是整数 / 枚举 / bool (按 32 位保存)，格式串只支持 %d %i %u %x %X %c；
+//   个数或类型不匹配在编译期报错
+// - 缓冲区满时丢弃新记录并计数，drain 会补一条 "丢了 N 条" 的记录
+
+#define TRACE_LEVEL_OFF 0
+#define TRACE_LEVEL_ERROR 1
+#define TRACE_LEVEL_WARN 2
+#define TRACE_LEVEL_INFO 3
+#define TRACE_LEVEL_DEBUG 4
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_LEVEL_INFO
+#endif
+
+// 环形缓冲区容量 (条，2 的幂)；256 条约 8KB
+#ifndef TRACE_RING_RECORDS
+#define TRACE_RING_RECORDS 256
+#endif
+
+namespace Trace
+{
+    static const uint8_t MAX_ARGS = 4;
+    static const uint32_t DROPPED_ID = 0; // 特殊记录：args[0] = 自上次以来丢弃的条数
+
+    struct Record
+    {
+        uint32_t timestampUs;
+        uint32_t formatId;
+        uint16_t seq; // 入队序号的低 16 位 (解码端据此发现串口丢帧)
+        uint8_t level;
+        uint8_t argc;
+        uint32_t args[MAX_ARGS];
+    };
+
+    // 线上帧：A5 5A + 28 字节小端记录 + CRC8(记录)
+    static const uint8_t SYNC0 = 0xA5;
+    static const uint8_t SYNC1 = 0x5A;
+    static const uint8_t RECORD_BYTES = 4 + 4 + 2 + 1 + 1 + 4 * MAX_ARGS;
+    static const uint8_t FRAME_BYTES = 2 + RECORD_BYTES + 1;
+
+    // 格式串哈希 (FNV-1a 32)，与 tools/trace_decode.py 一致
+    constexpr uint32_t formatId(const char *s)
+    {
+        uint32_t h = 2166136261u;
+        while (*s)
+        {
+            h ^= (uint8_t)*s++;
+            h *= 16777619u;
+        }
+        return h == DROPPED_ID ? 1 : h;
+    }
+
+    // 格式串需要的参数个数；有不支持的转换 (%s %f %p ...) 时返回 -1
+    constexpr int formatArgs(const char *s)
+    {
+        int n = 0;
+        while (*s)
+        {
+            if (*s++ != '%')
+                continue;
+            if (*s == '%')
+            {
+                s++;
+                continue;
+            }
+            while (*s == '-' || *s == '+' || *s == ' ' || *s == '#' || *s == '.' || (*s >= '0' && *s <= '9'))
+                s++;
+            while (*s == 'l' || *s == 'h' || *s == 'z')
+                s++;
+            if (!(*s == 'd' || *s == 'i' || *s == 'u' || *s == 'x' || *s == 'X' || *s == 'c'))
+                return -1;
+            s++;
+            n++;
+        }
+        return n;
+    }
+
+    // 只用于 sizeof 数参数个数 (不求值，参数可以是任意表达式)
+    template <typename... A>
+    char (&argPack(A &&...))[sizeof...(A) + 1];
+
+    template <typename T>
+    inline uint32_t toArg(T v)
+    {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "trace arguments must be integers, enums or bool");
+        return (uint32_t)v;
+    }
+
+    // 有界多生产者 / 单消费者无锁队列 (Vyukov)：
+    // 任何任务都能 push，只有 drain 任务 pop；每个槽的序号告诉双方它现在归谁
+    template <uint32_t N>
+    class Ring
+    {
+        static_assert(N >= 2 && (N & (N - 1)) == 0, "trace ring size must be a power of two");
+
+    private:
+        struct Cell
+        {
+            std::atomic<uint32_t> seq;
+            Record rec;
+        };
+        Cell cells[N];
+        std::atomic<uint32_t> head{0}; // 下一个写入位置
+        uint32_t tail = 0;             // 下一个读取位置 (只有消费者访问)
+        std::atomic<uint32_t> dropped{0};
+
+    public:
+        Ring() { clear(); }
+
+        // 只在没有生产者时调用 (启动 / 测试)
+        void clear()
+        {
+            for (uint32_t i = 0; i < N; i++)
+                cells[i].seq.store(i, std::memory_order_relaxed);
+            head.store(0, std::memory_order_relaxed);
+            tail = 0;
+            dropped.store(0, std::memory_order_relaxed);
+        }
+
+        bool push(const Record &r)
+        {
+            uint32_t pos = head.load(std::memory_order_relaxed);
+            Cell *c;
+            for (;;)
+            {
+                c = &cells[pos & (N - 1)];
+                int32_t dif = (int32_t)(c->seq.load(std::memory_order_acquire) - pos);
+                if (dif == 0)
+                {
+                    if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (dif < 0)
+                {
+                    dropped.fetch_add(1, std::memory_order_relaxed); // 满了：丢新的，不阻塞调用方
+                    return false;
+                }
+                else
+                {
+                    pos = head.load(std::memory_order_relaxed);
+                }
+            }
+            c->rec = r;
+            c->rec.seq = (uint16_t)pos;
+            c->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(Record &out)
+        {
+            Cell &c = cells[tail & (N - 1)];
+            if ((int32_t)(c.seq.load(std::memory_order_acquire) - (tail + 1)) < 0)
+                return false;
+            out = c.rec;
+            c.seq.store(tail + N, std::memory_order_release);
+            tail++;
+            return true;
+        }
+
+        bool empty() const
+        {
+            return (int32_t)(cells[tail & (N - 1)].seq.load(std::memory_order_acquire) - (tail + 1)) < 0;
+        }
+
+        // 取走丢弃计数 (drain 据此补一条记录)
+        uint32_t takeDropped() { return dropped.exchange(0, std::memory_order_relaxed); }
+    };
+
+    typedef Ring<TRACE_RING_RECORDS> DefaultRing;
+
+    // 全局环：ESP32 上所有任务共用一个；native 上每个线程一个 (和 HostHal 一样，一个线程就是一台设备)
+    inline DefaultRing &ring()
+    {
+#ifdef ARDUINO
+        static DefaultRing r;
+#else
+        static thread_local DefaultRing r;
+#endif
+        return r;
+    }
+
+    template <typename... A>
+    inline void emit(uint8_t level, uint32_t id, A... a)
+    {
+        static_assert(sizeof...(A) <= MAX_ARGS, "at most 4 trace arguments");
+        Record r;
+        r.timestampUs = (uint32_t)micros();
+        r.formatId = id;
+        r.seq = 0;
+        r.level = level;
+        r.argc = (uint8_t)sizeof...(A);
+        const uint32_t vals[MAX_ARGS + 1] = {toArg(a)...};
+        memcpy(r.args, vals, sizeof(r.args));
+        ring().push(r);
+    }
+
+    inline uint8_t crc8(const uint8_t *p, size_t n)
+    {
+        uint8_t crc = 0;
+        while (n--)
+        {
+            crc ^= *p++;
+            for (uint8_t i = 0; i < 8; i++)
+                crc = (uint8_t)(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+        return crc;
+    }
+
+    inline void put32(uint8_t *p, uint32_t v)
+    {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+        p[2] = (uint8_t)(v >> 16);
+        p[3] = (uint8_t)(v >> 24);
+    }
+
+    // 编码一帧 (固定 FRAME_BYTES 字节)
+    inline void encode(const Record &r, uint8_t *out)
+    {
+        out[0] = SYNC0;
+        out[1] = SYNC1;
+        uint8_t *p = out + 2;
+        put32(p, r.timestampUs);
+        put32(p + 4, r.formatId);
+        p[8] = (uint8_t)r.seq;
+        p[9] = (uint8_t)(r.seq >> 8);
+        p[10] = r.level;
+        p[11] = r.argc;
+        for (uint8_t i = 0; i < MAX_ARGS; i++)
+            put32(p + 12 + 4 * i, r.args[i]);
+        out[2 + RECORD_BYTES] = crc8(p, RECORD_BYTES);
+    }
+
+    // [drain 任务] 取出最多 maxRecords 条，编码后交给 write(const uint8_t*, size_t)
+    // 返回写出的帧数；有丢弃时先写一条 DROPPED_ID 记录
+    template <typename Write, uint32_t N>
+    uint16_t drain(Ring<N> &r, Write &&write, uint16_t maxRecords)
+    {
+        uint8_t frame[FRAME_BYTES];
+        uint16_t n = 0;
+        uint32_t lost = r.takeDropped();
+        if (lost)
+        {
+            Record d = {};
+            d.timestampUs = (uint32_t)micros();
+            d.formatId = DROPPED_ID;
+            d.level = TRACE_LEVEL_WARN;
+            d.argc = 1;
+            d.args[0] = lost;
+            encode(d, frame);
+            write(frame, FRAME_BYTES);
+            n++;
+        }
+        Record rec;
+        while (n < maxRecords && r.pop(rec))
+        {
+            encode(rec, frame);
+            write(frame, FRAME_BYTES);
+            n++;
+        }
+        return n;
+    }
+
+    template <typename Write>
+    uint16_t drain(Write &&write, uint16_t maxRecords)
+    {
+        return drain(ring(), write, maxRecords);
+    }
+}
+
+// 调用点：TRACE_I("[Watering] START Zone %d (Cycle %d / %d)", zone, cycle, max);
+// 格式串必须是字面量 (编译期哈希)；不需要结尾的 \n
+#define TRACE_AT_(level, fmt, ...)                                                                              \
+    do                                                                                                          \
+    {                                                                                                           \
+        static_assert(::Trace::formatArgs(fmt) == (int)sizeof(::Trace::argPack(__VA_ARGS__)) - 1,              \
+                      "trace: argument count mismatch or unsupported conversion (integers only: %d %u %x %c)"); \
+        constexpr uint32_t traceId_ = ::Trace::formatId(fmt);                                                   \
+        ::Trace::emit(level, traceId_, ##__VA_ARGS__);                                                          \
+    } while (0)
+
+// 裁剪掉的级别：不生成代码，只让参数保持 "被使用"，避免未使用变量的警告
+#define TRACE_OFF_(fmt, ...) ((void)sizeof(::Trace::argPack(__VA_ARGS__)))
+
+#if TRACE_LEVEL >= TRACE_LEVEL_ERROR
+#define TRACE_E(fmt, ...) TRACE_AT_(TRACE_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define TRACE_E(fmt, ...) TRACE_OFF_(fmt, ##__VA_ARGS__)
+#endif
+
+#if TRACE_LEVEL >= TRACE_LEVEL_WARN
+#define TRACE_W(fmt, ...) TRACE_AT_(TRACE_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define TRACE_W(fmt, ...) TRACE_OFF_(fmt, ##__VA_ARGS__)
+#endif
+
+#if TRACE_LEVEL >= TRACE_LEVEL_INFO
+#define TRACE_I(fmt, ...) TRACE_AT_(TRACE_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define TRACE_I(fmt, ...) TRACE_OFF_(fmt, ##__VA_ARGS__)
+#endif
+
+#if TRACE_LEVEL >= TRACE_LEVEL_DEBUG
+#define TRACE_D(fmt, ...) TRACE_AT_(TRACE_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define TRACE_D(fmt, ...) TRACE_OFF_(fmt, ##__VA_ARGS__)
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef EPOCH_TIME_H
+#define EPOCH_TIME_H
+
+#include <stdint.h>
+#include <time.h>
+
+// 纯算术的日历换算 (本地时间，不经过 mktime / 时区库)
+// "本地 epoch 秒" = 1970-01-01 00:00:00 (本地) 起的秒数
+namespace EpochTime
+{
+  const int32_t SECONDS_PER_DAY = 86400;
+
+  // 公历日期 -> 距 1970-01-01 的天数 (Howard Hinnant 的 days_from_civil)
+  inline int32_t daysFromCivil(int y, int m, int d)
+  {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;
+    const int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+  }
+
+  // struct tm -> epoch 天 (只用 tm_year + tm_yday，不依赖 tm_mon/tm_mday)
+  inline int32_t epochDay(const struct tm &t)
+  {
+    return daysFromCivil(t.tm_year + 1900, 1, 1) + t.tm_yday;
+  }
+
+  // struct tm -> 本地 epoch 秒
+  inline int64_t toLocalEpoch(const struct tm &t)
+  {
+    return (int64_t)epochDay(t) * SECONDS_PER_DAY +
+           t.tm_hour * 3600 + t.tm_min * 60 + t.tm_sec;
+  }
+
+  // 向下取整的除法 (负数 epoch 也正确)
+  inline int32_t dayOf(int64_t localEpoch)
+  {
+    return (int32_t)(localEpoch >= 0 ? localEpoch / SECONDS_PER_DAY
+                                     : (localEpoch - SECONDS_PER_DAY + 1) / SECONDS_PER_DAY);
+  }
+
+  inline int32_t secondOfDay(int64_t localEpoch)
+  {
+    return (int32_t)(localEpoch - (int64_t)dayOf(localEpoch) * SECONDS_PER_DAY);
+  }
+
+  // epoch 天 -> 公历日期 (days_from_civil 的逆运算)
+  inline void civilFromDays(int32_t z, int &y, int &m, int &d)
+  {
+    z += 719468;
+    const int era = (z >= 0 ? z : z - 146096) / 146097;
+    const int doe = z - era * 146097;
+    const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = yoe + era * 400 + (m <= 2);
+  }
+
+  // 星期几 (0 = 周日，与 tm_wday 一致)；1970-01-01 是周四
+  inline int weekday(int32_t day)
+  {
+    const int w = (day + 4) % 7;
+    return w < 0 ? w + 7 : w;
+  }
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef FLOW_DOSE_H
+#define FLOW_DOSE_H
+
+#include <stdint.h>
+
+// 流量计标定：每升多少个脉冲 (YF-S201 一类霍尔流量计约 450)
+#ifndef FLOW_PULSES_PER_LITRE
+#define FLOW_PULSES_PER_LITRE 450
+#endif
+
+// 水泵在转、这么久 (ms) 没有一个脉冲：判为断流 (水箱空了 / 管子脱落 / 流量计坏了)
+#ifndef FLOW_STALL_MS
+#define FLOW_STALL_MS 10000
+#endif
+
+// 按量浇水时两次读计数器的间隔范围 (ms)
+#ifndef FLOW_MIN_POLL_MS
+#define FLOW_MIN_POLL_MS 20
+#endif
+#ifndef FLOW_MAX_POLL_MS
+#define FLOW_MAX_POLL_MS 1000
+#endif
+
+// 一次浇水的流量计量 (纯逻辑，输入是累计脉冲数和 millis)
+// 1. begin()：记下起点计数；targetMl = 0 时只计量，由时长结束
+// 2. 控制任务每次醒来 update()，reached() / stalled() 决定是否提前停泵
+// 3. msUntilCheck()：按当前流速估计到量的时刻，只睡一半的路程 (越接近越密)，
+//    所以过冲不超过 FLOW_MIN_POLL_MS 的流量，而大部分时间任务仍在睡眠
+// 计数器是 32 位累计值，差值用无符号减法，回绕不影响
+class FlowDose
+{
+private:
+    static const uint32_t RATE_WINDOW_MS = 100;
+
+    uint32_t perLitre = FLOW_PULSES_PER_LITRE;
+    uint32_t startCount = 0;
+    uint32_t goalMl = 0;
+    uint32_t target = 0;     // 目标脉冲数 (0 = 不控制)
+    uint32_t pulses = 0;     // 本次已计脉冲
+    uint32_t lastMoveMs = 0; // 最近一次计数增加的时刻
+    uint32_t rateMs = 0;     // 流速估计窗口的起点
+    uint32_t ratePulses = 0;
+    uint32_t rateQ8 = 0;     // 流速估计 (脉冲/秒，Q8)；0 = 还不知道
+    bool active = false;
+
+public:
+    void begin(uint32_t pulsesPerLitre, uint32_t targetMl, uint32_t count, uint32_t nowMs)
+    {
+        perLitre = pulsesPerLitre > 0 ? pulsesPerLitre : FLOW_PULSES_PER_LITRE;
+        startCount = count;
+        goalMl = targetMl;
+        target = (uint32_t)(((uint64_t)targetMl * perLitre + 999) / 1000);
+        pulses = 0;
+        lastMoveMs = rateMs = nowMs;
+        ratePulses = 0;
+        rateQ8 = 0;
+        active = true;
+    }
+
+    void update(uint32_t count, uint32_t nowMs)
+    {
+        if (!active)
+            return;
+        uint32_t p = count - startCount;
+        if (p != pulses)
+        {
+            pulses = p;
+            lastMoveMs = nowMs;
+        }
+        // 每 RATE_WINDOW_MS 以上的一段算一次平均流速，和旧估计各占一半：
+        // 启动时管子充水的慢段很快被忘掉，窗口够长，脉冲的量化误差也不大
+        uint32_t dt = nowMs - rateMs;
+        if (dt >= RATE_WINDOW_MS)
+        {
+            uint32_t inst = (uint32_t)((uint64_t)(p - ratePulses) * 1000 * 256 / dt);
+            rateQ8 = rateQ8 ? (rateQ8 + inst) / 2 : inst;
+            ratePulses = p;
+            rateMs = nowMs;
+        }
+    }
+
+    void end() { active = false; }
+
+    bool metering() const { return active; }
+    bool targeted() const { return target > 0; }
+    bool reached() const { return target > 0 && pulses >= target; }
+    bool stalled(uint32_t nowMs) const { return active && nowMs - lastMoveMs >= FLOW_STALL_MS; }
+
+    uint32_t pulseCount() const { return pulses; }
+    uint32_t deliveredMl() const { return (uint32_t)((uint64_t)pulses * 1000 / perLitre); }
+    uint32_t targetMl() const { return goalMl; }
+
+    // 流速 (毫升/分钟)，还没测出时为 0
+    uint32_t flowMlPerMin() const { return (uint32_t)((uint64_t)rateQ8 * 60 * 1000 / perLitre >> 8); }
+
+    // 距离下一次需要读计数器的毫秒数 (不超过断流判定的截止时刻)
+    uint32_t msUntilCheck(uint32_t nowMs) const
+    {
+        if (!active)
+            return UINT32_MAX;
+        uint32_t sinceMove = nowMs - lastMoveMs;
+        uint32_t wait = sinceMove >= FLOW_STALL_MS ? 0 : FLOW_STALL_MS - sinceMove;
+        if (target == 0)
+            return wait;
+
+        uint32_t poll = FLOW_MAX_POLL_MS / 4; // 流速未知：先密一点地看
+        if (pulses >= target)
+            poll = 0;
+        else if (rateQ8 > 0)
+        {
+            uint64_t eta = (uint64_t)(target - pulses) * 1000 * 256 / rateQ8;
+            poll = eta / 2 > FLOW_MAX_POLL_MS ? FLOW_MAX_POLL_MS : (uint32_t)(eta / 2);
+            if (poll < FLOW_MIN_POLL_MS)
+                poll = FLOW_MIN_POLL_MS;
+        }
+        return poll < wait ? poll : wait;
+    }
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef PUMP_STATE_MACHINE_H
+#define PUMP_STATE_MACHINE_H
+
+#include <stdint.h>
+
+// 水泵运行阶段：Idle -> Starting -> Running -> Stopping -> Idle
+enum class PumpState : uint8_t
+{
+  Idle,     // 空闲，继电器断开
+  Starting, // 已接受启动请求，下一个 tick 吸合继电器
+  Running,  // 继电器吸合，计时中
+  Stopping  // 继电器已断开，下一个 tick 结算并回到 Idle
+};
+
+// tick() 的返回值：告诉上层这一拍发生了什么
+enum class PumpEvent : uint8_t
+{
+  None,
+  Started,  // 继电器刚吸合
+  Finished, // 正常跑满时长
+  Aborted   // 中途被 stop
+};
+
+// 纯逻辑的非阻塞水泵状态机 (基于 millis 时间戳，不依赖硬件)
+// 上层每个 loop 调用一次 tick(now)，再根据 relayOn() 驱动引脚
+class PumpStateMachine
+{
+private:
+  PumpState state = PumpState::Idle;
+  uint32_t durationMs = 0;
+  uint32_t runStartMs = 0;
+  uint32_t elapsedMs = 0;
+  bool stopRequested = false;
+
+public:
+  // 请求启动，非 Idle 时拒绝 (由上层做忙碌锁提示)
+  bool start(uint32_t duration)
+  {
+    if (state != PumpState::Idle)
+      return false;
+
+    durationMs = duration;
+    elapsedMs = 0;
+    stopRequested = false;
+    state = PumpState::Starting;
+    return true;
+  }
+
+  // 请求停止：Running 状态立即切到 Stopping (继电器马上断开)，
+  // 不必等下一个 tick，这样 stop 延迟只取决于调用方
+  void requestStop(uint32_t now)
+  {
+    if (state == PumpState::Starting)
+    {
+      // 还没吸合就被取消：直接进入结算
+      stopRequested = true;
+      elapsedMs = 0;
+      state = PumpState::Stopping;
+    }
+    else if (state == PumpState::Running)
+    {
+      stopRequested = true;
+      elapsedMs = now - runStartMs;
+      state = PumpState::Stopping;
+    }
+  }
+
+  // 提前正常结束 (流量计已经量够)：和 requestStop 一样立即断开继电器，但结算为 Finished
+  void complete(uint32_t now)
+  {
+    if (state != PumpState::Running)
+      return;
+    elapsedMs = now - runStartMs;
+    state = PumpState::Stopping;
+  }
+
+  // 推进状态机，每次只做 O(1) 的工作，永不阻塞
+  PumpEvent tick(uint32_t now)
+  {
+    switch (state)
+    {
+    case PumpState::Starting:
+      runStartMs = now;
+      state = PumpState::Running;
+      return PumpEvent::Started;
+
+    case PumpState::Running:
+      // 无符号减法，millis() 溢出 (约 49 天) 也能正确计时
+      if (now - runStartMs >= durationMs)
+      {
+        elapsedMs = now - runStartMs;
+        state = PumpState::Stopping;
+      }
+      return PumpEvent::None;
+
+    case PumpState::Stopping:
+      state = PumpState::Idle;
+      return stopRequested ? PumpEvent::Aborted : PumpEvent::Finished;
+
+    case PumpState::Idle:
+    default:
+      return PumpEvent::None;
+    }
+  }
+
+  PumpState getState() const { return state; }
+  bool isIdle() const { return state == PumpState::Idle; }
+  bool relayOn() const { return state == PumpState::Running; }
+
+  // 本次实际运行时长 (Stopping 之后有效)
+  uint32_t getElapsedMs() const { return elapsedMs; }
+
+  // 距离下一次需要 tick 的毫秒数：Idle 没有工作 (UINT32_MAX)，
+  // Starting/Stopping 要立刻推进 (0)，Running 等到时长结束
+  uint32_t msUntilNextTick(uint32_t now) const
+  {
+    switch (state)
+    {
+    case PumpState::Running:
+    {
+      uint32_t elapsed = now - runStartMs;
+      return elapsed >= durationMs ? 0 : durationMs - elapsed;
+    }
+    case PumpState::Starting:
+    case PumpState::Stopping:
+      return 0;
+    case PumpState::Idle:
+    default:
+      return UINT32_MAX;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef RUN_EVENT_H
+#define RUN_EVENT_H
+
+#include <stdint.h>
+
+// 手动运行 (start N) 的时长上限 (秒)：文本 / 二进制指令解析和 forceWatering() 都拒绝更长的
+// 也保证 N × 1000 毫秒在 32 位上不溢出、事件和历史里的 u16 秒数不截断
+#ifndef WATERING_MAX_MANUAL_SEC
+#define WATERING_MAX_MANUAL_SEC 3600
+#endif
+static_assert(WATERING_MAX_MANUAL_SEC > 0 && WATERING_MAX_MANUAL_SEC <= 0xFFFF, "WATERING_MAX_MANUAL_SEC must fit the u16 durationSec");
+
+// 结构化的运行事件：和文本通知在同一处产生，给二进制协议 (WireProtocol) 用，后台不必再解析文本
+// 数值只用定长整数，事件对象可以按值放进 SPSC 队列
+enum class RunEventKind : uint8_t
+{
+    Started = 1,   // 继电器吸合；aux = 目标水量 (mL，0 = 按时长)
+    Done = 2,      // 正常结束；durationSec / volumeMl 为实际值，aux = 目标水量
+    Aborted = 3,   // 中途停泵 (stop / 升级 / 失去供电名额 / 断流)
+    Skipped = 4,   // 土还湿，跳过计划；aux = 湿度 (千分比)
+    Missed = 5,    // 错过计划；aux = 次数，durationSec = 迟到分钟数
+    Queued = 6,    // 手动运行在等供电名额
+    Cancelled = 7, // 排队的手动运行被 stop 取消
+    Rejected = 8,  // 指令被拒绝；aux = RejectReason
+    Killed = 9,
+    Revived = 10,
+    Reset = 11
+};
+
+enum class RejectReason : uint8_t
+{
+    UnknownZone = 1,
+    NoFlowMeter = 2,
+    Updating = 3, // 固件升级中
+    Busy = 4,
+    NotWatering = 5,
+    TooLong = 6 // 手动时长超过 WATERING_MAX_MANUAL_SEC
+};
+
+struct RunEvent
+{
+    static const uint8_t NO_ZONE = 0xFF;
+    static const uint8_t FLAG_MANUAL = 0x01;
+    static const uint8_t FLAG_CAPPED = 0x02;  // 按量运行到了时长上限
+    static const uint8_t FLAG_NO_FLOW = 0x04; // 因断流中止
+
+    RunEventKind kind = RunEventKind::Started;
+    uint8_t zone = NO_ZONE;
+    uint8_t flags = 0;
+    uint16_t cycle = 0;       // 第几次 (从 1 开始，和文本通知里的 [5/18] 一致)
+    uint16_t maxCycles = 0;
+    uint16_t durationSec = 0;
+    int32_t volumeMl = -1;    // 实际水量，没有流量计为 -1
+    uint32_t aux = 0;         // 含义见 RunEventKind
+};
+
+#endif
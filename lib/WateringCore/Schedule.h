@@ -0,0 +1,332 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdint.h>
+#include "EpochTime.h"
+
+// 编译后的浇水日历 (类似 cron)：所有规则在构造时展开成位图，匹配只是几次位测试
+// - 开始时刻：1440 位的分钟位图，一天可以有多个时刻；另有 23 位的 "哪些字非空" 摘要，
+//   找下一个时刻只要两次 ctz，与时刻数量无关
+// - 星期：7 位 (bit0 = 周日，与 tm_wday 一致)
+// - 季节窗口：按 "月-日" 编号 ((月-1)*31 + 日-1) 的 372 位图，与闰年无关，可以跨年
+// - 间隔：距上次自动浇水至少 N 个 epoch 天 (同一天的其它时刻不受限)
+// 构造和 parse() 都是 constexpr：来自 build flag 的计划在编译期展开，写错了直接 static_assert
+//
+// 文本格式 (空格分隔，顺序任意，大小写不敏感)：
+//   06:00,18:30      开始时刻 (必填)
+//   mon-fri,sun      星期 (默认每天；daily / * 也表示每天)
+//   apr-oct          月份窗口 (nov-feb 跨年)
+//   05-15..09-30     日期窗口 (月-日)，可以写多个
+//   /3d              间隔天数 (默认 1)
+class Schedule
+{
+public:
+    static const int MINUTES_PER_DAY = 1440;
+    static const uint8_t ALL_WEEKDAYS = 0x7F;
+    static const int SEARCH_DAYS = 4 * 366 + 7; // 最坏情况 (只有 2 月 29 日) 也能找到
+
+private:
+    static const int MINUTE_WORDS = (MINUTES_PER_DAY + 63) / 64; // 23
+    static const int DATE_BITS = 12 * 31;
+    static const int DATE_WORDS = (DATE_BITS + 63) / 64; // 6
+
+    uint64_t minutes[MINUTE_WORDS] = {};
+    uint32_t minuteWords = 0; // bit w = minutes[w] 非空
+    uint64_t dates[DATE_WORDS] = {};
+    bool anyWindow = false;   // 没有窗口 = 全年
+    uint8_t weekdayMask = ALL_WEEKDAYS;
+    uint16_t interval = 1;
+    bool valid = true;
+
+    static constexpr int dateIndex(int month, int day) { return (month - 1) * 31 + (day - 1); }
+
+    constexpr void setMinute(int m)
+    {
+        minutes[m >> 6] |= 1ULL << (m & 63);
+        minuteWords |= 1UL << (m >> 6);
+    }
+
+    constexpr void setDate(int idx) { dates[idx >> 6] |= 1ULL << (idx & 63); }
+
+    // [from, to] 闭区间，to < from 时跨年
+    constexpr void addWindow(int from, int to)
+    {
+        anyWindow = true;
+        for (int i = from;; i = (i + 1) % DATE_BITS)
+        {
+            setDate(i);
+            if (i == to)
+                break;
+        }
+    }
+
+    // ---- parse() 用到的字符工具 ----
+    static constexpr char lower(char c) { return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c; }
+    static constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    static constexpr bool isSep(char c) { return c == ' ' || c == '\t' || c == '\0'; }
+
+    // 读一个十进制数，最多 maxDigits 位；失败返回 -1
+    static constexpr int number(const char *s, int &i, int maxDigits)
+    {
+        int v = 0, n = 0;
+        while (isDigit(s[i]) && n < maxDigits)
+            v = v * 10 + (s[i++] - '0'), n++;
+        return n ? v : -1;
+    }
+
+    // 读一个三字母名字：星期返回 0..6，月份返回 100 + 1..12，否则 -1
+    static constexpr int name(const char *s, int &i)
+    {
+        const char *week = "sunmontuewedthufrisat";
+        const char *month = "janfebmaraprmayjunjulaugsepoctnovdec";
+        char a = lower(s[i]), b = a ? lower(s[i + 1]) : 0, c = b ? lower(s[i + 2]) : 0;
+        for (int k = 0; k < 7; k++)
+            if (week[k * 3] == a && week[k * 3 + 1] == b && week[k * 3 + 2] == c)
+                return i += 3, k;
+        for (int k = 0; k < 12; k++)
+            if (month[k * 3] == a && month[k * 3 + 1] == b && month[k * 3 + 2] == c)
+                return i += 3, 101 + k;
+        return -1;
+    }
+
+    static constexpr int daysInMonth(int m) { return m == 2 ? 29 : (m == 4 || m == 6 || m == 9 || m == 11) ? 30 : 31; }
+
+    // "MM-DD"：返回日期编号，失败 -1
+    static constexpr int monthDay(const char *s, int &i)
+    {
+        int m = number(s, i, 2);
+        if (m < 1 || m > 12 || s[i] != '-')
+            return -1;
+        i++;
+        int d = number(s, i, 2);
+        if (d < 1 || d > daysInMonth(m))
+            return -1;
+        return dateIndex(m, d);
+    }
+
+    // 解析一个 token，返回 token 之后的位置；出错时把 valid 置 false
+    constexpr int parseToken(const char *s, int i)
+    {
+        int start = i;
+        bool hasColon = false, hasDots = false;
+        for (int k = i; !isSep(s[k]); k++)
+        {
+            hasColon = hasColon || s[k] == ':';
+            hasDots = hasDots || (s[k] == '.' && s[k + 1] == '.');
+        }
+
+        if (s[i] == '/')
+        {
+            // 间隔："/3" 或 "/3d"
+            i++;
+            int n = number(s, i, 3);
+            if (lower(s[i]) == 'd')
+                i++;
+            if (n < 1)
+                valid = false;
+            else
+                interval = (uint16_t)n;
+        }
+        else if (hasColon)
+        {
+            // 时刻列表："06:00,18:30"
+            for (;;)
+            {
+                int h = number(s, i, 2);
+                if (s[i] != ':')
+                    return valid = false, i;
+                i++;
+                int m = number(s, i, 2);
+                if (h < 0 || h > 23 || m < 0 || m > 59)
+                    return valid = false, i;
+                setMinute(h * 60 + m);
+                if (s[i] != ',')
+                    break;
+                i++;
+            }
+        }
+        else if (hasDots)
+        {
+            // 日期窗口："05-15..09-30"
+            int from = monthDay(s, i);
+            if (from < 0 || s[i] != '.' || s[i + 1] != '.')
+                return valid = false, i;
+            i += 2;
+            int to = monthDay(s, i);
+            if (to < 0)
+                return valid = false, i;
+            addWindow(from, to);
+        }
+        else if (s[i] == '*' || (lower(s[i]) == 'd' && lower(s[i + 1]) == 'a' && lower(s[i + 2]) == 'i' &&
+                                 lower(s[i + 3]) == 'l' && lower(s[i + 4]) == 'y'))
+        {
+            i += s[i] == '*' ? 1 : 5;
+            weekdayMask = ALL_WEEKDAYS;
+        }
+        else
+        {
+            // 名字列表："mon-fri,sun" / "apr-oct"
+            uint8_t days = 0;
+            for (;;)
+            {
+                int a = name(s, i);
+                int b = a;
+                if (s[i] == '-')
+                {
+                    i++;
+                    b = name(s, i);
+                }
+                if (a < 0 || b < 0 || (a >= 100) != (b >= 100))
+                    return valid = false, i;
+                if (a >= 100)
+                    addWindow(dateIndex(a - 100, 1), dateIndex(b - 100, daysInMonth(b - 100)));
+                else
+                    for (int k = a;; k = (k + 1) % 7)
+                    {
+                        days |= (uint8_t)(1 << k);
+                        if (k == b)
+                            break;
+                    }
+                if (s[i] != ',')
+                    break;
+                i++;
+            }
+            if (days)
+                weekdayMask = days;
+        }
+
+        if (!isSep(s[i]) || i == start)
+            valid = false;
+        return i;
+    }
+
+    static int ctz64(uint64_t v) { return __builtin_ctzll(v); }
+    static int ctz32(uint32_t v) { return __builtin_ctz(v); }
+
+public:
+    constexpr Schedule() {}
+
+    // 每天一个时刻 (旧版 hour/min 配置)
+    static constexpr Schedule daily(int hour, int min)
+    {
+        Schedule s;
+        return s.at(hour, min);
+    }
+
+    // 解析文本计划；格式错误时 isValid() 为 false
+    static constexpr Schedule parse(const char *text)
+    {
+        Schedule s;
+        int i = 0;
+        while (s.valid && text[i])
+        {
+            if (text[i] == ' ' || text[i] == '\t')
+                i++;
+            else
+                i = s.parseToken(text, i);
+        }
+        if (!s.minuteWords)
+            s.valid = false;
+        return s;
+    }
+
+    // ---- 构造器 (返回新对象，可以串起来用在 constexpr 里) ----
+    constexpr Schedule at(int hour, int min) const
+    {
+        Schedule s = *this;
+        if (hour < 0 || hour > 23 || min < 0 || min > 59)
+            s.valid = false;
+        else
+            s.setMinute(hour * 60 + min);
+        return s;
+    }
+
+    // 星期位图 (bit0 = 周日)
+    constexpr Schedule on(uint8_t mask) const
+    {
+        Schedule s = *this;
+        s.weekdayMask = mask & ALL_WEEKDAYS;
+        if (!s.weekdayMask)
+            s.valid = false;
+        return s;
+    }
+
+    // 日期窗口 [fromMonth-fromDay, toMonth-toDay]，可以跨年；可多次调用
+    constexpr Schedule season(int fromMonth, int fromDay, int toMonth, int toDay) const
+    {
+        Schedule s = *this;
+        if (fromMonth < 1 || fromMonth > 12 || toMonth < 1 || toMonth > 12 ||
+            fromDay < 1 || fromDay > daysInMonth(fromMonth) || toDay < 1 || toDay > daysInMonth(toMonth))
+            s.valid = false;
+        else
+            s.addWindow(dateIndex(fromMonth, fromDay), dateIndex(toMonth, toDay));
+        return s;
+    }
+
+    constexpr Schedule every(int days) const
+    {
+        Schedule s = *this;
+        s.interval = (uint16_t)(days > 0 ? days : 1);
+        return s;
+    }
+
+    // ---- 查询 ----
+    constexpr bool isValid() const { return valid && minuteWords != 0; }
+    constexpr int intervalDays() const { return interval; }
+    constexpr uint8_t weekdays() const { return weekdayMask; }
+    constexpr bool hasSeason() const { return anyWindow; }
+
+    constexpr bool hasMinute(int m) const
+    {
+        return m >= 0 && m < MINUTES_PER_DAY && ((minutes[m >> 6] >> (m & 63)) & 1);
+    }
+
+    int timesPerDay() const
+    {
+        int n = 0;
+        for (int w = 0; w < MINUTE_WORDS; w++)
+            n += __builtin_popcountll(minutes[w]);
+        return n;
+    }
+
+    // >= from 的第一个开始时刻 (一天中的分钟)，没有返回 -1
+    int nextMinute(int from) const
+    {
+        if (from < 0)
+            from = 0;
+        if (from >= MINUTES_PER_DAY)
+            return -1;
+        int w = from >> 6;
+        uint64_t bits = minutes[w] & (~0ULL << (from & 63));
+        if (bits)
+            return (w << 6) + ctz64(bits);
+        uint32_t rest = minuteWords & ~((2UL << w) - 1); // w 之后的非空字
+        if (!rest)
+            return -1;
+        w = ctz32(rest);
+        return (w << 6) + ctz64(minutes[w]);
+    }
+
+    int firstMinute() const { return nextMinute(0); }
+
+    // 这一天是否允许浇水 (星期 + 季节窗口)
+    bool dayMatches(int32_t day) const
+    {
+        if (!((weekdayMask >> EpochTime::weekday(day)) & 1))
+            return false;
+        if (!anyWindow)
+            return true;
+        int y = 0, m = 0, d = 0;
+        EpochTime::civilFromDays(day, y, m, d);
+        int idx = dateIndex(m, d);
+        return (dates[idx >> 6] >> (idx & 63)) & 1;
+    }
+
+    // 本地 epoch 秒是否落在某个开始时刻的那一分钟里
+    bool matches(int64_t localEpoch) const
+    {
+        return hasMinute(EpochTime::secondOfDay(localEpoch) / 60) && dayMatches(EpochTime::dayOf(localEpoch));
+    }
+};
+
+#endif
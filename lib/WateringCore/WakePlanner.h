@@ -0,0 +1,34 @@
+#ifndef WAKE_PLANNER_H
+#define WAKE_PLANNER_H
+
+#include <stdint.h>
+
+// 控制任务的睡眠时长计算 (纯逻辑)
+// 下一次醒来 = min(水泵状态机的下一个截止时刻, 下一次计划触发的整秒边界, 上限)
+namespace WakePlanner
+{
+    // timeKnown:     是否已有可信的本地时间
+    // nowEpoch / ms: 当前本地 epoch 秒，以及这一秒里已经过去的毫秒
+    // nextFireAt:    调度堆顶的触发时刻 (INT64_MAX 表示没有)
+    // pumpMs:        PumpStateMachine::msUntilNextTick 的最小值 (UINT32_MAX 表示没有水泵在跑)
+    // maxSleepMs:    单次最长睡眠 (喂狗 / 时间同步)
+    inline uint32_t sleepMs(bool timeKnown, int64_t nowEpoch, uint16_t ms,
+                            int64_t nextFireAt, uint32_t pumpMs, uint32_t maxSleepMs)
+    {
+        uint32_t wait = pumpMs < maxSleepMs ? pumpMs : maxSleepMs;
+
+        // 已经过期的触发时刻不参与：它在等并发名额，运行中水泵的截止时刻会叫醒我们
+        // 比上限还远的 (包括 NEVER) 直接跳过，避免秒数乘 1000 溢出
+        if (timeKnown && nextFireAt > nowEpoch && nextFireAt - nowEpoch <= (int64_t)(wait / 1000) + 1)
+        {
+            int64_t untilFire = (nextFireAt - nowEpoch) * 1000 - ms;
+            if (untilFire < 0)
+                untilFire = 0;
+            if (untilFire < (int64_t)wait)
+                wait = (uint32_t)untilFire;
+        }
+        return wait;
+    }
+}
+
+#endif
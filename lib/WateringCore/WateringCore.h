@@ -1,27 +1,52 @@
 #ifndef WATERING_CORE_H
 #define WATERING_CORE_H
 
+#include <stdint.h>
+#include "EpochTime.h"
+#include "Schedule.h"
+
+// 控制循环停顿 (联网 / 对时阻塞、断电重启) 跨过了开始时刻时的处理方式
+enum class MissedFirePolicy : uint8_t
+{
+  RunLate, // 补跑窗口内的最后一次补跑，更早的记为错过并通知
+  Skip,    // 全部记为错过，只计数
+  Report,  // 全部记为错过，计数并通知
+};
+
 class WateringLogic
 {
 public:
-  int targetHour;
-  int targetMin;
-  int intervalDays;
+  // 从未浇过水的哨兵值
+  static const int32_t NEVER_WATERED = -999;
+  // 不再触发 (次数用完)
+  static const int64_t NEVER = INT64_MAX;
+  // 一次结算最多逐个清点的错过次数 (停机数年也不会卡住控制循环)
+  static const uint16_t MAX_CATCH_UP = 4096;
+
+  // 土壤湿度 (千分比，0 = 全干，1000 = 泡在水里)
+  static const int16_t MOISTURE_UNKNOWN = -1; // 没有探头 / 探头故障
+  static const int16_t MOISTURE_OFF = -1;     // 不看湿度，只按时钟
+
+  Schedule schedule;
   int maxCycles;
+  int16_t moistureThreshold = MOISTURE_OFF; // 计划到点时湿度不低于它就跳过这一次
 
+  // 旧配置：每天 hour:min，间隔 interval 天
   WateringLogic(int hour, int min, int interval, int max)
-  {
-    targetHour = hour;
-    targetMin = min;
-    intervalDays = interval;
-    maxCycles = max;
-  }
+      : schedule(Schedule::daily(hour, min).every(interval)), maxCycles(max) {}
+
+  WateringLogic(const Schedule &s, int max) : schedule(s), maxCycles(max) {}
+
+  // 第一个开始时刻 (日志 / 上报用)
+  int targetHour() const { return schedule.firstMinute() / 60; }
+  int targetMin() const { return schedule.firstMinute() % 60; }
+  int intervalDays() const { return schedule.intervalDays(); }
 
   // 核心判断函数
-  bool shouldStart(int currentHour, int currentMin, int currentDayOfYear,
-                   int wateredCount, int lastWateredDay, bool hasWateredToday)
+  // now 为本地 epoch 秒，lastWateredEpochDay 为上次自动浇水的 epoch 天 (EpochTime::dayOf)
+  // 用 epoch 天相减，跨年 / 闰年都不需要特殊处理
+  bool shouldStart(int64_t now, int wateredCount, int32_t lastWateredEpochDay, bool hasFiredThisSlot) const
   {
-
     if (wateredCount >= maxCycles)
       return false;
     // MTEST:START测试
@@ -30,22 +55,93 @@ public:
       return true;
     #endif
     // MTEST:END测试结束
-    if (currentHour != targetHour || currentMin != targetMin)
+    if (!schedule.matches(now))
       return false;
-    if (hasWateredToday)
+    if (hasFiredThisSlot)
       return false;
-    if (lastWateredDay == -999)
+    if (lastWateredEpochDay == NEVER_WATERED)
       return true;
 
-    int daysDiff = currentDayOfYear - lastWateredDay;
-    if (daysDiff < 0)
-      daysDiff += 365; // 跨年处理
+    // 同一天的其它开始时刻不受间隔限制
+    int32_t daysDiff = EpochTime::dayOf(now) - lastWateredEpochDay;
+    return daysDiff == 0 || daysDiff >= schedule.intervalDays();
+  }
 
-    if (daysDiff >= intervalDays)
+  // 计划到点后的湿度条件：土还够湿就不浇 (不计次数，不算浇过，下一个时刻再看)
+  // 读不到湿度时照常浇：宁可多浇一次，也不能因为探头坏了把植物旱死
+  bool soilNeedsWater(int16_t moisture) const
+  {
+    if (moistureThreshold == MOISTURE_OFF || moisture == MOISTURE_UNKNOWN)
       return true;
+    return moisture < moistureThreshold;
+  }
 
-    return false;
+  // 预先计算下一次触发时刻 (本地 epoch 秒，>= now)，次数用完或计划永远不匹配返回 NEVER
+  // 调度器只需比较这个时刻，不必每秒询问 shouldStart
+  int64_t nextFireTime(int64_t now, int wateredCount, int32_t lastWateredEpochDay) const
+  {
+    if (wateredCount >= maxCycles)
+      return NEVER;
+    // MTEST:START测试
+    #ifdef SYSTEM_MANUAL_TEST
+    if (SYSTEM_MANUAL_TEST)
+      return now;
+    #endif
+    // MTEST:END测试结束
+
+    if (schedule.firstMinute() < 0)
+      return NEVER;
+
+    int32_t day = EpochTime::dayOf(now);
+    // 当前分钟之内 (hh:mm:00 ~ hh:mm:59) 仍可触发；刚浇过的那一天只看之后的时刻
+    int from = EpochTime::secondOfDay(now) / 60;
+    if (day == lastWateredEpochDay)
+      from++;
+
+    // 1. 间隔约束：跳到最早允许的那一天
+    // 2. 逐天查星期 / 季节位图，当天用 nextMinute 直接取下一个时刻
+    // 最坏情况 (例如只有 2 月 29 日) 也在 SEARCH_DAYS 天内结束
+    const int interval = schedule.intervalDays();
+    for (int i = 0; i < Schedule::SEARCH_DAYS; i++, day++, from = 0)
+    {
+      if (lastWateredEpochDay != NEVER_WATERED && day != lastWateredEpochDay && day < lastWateredEpochDay + interval)
+      {
+        day = lastWateredEpochDay + interval;
+        from = 0;
+      }
+      if (!schedule.dayMatches(day))
+        continue;
+      int minute = schedule.nextMinute(from);
+      if (minute < 0)
+        continue;
+      int64_t fireAt = (int64_t)day * EpochTime::SECONDS_PER_DAY + minute * 60;
+      return fireAt < now ? now : fireAt;
+    }
+    return NEVER;
+  }
+
+  // 结算停顿期间落下的开始时刻：调度器第一次看到 fireAt 时 (now >= fireAt) 调用
+  // - 还在目标分钟之内 (now < f + 60) 的是准时，直接返回
+  // - 迟到的时刻里，只有最后一个且 f >= runLateFrom 时补跑 (多次停顿只补一次)，其余记入 missed
+  // 返回要立即执行的时刻 (<= now)，或者下一个未来的时刻 / NEVER
+  int64_t catchUp(int64_t fireAt, int64_t now, int wateredCount, int32_t lastWateredEpochDay,
+                  int64_t runLateFrom, uint32_t &missed) const
+  {
+    missed = 0;
+    int64_t f = fireAt;
+    while (f <= now)
+    {
+      if (now < f + 60)
+        return f;
+      int64_t next = missed < MAX_CATCH_UP ? nextFireTime(f + 60, wateredCount, lastWateredEpochDay)
+                                           : nextFireTime(now, wateredCount, lastWateredEpochDay);
+      if (next > now && f >= runLateFrom)
+        return f;
+      missed++;
+      f = next;
+    }
+    return f;
   }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,158 @@
+#ifndef ZONE_SCHEDULER_H
+#define ZONE_SCHEDULER_H
+
+#include <stdint.h>
+
+// 多区域调度器：按 "下一次触发时刻" 排序的索引最小堆
+// - nextFireAt() / popDue() 看堆顶，每个 tick 的开销是 O(1)，与区域数无关
+// - 只有真正到期的区域才会被弹出，重新排期是 O(log n)
+// 容量在编译期确定，不做任何堆内存分配
+template <uint16_t CAPACITY>
+class ZoneScheduler
+{
+public:
+  static const int64_t NEVER = INT64_MAX;
+
+private:
+  struct Entry
+  {
+    int64_t fireAt;
+    uint16_t zone;
+  };
+
+  Entry heap[CAPACITY];
+  int32_t pos[CAPACITY]; // zone -> 堆下标，-1 表示未排期
+  uint16_t count = 0;
+
+  // 同一时刻到期时，编号小的区域优先 (结果确定)
+  static bool before(const Entry &a, const Entry &b)
+  {
+    return a.fireAt < b.fireAt || (a.fireAt == b.fireAt && a.zone < b.zone);
+  }
+
+  void place(int32_t i, const Entry &e)
+  {
+    heap[i] = e;
+    pos[e.zone] = i;
+  }
+
+  void siftUp(int32_t i)
+  {
+    Entry e = heap[i];
+    while (i > 0)
+    {
+      int32_t parent = (i - 1) / 2;
+      if (!before(e, heap[parent]))
+        break;
+      place(i, heap[parent]);
+      i = parent;
+    }
+    place(i, e);
+  }
+
+  void siftDown(int32_t i)
+  {
+    Entry e = heap[i];
+    while (true)
+    {
+      int32_t child = 2 * i + 1;
+      if (child >= count)
+        break;
+      if (child + 1 < count && before(heap[child + 1], heap[child]))
+        child++;
+      if (!before(heap[child], e))
+        break;
+      place(i, heap[child]);
+      i = child;
+    }
+    place(i, e);
+  }
+
+  void removeAt(int32_t i)
+  {
+    uint16_t zone = heap[i].zone;
+    count--;
+    if (i != count)
+    {
+      // 用末尾元素填洞，再向下或向上调整
+      uint16_t moved = heap[count].zone;
+      place(i, heap[count]);
+      siftDown(i);
+      if (pos[moved] == i)
+        siftUp(i);
+    }
+    pos[zone] = -1;
+  }
+
+public:
+  ZoneScheduler()
+  {
+    for (uint16_t i = 0; i < CAPACITY; i++)
+      pos[i] = -1;
+  }
+
+  // 插入或更新区域的触发时刻；NEVER 等同于取消
+  void schedule(uint16_t zone, int64_t fireAt)
+  {
+    if (zone >= CAPACITY)
+      return;
+    if (fireAt == NEVER)
+    {
+      cancel(zone);
+      return;
+    }
+
+    int32_t i = pos[zone];
+    if (i < 0)
+    {
+      i = count++;
+      place(i, Entry{fireAt, zone});
+      siftUp(i);
+    }
+    else
+    {
+      int64_t old = heap[i].fireAt;
+      heap[i].fireAt = fireAt;
+      if (fireAt < old)
+        siftUp(i);
+      else
+        siftDown(i);
+    }
+  }
+
+  void cancel(uint16_t zone)
+  {
+    if (zone < CAPACITY && pos[zone] >= 0)
+      removeAt(pos[zone]);
+  }
+
+  bool isScheduled(uint16_t zone) const { return zone < CAPACITY && pos[zone] >= 0; }
+
+  int64_t fireAtOf(uint16_t zone) const
+  {
+    return isScheduled(zone) ? heap[pos[zone]].fireAt : NEVER;
+  }
+
+  // 最近的触发时刻 (O(1))
+  int64_t nextFireAt() const { return count ? heap[0].fireAt : NEVER; }
+
+  // 堆顶已到期则弹出并返回 true，否则 O(1) 返回 false
+  bool popDue(int64_t now, uint16_t &zone)
+  {
+    if (count == 0 || heap[0].fireAt > now)
+      return false;
+    zone = heap[0].zone;
+    removeAt(0);
+    return true;
+  }
+
+  uint16_t size() const { return count; }
+  void clear()
+  {
+    for (uint16_t i = 0; i < count; i++)
+      pos[heap[i].zone] = -1;
+    count = 0;
+  }
+};
+
+#endif
@@ -1,10 +1,207 @@
 #ifndef WATERING_SYSTEM_H
 #define WATERING_SYSTEM_H
 
-#include <Arduino.h>
-#include <Preferences.h>
 #include <functional>
+#include "../Hal/Hal.h" // 时间 / GPIO / Preferences / Serial (native 下为虚拟时钟实现)
 #include "../WateringCore/WateringCore.h" // 引用之前的逻辑大脑
+#include "../WateringCore/PumpStateMachine.h" // 非阻塞水泵状态机
+#include "../WateringCore/ZoneScheduler.h" // 多区域下一次触发时刻的最小堆
+#include "../WateringCore/FlowDose.h" // 按流量计量 / 定量浇水
+#include "../WateringCore/RunEvent.h" // 结构化运行事件 (二进制协议)
+#include "../WireProtocol/WireProtocol.h" // 二进制状态帧
+#include "../FlowMeter/FlowMeter.h" // 流量计脉冲计数器 (PCNT / 模拟)
+#include "../JsonWriter/JsonWriter.h" // 流式 JSON 输出
+#include "../StateJournal/StateJournal.h" // 追加写的状态日志
+#include "../StateJournal/PartitionFlash.h"
+#include "../HistoryLog/HistoryLog.h" // 浇水历史
+#include "../Metrics/Metrics.h" // 延迟指标 (WATERING_METRICS 未定义时为空)
+#include "../Trace/Trace.h" // 运行期日志 (二进制，延迟写出)
+
+// 单个控制器最多支持的区域 (继电器) 数量
+#ifndef WATERING_MAX_ZONES
+#define WATERING_MAX_ZONES 64
+#endif
+
+// 默认补跑窗口：开始时刻过去不超过这么久 (秒) 仍然补跑 (MissedFirePolicy::RunLate)
+#ifndef WATERING_RUN_LATE_SEC
+#define WATERING_RUN_LATE_SEC 7200
+#endif
+
+// 定量浇水 (按毫升) 的默认时长上限 (秒)：流量计坏了或流速太小也不会一直浇下去
+#ifndef WATERING_DOSE_CAP_SEC
+#define WATERING_DOSE_CAP_SEC 300
+#endif
+
+// 状态日志里的键数量上限：每个区域 2 个 + 系统级键的余量
+#define WATERING_JOURNAL_KEYS (WATERING_MAX_ZONES * 2 + 16)
+
+// 一个浇水区域：独立的继电器、计划、计数和存档键
+struct WateringZone
+{
+    int relayPin = -1;                 // 硬件引脚
+    int durationSec = 0;               // 浇水时长
+    WateringLogic logic{0, 0, 1, 0};   // 大脑
+    PumpStateMachine pump;             // 水泵状态机
+
+    int wateredCount = 0;
+    int32_t lastWateredDay = WateringLogic::NEVER_WATERED; // 上次自动浇水的 epoch 天
+    bool relayActive = false;          // 引脚当前是否吸合
+
+    // 本次运行的上下文 (Started 到 Finished 之间有效)
+    bool runIsManual = false;
+    int32_t runDay = WateringLogic::NEVER_WATERED;
+    int64_t runStart = 0; // 开始时刻 (本地 epoch 秒，写入历史)
+
+    int32_t dueDay = WateringLogic::NEVER_WATERED; // 等待名额的计划所属的 epoch 天
+    uint32_t missedCount = 0;                      // 错过的计划次数 (本次上电以来)
+
+    int16_t moisture = WateringLogic::MOISTURE_UNKNOWN; // 最近的土壤湿度 (千分比，控制任务写入)
+    uint32_t skippedCount = 0;                          // 土还湿、跳过的计划次数 (本次上电以来)
+
+    // 流量计 (可选)：有表时每次运行都计量；doseMl > 0 时按量浇水，时长只作为安全上限
+    PulseCounter *meter = nullptr;
+    uint32_t pulsesPerLitre = FLOW_PULSES_PER_LITRE;
+    uint32_t doseMl = 0;                        // 计划运行的目标水量 (0 = 按时长)
+    uint32_t doseCapSec = WATERING_DOSE_CAP_SEC; // 按量运行的时长上限
+    FlowDose dose;                              // 本次运行的计量
+    uint32_t runDoseMl = 0;                     // 本次运行的目标水量
+    bool runNoFlow = false;                     // 本次运行因断流被停下
+    int32_t lastVolumeMl = -1;                  // 上次运行的实际水量 (-1 = 没有流量计 / 还没运行过)
+    uint32_t totalVolumeMl = 0;                 // 累计水量 (本次上电以来)
+    uint32_t cappedCount = 0;                   // 按量运行到了时长上限还没浇够的次数
+};
+
+// 一个区域的状态快照 (状态 JSON 里 zones 数组的一项 / 状态帧里的一个区域)
+struct ZoneStatus
+{
+    int relayPin;
+    bool busy;
+    bool relay; // 引脚当前是否吸合
+    bool hasMeter;
+    int count;
+    int maxCycles;
+    int intervalDays;
+    int durationSec;
+    int startMinute; // 第一次开始时刻 (当天的分钟数)
+    int timesPerDay;
+    int32_t lastDay;
+    uint32_t missed;
+    int16_t moisture;
+    int16_t moistureThreshold;
+    uint32_t skipped;
+    uint32_t doseMl;
+    int32_t lastVolumeMl;
+    uint32_t totalVolumeMl;
+    uint32_t flowMlPerMin;
+    uint32_t capped;
+};
+
+// 系统状态快照：控制任务一次填好 (WateringSystem::captureStatus)，网络任务拿着副本编码
+// 流式 JSON / 二进制帧都要写两遍，两遍必须看到同样的数；区域状态只在控制任务里改，网络任务不直接读
+struct SystemStatus
+{
+    bool enabled;
+    bool busy;
+    bool held;
+    bool powerOk;
+    bool persistence;
+    uint16_t zoneCount;
+    int64_t nextFire; // WateringLogic::NEVER = 没有计划
+    uint32_t missed;
+    ZoneStatus zones[WATERING_MAX_ZONES]; // 没有区域时 zones[0] 仍有效 (顶层旧字段)
+
+    // 状态 JSON 里的 "system" 对象：顶层字段保持旧格式 (区域 0)，zones 数组包含所有区域
+    void write(JsonWriter &w) const
+    {
+        const ZoneStatus &z0 = zones[0];
+        char startTime[16]; // "%d:%02d" 覆盖 int 的全部取值，编译器不报截断
+
+        w.beginObject();
+
+        // 1. 当前运行状态
+        w.field("status", enabled ? "ACTIVE" : "KILLED");
+        w.field("is_busy", busy);
+
+        // 2. 进度信息 (区域 0)
+        w.field("cycle_current", z0.count);
+        w.field("cycle_max", z0.maxCycles);
+
+        // 3. 配置参数 (这些值来自你的宏)
+        w.field("interval_days", z0.intervalDays);
+        w.field("duration_sec", z0.durationSec);
+        snprintf(startTime, sizeof(startTime), "%d:%02d", z0.startMinute / 60, z0.startMinute % 60);
+        w.field("start_time", startTime);
+
+        // 4. 系统开关
+        w.field("persistence", persistence ? "on" : "off");
+        w.field("next_fire", (long long)(nextFire == WateringLogic::NEVER ? -1 : nextFire));
+        w.field("missed", (long)missed);
+
+        // 5. 所有区域
+        w.beginArray("zones");
+        for (int i = 0; i < zoneCount; i++)
+        {
+            const ZoneStatus &z = zones[i];
+            snprintf(startTime, sizeof(startTime), "%d:%02d", z.startMinute / 60, z.startMinute % 60);
+            w.beginObject();
+            w.field("id", i);
+            w.field("pin", z.relayPin);
+            w.field("busy", z.busy);
+            w.field("count", z.count);
+            w.field("max", z.maxCycles);
+            w.field("interval_days", z.intervalDays);
+            w.field("duration_sec", z.durationSec);
+            w.field("start_time", startTime);
+            w.field("times_per_day", z.timesPerDay);
+            w.field("last_day", (long)z.lastDay);
+            w.field("missed", (long)z.missed);
+            w.field("moisture", (int)z.moisture);
+            w.field("moisture_threshold", (int)z.moistureThreshold);
+            w.field("skipped", (long)z.skipped);
+            if (z.hasMeter)
+            {
+                w.field("dose_ml", (long)z.doseMl);
+                w.field("volume_ml", (long)z.lastVolumeMl);
+                w.field("volume_total_ml", (long)z.totalVolumeMl);
+                w.field("flow_ml_min", (long)z.flowMlPerMin);
+                w.field("capped", (long)z.capped);
+            }
+            w.endObject();
+        }
+        w.endArray();
+
+        w.endObject();
+    }
+
+    // 二进制状态帧的帧体 (帧头由调用方写)，字段和 JSON 对应
+    // 每个区域 28 字节：flags u8, timesPerDay u8, count u16, max u16, durationSec u16, moisture i16,
+    // startMinute u16, lastDay i32, lastVolumeMl i32, totalVolumeMl u32, missed u16, skipped u16
+    void write(Wire::Encoder &e) const
+    {
+        e.u8((enabled ? Wire::STATUS_ENABLED : 0) | (busy ? Wire::STATUS_BUSY : 0) |
+             (held ? Wire::STATUS_HELD : 0) | (powerOk ? Wire::STATUS_POWER : 0) |
+             (persistence ? Wire::STATUS_PERSISTENCE : 0));
+        e.u8((uint8_t)zoneCount);
+        e.u32(nextFire == WateringLogic::NEVER ? 0xFFFFFFFF : Wire::epoch32(nextFire));
+        e.u32(missed);
+        for (int i = 0; i < zoneCount; i++)
+        {
+            const ZoneStatus &z = zones[i];
+            e.u8((z.busy ? Wire::ZONE_BUSY : 0) | (z.relay ? Wire::ZONE_RELAY : 0) | (z.hasMeter ? Wire::ZONE_METER : 0));
+            e.u8((uint8_t)z.timesPerDay);
+            e.u16((uint16_t)z.count);
+            e.u16((uint16_t)z.maxCycles);
+            e.u16((uint16_t)z.durationSec);
+            e.i16(z.moisture);
+            e.u16((uint16_t)z.startMinute);
+            e.i32(z.lastDay);
+            e.i32(z.lastVolumeMl);
+            e.u32(z.totalVolumeMl);
+            e.u16(z.missed > 0xFFFF ? 0xFFFF : (uint16_t)z.missed);
+            e.u16(z.skipped > 0xFFFF ? 0xFFFF : (uint16_t)z.skipped);
+        }
+    }
+};
 
 class WateringSystem
 {
@@ -12,180 +209,723 @@ private:
     // 定义通知回调函数类型：接收一个字符串消息
     typedef std::function<void(const char *)> NotifierCallback;
     NotifierCallback notifier = nullptr; // 状态变更通知回调
-
-    // 定义一个空闲时的回调类型
-    typedef std::function<void(void)> YieldCallback;
-    YieldCallback yieldHandler = nullptr; // 保存回调函数
-
-    WateringLogic logic; // 大脑
-    Preferences prefs;   // 用于存储状态
-    int relayPin;        // 硬件引脚
-    int durationSec;     // 浇水时长
+    typedef std::function<void(const RunEvent &)> RunEventCallback;
+    RunEventCallback eventSink = nullptr; // 同一时刻的结构化事件 (可选)
+
+    WateringZone zones[WATERING_MAX_ZONES];
+    uint16_t zoneCount = 0;
+    ZoneScheduler<WATERING_MAX_ZONES> scheduler; // 按下一次触发时刻排序
+
+    // 正在运行的区域列表：loop() 只推进它们，开销与区域总数无关
+    uint16_t activeZones[WATERING_MAX_ZONES];
+    uint16_t activeCount = 0;
+    uint16_t maxConcurrentRuns = 1; // 同时运行的水泵上限 (电源容量)
+
+    // 已到期、等待运行名额的区域 (FIFO，按触发时刻先后)
+    // 到期的区域在第一次被看到时就出堆并结算迟到，排队等名额不算迟到
+    uint16_t readyZones[WATERING_MAX_ZONES];
+    uint16_t readyHead = 0;
+    uint16_t readyCount = 0;
+
+    // 错过计划的处理
+    MissedFirePolicy missedPolicy = MissedFirePolicy::RunLate;
+    uint32_t runLateSec = WATERING_RUN_LATE_SEC;
+    bool catchUpPending = false; // 启动后第一次排期：从存档的检查点开始，补上断电期间的计划
+
+    // 状态存档：专用分区里的追加写日志，每次只追加一条几十字节的记录
+    // Preferences 只用于首次启动时导入旧版存档
+    PartitionFlash journalFlash;
+    StateJournal<PartitionFlash, WATERING_JOURNAL_KEYS> journal{journalFlash};
+    Preferences prefs;
     bool enableStorage;  // 是否启用状态存储
 
+    // 浇水历史：独立分区里的差分编码环形日志 (旧分区表借用 journal 前面的 128KB)
+    PartitionFlash historyFlash{"history", HISTORY_FALLBACK_BYTES, JOURNAL_FALLBACK_BYTES};
+    HistoryLog<PartitionFlash> history{historyFlash};
+
     // 内部状态
-    int wateredCount = 0;
-    int lastWateredDay = -999;
-    bool hasWateredToday = false;
-    bool isBusy = false;
-    bool stopRequested = false;
     bool systemEnabled = true; // 系统总开关
-    char systemInfo[128];
+    bool held = false;          // 固件升级期间暂停运行 (不存档，重启即解除)
+    bool powerOk = true;        // 机队供电名额 (PowerLease)；没拿到时不启动水泵
+    bool scheduleValid = false; // 调度堆是否已按当前时间建立
+    int64_t lastNow = 0;        // 最近一次 update() 的本地 epoch 秒
+    uint32_t lastNowMs = 0;     // 收到 lastNow 时的 millis()
+    bool timeKnown = false;
+    char systemInfo[160];
+
+    // 没拿到供电名额时收到的手动指令：拿到名额后第一个运行 (同一时间只排一个)
+    int pendingZone = -1;
+    int pendingDurationSec = 0;
+    uint32_t pendingVolumeMl = 0;
+
+    // 通知/日志共用的消息缓存
+    char msgBuffer[64];
+
+    bool validZone(int zone) { return zone >= 0 && zone < zoneCount; }
+
+    // 当前本地 epoch 秒 (用最近一次 update() 的时间加上经过的 millis 推算)，未同步时为 0
+    int64_t currentEpoch()
+    {
+        return timeKnown ? lastNow + (int64_t)((uint32_t)millis() - lastNowMs) / 1000 : 0;
+    }
+
+    // 多区域时在消息前加 "Zone N: "，单区域保持原有格式
+    int zonePrefix(int zone)
+    {
+        if (zoneCount <= 1)
+        {
+            msgBuffer[0] = '\0';
+            return 0;
+        }
+        return snprintf(msgBuffer, sizeof(msgBuffer), "Zone %d: ", zone);
+    }
+
+    // 结构化事件：区域相关的字段先按当前状态填好，调用方再补充
+    RunEvent zoneEvent(RunEventKind kind, int zone)
+    {
+        RunEvent e;
+        e.kind = kind;
+        if (validZone(zone))
+        {
+            const WateringZone &z = zones[zone];
+            e.zone = (uint8_t)zone;
+            e.cycle = (uint16_t)(z.wateredCount + 1);
+            e.maxCycles = (uint16_t)z.logic.maxCycles;
+        }
+        return e;
+    }
 
-    // 私有动作：干活
-    void activatePump(bool isManual = false)
+    void emit(RunEventKind kind, int zone = -1, uint32_t aux = 0)
     {
+        if (!eventSink)
+            return;
+        RunEvent e = zoneEvent(kind, zone);
+        e.aux = aux;
+        eventSink(e);
+    }
 
-        // 2. 上锁
-        isBusy = true;
+    // 拒绝一条指令：文本通知 + Rejected 事件
+    void reject(RejectReason reason, const char *text, int zone = -1)
+    {
+        if (notifier)
+            notifier(text);
+        emit(RunEventKind::Rejected, zone, (uint32_t)reason);
+    }
 
-        // 重置停止请求
-        stopRequested = false;
+    // 私有动作：启动一次浇水 (非阻塞，只把状态机推到 Starting)
+    // volumeMl > 0：按量浇水，时长上限为 doseCapSec；durationSec > 0：按这个时长；
+    // 都不给时按区域配置 (有流量计且配置了 doseMl 时按量，否则按时长)
+    bool activatePump(int zone, bool isManual, int32_t day, int durationSec = 0, uint32_t volumeMl = 0)
+    {
+        WateringZone &z = zones[zone];
+        if (volumeMl == 0 && durationSec <= 0 && z.meter)
+            volumeMl = z.doseMl;
+        if (volumeMl > 0)
+            durationSec = (int)z.doseCapSec;
+        else if (durationSec <= 0)
+            durationSec = z.durationSec;
+        if (!z.pump.start((uint32_t)durationSec * 1000UL))
+            return false;
+
+        // 记录本次运行的上下文，结束时结算
+        z.runDoseMl = volumeMl;
+        z.runNoFlow = false;
+        z.runIsManual = isManual;
+        z.runDay = day;
+        z.runStart = currentEpoch();
+        activeZones[activeCount++] = (uint16_t)zone;
+
+        // 立即推进一拍，继电器在本次调用内吸合
+        tickZone(zone);
+        return true;
+    }
 
-        // 定义一个临时缓存区，用来存放拼接后的字符串
-        char msgBuffer[64];
+    // 把状态机的输出同步到继电器引脚 (低电平触发)
+    void applyRelay(WateringZone &z)
+    {
+        bool on = z.pump.relayOn();
+        if (on != z.relayActive)
+        {
+            digitalWrite(z.relayPin, on ? LOW : HIGH);
+            z.relayActive = on;
+        }
+    }
 
-        // 计算当前是第几次 (因为 wateredCount 从0开始，所以显示时 +1)
-        int currentCycle = wateredCount + 1;
+    void tickZone(int zone)
+    {
+        WateringZone &z = zones[zone];
+        uint32_t now = millis();
+        // 水泵在转：读一次计数器，量够了提前正常结束，一直没有脉冲就按断流停泵
+        if (z.dose.metering() && z.pump.relayOn())
+        {
+            z.dose.update(z.meter->pulses(), now);
+            if (z.dose.reached())
+                z.pump.complete(now);
+            else if (z.dose.stalled(now))
+            {
+                z.runNoFlow = true;
+                z.pump.requestStop(now);
+            }
+        }
+        PumpEvent ev = z.pump.tick(now);
+        applyRelay(z);
+        handlePumpEvent(zone, ev);
+    }
 
-        // 1. 格式化“开始”消息
-        // 格式示例: "Auto Start [5/18]"
-        snprintf(msgBuffer, sizeof(msgBuffer), "%s [%d/%d]",
-                 isManual ? "Manual Start" : "Auto Start",
-                 currentCycle,
-                 logic.maxCycles);
+    // 运行结束时在通知后面附上实际水量 (没有流量计时不加，消息保持原样)
+    // 示例: "Done [5/18] 1502mL"、按量运行: "Done [5/18] 820/1500mL (time cap)"
+    void appendVolume(const WateringZone &z, int n, bool capped)
+    {
+        if (!z.meter || n >= (int)sizeof(msgBuffer))
+            return;
+        if (z.runDoseMl > 0)
+            snprintf(msgBuffer + n, sizeof(msgBuffer) - n, " %ld/%lumL%s", (long)z.lastVolumeMl,
+                     (unsigned long)z.runDoseMl, capped ? " (time cap)" : "");
+        else
+            snprintf(msgBuffer + n, sizeof(msgBuffer) - n, " %ldmL", (long)z.lastVolumeMl);
+    }
 
-        // 1. 通知：开始
-        if (notifier)
-            notifier(msgBuffer);
+    // 处理状态机吐出的事件：发通知、更新计数
+    void handlePumpEvent(int zone, PumpEvent ev)
+    {
+        WateringZone &z = zones[zone];
+        if (ev == PumpEvent::None)
+            return;
 
-        Serial.printf("[Watering] START (Cycle %d / %d)\n", currentCycle, logic.maxCycles);
-        digitalWrite(relayPin, LOW); // 开
+        // 计算当前是第几次 (因为 wateredCount 从0开始，所以显示时 +1)
+        int currentCycle = z.wateredCount + 1;
+        // 没有人订阅通知时 (仿真 / 测试) 不格式化消息
+        int n = notifier ? zonePrefix(zone) : 0;
 
-        int elapsed = 0;
-        for (int i = 0; i < durationSec; i++)
+        if (ev == PumpEvent::Started)
         {
-            elapsed++;
-            // 内层循环：把 1秒 切成 20份 (每份 50ms)
-            // 这样 OTA 的响应延迟从 1000ms 降低到了 50ms
-            for (int k = 0; k < 20; k++)
+            // 继电器刚吸合：从这一刻的计数开始计量
+            if (z.meter)
+                z.dose.begin(z.pulsesPerLitre, z.runDoseMl, z.meter->pulses(), millis());
+            TRACE_I("[Watering] START Zone %d (Cycle %d / %d)", zone, currentCycle, z.logic.maxCycles);
+            if (notifier)
             {
-                delay(50);
-
-                // 检查停止信号 (响应也变快了)
-                if (stopRequested)
-                {
-                    Serial.println("[Watering] STOP signal received! Aborting...");
-                    break;
-                }
-
-                // 频繁处理 OTA 和 MQTT
-                if (yieldHandler)
-                    yieldHandler();
+                // 格式示例: "Auto Start [5/18]"，按量运行: "Auto Start [5/18] 1500mL"
+                n += snprintf(msgBuffer + n, sizeof(msgBuffer) - n, "%s [%d/%d]",
+                              z.runIsManual ? "Manual Start" : "Auto Start",
+                              currentCycle,
+                              z.logic.maxCycles);
+                if (z.runDoseMl > 0 && n < (int)sizeof(msgBuffer))
+                    snprintf(msgBuffer + n, sizeof(msgBuffer) - n, " %lumL", (unsigned long)z.runDoseMl);
+                notifier(msgBuffer);
             }
-            if (stopRequested)
+            if (eventSink)
             {
-                Serial.println("[Watering] STOP signal received! Aborting...");
-                break;
+                RunEvent e = zoneEvent(RunEventKind::Started, zone);
+                e.flags = z.runIsManual ? RunEvent::FLAG_MANUAL : 0;
+                e.aux = z.runDoseMl;
+                eventSink(e);
             }
+            return;
         }
 
-        digitalWrite(relayPin, HIGH); // 关
+        // 结算水量：继电器断开后最后读一次计数器
+        if (z.dose.metering())
+        {
+            z.dose.update(z.meter->pulses(), millis());
+            z.dose.end();
+            z.lastVolumeMl = (int32_t)z.dose.deliveredMl();
+            z.totalVolumeMl += z.dose.deliveredMl();
+        }
+        bool capped = ev == PumpEvent::Finished && z.runDoseMl > 0 && !z.dose.reached();
 
-        // 3. 发送结束通知 (区分是正常完成还是被终止)
-        if (stopRequested)
+        // 发送结束通知 (区分是正常完成还是被终止)
+        if (ev == PumpEvent::Aborted)
         {
-            snprintf(msgBuffer, sizeof(msgBuffer), "Aborted (Run %ds) [%d/%d]",
-                     elapsed, currentCycle, logic.maxCycles);
-            Serial.printf("[Watering] ABORTED(Cycle %d / %d / %ds)\n", currentCycle, logic.maxCycles, elapsed);
+            int elapsed = (int)(z.pump.getElapsedMs() / 1000UL);
+            if (notifier)
+                n += snprintf(msgBuffer + n, sizeof(msgBuffer) - n, "Aborted%s (Run %ds) [%d/%d]",
+                              z.runNoFlow ? ": No flow" : "", elapsed, currentCycle, z.logic.maxCycles);
+            if (z.runNoFlow)
+                TRACE_E("[Watering] NO FLOW Zone %d: pump stopped after %ds, %d pulses", zone, elapsed, (int32_t)z.dose.pulseCount());
+            else
+                TRACE_W("[Watering] ABORTED Zone %d (Cycle %d / %d / %ds)", zone, currentCycle, z.logic.maxCycles, elapsed);
         }
         else
         {
-            snprintf(msgBuffer, sizeof(msgBuffer), "Done [%d/%d]",
-                     currentCycle, logic.maxCycles);
-            Serial.printf("[Watering] DONE(Cycle %d / %d)\n", currentCycle, logic.maxCycles);
+            if (notifier)
+                n += snprintf(msgBuffer + n, sizeof(msgBuffer) - n, "Done [%d/%d]",
+                              currentCycle, z.logic.maxCycles);
+            if (capped)
+            {
+                z.cappedCount++;
+                TRACE_W("[Watering] Zone %d hit time cap: %d of %u mL", zone, z.lastVolumeMl, z.runDoseMl);
+            }
+            TRACE_I("[Watering] DONE Zone %d (Cycle %d / %d)", zone, currentCycle, z.logic.maxCycles);
+        }
+        if (notifier)
+            appendVolume(z, n, capped);
+        RunEvent done = zoneEvent(ev == PumpEvent::Aborted ? RunEventKind::Aborted : RunEventKind::Done, zone);
+        if (eventSink)
+        {
+            done.flags = (z.runIsManual ? RunEvent::FLAG_MANUAL : 0) | (capped ? RunEvent::FLAG_CAPPED : 0) |
+                         (ev == PumpEvent::Aborted && z.runNoFlow ? RunEvent::FLAG_NO_FLOW : 0);
+            done.durationSec = (uint16_t)((z.pump.getElapsedMs() + 500) / 1000);
+            done.volumeMl = z.meter ? z.lastVolumeMl : -1;
+            done.aux = z.runDoseMl;
+        }
+
+        // 写入历史 (手动和自动都记)
+        if (enableStorage)
+        {
+            RunRecord rec;
+            rec.start = z.runStart;
+            rec.durationSec = (z.pump.getElapsedMs() + 500) / 1000;
+            rec.zone = (uint16_t)zone;
+            rec.aborted = ev == PumpEvent::Aborted;
+            rec.trigger = z.runIsManual ? RunTrigger::Manual : RunTrigger::Auto;
+            history.append(rec);
+        }
+
+        // 更新状态 (手动浇水不影响 lastWateredDay，也不写 Flash)
+        z.wateredCount++;
+        if (!z.runIsManual)
+        {
+            z.lastWateredDay = z.runDay;
+            saveZone(zone);
+        }
+
+        // 计数变了，重新排期
+        rescheduleZone(zone);
+
+        if (notifier)
+            notifier(msgBuffer);
+        if (eventSink)
+            eventSink(done);
+    }
+
+    // 用最近已知的时间给区域重新计算下一次触发时刻
+    // from 早于现在时 (启动补算) 得到的时刻可能已经过去，update() 会按错过策略结算
+    void rescheduleZone(int zone) { rescheduleZone(zone, lastNow); }
+
+    void rescheduleZone(int zone, int64_t from)
+    {
+        if (!timeKnown)
+            return;
+        WateringZone &z = zones[zone];
+        int64_t fireAt = z.logic.nextFireTime(from, z.wateredCount, z.lastWateredDay);
+
+        // MTEST:START:模拟隔天 (冷却 10 秒再允许下一次自动触发)
+        #ifdef SYSTEM_MANUAL_TEST
+        if (SYSTEM_MANUAL_TEST && fireAt != WateringLogic::NEVER && fireAt < lastNow + 10)
+            fireAt = lastNow + 10;
+        #endif
+        // MTEST:END
+
+        scheduler.schedule((uint16_t)zone, fireAt);
+    }
+
+    void rescheduleAll()
+    {
+        scheduler.clear();
+        readyHead = readyCount = 0;
+
+        // 启动后第一次：从检查点的下一分钟算起，断电 / 未对时期间落下的计划都会被结算
+        int64_t from = lastNow;
+        if (catchUpPending && enableStorage)
+        {
+            int32_t checkpoint = journal.get(KEY_CHECKPOINT, NO_CHECKPOINT);
+            int64_t after = ((int64_t)checkpoint + 1) * 60;
+            if (checkpoint != NO_CHECKPOINT && after < lastNow)
+                from = after;
+            if (checkpoint == NO_CHECKPOINT)
+                saveCheckpoint(lastNow);
+        }
+        catchUpPending = false;
+
+        for (int i = 0; i < zoneCount; i++)
+        {
+            if (zones[i].pump.isIdle())
+                rescheduleZone(i, from);
+        }
+        scheduleValid = true;
+    }
+
+    // 检查点：到这一分钟为止的计划都已结算 (执行或记为错过)
+    // 只在有计划出堆时写一次，重启后从这里补算
+    void saveCheckpoint(int64_t now)
+    {
+        if (!enableStorage)
+            return;
+        METRIC_SCOPE(NvsCommit);
+        journal.set(KEY_CHECKPOINT, (int32_t)(now / 60));
+    }
+
+    // 到期区域第一次被看到：结算迟到，决定立即排队、记为错过还是排到下一次
+    void handleDue(uint16_t zone, int64_t fireAt, int64_t now)
+    {
+        WateringZone &z = zones[zone];
+        // 手动运行中的区域：跳过，运行结束时会重新排期
+        if (!z.pump.isIdle())
+            return;
+
+        uint32_t missed = 0;
+        int64_t runLateFrom = missedPolicy == MissedFirePolicy::RunLate ? now - (int64_t)runLateSec : WateringLogic::NEVER;
+        int64_t f = z.logic.catchUp(fireAt, now, z.wateredCount, z.lastWateredDay, runLateFrom, missed);
+        if (missed)
+            recordMissed(zone, missed, now - fireAt);
+
+        if (f > now)
+        {
+            scheduler.schedule(zone, f);
+            return;
+        }
+        if (!z.logic.soilNeedsWater(z.moisture))
+        {
+            recordSkipped(zone, f);
+            return;
+        }
+        if (now >= f + 60)
+            TRACE_W("[Watering] Zone %d running late by %ds", zone, (int32_t)(now - f));
+        z.dueDay = EpochTime::dayOf(f); // 间隔按计划所属的那一天算，补跑不会推迟后面的计划
+        readyZones[(readyHead + readyCount++) % WATERING_MAX_ZONES] = zone;
+    }
+
+    // 排队的手动运行：有名额就启动 (手动运行不受总开关限制)
+    void startPending()
+    {
+        if (pendingZone < 0 || held || !powerOk || activeCount >= maxConcurrentRuns)
+            return;
+        int zone = pendingZone;
+        pendingZone = -1;
+        if (zones[zone].pump.isIdle())
+            activatePump(zone, true, zones[zone].lastWateredDay, pendingDurationSec, pendingVolumeMl);
+    }
+
+    // 取消排队的手动运行，返回是否有
+    bool cancelPending(int zone)
+    {
+        if (pendingZone < 0 || (zone >= 0 && zone != pendingZone))
+            return false;
+        TRACE_I("[Watering] Queued run for Zone %d cancelled", pendingZone);
+        emit(RunEventKind::Cancelled, pendingZone);
+        pendingZone = -1;
+        if (notifier)
+            notifier("Cancelled: Queued run");
+        return true;
+    }
+
+    void recordMissed(uint16_t zone, uint32_t n, int64_t lateSec)
+    {
+        zones[zone].missedCount += n;
+        TRACE_W("[Watering] Zone %d MISSED %u run(s), %ds late", zone, n, (int32_t)lateSec);
+        if (eventSink)
+        {
+            RunEvent e = zoneEvent(RunEventKind::Missed, zone);
+            e.aux = n;
+            e.durationSec = lateSec / 60 > 0xFFFF ? 0xFFFF : (uint16_t)(lateSec / 60);
+            eventSink(e);
+        }
+        if (notifier && missedPolicy != MissedFirePolicy::Skip)
+        {
+            int len = zonePrefix(zone);
+            snprintf(msgBuffer + len, sizeof(msgBuffer) - len, "Missed %lu run(s) (%ld min late)",
+                     (unsigned long)n, (long)(lateSec / 60));
+            notifier(msgBuffer);
         }
+    }
 
-        // 2. 通知：结束
+    // 土还够湿：这一次不浇，不计次数也不算浇过，排到下一个开始时刻再看湿度
+    void recordSkipped(uint16_t zone, int64_t fireAt)
+    {
+        WateringZone &z = zones[zone];
+        z.skippedCount++;
+        TRACE_I("[Watering] Zone %d SKIPPED: moisture %d >= %d permille", zone, z.moisture, z.logic.moistureThreshold);
+        scheduler.schedule(zone, z.logic.nextFireTime(fireAt + 60, z.wateredCount, z.lastWateredDay));
         if (notifier)
+        {
+            int len = zonePrefix(zone);
+            snprintf(msgBuffer + len, sizeof(msgBuffer) - len, "Skipped: soil moisture %d.%d%%",
+                     z.moisture / 10, z.moisture % 10);
             notifier(msgBuffer);
+        }
+        emit(RunEventKind::Skipped, zone, (uint32_t)z.moisture);
+    }
 
-        // 3. 解锁
-        isBusy = false;
+    // 日志键：0x0001 系统开关；0x0002 调度检查点；0x0100 + 区域*2 + 字段 (0 计数 / 1 上次浇水日)
+    static const uint16_t KEY_ENABLED = 0x0001;
+    static const uint16_t KEY_CHECKPOINT = 0x0002; // 已结算到的本地 epoch 分钟
+    static const int32_t NO_CHECKPOINT = INT32_MIN;
+    static uint16_t zoneKey(int zone, int field) { return (uint16_t)(0x0100 + zone * 2 + field); }
+
+    // 暂存单个区域的状态 (由调用方 commit，多个字段原子写入)
+    void stageZone(int zone)
+    {
+        journal.stage(zoneKey(zone, 0), zones[zone].wateredCount);
+        journal.stage(zoneKey(zone, 1), zones[zone].lastWateredDay);
+    }
+
+    // 保存单个区域状态到 Flash (计数和日期一条记录写完)
+    void saveZone(int zone)
+    {
+        if (!enableStorage)
+            return;
+
+        METRIC_SCOPE(NvsCommit);
+        stageZone(zone);
+        journal.commit();
+        TRACE_D("[System] Zone %d State Saved to Flash.", zone);
     }
 
-    // 保存状态到 Flash
-    void saveState()
+    // 保存系统开关 (是否被杀死)
+    void saveEnabled()
     {
         if (!enableStorage)
             return;
 
-        prefs.begin("plant_data", false); // 打开命名空间
-        prefs.putInt("count", wateredCount);
-        prefs.putInt("last_day", lastWateredDay);
-        // 新增：保存是否被杀死的标志
-        prefs.putBool("enabled", systemEnabled);
+        METRIC_SCOPE(NvsCommit);
+        journal.set(KEY_ENABLED, systemEnabled ? 1 : 0);
+        TRACE_D("[System] State Saved to Flash.");
+    }
+
+    // 日志还是空的：把旧版 Preferences 存档导入进来 (只发生一次)
+    void importLegacyState()
+    {
+        char key[16];
+        prefs.begin("plant_data", true);
+        for (int i = 0; i < zoneCount; i++)
+        {
+            snprintf(key, sizeof(key), "z%d_cnt", i);
+            if (prefs.isKey(key))
+                journal.stage(zoneKey(i, 0), prefs.getInt(key, 0));
+            else if (i == 0 && prefs.isKey("count"))
+                journal.stage(zoneKey(0, 0), prefs.getInt("count", 0)); // 旧版单区域 (last_day 是 tm_yday，无法换算，只迁移次数)
+            snprintf(key, sizeof(key), "z%d_last", i);
+            if (prefs.isKey(key))
+                journal.stage(zoneKey(i, 1), prefs.getInt(key, WateringLogic::NEVER_WATERED));
+        }
+        journal.stage(KEY_ENABLED, prefs.getBool("enabled", true) ? 1 : 0);
         prefs.end();
-        Serial.println("[System] State Saved to Flash.");
+        journal.commit();
+        Serial.println("[System] Imported legacy NVS state into journal.");
+    }
+
+    void loadZone(int zone)
+    {
+        WateringZone &z = zones[zone];
+        z.wateredCount = journal.get(zoneKey(zone, 0), 0);
+        z.lastWateredDay = journal.get(zoneKey(zone, 1), WateringLogic::NEVER_WATERED);
     }
 
 public:
-    // 构造函数
+    // 构造函数 (单区域，兼容旧接口)
     WateringSystem(int pin, int duration, int hour, int min, int interval, int max, bool useNVS = true)
-        : logic(hour, min, interval, max), relayPin(pin), durationSec(duration), enableStorage(useNVS) {}
+        : enableStorage(useNVS)
+    {
+        addZone(pin, duration, hour, min, interval, max);
+    }
+
+    // 构造函数 (单区域，日历计划)
+    WateringSystem(int pin, int duration, const Schedule &schedule, int max, bool useNVS = true)
+        : enableStorage(useNVS)
+    {
+        addZone(pin, duration, schedule, max);
+    }
+
+    // 构造函数 (多区域，之后用 addZone 添加)
+    explicit WateringSystem(bool useNVS = true) : enableStorage(useNVS) {}
+
+    // 添加一个区域，返回区域编号；超出容量返回 -1
+    // 必须在 begin() 之前调用
+    int addZone(int pin, int duration, int hour, int min, int interval, int max)
+    {
+        if (zoneCount >= WATERING_MAX_ZONES)
+            return -1;
+        WateringZone &z = zones[zoneCount];
+        z.relayPin = pin;
+        z.durationSec = duration;
+        z.logic = WateringLogic(hour, min, interval, max);
+        return zoneCount++;
+    }
+
+    // 添加一个按日历计划 (星期 / 季节 / 一天多次) 运行的区域；计划无效返回 -1
+    int addZone(int pin, int duration, const Schedule &schedule, int max)
+    {
+        if (zoneCount >= WATERING_MAX_ZONES || !schedule.isValid())
+            return -1;
+        WateringZone &z = zones[zoneCount];
+        z.relayPin = pin;
+        z.durationSec = duration;
+        z.logic = WateringLogic(schedule, max);
+        return zoneCount++;
+    }
+
+    int getZoneCount() { return zoneCount; }
+
+    // 同时运行的水泵上限 (默认 1，避免多路浪涌电流叠加)
+    void setMaxConcurrentRuns(uint16_t n) { maxConcurrentRuns = n > 0 ? n : 1; }
+
+    // 错过计划的处理方式；runLateWindowSec 只对 RunLate 有效
+    void setMissedFirePolicy(MissedFirePolicy policy, uint32_t runLateWindowSec = WATERING_RUN_LATE_SEC)
+    {
+        missedPolicy = policy;
+        runLateSec = runLateWindowSec;
+    }
+
+    // 错过的计划次数 (本次上电以来)
+    uint32_t getMissedCount(int zone) { return validZone(zone) ? zones[zone].missedCount : 0; }
+
+    uint32_t getMissedCount()
+    {
+        uint32_t n = 0;
+        for (int i = 0; i < zoneCount; i++)
+            n += zones[i].missedCount;
+        return n;
+    }
+
+    // 湿度条件：计划到点时土壤湿度 (千分比) 不低于 threshold 就跳过；MOISTURE_OFF 关闭
+    void setMoistureThreshold(int zone, int16_t threshold)
+    {
+        if (validZone(zone))
+            zones[zone].logic.moistureThreshold = threshold;
+    }
+
+    // [控制任务] 更新区域的土壤湿度 (采样任务滤波后的千分比，读不到时为 MOISTURE_UNKNOWN)
+    void setMoisture(int zone, int16_t permille)
+    {
+        if (validZone(zone))
+            zones[zone].moisture = permille;
+    }
+
+    int16_t getMoisture(int zone = 0) { return validZone(zone) ? zones[zone].moisture : WateringLogic::MOISTURE_UNKNOWN; }
+
+    // 因为土还湿跳过的计划次数 (本次上电以来)
+    uint32_t getSkippedCount(int zone = 0) { return validZone(zone) ? zones[zone].skippedCount : 0; }
+
+    // 给区域接上流量计 (必须在 begin() 之前)；pulsesPerLitre 为标定值
+    void setFlowMeter(int zone, PulseCounter *meter, uint32_t pulsesPerLitre = FLOW_PULSES_PER_LITRE)
+    {
+        if (!validZone(zone))
+            return;
+        zones[zone].meter = meter;
+        zones[zone].pulsesPerLitre = pulsesPerLitre > 0 ? pulsesPerLitre : FLOW_PULSES_PER_LITRE;
+    }
+
+    // 按量浇水：计划运行 (以及不带参数的手动 start) 浇够 ml 毫升就停，最长 capSec 秒
+    // 需要流量计；ml = 0 恢复按时长浇水
+    void setDose(int zone, uint32_t ml, uint32_t capSec = WATERING_DOSE_CAP_SEC)
+    {
+        if (!validZone(zone))
+            return;
+        zones[zone].doseMl = ml;
+        zones[zone].doseCapSec = capSec > 0 ? capSec : WATERING_DOSE_CAP_SEC;
+    }
+
+    // 上次运行的实际水量 (毫升)；没有流量计 / 还没运行过为 -1
+    int32_t getLastVolumeMl(int zone = 0) { return validZone(zone) ? zones[zone].lastVolumeMl : -1; }
+
+    // 累计水量 (毫升，本次上电以来)
+    uint32_t getTotalVolumeMl(int zone = 0) { return validZone(zone) ? zones[zone].totalVolumeMl : 0; }
+
+    // 按量运行到了时长上限还没浇够的次数
+    uint32_t getCappedCount(int zone = 0) { return validZone(zone) ? zones[zone].cappedCount : 0; }
 
     // 获取当前计数
-    int getWateredCount() { return wateredCount; }
+    int getWateredCount(int zone = 0) { return validZone(zone) ? zones[zone].wateredCount : 0; }
+
+    // 上次自动浇水的 epoch 天 (从未浇过为 NEVER_WATERED)
+    int32_t getLastWateredDay(int zone = 0) { return validZone(zone) ? zones[zone].lastWateredDay : WateringLogic::NEVER_WATERED; }
 
     // 获取系统是否存活
     bool isEnabled() { return systemEnabled; }
 
-    // [危险!!!] 仅用于测试：擦除 NVS 数据，重置环境
+    // 最近的一次计划触发时刻 (本地 epoch 秒)
+    int64_t getNextFireTime() { return scheduler.nextFireAt(); }
+
+    // [危险!!!] 仅用于测试：擦除存档数据，重置环境
     void factoryReset()
     {
         if (enableStorage)
         {
+            journal.format();
+            history.clear();
+            // 旧版存档也清掉，否则下次 begin() 会把它重新导入
             prefs.begin("plant_data", false);
-            prefs.clear(); // 清空所有 key
+            prefs.clear();
             prefs.end();
-            Serial.println("[Test] NVS Cleared.");
+            Serial.println("[Test] Journal & NVS Cleared.");
+        }
+        for (int i = 0; i < zoneCount; i++)
+        {
+            WateringZone &z = zones[i];
+            z.wateredCount = 0;
+            z.lastWateredDay = WateringLogic::NEVER_WATERED;
+            z.missedCount = 0;
+            z.skippedCount = 0;
+            z.lastVolumeMl = -1;
+            z.totalVolumeMl = 0;
+            z.cappedCount = 0;
+            z.dose.end();
+            z.pump = PumpStateMachine();
+            z.relayActive = false;
+            digitalWrite(z.relayPin, HIGH);
         }
-        wateredCount = 0;
-        lastWateredDay = -999;
-        hasWateredToday = false;
-        isBusy = false;
-        stopRequested = false;
+        activeCount = 0;
+        pendingZone = -1;
+        scheduler.clear();
+        readyHead = readyCount = 0;
+        scheduleValid = false;
     }
 
     void begin()
     {
-        pinMode(relayPin, OUTPUT);
-        digitalWrite(relayPin, HIGH); // 默认关
+        for (int i = 0; i < zoneCount; i++)
+        {
+            pinMode(zones[i].relayPin, OUTPUT);
+            digitalWrite(zones[i].relayPin, HIGH); // 默认关
+            zones[i].relayActive = false;
+        }
+
+        if (enableStorage && !journal.begin())
+        {
+            // 没有可用的分区：退化为不保存
+            enableStorage = false;
+            Serial.println("[Watering] Journal unavailable, persistence DISABLED.");
+        }
 
         if (enableStorage)
         {
-            // 启动时加载存档
-            prefs.begin("plant_data", false);                // 只读模式打开
-            wateredCount = prefs.getInt("count", 0);         // 读不到默认返 0
-            lastWateredDay = prefs.getInt("last_day", -999); // 读不到默认返 -999
-            // 新增：读取开关状态 (默认为 true)
-            systemEnabled = prefs.getBool("enabled", true);
-            prefs.end();
-            Serial.printf("[Watering] Init. Enabled: %s\n", systemEnabled ? "YES" : "NO (KILLED)");
-            Serial.printf("[Watering] Persistence ENABLED. Loaded State: Count=%d, LastDay=%d\n", wateredCount, lastWateredDay);
+            // 启动时恢复存档 (begin() 已重放日志，掉电打断的最后一条会被丢弃)
+            if (journal.isBlank())
+                importLegacyState();
+            for (int i = 0; i < zoneCount; i++)
+                loadZone(i);
+            // 读取开关状态 (默认为 true)
+            systemEnabled = journal.get(KEY_ENABLED, 1) != 0;
+            StateJournal<PartitionFlash, WATERING_JOURNAL_KEYS>::Stats js = journal.getStats();
+            Serial.printf("[Watering] Journal replayed %u records (%u torn).\n", (unsigned)js.replayed, (unsigned)js.corruptTails);
+            if (history.begin())
+                Serial.printf("[Watering] History: %u runs on flash.\n", (unsigned)history.size());
+            Serial.printf("[Watering] Init. Enabled: %s, Zones: %d\n", systemEnabled ? "YES" : "NO (KILLED)", zoneCount);
+            for (int i = 0; i < zoneCount; i++)
+                Serial.printf("[Watering] Persistence ENABLED. Zone %d Loaded State: Count=%d, LastDay=%ld\n",
+                              i, zones[i].wateredCount, (long)zones[i].lastWateredDay);
         }
         else
         {
             Serial.println("[Watering] Persistence DISABLED. State will reset on reboot.");
         }
 
-        snprintf(systemInfo, sizeof(systemInfo),
-                 "[Watering] System Info: pin: %d, duration: %ds, target_time: %02d:%02d:00, interval: %d days, max cycles: %d",
-                 relayPin, durationSec,
-                 logic.targetHour, logic.targetMin,
-                 logic.intervalDays,
-                 logic.maxCycles);
-        Serial.println(systemInfo);
+        // 时间同步后的第一次 update() 再建立调度堆 (并补算断电期间的计划)
+        scheduleValid = false;
+        catchUpPending = true;
+
+        for (int i = 0; i < zoneCount; i++)
+        {
+            WateringZone &z = zones[i];
+            snprintf(systemInfo, sizeof(systemInfo),
+                     "[Watering] Zone %d Info: pin: %d, duration: %ds, target_time: %02d:%02d:00 (x%d/day), interval: %d days, max cycles: %d",
+                     i, z.relayPin, z.durationSec,
+                     z.logic.targetHour(), z.logic.targetMin(), z.logic.schedule.timesPerDay(),
+                     z.logic.intervalDays(),
+                     z.logic.maxCycles);
+            Serial.println(systemInfo);
+        }
     }
 
     // 注册通知回调
@@ -195,39 +935,173 @@ public:
         notifier = cb;
     }
 
-    // 允许外部注入“呼吸”逻辑
-    void setYieldCallback(YieldCallback cb)
+    // 注册结构化事件回调 (和文本通知同时产生，字段见 RunEvent.h)
+    void setEventSink(RunEventCallback cb)
+    {
+        eventSink = cb;
+    }
+
+    // 是否有区域正在浇水
+    bool isBusy() { return activeCount > 0; }
+
+    // 指定区域是否正在浇水 (状态机不在 Idle)
+    bool isBusy(int zone) { return validZone(zone) && !zones[zone].pump.isIdle(); }
+
+    // 当前继电器是否吸合
+    bool isRelayOn(int zone = 0) { return validZone(zone) && zones[zone].relayActive; }
+
+    PumpState getPumpState(int zone = 0) { return validZone(zone) ? zones[zone].pump.getState() : PumpState::Idle; }
+
+    // 距离下一次必须调用 loop() 的毫秒数 (没有水泵在跑时为 UINT32_MAX)
+    // 控制任务据此睡眠，而不是固定 10ms 轮询
+    uint32_t msUntilPumpDeadline()
+    {
+        uint32_t now = millis();
+        uint32_t wait = UINT32_MAX;
+        for (uint16_t i = 0; i < activeCount; i++)
+        {
+            const WateringZone &z = zones[activeZones[i]];
+            uint32_t ms = z.pump.msUntilNextTick(now);
+            if (z.dose.metering() && z.pump.relayOn())
+            {
+                // 按量运行：按流速估计的到量时刻提前醒来读计数器 (越接近越密)
+                uint32_t check = z.dose.msUntilCheck(now);
+                if (check < ms)
+                    ms = check;
+            }
+            if (ms < wait)
+                wait = ms;
+        }
+        return wait;
+    }
+
+    // 推进水泵状态机：在每个水泵截止时刻 (msUntilPumpDeadline) 或收到指令后调用
+    // 只遍历正在运行的区域，不会阻塞
+    void loop()
     {
-        yieldHandler = cb;
+        for (uint16_t i = 0; i < activeCount;)
+        {
+            uint16_t zone = activeZones[i];
+            tickZone(zone);
+            if (zones[zone].pump.isIdle())
+                activeZones[i] = activeZones[--activeCount]; // 交换删除
+            else
+                i++;
+        }
     }
 
-    // 强制手动浇水接口
-    void forceWatering()
+    // 强制手动浇水接口；durationSec > 0 时覆盖本次的浇水时长，volumeMl > 0 时按量浇水 (需要流量计)
+    void forceWatering(int zone = 0, int durationSec = 0, uint32_t volumeMl = 0)
     {
+        if (!validZone(zone))
+        {
+            reject(RejectReason::UnknownZone, "Ignored: Unknown zone");
+            return;
+        }
+
+        if (volumeMl > 0 && !zones[zone].meter)
+        {
+            reject(RejectReason::NoFlowMeter, "Ignored: No flow meter", zone);
+            return;
+        }
+
+        if (durationSec > WATERING_MAX_MANUAL_SEC)
+        {
+            reject(RejectReason::TooLong, "Ignored: Duration too long", zone);
+            return;
+        }
+
         if (!systemEnabled)
         {
-            Serial.println("[System] Warning: System is KILLED, but Force run allowed.");
+            TRACE_W("[System] Warning: System is KILLED, but Force run allowed.");
             // 或者直接 return 拒绝执行，看你需求
         }
 
-        // 4. 检查锁
-        if (isBusy)
+        if (held)
+        {
+            reject(RejectReason::Updating, "Ignored: Firmware update in progress", zone);
+            return;
+        }
+
+        // 4. 检查锁 (区域忙，或者已达到同时运行上限)
+        if (isBusy(zone) || activeCount >= maxConcurrentRuns)
         {
-            Serial.println("[Watering] Ignored: Already watering.");
+            TRACE_I("[Watering] Ignored: Already watering.");
             // 可选：告诉 MQTT 我很忙
-            if (notifier)
-                notifier("Ignored: System is Busy");
+            reject(RejectReason::Busy, "Ignored: System is Busy", zone);
             return; // 直接返回，不执行
         }
 
-        Serial.println("[Watering] Force watering triggered!");
-        activatePump(true); // true 表示是手动触发
-        // 手动浇水通常不增加 wateredCount 计数，也不影响自动逻辑，
-        // 或者你可以根据需求决定是否要更新 lastWateredDay
-        // 更新状态
-        wateredCount++;
-        // lastWateredDay = currentTime.tm_yday;
-        hasWateredToday = true;
+        // 5. 机队供电名额还没拿到：排队，拿到后第一个运行
+        if (!powerOk)
+        {
+            if (pendingZone >= 0)
+            {
+                reject(RejectReason::Busy, "Ignored: System is Busy", zone);
+                return;
+            }
+            pendingZone = zone;
+            pendingDurationSec = durationSec;
+            pendingVolumeMl = volumeMl;
+            TRACE_I("[Watering] Zone %d queued, waiting for power slot", zone);
+            if (notifier)
+                notifier("Queued: Waiting for power");
+            emit(RunEventKind::Queued, zone);
+            return;
+        }
+
+        TRACE_I("[Watering] Force watering triggered! Zone %d", zone);
+        // true 表示是手动触发；计数在运行结束时 (handlePumpEvent) 更新
+        activatePump(zone, true, zones[zone].lastWateredDay, durationSec, volumeMl);
+    }
+
+    // 暂停 / 恢复运行 (固件升级用)
+    // 暂停时正在运行的区域经状态机正常停泵 (记为中止)；到期的计划留在队列里，恢复后照常运行
+    void setHold(bool on)
+    {
+        if (on == held)
+            return;
+        held = on;
+        if (on)
+        {
+            TRACE_W("[Watering] Hold: stopping %u running zone(s)", activeCount);
+            for (uint16_t i = 0; i < activeCount; i++)
+                stopZone(activeZones[i]);
+        }
+        else
+        {
+            TRACE_I("[Watering] Hold released, %u zone(s) waiting", readyCount);
+        }
+    }
+
+    bool isHeld() { return held; }
+
+    // [控制任务] 机队供电名额 (PowerLease 的结果)；不接机队协调时一直为 true
+    // 失去名额 (租约没续上) 时正在运行的区域立即停泵 (记为中止)，到期的计划和排队的手动运行留着等下一次名额
+    void setPowerPermit(bool ok)
+    {
+        if (ok == powerOk)
+            return;
+        powerOk = ok;
+        if (!ok && activeCount > 0)
+        {
+            TRACE_W("[Watering] Power slot lost: stopping %u running zone(s)", activeCount);
+            for (uint16_t i = 0; i < activeCount; i++)
+                stopZone(activeZones[i]);
+        }
+    }
+
+    bool hasPowerPermit() { return powerOk; }
+
+    // 是否需要供电名额：有区域在运行，或者有到期的计划 / 手动运行在等
+    // 暂停 (固件升级) 期间不启动新的运行，不占名额
+    bool needsPower()
+    {
+        if (activeCount > 0)
+            return true;
+        if (held)
+            return false;
+        return pendingZone >= 0 || (systemEnabled && readyCount > 0);
     }
 
     // 2. 新增：彻底终止接口
@@ -236,17 +1110,18 @@ public:
         if (!systemEnabled)
             return; // 已经死了，不用再杀
 
-        Serial.println("[Watering] KILL command received. Shutting down forever.");
+        TRACE_W("[Watering] KILL command received. Shutting down forever.");
 
         // 如果正在浇水，先立刻停下
-        if (isBusy)
+        if (isBusy())
             stopWatering();
 
         systemEnabled = false;
-        saveState(); // 写入 Flash，重启后依然保持“死亡”状态
+        saveEnabled(); // 写入 Flash，重启后依然保持“死亡”状态
 
         if (notifier)
             notifier("System KILLED. No more auto watering.");
+        emit(RunEventKind::Killed);
     }
 
     // 3. (可选) 新增：复活接口
@@ -255,139 +1130,191 @@ public:
         if (systemEnabled)
             return;
 
-        Serial.println("[Watering] Revive command received.");
+        TRACE_I("[Watering] Revive command received.");
         systemEnabled = true;
-        saveState();
+        saveEnabled();
+
+        // 停用期间错过的计划不补，下一次 update() 按当前时间重新排期
+        scheduleValid = false;
 
         if (notifier)
             notifier("System Revived. Back online.");
+        emit(RunEventKind::Revived);
     }
 
     // 核心接口：接收时间，执行逻辑
     // 这个函数不需要自己去获取时间，而是由外部传入
     void update(struct tm &currentTime)
     {
+        update(EpochTime::toLocalEpoch(currentTime));
+    }
+
+    // 同上，直接传入本地 epoch 秒
+    // 没有区域到期时只看一眼堆顶，开销 O(1)，与区域数量无关
+    void update(int64_t now)
+    {
+        // 时间照常记录 (手动浇水的历史记录要用)
+        lastNow = now;
+        lastNowMs = (uint32_t)millis();
+        timeKnown = true;
+
+        // 排队的手动运行先走 (拿到名额后 update() 会被立即调用)
+        startPending();
+
         // 如果系统被 kill 了，直接忽略自动逻辑
         if (!systemEnabled)
         {
             return;
         }
 
-        if (isBusy)
-            return; // 忙碌中，跳过
+        if (!scheduleValid)
+            rescheduleAll();
 
-        // 1. 询问大脑
-        bool shouldRun = logic.shouldStart(
-            currentTime.tm_hour,
-            currentTime.tm_min,
-            currentTime.tm_yday,
-            wateredCount,
-            lastWateredDay,
-            hasWateredToday);
-
-        // 2. 执行
-        if (shouldRun)
+        // 1. 询问堆顶：只有到期的区域才会被唤醒
+        //    上次检查之后到期的全部出堆，逐个按错过策略结算 (停顿多久都不会漏看)
+        uint16_t zone;
+        bool settled = false;
+        for (int64_t fireAt = scheduler.nextFireAt(); scheduler.popDue(now, zone); fireAt = scheduler.nextFireAt())
         {
-            activatePump();
-
-            // 更新状态
-            wateredCount++;
-            lastWateredDay = currentTime.tm_yday;
-            hasWateredToday = true;
-
-            saveState();
-
-            // MTEST:START:模拟隔天
-            #ifdef SYSTEM_MANUAL_TEST
-            if (SYSTEM_MANUAL_TEST)
-            {
-                for (int k = 0; k < 200; k++)
-                {
-                    delay(50);
-
-                    // 频繁处理 OTA 和 MQTT
-                    if (yieldHandler)
-                        yieldHandler();
-                }
-            }
-            #endif
-            // MTEST:END
+            handleDue(zone, fireAt, now);
+            settled = true;
         }
+        if (settled)
+            saveCheckpoint(now);
 
-        // 3. 重置防抖
-        if (currentTime.tm_hour != logic.targetHour)
+        // 2. 执行 (只启动状态机，计数与存档在运行结束时完成)
+        //    达到同时运行上限时留在队列里，等运行中的区域结束再说
+        //    暂停期间 (固件升级) 或没有供电名额时不启动，队列保留
+        while (!held && powerOk && activeCount < maxConcurrentRuns && readyCount > 0)
         {
-            hasWateredToday = false;
+            zone = readyZones[readyHead];
+            readyHead = (readyHead + 1) % WATERING_MAX_ZONES;
+            readyCount--;
+            if (zones[zone].pump.isIdle())
+                activatePump(zone, false, zones[zone].dueDay);
         }
     }
 
+    // 停止所有正在运行的区域
     void stopWatering()
     {
-        if (isBusy)
+        if (cancelPending(-1) && !isBusy())
+            return;
+        if (isBusy())
         {
-            Serial.println("[Watering] Stopping current session...");
-            stopRequested = true; // 设置标志位
+            TRACE_I("[Watering] Stopping current session...");
+            for (uint16_t i = 0; i < activeCount; i++)
+                stopZone(activeZones[i]);
         }
         else
         {
             // 如果没在浇水，也可以发个通知
-            if (notifier)
-                notifier("Ignored: Not watering");
+            reject(RejectReason::NotWatering, "Ignored: Not watering");
         }
     }
 
+    // 停止指定区域
+    void stopWatering(int zone)
+    {
+        if (cancelPending(zone))
+            return;
+        if (isBusy(zone))
+        {
+            TRACE_I("[Watering] Stopping Zone %d...", zone);
+            stopZone(zone);
+        }
+        else
+        {
+            reject(RejectReason::NotWatering, "Ignored: Not watering", zone);
+        }
+    }
+
+    // 状态机立即进入 Stopping，这里同步断开继电器，不等下一个 tick
+    void stopZone(int zone)
+    {
+        WateringZone &z = zones[zone];
+        z.pump.requestStop(millis());
+        applyRelay(z);
+    }
+
     void resetSystem()
     {
         // 1. 安全检查：如果正在浇水，禁止重置！
         // 因为浇水结束时会写入一次 Count，会覆盖掉你现在的重置操作。
-        if (isBusy)
+        if (isBusy())
         {
-            Serial.println("[System] Cannot Reset: System is Busy watering.");
-            if (notifier)
-                notifier("Reset Failed: System is Busy");
+            TRACE_W("[System] Cannot Reset: System is Busy watering.");
+            reject(RejectReason::Busy, "Reset Failed: System is Busy");
             return;
         }
 
-        // 2. 执行重置
-        wateredCount = 0;
-        lastWateredDay = -999;
-        hasWateredToday = false;
+        // 2. 执行重置 (所有区域，一条记录原子写入)
+        for (int i = 0; i < zoneCount; i++)
+        {
+            zones[i].wateredCount = 0;
+            zones[i].lastWateredDay = WateringLogic::NEVER_WATERED;
+            if (enableStorage)
+                stageZone(i);
+        }
+        if (enableStorage)
+            journal.commit();
 
         // 注意：不要修改 systemEnabled，保持它的独立性
 
-        saveState();
+        scheduleValid = false;
 
-        Serial.println("[System] Task Reset. Counter back to 0.");
+        TRACE_I("[System] Task Reset. Counter back to 0.");
         if (notifier)
             notifier("System Reset: Counter=0");
+        emit(RunEventKind::Reset);
     }
 
-    int getCount() { return wateredCount; }
+    int getCount() { return getWateredCount(0); }
 
-    // 导出系统信息 (JSON 格式)
-    String getSystemInfoJson()
-    {
-        String json = "{";
+    // 历史记录总数
+    uint32_t getHistorySize() { return history.size(); }
 
-        // 1. 当前运行状态
-        json += "\"status\": \"" + String(systemEnabled ? "ACTIVE" : "KILLED") + "\",";
-        json += "\"is_busy\": " + String(isBusy ? "true" : "false") + ",";
-
-        // 2. 进度信息
-        json += "\"cycle_current\": " + String(wateredCount) + ",";
-        json += "\"cycle_max\": " + String(logic.maxCycles) + ",";
+    // 按页读取历史 (第 0 页最新)，可以在网络任务里调用
+    uint16_t readHistory(uint32_t page, uint16_t pageSize, RunRecord *out) { return history.readPage(page, pageSize, out); }
 
-        // 3. 配置参数 (这些值来自你的宏)
-        json += "\"interval_days\": " + String(logic.intervalDays) + ",";
-        json += "\"duration_sec\": " + String(durationSec) + ",";
-        json += "\"start_time\": \"" + String(logic.targetHour) + ":" + String(logic.targetMin < 10 ? "0" : "") + String(logic.targetMin) + "\",";
-
-        // 4. 系统开关
-        json += "\"persistence\": " + String(enableStorage ? "on" : "off");
-
-        json += "}";
-        return json;
+    // [控制任务] 把当前状态拷进快照 (网络任务从快照编码状态 JSON / 状态帧，不直接读区域状态)
+    void captureStatus(SystemStatus &s)
+    {
+        s.enabled = systemEnabled;
+        s.busy = isBusy();
+        s.held = held;
+        s.powerOk = powerOk;
+        s.persistence = enableStorage;
+        s.zoneCount = zoneCount;
+        s.nextFire = scheduler.nextFireAt();
+        s.missed = getMissedCount();
+        int n = zoneCount > 0 ? zoneCount : 1; // 没有区域时顶层字段取默认的区域 0
+        for (int i = 0; i < n; i++)
+        {
+            const WateringZone &z = zones[i];
+            ZoneStatus &o = s.zones[i];
+            o.relayPin = z.relayPin;
+            o.busy = !z.pump.isIdle();
+            o.relay = z.relayActive;
+            o.hasMeter = z.meter != nullptr;
+            o.count = z.wateredCount;
+            o.maxCycles = z.logic.maxCycles;
+            o.intervalDays = z.logic.intervalDays();
+            o.durationSec = z.durationSec;
+            o.startMinute = z.logic.targetHour() * 60 + z.logic.targetMin();
+            o.timesPerDay = z.logic.schedule.timesPerDay();
+            o.lastDay = z.lastWateredDay;
+            o.missed = z.missedCount;
+            o.moisture = z.moisture;
+            o.moistureThreshold = z.logic.moistureThreshold;
+            o.skipped = z.skippedCount;
+            o.doseMl = z.doseMl;
+            o.lastVolumeMl = z.lastVolumeMl;
+            o.totalVolumeMl = z.totalVolumeMl;
+            o.flowMlPerMin = z.dose.metering() ? z.dose.flowMlPerMin() : 0;
+            o.capped = z.cappedCount;
+        }
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,322 @@
+#ifndef WIRE_PROTOCOL_H
+#define WIRE_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../ControlBus/ControlBus.h"     // Command
+#include "../WateringCore/RunEvent.h"     // 运行事件
+#include "../HistoryLog/HistoryLog.h"     // RunRecord
+
+// 二进制指令 / 事件 / 状态协议 (和文本 topic 并行，给后台程序用；文本 topic 照旧给人看)
+// 定长字段、小端，没有可变长编码：两端都是按偏移读写，不需要解析器
+//
+// 帧头 (8 字节，所有帧相同)：
+//   [0] magic 0x57 ('W')   [1] version   [2] type   [3] flags   [4..7] seq (u32)
+//   seq：发送方自己的递增序号 (设备每次启动从 0 开始，第一帧带 FLAG_BOOT)，后台据此发现丢帧和重启
+//   同一 version 内只会在帧尾追加字段：解码方忽略多出来的字节，缺字段的旧帧按默认值处理；不兼容的改动才升 version
+//
+// 帧体 (type)：
+//   0x01 Command  后台 -> 设备   verb u8, zone i16 (-1 = 默认), arg i32                          共 15 字节
+//                                (start 的 arg 是秒数，超过 WATERING_MAX_MANUAL_SEC 应答 bad_argument)
+//   0x02 Ack      设备 -> 后台   cmdSeq u32, result u8                                          共 13 字节
+//   0x10 Event    设备 -> 后台   kind u8, zone u8, flags u8, cycle u16, max u16, durationSec u16,
+//                                volumeMl i32, aux u32 (含义见 RunEvent.h)                       共 25 字节
+//   0x20 Status   设备 -> 后台   flags u8, zoneCount u8, nextFire u32, missed u32, 每个区域 28 字节 (见 SystemStatus::write)
+//   0x21 History  设备 -> 后台   page u32, total u32, n u8, 每条 start u32, durationSec u16, zone u8, flags u8
+namespace Wire
+{
+    const uint8_t MAGIC = 0x57;
+    const uint8_t VERSION = 1;
+    const size_t HEADER_BYTES = 8;
+    const uint8_t FLAG_BOOT = 0x01; // 设备启动后的第一帧 (seq 从这里重新开始)
+
+    enum class MsgType : uint8_t
+    {
+        Command = 0x01,
+        Ack = 0x02,
+        Event = 0x10,
+        Status = 0x20,
+        History = 0x21
+    };
+
+    // 指令的线上编号 (和 CommandType 的内部顺序无关，只能追加)
+    enum class Verb : uint8_t
+    {
+        Start = 1,
+        Stop = 2,
+        Reset = 3,
+        Kill = 4,
+        Revive = 5,
+        Info = 6,
+        History = 7,
+        Dose = 8
+    };
+
+    enum class AckResult : uint8_t
+    {
+        Accepted = 0,
+        Duplicate = 1,   // 同一个 seq 已经执行过 (QoS1 重发)，这次不再执行
+        QueueFull = 2,
+        BadArgument = 3,
+        Unsupported = 4  // 版本或 verb 不认识
+    };
+
+    enum class ParseResult : uint8_t
+    {
+        Ok,
+        NotWire,     // 太短或 magic 不对
+        BadVersion,
+        BadType,
+        BadArgument
+    };
+
+    // 状态帧的标志位
+    const uint8_t STATUS_ENABLED = 0x01;
+    const uint8_t STATUS_BUSY = 0x02;
+    const uint8_t STATUS_HELD = 0x04;
+    const uint8_t STATUS_POWER = 0x08;       // 有供电名额 (没接机队协调时一直为 1)
+    const uint8_t STATUS_PERSISTENCE = 0x10;
+
+    // 状态帧里每个区域的标志位
+    const uint8_t ZONE_BUSY = 0x01;
+    const uint8_t ZONE_RELAY = 0x02;
+    const uint8_t ZONE_METER = 0x04;
+
+    // 历史记录的标志位
+    const uint8_t RUN_ABORTED = 0x01;
+    const uint8_t RUN_MANUAL = 0x02;
+
+    // 小端写入；buf 为 nullptr 时只数长度 (先算长度、再写进发送缓冲区)
+    class Encoder
+    {
+    private:
+        uint8_t *buf;
+        size_t cap;
+        size_t skip; // 只保存第 skip 字节起的 cap 字节 (分段发布时一次编码一段)
+        size_t len = 0;
+        bool overflow = false;
+
+        void put(uint32_t v, uint8_t bytes)
+        {
+            if (buf && len + bytes > skip + cap)
+                overflow = true;
+            for (uint8_t i = 0; i < bytes; i++, len++)
+            {
+                if (buf && len >= skip && len - skip < cap)
+                    buf[len - skip] = (uint8_t)(v >> (8 * i));
+            }
+        }
+
+    public:
+        Encoder(uint8_t *buf = nullptr, size_t cap = 0, size_t skip = 0) : buf(buf), cap(cap), skip(skip) {}
+
+        void u8(uint8_t v) { put(v, 1); }
+        void u16(uint16_t v) { put(v, 2); }
+        void u32(uint32_t v) { put(v, 4); }
+        void i16(int16_t v) { put((uint16_t)v, 2); }
+        void i32(int32_t v) { put((uint32_t)v, 4); }
+
+        void header(MsgType type, uint32_t seq, uint8_t flags = 0)
+        {
+            u8(MAGIC);
+            u8(VERSION);
+            u8((uint8_t)type);
+            u8(flags);
+            u32(seq);
+        }
+
+        size_t length() const { return len; }
+        bool ok() const { return !overflow; }
+    };
+
+    // 小端读取；越界读到 0 并记下，帧尾缺字段时按默认值处理
+    class Reader
+    {
+    private:
+        const uint8_t *p;
+        size_t len;
+        size_t at = 0;
+
+        uint32_t get(uint8_t bytes)
+        {
+            uint32_t v = 0;
+            for (uint8_t i = 0; i < bytes; i++, at++)
+            {
+                if (at < len)
+                    v |= (uint32_t)p[at] << (8 * i);
+            }
+            return v;
+        }
+
+    public:
+        Reader(const uint8_t *p, size_t len) : p(p), len(len) {}
+
+        uint8_t u8() { return (uint8_t)get(1); }
+        uint16_t u16() { return (uint16_t)get(2); }
+        uint32_t u32() { return get(4); }
+        int16_t i16() { return (int16_t)get(2); }
+        int32_t i32() { return (int32_t)get(4); }
+
+        // 到目前为止读的字段都在帧内
+        bool complete() const { return at <= len; }
+    };
+
+    struct Header
+    {
+        MsgType type;
+        uint8_t flags;
+        uint32_t seq;
+    };
+
+    inline ParseResult parseHeader(Reader &r, size_t len, Header &h)
+    {
+        if (len < HEADER_BYTES || r.u8() != MAGIC)
+            return ParseResult::NotWire;
+        if (r.u8() != VERSION)
+            return ParseResult::BadVersion;
+        h.type = (MsgType)r.u8();
+        h.flags = r.u8();
+        h.seq = r.u32();
+        return ParseResult::Ok;
+    }
+
+    // 设备端：解码一条 Command 帧；seq 在帧头合法时就会填上 (用于回 Ack)
+    inline ParseResult parseCommand(const uint8_t *payload, size_t len, uint32_t &seq, Command &out)
+    {
+        Reader r(payload, len);
+        Header h;
+        ParseResult pr = parseHeader(r, len, h);
+        if (pr != ParseResult::Ok)
+            return pr;
+        seq = h.seq;
+        if (h.type != MsgType::Command)
+            return ParseResult::BadType;
+        uint8_t verb = r.u8();
+        int16_t zone = r.i16();
+        int32_t arg = r.i32();
+        if (!r.complete())
+            return ParseResult::BadArgument;
+
+        static const CommandType TYPES[] = {CommandType::Start, CommandType::Stop, CommandType::Reset, CommandType::Kill,
+                                            CommandType::Revive, CommandType::Info, CommandType::History, CommandType::Dose};
+        if (verb < (uint8_t)Verb::Start || verb > (uint8_t)Verb::Dose)
+            return ParseResult::BadType;
+        out.type = TYPES[verb - 1];
+        if (zone < -1 || arg < 0 || (out.type == CommandType::Dose && arg == 0) ||
+            (out.type == CommandType::Start && arg > WATERING_MAX_MANUAL_SEC))
+            return ParseResult::BadArgument;
+        out.zone = zone;
+        out.arg = arg;
+        return ParseResult::Ok;
+    }
+
+    // 后台 / 测试端：编码一条指令
+    inline void writeCommand(Encoder &e, uint32_t seq, Verb verb, int16_t zone = -1, int32_t arg = 0)
+    {
+        e.header(MsgType::Command, seq);
+        e.u8((uint8_t)verb);
+        e.i16(zone);
+        e.i32(arg);
+    }
+
+    inline void writeAck(Encoder &e, uint32_t seq, uint8_t flags, uint32_t cmdSeq, AckResult result)
+    {
+        e.header(MsgType::Ack, seq, flags);
+        e.u32(cmdSeq);
+        e.u8((uint8_t)result);
+    }
+
+    inline void writeEvent(Encoder &e, uint32_t seq, uint8_t flags, const RunEvent &ev)
+    {
+        e.header(MsgType::Event, seq, flags);
+        e.u8((uint8_t)ev.kind);
+        e.u8(ev.zone);
+        e.u8(ev.flags);
+        e.u16(ev.cycle);
+        e.u16(ev.maxCycles);
+        e.u16(ev.durationSec);
+        e.i32(ev.volumeMl);
+        e.u32(ev.aux);
+    }
+
+    inline bool parseEvent(const uint8_t *payload, size_t len, Header &h, RunEvent &ev)
+    {
+        Reader r(payload, len);
+        if (parseHeader(r, len, h) != ParseResult::Ok || h.type != MsgType::Event)
+            return false;
+        ev.kind = (RunEventKind)r.u8();
+        ev.zone = r.u8();
+        ev.flags = r.u8();
+        ev.cycle = r.u16();
+        ev.maxCycles = r.u16();
+        ev.durationSec = r.u16();
+        ev.volumeMl = r.i32();
+        ev.aux = r.u32();
+        return r.complete();
+    }
+
+    // 本地 epoch 秒压成 u32 (到 2106 年)；未同步 (0) 和负数都写 0
+    inline uint32_t epoch32(int64_t t) { return t <= 0 ? 0 : (t > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)t); }
+
+    inline void writeHistory(Encoder &e, uint32_t seq, uint8_t flags, uint32_t page, uint32_t total, const RunRecord *runs, uint8_t n)
+    {
+        e.header(MsgType::History, seq, flags);
+        e.u32(page);
+        e.u32(total);
+        e.u8(n);
+        for (uint8_t i = 0; i < n; i++)
+        {
+            e.u32(epoch32(runs[i].start));
+            e.u16(runs[i].durationSec > 0xFFFF ? 0xFFFF : (uint16_t)runs[i].durationSec);
+            e.u8((uint8_t)runs[i].zone);
+            e.u8((runs[i].aborted ? RUN_ABORTED : 0) | (runs[i].trigger == RunTrigger::Manual ? RUN_MANUAL : 0));
+        }
+    }
+
+    // 设备发出的帧序号：单线程使用 (网络任务)
+    class Sequencer
+    {
+    private:
+        uint32_t seq = 0;
+
+    public:
+        // 返回这一帧的 seq，flags 带上 FLAG_BOOT (启动后第一帧)
+        uint32_t next(uint8_t &flags)
+        {
+            flags = seq == 0 ? FLAG_BOOT : 0;
+            return seq++;
+        }
+    };
+
+    // 最近执行过的指令 seq：QoS1 重发的同一条指令只执行一次
+    // 只有真正投递出去的指令才 remember()，队列满被拒的指令后台可以用同一个 seq 重试
+    class CommandDedup
+    {
+    private:
+        static const uint8_t DEPTH = 8;
+        uint32_t recent[DEPTH];
+        uint8_t count = 0;
+        uint8_t head = 0;
+
+    public:
+        bool seen(uint32_t seq) const
+        {
+            for (uint8_t i = 0; i < count; i++)
+            {
+                if (recent[i] == seq)
+                    return true;
+            }
+            return false;
+        }
+
+        void remember(uint32_t seq)
+        {
+            recent[head] = seq;
+            head = (head + 1) % DEPTH;
+            if (count < DEPTH)
+                count++;
+        }
+    };
+}
+
+#endif
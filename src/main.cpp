@@ -6,58 +6,783 @@
 #include "WateringSystem.h"
 #include "MqttManager.h"
 #include "OtaManager.h" // 引入 OTA
+#include "ControlBus.h"
+#include "SeqLock.h"
+#include "CommandParser.h"
+#include "WakeableTask.h"
+#include "WakePlanner.h"
+#include "PowerManager.h"
+#include "Metrics.h"
+#include "HeapStats.h"
+#include "MemoryPool.h"
+#ifdef WATERING_METRICS
+#include "HeapCountNew.h" // 统计 operator new 调用次数：稳态下 heap.new_calls 不应该再涨 (只能在这一个文件里包含)
+#endif
+#include "Trace.h"
+#include "MoistureAdc.h"
+#include "FlowMeter.h"
+#include "PowerLease.h"
+#include "WireProtocol.h"
 
 // ================= 实例化模块 =================
 NetworkManager wifiMgr(WIFI_SSID, WIFI_PASSWORD);
 TimeManager timeMgr;
-// 使用 secrets.ini 里的 OTA_PASS 密码
-OtaManager otaMgr("esp32-watering", OTA_PASS);
+// 使用 secrets.ini 里的 OTA_PASS 密码；升级时通过 otaGate 与控制 / 网络任务握手
+OtaGate otaGate;
+OtaManager otaMgr("esp32-watering", OTA_PASS, otaGate);
 MqttManager mqttMgr(MQTT_SERVER, MQTT_PORT, MQTT_USER, MQTT_PASS);
+PowerManager powerMgr;
+
+// 浇水计划：默认由 START_HOUR / START_MINUTE / INTERVAL_DAYS 组成每天一次的计划
+// 在 build_flags 里加 '-D SYSTEM_WATERING_SCHEDULE="06:00,18:30 mon-fri apr-oct /2d"' 可以改用日历计划 (格式见 Schedule.h)，
+// 编译期展开成位图，格式写错直接编译失败
+#ifdef SYSTEM_WATERING_SCHEDULE
+constexpr Schedule wateringSchedule = Schedule::parse(SYSTEM_WATERING_SCHEDULE);
+static_assert(wateringSchedule.isValid(), "SYSTEM_WATERING_SCHEDULE: invalid schedule spec");
+#else
+constexpr Schedule wateringSchedule = Schedule::daily(SYSTEM_WATERING_START_HOUR, SYSTEM_WATERING_START_MINUTE).every(SYSTEM_WATERING_INTERVAL_DAYS);
+static_assert(wateringSchedule.isValid(), "SYSTEM_WATERING_START_HOUR / MINUTE out of range");
+#endif
 
 // 传入 ENABLE_NVS 宏
-WateringSystem waterSys(SYSTEM_WATERING_PIN, SYSTEM_WATERING_DURATION, SYSTEM_WATERING_START_HOUR, SYSTEM_WATERING_START_MINUTE, SYSTEM_WATERING_INTERVAL_DAYS, SYSTEM_WATERING_COUNT, ENABLE_NVS);
+WateringSystem waterSys(SYSTEM_WATERING_PIN, SYSTEM_WATERING_DURATION, wateringSchedule, SYSTEM_WATERING_COUNT, ENABLE_NVS);
+
+// 多区域：在 build_flags 里加 -D SYSTEM_EXTRA_ZONE_PINS=5,6,7 追加继电器 (共用同一套计划参数)
+#ifdef SYSTEM_EXTRA_ZONE_PINS
+const int extraZonePins[] = {SYSTEM_EXTRA_ZONE_PINS};
+#endif
+
+// 土壤湿度 (可选)：build_flags 里加 -D SYSTEM_MOISTURE_CHANNELS=3,4 (ADC1 通道号，按区域顺序) 启用电容探头，
+// -D SYSTEM_MOISTURE_THRESHOLD=400 (千分比)：计划到点时土壤湿度不低于它就跳过；标定见 MoistureFilter.h (MOISTURE_DRY_RAW / WET_RAW)
+#ifdef SYSTEM_MOISTURE_CHANNELS
+#ifndef SYSTEM_MOISTURE_THRESHOLD
+#define SYSTEM_MOISTURE_THRESHOLD 400
+#endif
+const uint8_t moistureChannels[] = {SYSTEM_MOISTURE_CHANNELS};
+MoistureAdc moistureAdc;
+WakeableTask sensorTask; // 每 MOISTURE_PERIOD_MS 用 DMA 采一轮
+bool moistureReady = false;
+#endif
+
+// 流量计 (可选)：build_flags 里加 -D SYSTEM_FLOW_METER_PINS=17,18 (信号脚，按区域顺序，最多 4 个 PCNT 单元)，
+// -D SYSTEM_FLOW_PULSES_PER_LITRE=450 (标定)；再加 -D SYSTEM_WATERING_DOSE_ML=1500 时计划运行按量浇水，
+// 时长上限为 WATERING_DOSE_CAP_SEC；MQTT "start 500ml" 手动按量浇水
+#ifdef SYSTEM_FLOW_METER_PINS
+#ifndef SYSTEM_FLOW_PULSES_PER_LITRE
+#define SYSTEM_FLOW_PULSES_PER_LITRE FLOW_PULSES_PER_LITRE
+#endif
+const int flowMeterPins[] = {SYSTEM_FLOW_METER_PINS};
+static_assert(sizeof(flowMeterPins) / sizeof(flowMeterPins[0]) <= PCNT_UNIT_MAX, "SYSTEM_FLOW_METER_PINS: more meters than PCNT units");
+PcntCounter flowMeters[sizeof(flowMeterPins) / sizeof(flowMeterPins[0])];
+#endif
+
+// 机队供电名额 (可选)：几台控制器共用一路电源时，build_flags 里加 -D SYSTEM_POWER_SLOTS=2，
+// 整个机队同时最多 2 台水泵在转；名额经 broker 上 POWER_LEASE_TOPIC 下的保留消息协调 (见 PowerLease.h)
+// 网络任务维护租约，控制任务只看 powerGate：没拿到名额时计划和手动运行排队
+#ifdef SYSTEM_POWER_SLOTS
+PowerLease powerLease;
+PowerGate powerGate;
+char powerTopic[48]; // POWER_LEASE_TOPIC/<MAC 后 3 字节>，发布时只保存指针
+#endif
+
+// 二进制协议 (可选)：build_flags 里加 -D SYSTEM_BINARY_PROTOCOL，在文本 topic 之外
+// MQTT_TOPIC_CMD_BIN 收二进制指令，MQTT_TOPIC_STATUS_BIN 发应答 / 运行事件 / 状态 / 历史 (帧格式见 WireProtocol.h)
+// 文本 topic 照常工作；二进制的序号、去重都只在网络任务里读写
+#ifdef SYSTEM_BINARY_PROTOCOL
+#ifndef MQTT_TOPIC_CMD_BIN
+#define MQTT_TOPIC_CMD_BIN MQTT_TOPIC_CMD "/bin"
+#endif
+#ifndef MQTT_TOPIC_STATUS_BIN
+#define MQTT_TOPIC_STATUS_BIN MQTT_TOPIC_STATUS "/bin"
+#endif
+Wire::Sequencer wireSeq;
+Wire::CommandDedup wireDedup;
+#endif
+
+// ================= 内存布局 =================
+// 热数据 (区域表、调度堆、控制总线队列、水泵状态机、跟踪环形缓冲) 是内部 RAM 里的静态变量，每个节拍都要访问；
+// 大块、冷的缓冲区启动时从 bulkArena 一次切好：有 PSRAM (N16R8 上 8MB) 时整块在 PSRAM，
+// 没有时退回内部 RAM 的 MEM_BULK_INTERNAL_BYTES，MQTT 断线缓存相应改用小尺寸
+//   MQTT 断线缓存 + 发送缓冲区、拉取升级的解压 / 补丁缓冲、状态快照、历史页 (historyPages：网络任务借还的定长槽)
+const uint16_t HISTORY_PAGE_SIZE = 20;  // history 指令每页的记录数
+const uint16_t HISTORY_PAGE_SLOTS = 2;  // 同时在编码的历史页 (文本 + 二进制各一页)
+
+// 状态快照分段发布，不必整条放进发送缓冲区；整条发布的历史页要放得下
+static_assert(HISTORY_PAGE_SIZE * 160 + 256 <= MQTT_TX_BYTES, "history page JSON must fit the tx buffer");
+// 状态 JSON 里区域以外的统计 (outbox / mqtt / wifi / heap / arenas / pools / power)：开始上报时先写成文本，
+// 分段发布的每一段原样重放 (这些数在写出的过程中会变)
+#ifndef STATUS_JSON_EXTRA_BYTES
+#define STATUS_JSON_EXTRA_BYTES 3072
+#endif
+
+// 分区里除断线缓存以外的部分 (对齐按每块 8 字节留余量)；没有 PSRAM 的板子嫌大时调小 WATERING_MAX_ZONES (每个区域两份快照)
+constexpr uint32_t MEM_BULK_FIXED_BYTES = MQTT_TX_BYTES + sizeof(Ota::PullUpdater) + sizeof(HttpSource) +
+                                          sizeof(SeqLock<SystemStatus>) + sizeof(SystemStatus) + STATUS_JSON_EXTRA_BYTES +
+                                          HISTORY_PAGE_SLOTS * (sizeof(RunRecord) * HISTORY_PAGE_SIZE + sizeof(uint16_t)) + 8 * 8;
+#ifndef MEM_BULK_PSRAM_BYTES
+#define MEM_BULK_PSRAM_BYTES (MQTT_OUTBOX_PSRAM_BYTES + MEM_BULK_FIXED_BYTES)
+#endif
+#ifndef MEM_BULK_INTERNAL_BYTES
+#define MEM_BULK_INTERNAL_BYTES (MQTT_OUTBOX_BYTES + MEM_BULK_FIXED_BYTES)
+#endif
+static_assert(MEM_BULK_PSRAM_BYTES >= MQTT_OUTBOX_PSRAM_BYTES + MEM_BULK_FIXED_BYTES, "MEM_BULK_PSRAM_BYTES too small for WATERING_MAX_ZONES");
+static_assert(MEM_BULK_INTERNAL_BYTES >= MQTT_OUTBOX_BYTES + MEM_BULK_FIXED_BYTES, "MEM_BULK_INTERNAL_BYTES too small for WATERING_MAX_ZONES");
+MemArena bulkArena;
+SlotPool historyPages;
+
+// 状态快照：控制任务收到 info 时填写 (顺序锁)，网络任务拷一份私有副本再编码，两遍序列化看到同一份数据
+SeqLock<SystemStatus> *statusBoard = nullptr; // [控制任务 / setup 写]
+SystemStatus *statusCopy = nullptr;           // [网络任务]
+
+// [控制任务 / setup] 拍一张状态快照
+void captureStatus()
+{
+    if (statusBoard)
+        statusBoard->write([](SystemStatus &s)
+                           { waterSys.captureStatus(s); });
+}
+
+// [网络任务] 取最近一张完整的快照；还没拍过 / 一直撞上控制任务在写时返回 nullptr
+const SystemStatus *readStatus()
+{
+    return statusBoard && statusBoard->read(*statusCopy) ? statusCopy : nullptr;
+}
+
+// [网络任务] 各分区 / 池的用量
+void writeMemory(JsonWriter &w)
+{
+    w.beginArray("arenas");
+    bulkArena.write(w);
+    w.endArray();
+    w.beginArray("pools");
+    historyPages.write(w);
+    w.endArray();
+}
+
+// ================= 任务划分 =================
+// 核心 0：网络任务 (WiFi / MQTT)，慢速 broker 或 TCP 卡顿只影响它自己；
+//        OTA 任务 (优先级更低)，一次上传从头到尾在它里面跑完
+// 核心 1：控制任务 (水泵状态机 + 定时)，优先级更高
+// 两者只通过 ControlBus 的两条无锁 SPSC 队列通信，投递后 wake() 对方
+// 两个任务都没有固定节拍：控制任务睡到下一个截止时刻 (水泵结束 / 计划触发)，
+// 网络任务空闲时放慢轮询，两者都阻塞时芯片进入 light sleep
+ControlBus bus;
+WakeableTask networkTask;
+WakeableTask controlTask;
+WakeableTask otaTask;
+WakeableTask traceTask; // 最低优先级：把 TRACE_x 记录编码后写到串口 (解码见 tools/trace_decode.py)
+
+const uint32_t NETWORK_TICK_MS = 10;        // 有积压 (断线缓存) 时的轮询间隔
+const uint32_t NETWORK_IDLE_TICK_MS = 100;  // 空闲时的轮询间隔 (指令延迟 < 100ms)
+const uint32_t CONTROL_MAX_SLEEP_MS = 10000; // 控制任务单次最长睡眠 (喂狗，看门狗 30s)
+const uint16_t TRACE_DRAIN_BATCH = 32;        // 跟踪任务每轮最多写出的记录数 (约 1KB)
+const uint32_t TRACE_IDLE_MS = 1000;          // 环形缓冲区空了之后多久再看一次
+const uint32_t MOISTURE_PERIOD_MS = 60000;    // 土壤湿度采样周期 (一轮几十 ms，其余时间 ADC 关闭)
+
+// 延迟指标 (build_flags 里定义 WATERING_METRICS 才编译进来)：每 METRICS_PUBLISH_MS 发布一次并清零
+#ifdef WATERING_METRICS
+#ifndef MQTT_TOPIC_METRICS
+#define MQTT_TOPIC_METRICS MQTT_TOPIC_STATUS "/metrics"
+#endif
+#ifndef METRICS_PUBLISH_MS
+#define METRICS_PUBLISH_MS 60000
+#endif
+uint32_t lastMetricsMs = 0;
+Metrics::WakeLateness controlLateness(Metrics::LoopLate);
+#endif
 
 // ================= 辅助函数 =================
-void reportDeviceStatus()
+#ifdef SYSTEM_POWER_SLOTS
+// [网络任务] 供电名额的状态 (租约只在网络任务里读写)
+void writePowerStatus(JsonWriter &w)
+{
+    int64_t now = 0;
+    uint16_t ms = 0;
+    timeMgr.getEpoch(now, ms);
+    const PowerLease::Stats &st = powerLease.getStats();
+    w.key("power");
+    w.beginObject();
+    w.field("id", powerLease.id());
+    w.field("state", PowerLease::stateName(powerLease.state()));
+    w.field("slots", SYSTEM_POWER_SLOTS);
+    w.field("holders", powerLease.holders(now));
+    w.field("position", powerLease.position(now));
+    w.field("grants", (long)st.grants);
+    w.field("lost", (long)st.lost);
+    w.field("local", (long)st.localGrants);
+    w.field("max_wait_sec", (long)st.maxWaitSec);
+    w.endObject();
+}
+#endif
+
+// [网络任务] 一次状态上报的数据：区域部分是快照副本，其余统计开始时已经写成文本
+// 分段发布时每一段都从这里从头序列化，每一遍的输出逐字节相同
+struct StatusReport
+{
+    const SystemStatus *status = nullptr;
+    char ip[16];
+    char *extra = nullptr; // 顶层的一串 "key":value (STATUS_JSON_EXTRA_BYTES，从 bulkArena 切)
+
+    void write(JsonWriter &w) const
+    {
+        w.beginObject();
+        w.field("event", "boot");
+        w.field("ip", ip);
+        w.key("system");
+        status->write(w);
+        if (extra[0])
+            w.raw(extra);
+        w.field("ota_version", "0.2.1");
+        w.endObject();
+    }
+};
+
+#ifdef SYSTEM_BINARY_PROTOCOL
+// [网络任务] 二进制状态帧 (和状态 JSON 的 system 部分对应)：seq 开始发布前取好，帧体来自同一份快照
+struct StatusFrame
+{
+    const SystemStatus *status = nullptr;
+    uint32_t seq = 0;
+    uint8_t flags = 0;
+
+    void write(Wire::Encoder &e) const
+    {
+        e.header(Wire::MsgType::Status, seq, flags);
+        status->write(e);
+    }
+};
+StatusFrame statusFrame;
+#endif
+
+// 待发的状态上报：info 可能在上一条还在分段写出时到达，先记下来，每拍推进一步 (statusTick)
+const uint8_t STATUS_JSON = 0x01;
+const uint8_t STATUS_BINARY = 0x02;
+#ifdef SYSTEM_BINARY_PROTOCOL
+const uint8_t STATUS_ALL = STATUS_JSON | STATUS_BINARY;
+#else
+const uint8_t STATUS_ALL = STATUS_JSON;
+#endif
+uint8_t statusWanted = 0; // [网络任务] 请求了、还没开始的
+uint8_t statusLeft = 0;   // [网络任务] 快照已经拷出来、还没发出的 (发完之前副本不能覆盖)
+StatusReport statusReport;
+
+// [网络任务] 请求上报 (控制任务已经拍好快照)；真正的发布在 statusTick 里
+void reportDeviceStatus(uint8_t parts = STATUS_ALL)
 {
+    statusWanted |= parts;
+}
+
+// [网络任务] 把统计字段写成文本，之后分段发布时原样重放
+void prepareStatusJson()
+{
+    IPAddress addr = WiFi.localIP();
+    snprintf(statusReport.ip, sizeof(statusReport.ip), "%u.%u.%u.%u", addr[0], addr[1], addr[2], addr[3]);
+    statusReport.status = statusCopy;
+    Heap::Report heap;
+    heap.take();
+
+    BufferSink sink(statusReport.extra, STATUS_JSON_EXTRA_BYTES);
+    JsonWriter w(sink); // 不开对象：顶层直接写 "key":value，逗号由 JsonWriter 补
+    w.key("outbox");
+    mqttMgr.writeOutboxStats(w);
+    w.key("mqtt");
+    mqttMgr.writeSessionStats(w);
+    w.key("wifi");
+    wifiMgr.writeStats(w);
+    w.key("heap");
+    heap.write(w);
+    writeMemory(w);
+#ifdef SYSTEM_POWER_SLOTS
+    writePowerStatus(w);
+#endif
+    if (sink.overflow())
+    {
+        TRACE_E("[Status] Stats exceed %u bytes, omitted", (uint32_t)STATUS_JSON_EXTRA_BYTES);
+        statusReport.extra[0] = '\0';
+    }
+}
+
+// [网络任务] 推进状态上报：上一条还在分段写出时等下一拍；一份快照先发 JSON、再发二进制帧
+// 从控制任务拍好的快照编码，不直接读区域状态
+void statusTick()
+{
+    if (!(statusWanted | statusLeft))
+        return;
     if (!mqttMgr.isConnected())
+    {
+        statusWanted = statusLeft = 0; // QoS0 快照：断线期间的不补
+        return;
+    }
+    if (mqttMgr.streaming())
+        return;
+
+    if (!statusLeft)
+    {
+        if (!readStatus())
+        {
+            TRACE_W("[Status] No consistent snapshot, report skipped");
+            statusWanted = 0;
+            return;
+        }
+        statusLeft = statusWanted;
+        statusWanted = 0;
+        if (statusLeft & STATUS_JSON)
+            prepareStatusJson();
+    }
+
+    if (statusLeft & STATUS_JSON)
+    {
+        if (mqttMgr.streamJson(MQTT_TOPIC_STATUS, statusReport))
+            statusLeft &= ~STATUS_JSON;
+        return;
+    }
+#ifdef SYSTEM_BINARY_PROTOCOL
+    if (statusLeft & STATUS_BINARY)
+    {
+        statusFrame.status = statusCopy;
+        statusFrame.seq = wireSeq.next(statusFrame.flags);
+        mqttMgr.streamBinary(MQTT_TOPIC_STATUS_BIN, statusFrame);
+        statusLeft &= ~STATUS_BINARY;
+    }
+#endif
+}
+
+// [网络任务] 上报一页浇水历史 (第 0 页最新)
+// 先把这一页拷到借来的槽里，再流式发布：两遍序列化看到的是同一份数据
+void reportHistory(uint32_t page)
+{
+    if (!mqttMgr.isConnected())
+        return;
+
+    PoolSlot slot(historyPages);
+    if (!slot.ok())
+        return;
+    RunRecord *runs = slot.as<RunRecord>();
+    uint16_t n = waterSys.readHistory(page, HISTORY_PAGE_SIZE, runs);
+    uint32_t total = waterSys.getHistorySize();
+
+    mqttMgr.publishJson(MQTT_TOPIC_STATUS, [&](JsonWriter &w)
+                        {
+        w.beginObject();
+        w.field("event", "history");
+        w.field("page", page);
+        w.field("pages", (total + HISTORY_PAGE_SIZE - 1) / HISTORY_PAGE_SIZE);
+        w.field("total", total);
+        w.beginArray("runs");
+        for (uint16_t i = 0; i < n; i++)
+        {
+            w.beginObject();
+            w.field("zone", runs[i].zone);
+            w.field("start", (long long)runs[i].start);
+            w.field("duration_sec", runs[i].durationSec);
+            w.field("aborted", runs[i].aborted);
+            w.field("trigger", runs[i].trigger == RunTrigger::Manual ? "manual" : "auto");
+            w.endObject();
+        }
+        w.endArray();
+        w.endObject(); });
+}
+
+#ifdef WATERING_METRICS
+// [网络任务] 发布一个统计窗口的延迟直方图摘要 (单位微秒)
+void reportMetrics()
+{
+    uint32_t nowMs = millis();
+    if (nowMs - lastMetricsMs < METRICS_PUBLISH_MS || !mqttMgr.isConnected())
+        return;
+
+    Metrics::Report report;
+    report.take(nowMs - lastMetricsMs);
+    lastMetricsMs = nowMs;
+    Heap::Report heap;
+    heap.take();
+    mqttMgr.publishJson(MQTT_TOPIC_METRICS, [&](JsonWriter &w)
+                        {
+        w.beginObject();
+        report.writeFields(w);
+        w.key("heap"); // 每个窗口一次：看最大块 / 最低空闲的长期趋势 (碎片化)
+        heap.write(w);
+        writeMemory(w);
+        w.endObject(); });
+}
+#endif
+
+// [网络任务] 升级进度有变化时发布 (OTA 任务只写 otaGate，不碰 MQTT)
+void reportOtaProgress()
+{
+    static uint16_t seen = 0;
+    OtaGate::Phase phase;
+    uint8_t pct;
+    if (!otaGate.poll(seen, phase, pct))
+        return;
+    char msg[64];
+    Ota::Result pull = otaMgr.lastPullResult();
+    if (phase == OtaGate::Phase::Failed && pull != Ota::Result::Ok)
+        snprintf(msg, sizeof(msg), "OTA: %s %u%% (%s)", OtaGate::phaseName(phase), pct, Ota::resultName(pull));
+    else
+        snprintf(msg, sizeof(msg), "OTA: %s %u%%", OtaGate::phaseName(phase), pct);
+    mqttMgr.publish(MQTT_TOPIC_STATUS, msg);
+}
+
+// [网络任务] "ota <url> <sha256>"：交给 OTA 任务去下载，返回是否是 ota 指令
+bool handleOtaCommand(const uint8_t *payload, unsigned int length)
+{
+    static Ota::Request req; // 只在网络任务里用，不占任务栈
+    Ota::ParseResult r = Ota::parseRequest(payload, length, req);
+    if (r == Ota::ParseResult::NotOta)
+        return false;
+    if (r == Ota::ParseResult::BadArgument)
+        mqttMgr.publish(MQTT_TOPIC_STATUS, "Ignored: Bad argument");
+    else if (!otaMgr.requestPull(req))
+        mqttMgr.publish(MQTT_TOPIC_STATUS, "Ignored: Firmware update in progress");
+    else
+    {
+        mqttMgr.publish(MQTT_TOPIC_STATUS, "OTA: downloading");
+        otaTask.wake();
+    }
+    return true;
+}
+
+#ifdef SYSTEM_POWER_SLOTS
+// [网络任务] POWER_LEASE_TOPIC/<id> 上的租约消息，返回是否是租约主题 (是的话调用方不再处理)
+bool handlePowerMessage(const char *topic, const uint8_t *payload, unsigned int length)
+{
+    static const size_t prefixLen = sizeof(POWER_LEASE_TOPIC "/") - 1;
+    if (strncmp(topic, POWER_LEASE_TOPIC "/", prefixLen) != 0)
+        return false;
+    int64_t now = 0;
+    uint16_t ms = 0;
+    if (timeMgr.getEpoch(now, ms)) // 没对时前看不懂到期时刻，重连后 broker 会再发一遍
+        powerLease.onMessage(topic + prefixLen, strlen(topic + prefixLen), payload, length, now);
+    return true;
+}
+
+// [网络任务] 推进租约：申请 / 续约 / 释放；结果有变化时叫醒控制任务
+void powerTick()
+{
+    int64_t now = 0;
+    uint16_t ms = 0;
+    if (!timeMgr.getEpoch(now, ms))
+        return;
+    uint32_t nextSec = 0;
+    bool ok = powerLease.tick(now, powerGate.wanted(), mqttMgr.isConnected(), [](const char *payload)
+                              { mqttMgr.publish(powerTopic, payload, true); }, nextSec);
+    if (powerGate.grant(ok))
+        controlTask.wake();
+}
+#endif
+
+#ifdef SYSTEM_BINARY_PROTOCOL
+// [网络任务] 二进制历史 (一页 HISTORY_PAGE_SIZE 条)
+void reportHistoryBinary(uint32_t page)
+{
+    if (!mqttMgr.isConnected())
+        return;
+    PoolSlot slot(historyPages);
+    if (!slot.ok())
         return;
-    String info = waterSys.getSystemInfoJson();
-    String ip = WiFi.localIP().toString();
-    String payload = "{\"event\":\"boot\", \"ip\":\"" + ip + "\", \"system\":" + info + ", \"ota_version\":\"0.2.1\"}";
-    mqttMgr.publish(MQTT_TOPIC_STATUS, payload.c_str());
+    RunRecord *runs = slot.as<RunRecord>();
+    uint16_t n = waterSys.readHistory(page, HISTORY_PAGE_SIZE, runs);
+    uint32_t total = waterSys.getHistorySize();
+    uint8_t flags = 0;
+    uint32_t seq = wireSeq.next(flags);
+    mqttMgr.publishBinary(MQTT_TOPIC_STATUS_BIN, [&](Wire::Encoder &e)
+                          { Wire::writeHistory(e, seq, flags, page, total, runs, (uint8_t)n); });
 }
 
+// [网络任务] 应答走 QoS1 缓存 (和文本通知一样保证送达、保序)
+void sendAck(uint32_t cmdSeq, Wire::AckResult result)
+{
+    uint8_t frame[Wire::HEADER_BYTES + 5];
+    uint8_t flags = 0;
+    uint32_t seq = wireSeq.next(flags);
+    Wire::Encoder e(frame, sizeof(frame));
+    Wire::writeAck(e, seq, flags, cmdSeq, result);
+    mqttMgr.publish(MQTT_TOPIC_STATUS_BIN, frame, e.length());
+}
+
+// [网络任务] 控制任务产生的运行事件
+void sendRunEvent(const RunEvent &run)
+{
+    uint8_t frame[Wire::HEADER_BYTES + 17];
+    uint8_t flags = 0;
+    uint32_t seq = wireSeq.next(flags);
+    Wire::Encoder e(frame, sizeof(frame));
+    Wire::writeEvent(e, seq, flags, run);
+    mqttMgr.publish(MQTT_TOPIC_STATUS_BIN, frame, e.length());
+}
+
+// [网络任务] 一条二进制指令：先应答，再执行 (history 直接回复；其余投递给控制任务，info 的快照也由它拍)
+void handleBinaryCommand(const uint8_t *payload, unsigned int length)
+{
+    Command cmd;
+    uint32_t seq = 0;
+    Wire::ParseResult r = Wire::parseCommand(payload, length, seq, cmd);
+#ifdef WATERING_METRICS
+    cmd.receivedUs = (uint32_t)micros();
+#endif
+    if (r == Wire::ParseResult::NotWire)
+        return; // 连帧头都不是，没有可以应答的 seq
+    if (r != Wire::ParseResult::Ok)
+    {
+        sendAck(seq, r == Wire::ParseResult::BadArgument ? Wire::AckResult::BadArgument : Wire::AckResult::Unsupported);
+        return;
+    }
+    if (wireDedup.seen(seq))
+    {
+        sendAck(seq, Wire::AckResult::Duplicate);
+        return;
+    }
+    if (cmd.type == CommandType::Info)
+        cmd.arg = INFO_BINARY_ONLY; // 控制任务拍快照，网络任务只回状态帧
+    if (cmd.type != CommandType::History && !bus.postCommand(cmd))
+    {
+        sendAck(seq, Wire::AckResult::QueueFull);
+        return;
+    }
+    wireDedup.remember(seq);
+    sendAck(seq, Wire::AckResult::Accepted);
+    if (cmd.type == CommandType::History)
+        reportHistoryBinary((uint32_t)cmd.arg);
+    else
+        controlTask.wake();
+}
+#endif
+
+// [网络任务] 只做解析和投递，真正的动作在控制任务里执行
+// 直接在 payload 上解析，不构造 String，稳态下没有堆分配
 void onMqttMessage(char *topic, uint8_t *payload, unsigned int length)
 {
-    String msg = "";
-    for (int i = 0; i < length; i++)
-        msg += (char)payload[i];
-    Serial.printf("[MQTT] Recv [%s]: %s\n", topic, msg.c_str());
+    TRACE_D("[MQTT] Recv: %u bytes", length);
+
+#ifdef SYSTEM_POWER_SLOTS
+    if (handlePowerMessage(topic, payload, length))
+        return;
+#endif
+#ifdef SYSTEM_BINARY_PROTOCOL
+    if (strcmp(topic, MQTT_TOPIC_CMD_BIN) == 0)
+    {
+        handleBinaryCommand(payload, length);
+        return;
+    }
+#endif
+    if (strcmp(topic, MQTT_TOPIC_CMD) != 0)
+        return;
+
+    if (handleOtaCommand(payload, length))
+        return;
+
+    Command cmd;
+    CommandParser::Result r = CommandParser::parse(payload, length, cmd);
+#ifdef WATERING_METRICS
+    cmd.receivedUs = (uint32_t)micros();
+#endif
+    if (r == CommandParser::Result::Ok && cmd.type == CommandType::History)
+    {
+        reportHistory((uint32_t)cmd.arg); // 只读查询，不经过控制任务
+    }
+    else if (r == CommandParser::Result::Ok)
+    {
+        if (bus.postCommand(cmd))
+            controlTask.wake(); // 控制任务可能正睡到几小时后的计划时刻
+        else
+            mqttMgr.publish(MQTT_TOPIC_STATUS, "Ignored: Command queue full");
+    }
+    else if (r == CommandParser::Result::BadArgument)
+    {
+        mqttMgr.publish(MQTT_TOPIC_STATUS, "Ignored: Bad argument");
+    }
+}
 
-    if (String(topic) == MQTT_TOPIC_CMD)
+// [控制任务] 执行一条指令
+void dispatchCommand(const Command &cmd)
+{
+    int zone = cmd.zone < 0 ? 0 : cmd.zone;
+    switch (cmd.type)
     {
-        msg.toLowerCase();
-        if (msg == "start" || msg == "on")
-            waterSys.forceWatering();
-        else if (msg == "stop" || msg == "off")
+    case CommandType::Start:
+        waterSys.forceWatering(zone, cmd.arg); // arg: 可选的时长 (秒)
+        break;
+    case CommandType::Dose:
+        waterSys.forceWatering(zone, 0, (uint32_t)cmd.arg); // arg: 水量 (毫升)
+        break;
+    case CommandType::Stop:
+        if (cmd.zone < 0)
             waterSys.stopWatering();
-        else if (msg == "reset")
-            waterSys.resetSystem();
-        else if (msg == "kill")
-            waterSys.killSystem();
-        else if (msg == "revive")
-            waterSys.reviveSystem();
-        else if (msg == "info" || msg == "status")
-            reportDeviceStatus();
+        else
+            waterSys.stopWatering(zone);
+        break;
+    case CommandType::Reset:
+        waterSys.resetSystem();
+        break;
+    case CommandType::Kill:
+        waterSys.killSystem();
+        break;
+    case CommandType::Revive:
+        waterSys.reviveSystem();
+        break;
+    case CommandType::Info:
+        captureStatus(); // 先拍快照再叫网络任务：网络任务只读快照
+        bus.postEvent(cmd.arg == INFO_BINARY_ONLY ? EventType::ReportBinary : EventType::Report);
+        networkTask.wake();
+        break;
+    case CommandType::History:
+        break; // 网络任务已直接处理
     }
+
+    // start / stop 都在本次调用内同步驱动继电器
+    if (cmd.type == CommandType::Start || cmd.type == CommandType::Dose || cmd.type == CommandType::Stop)
+        METRIC_SINCE(CmdToRelay, cmd.receivedUs);
 }
 
+// [控制任务] 状态通知不直接碰 MQTT，交给网络任务发布
 void onWateringEvent(const char *statusMsg)
 {
-    mqttMgr.publish(MQTT_TOPIC_STATUS, statusMsg);
+    bus.postEvent(EventType::Notify, statusMsg);
+    networkTask.wake();
+}
+
+// [网络任务 / setup] 联网后才能启动的服务，只启动一次
+void startNetworkServices()
+{
+    static bool started = false;
+    if (started)
+        return;
+    started = true;
+
+    // OTA 服务 (handle 在 OTA 任务里)，WiFi 进入 modem sleep
+    otaMgr.begin([]()
+                 {
+        controlTask.wake();
+        networkTask.wake(); });
+    powerMgr.enableModemSleep();
 }
 
+// ================= 任务主体 =================
+// 返回值：下一次最晚多少毫秒后再运行
+uint32_t networkTick()
+{
+    METRIC_SCOPE(YieldInterval);
+
+    // 1. 网络维护：WiFi 重连是异步的 (退避期间这里直接返回)，WiFi 事件会叫醒本任务
+    uint32_t wifiWait = wifiMgr.loop();
+    if (wifiMgr.isConnected())
+    {
+        startNetworkServices(); // 启动时没连上的话，第一次连上后再启动 OTA
+        mqttMgr.connect(); // 非阻塞：已连上 / 退避中时什么都不做
+        mqttMgr.loop();    // 收到的指令在 onMqttMessage 里入队
+    }
+
+    // 3. 发布控制任务产生的事件
+    Event ev;
+    while (bus.events.pop(ev))
+    {
+        if (ev.type == EventType::Notify)
+            mqttMgr.publish(MQTT_TOPIC_STATUS, ev.text);
+        else if (ev.type == EventType::Report)
+            reportDeviceStatus();
+#ifdef SYSTEM_BINARY_PROTOCOL
+        else if (ev.type == EventType::ReportBinary)
+            reportDeviceStatus(STATUS_BINARY);
+        else if (ev.type == EventType::Run)
+            sendRunEvent(ev.run);
+#endif
+    }
+
+    statusTick();
+    reportOtaProgress();
+#ifdef WATERING_METRICS
+    reportMetrics();
+#endif
+#ifdef SYSTEM_POWER_SLOTS
+    powerTick(); // 每秒级的动作，网络任务最多 100ms 醒一次，不另算等待时间
+#endif
+
+    // 4. MQTT 握手中、补发断线缓存、等待确认或状态还没发完期间轮询快一点
+    bool flushing = mqttMgr.isBusy() || statusWanted || statusLeft;
+    uint32_t wait = flushing ? NETWORK_TICK_MS : NETWORK_IDLE_TICK_MS;
+    return wifiWait < wait ? wifiWait : wait;
+}
+
+uint32_t controlTick()
+{
+#ifdef WATERING_METRICS
+    controlLateness.onWake();
+#endif
+
+    // 1. 执行网络任务投递的指令 (投递后会 wake 这个任务，stop 延迟与睡眠无关)
+    Command cmd;
+    while (bus.commands.pop(cmd))
+        dispatchCommand(cmd);
+
+    // 2. 推进水泵状态机；固件升级期间暂停运行，水泵经状态机停稳后才放行写 Flash
+    bool hold = otaGate.holdWanted();
+    waterSys.setHold(hold);
+#ifdef SYSTEM_POWER_SLOTS
+    waterSys.setPowerPermit(powerGate.granted()); // 租约没续上时在这里停泵
+#endif
+    waterSys.loop();
+    if (hold && !waterSys.isBusy())
+        otaGate.grant();
+
+    // 3. 业务逻辑：没有区域到期时只看一眼堆顶
+    //    湿度是采样任务发布的原子量，计划到点时按它决定浇不浇
+#ifdef SYSTEM_MOISTURE_CHANNELS
+    for (uint8_t i = 0; i < moistureAdc.channelCount(); i++)
+        waterSys.setMoisture(i, moistureAdc.permille(i));
+#endif
+    int64_t now = 0;
+    uint16_t ms = 0;
+    bool timeKnown = timeMgr.getEpoch(now, ms);
+    if (timeKnown)
+        waterSys.update(now);
+#ifdef SYSTEM_POWER_SLOTS
+    // 有区域在等 / 在跑就申请名额，都结束了就释放 (网络任务拿到名额后叫醒这里)
+    if (powerGate.want(waterSys.needsPower()))
+        networkTask.wake();
+#endif
+
+    // 4. 睡到下一个截止时刻：水泵结束、计划触发 (对齐整秒)，最长 CONTROL_MAX_SLEEP_MS
+    powerMgr.holdAwake(waterSys.isBusy());
+    uint32_t wait = WakePlanner::sleepMs(timeKnown, now, ms, waterSys.getNextFireTime(),
+                                         waterSys.msUntilPumpDeadline(), CONTROL_MAX_SLEEP_MS);
+#ifdef WATERING_METRICS
+    controlLateness.arm(wait);
+#endif
+    return wait;
+}
+
+// 一次上传 / 拉取在 handle() 里跑完；空闲时每 OTA_POLL_MS 看一眼有没有升级请求
+uint32_t otaTick()
+{
+    return otaMgr.handle();
+}
+
+// 串口慢只会拖慢这个任务；还有积压就让出 CPU 后马上继续
+uint32_t traceTick()
+{
+    Trace::drain([](const uint8_t *frame, size_t len)
+                 { Serial.write(frame, len); }, TRACE_DRAIN_BATCH);
+    return Trace::ring().empty() ? TRACE_IDLE_MS : 0;
+}
+
+#ifdef SYSTEM_MOISTURE_CHANNELS
+// 采一轮 (阻塞在 DMA 读上，不轮询)，之后 ADC 关闭，睡到下一轮
+// 看门狗要求最多睡 CONTROL_MAX_SLEEP_MS，中途醒来只算剩余时间
+uint32_t sensorTick()
+{
+    static uint32_t lastBurstMs = 0;
+    static bool sampled = false;
+    uint32_t elapsed = millis() - lastBurstMs;
+    if (sampled && elapsed < MOISTURE_PERIOD_MS)
+        return MOISTURE_PERIOD_MS - elapsed;
+    lastBurstMs = millis();
+    sampled = true;
+    moistureAdc.sampleBurst();
+    return MOISTURE_PERIOD_MS;
+}
+#endif
+
 // ================= SETUP =================
 void setup()
 {
@@ -68,34 +793,87 @@ void setup()
 
     // 1. 初始化看门狗 (30秒超时)
     // 如果系统卡死超过30秒不喂狗，自动重启
+    // setup 期间由 Arduino 的 loopTask 喂狗，之后交给两个工作任务
     esp_task_wdt_init(30, true);
     esp_task_wdt_add(NULL);
 
     // 2. 初始化各模块
+#ifdef SYSTEM_EXTRA_ZONE_PINS
+    for (int pin : extraZonePins)
+        waterSys.addZone(pin, SYSTEM_WATERING_DURATION, wateringSchedule, SYSTEM_WATERING_COUNT);
+#endif
+#ifdef SYSTEM_MOISTURE_CHANNELS
+    for (uint8_t ch : moistureChannels)
+    {
+        int zone = moistureAdc.addChannel(ch);
+        waterSys.setMoistureThreshold(zone, SYSTEM_MOISTURE_THRESHOLD);
+    }
+    moistureReady = moistureAdc.begin();
+    if (!moistureReady)
+        Serial.println("[Moisture] ADC init failed, watering by clock only.");
+#endif
+#ifdef SYSTEM_FLOW_METER_PINS
+    for (size_t i = 0; i < sizeof(flowMeterPins) / sizeof(flowMeterPins[0]); i++)
+    {
+        if (!flowMeters[i].begin(flowMeterPins[i], (uint8_t)i))
+        {
+            Serial.printf("[Flow] PCNT unit %u init failed, zone %u waters by time.\n", (unsigned)i, (unsigned)i);
+            continue;
+        }
+        waterSys.setFlowMeter((int)i, &flowMeters[i], SYSTEM_FLOW_PULSES_PER_LITRE);
+#ifdef SYSTEM_WATERING_DOSE_ML
+        waterSys.setDose((int)i, SYSTEM_WATERING_DOSE_ML);
+#endif
+    }
+#endif
+#ifdef SYSTEM_POWER_SLOTS
+    waterSys.setPowerPermit(false); // 拿到名额之前不开泵
+#endif
     waterSys.begin();
     timeMgr.begin();
-    mqttMgr.begin(onMqttMessage);
+    powerMgr.begin();
+    if (!bulkArena.begin("bulk", MEM_BULK_PSRAM_BYTES, Heap::Where::Psram, MEM_BULK_INTERNAL_BYTES))
+        Serial.println("[Mem] Bulk arena allocation failed.");
+    mqttMgr.begin(onMqttMessage, bulkArena);
+    if (!otaMgr.reserve(bulkArena))
+        Serial.println("[Mem] No room for pull OTA buffers, push OTA only.");
+    historyPages.begin("history", bulkArena, sizeof(RunRecord) * HISTORY_PAGE_SIZE, HISTORY_PAGE_SLOTS);
+    statusBoard = bulkArena.make<SeqLock<SystemStatus>>();
+    statusCopy = bulkArena.make<SystemStatus>();
+    statusReport.extra = (char *)bulkArena.take(STATUS_JSON_EXTRA_BYTES);
+    if (!statusCopy || !statusReport.extra)
+        statusBoard = nullptr; // 没有副本就不发状态 (文本通知不受影响)
+    Serial.printf("[Mem] Bulk arena: %u/%u bytes in %s\n", (unsigned)bulkArena.usedBytes(),
+                  (unsigned)bulkArena.capacity(), bulkArena.inPsram() ? "PSRAM" : "internal RAM");
+#ifdef SYSTEM_POWER_SLOTS
+    {
+        uint8_t mac[6];
+        WiFi.macAddress(mac);
+        char id[8];
+        snprintf(id, sizeof(id), "%02x%02x%02x", mac[3], mac[4], mac[5]);
+        snprintf(powerTopic, sizeof(powerTopic), POWER_LEASE_TOPIC "/%s", id);
+        PowerLease::Config pc;
+        pc.slots = SYSTEM_POWER_SLOTS;
+        powerLease.begin(id, pc);
+        mqttMgr.subscribe(POWER_LEASE_TOPIC "/+", 1);
+    }
+#endif
 
     // 3. 绑定回调
     waterSys.setNotifier([](const char *msg)
                          { onWateringEvent(msg); });
+#ifdef SYSTEM_BINARY_PROTOCOL
+    waterSys.setEventSink([](const RunEvent &run)
+                          {
+        bus.postRun(run);
+        networkTask.wake(); });
+    mqttMgr.subscribe(MQTT_TOPIC_CMD_BIN, 1);
+#endif
 
-    // 绑定呼吸逻辑 (包含 MQTT 循环 和 喂狗)
-    waterSys.setYieldCallback([]()
-                              {
-        // 浇水时也要处理 MQTT，防止断连
-        if (wifiMgr.isConnected()) mqttMgr.loop(); 
-        // 关键：浇水时也要喂狗，防止浇水38秒超过看门狗30秒限制
-        esp_task_wdt_reset();
-        // 3. 【新增】处理 OTA 请求
-        // 这样即使正在浇水，也能接收固件升级！
-        otaMgr.handle();
-    });
-
-    
-
-    // 4. 启动网络 (带冷却机制，防止死循环)
-    wifiMgr.connect();
+    // 4. 启动网络：最多等 10 秒，之后的重连由网络任务异步完成 (WiFi 事件叫醒它)
+    wifiMgr.begin([]()
+                  { networkTask.wake(); });
+    wifiMgr.waitConnected(10000);
 
     // 5. 联网后操作
     if (wifiMgr.isConnected())
@@ -103,51 +881,41 @@ void setup()
         Serial.print("WiFi Connected. IP: ");
         Serial.println(WiFi.localIP());
 
-        // A. 启动 OTA 服务
-        otaMgr.begin();
+        // A. 启动 OTA 服务，WiFi 进入 modem sleep
+        startNetworkServices();
 
-        // B. 连接 MQTT 并上报
-        mqttMgr.connect();
-        reportDeviceStatus();
+        // B. 连接 MQTT 并上报 (最多等 5 秒，之后由网络任务继续)
+        mqttMgr.waitConnected(5000);
+        captureStatus(); // 控制任务还没启动，这里拍快照
+        reportDeviceStatus(); // 网络任务启动后分段发出
 
         // C. 同步时间
-        timeMgr.waitForSync();
+        timeMgr.waitForSync(); // 最多 10 秒，setup 期间的看门狗是 30 秒
     }
     else
     {
-        Serial.println("WiFi Failed! Running offline mode.");
+        Serial.println("WiFi Failed! Running offline mode, retrying in background.");
     }
 
+    // 6. 启动工作任务：控制任务优先级高于网络任务
+    networkTask.start("network", networkTick, NETWORK_IDLE_TICK_MS, 8192, 1, 0);
+    controlTask.start("control", controlTick, CONTROL_MAX_SLEEP_MS, 4096, 3, 1);
+    otaTask.start("ota", otaTick, 1000, 8192, 0, 0); // 比网络任务低：升级时 MQTT 照常收发
+    traceTask.start("trace", traceTick, TRACE_IDLE_MS, 2048, 0, 0, false); // 日志卡住不该触发看门狗重启
+#ifdef SYSTEM_MOISTURE_CHANNELS
+    if (moistureReady)
+        sensorTask.start("sensor", sensorTick, CONTROL_MAX_SLEEP_MS, 3072, 1, 1);
+#endif
+
+    // loopTask 不再干活，退出看门狗监控
+    esp_task_wdt_delete(NULL);
+
     Serial.println("==== System Ready ====");
 }
 
 // ================= LOOP =================
 void loop()
 {
-    // 1. 喂狗 (防止主循环卡死)
-    esp_task_wdt_reset();
-
-    // 2. 处理 OTA 请求
-    otaMgr.handle();
-
-    // 3. 网络维护
-    if (!wifiMgr.isConnected())
-    {
-        wifiMgr.connect(); // 内部有冷却时间，不会一直卡这里
-    }
-    else
-    {
-        if (!mqttMgr.isConnected())
-            mqttMgr.connect();
-        mqttMgr.loop();
-    }
-
-    // 4. 业务逻辑
-    struct tm currentTime;
-    if (timeMgr.getTime(currentTime))
-    {
-        waterSys.update(currentTime);
-    }
-
-    delay(1000);
-}
\ No newline at end of file
+    // 所有工作都在 network / control 两个任务里，loopTask 直接退出
+    vTaskDelete(NULL);
+}
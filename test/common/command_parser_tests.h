@@ -0,0 +1,102 @@
+#ifndef COMMAND_PARSER_TESTS_H
+#define COMMAND_PARSER_TESTS_H
+
+#include <unity.h>
+#include <string.h>
+#include <stdio.h>
+#include "CommandParser.h"
+
+static CommandParser::Result parseText(const char *text, Command &cmd) {
+    return CommandParser::parse((const uint8_t *)text, strlen(text), cmd);
+}
+
+// === 测试用例 1: 全部旧指令 (含别名、大小写、首尾空白) ===
+void test_parser_basic_verbs(void) {
+    Command cmd;
+    TEST_ASSERT_TRUE(parseText("start", cmd) == CommandParser::Result::Ok);
+    TEST_ASSERT_TRUE(cmd.type == CommandType::Start);
+    TEST_ASSERT_EQUAL_INT(-1, cmd.zone);
+    TEST_ASSERT_EQUAL_INT(0, cmd.arg);
+
+    TEST_ASSERT_TRUE(parseText("ON", cmd) == CommandParser::Result::Ok && cmd.type == CommandType::Start);
+    TEST_ASSERT_TRUE(parseText(" Stop\n", cmd) == CommandParser::Result::Ok && cmd.type == CommandType::Stop);
+    TEST_ASSERT_TRUE(parseText("off", cmd) == CommandParser::Result::Ok && cmd.type == CommandType::Stop);
+    TEST_ASSERT_TRUE(parseText("reset", cmd) == CommandParser::Result::Ok && cmd.type == CommandType::Reset);
+    TEST_ASSERT_TRUE(parseText("kill", cmd) == CommandParser::Result::Ok && cmd.type == CommandType::Kill);
+    TEST_ASSERT_TRUE(parseText("Revive", cmd) == CommandParser::Result::Ok && cmd.type == CommandType::Revive);
+    TEST_ASSERT_TRUE(parseText("info", cmd) == CommandParser::Result::Ok && cmd.type == CommandType::Info);
+    TEST_ASSERT_TRUE(parseText("status", cmd) == CommandParser::Result::Ok && cmd.type == CommandType::Info);
+}
+
+// === 测试用例 2: 参数与 zone 前缀 ===
+void test_parser_arguments(void) {
+    Command cmd;
+    TEST_ASSERT_TRUE(parseText("start 30", cmd) == CommandParser::Result::Ok);
+    TEST_ASSERT_EQUAL_INT(30, cmd.arg);
+
+    TEST_ASSERT_TRUE(parseText("zone 3 start", cmd) == CommandParser::Result::Ok);
+    TEST_ASSERT_TRUE(cmd.type == CommandType::Start);
+    TEST_ASSERT_EQUAL_INT(3, cmd.zone);
+
+    TEST_ASSERT_TRUE(parseText("ZONE 12 start 45", cmd) == CommandParser::Result::Ok);
+    TEST_ASSERT_EQUAL_INT(12, cmd.zone);
+    TEST_ASSERT_EQUAL_INT(45, cmd.arg);
+
+    TEST_ASSERT_TRUE(parseText("history", cmd) == CommandParser::Result::Ok);
+    TEST_ASSERT_TRUE(cmd.type == CommandType::History);
+    TEST_ASSERT_EQUAL_INT(0, cmd.arg);
+    TEST_ASSERT_TRUE(parseText("History 2", cmd) == CommandParser::Result::Ok);
+    TEST_ASSERT_EQUAL_INT(2, cmd.arg);
+
+    // start 的参数带 ml 后缀：按量浇水
+    TEST_ASSERT_TRUE(parseText("zone 2 start 500ml", cmd) == CommandParser::Result::Ok);
+    TEST_ASSERT_TRUE(cmd.type == CommandType::Dose);
+    TEST_ASSERT_EQUAL_INT(2, cmd.zone);
+    TEST_ASSERT_EQUAL_INT(500, cmd.arg);
+    TEST_ASSERT_TRUE(parseText("ON 1500ML", cmd) == CommandParser::Result::Ok && cmd.type == CommandType::Dose);
+}
+
+// === 测试用例 3: 非法输入 ===
+void test_parser_rejects(void) {
+    Command cmd;
+    TEST_ASSERT_TRUE(parseText("", cmd) == CommandParser::Result::Empty);
+    TEST_ASSERT_TRUE(parseText("   ", cmd) == CommandParser::Result::Empty);
+    TEST_ASSERT_TRUE(parseText("starts", cmd) == CommandParser::Result::UnknownCommand);
+    TEST_ASSERT_TRUE(parseText("sta", cmd) == CommandParser::Result::UnknownCommand);
+    TEST_ASSERT_TRUE(parseText("zone", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("zone x start", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("zone 3", cmd) == CommandParser::Result::UnknownCommand);
+    TEST_ASSERT_TRUE(parseText("start -5", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("start 30 40", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("start 0ml", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("start ml", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("history 2ml", cmd) == CommandParser::Result::BadArgument);
+
+    // 不带参数的指令多给一个数字：拒绝，不能当成整条指令执行 ("kill 3" 不是停区域 3)
+    TEST_ASSERT_TRUE(parseText("stop 5", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("off 1", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("reset 1", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("kill 3", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("revive 0", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("info 2", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("status x", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("zone 3 stop 5", cmd) == CommandParser::Result::BadArgument);
+
+    // 手动时长上限：正好等于上限可以，多 1 秒 / 9 位数都拒绝
+    char text[32];
+    snprintf(text, sizeof(text), "start %d", WATERING_MAX_MANUAL_SEC);
+    TEST_ASSERT_TRUE(parseText(text, cmd) == CommandParser::Result::Ok);
+    TEST_ASSERT_EQUAL_INT(WATERING_MAX_MANUAL_SEC, cmd.arg);
+    snprintf(text, sizeof(text), "zone 1 start %d", WATERING_MAX_MANUAL_SEC + 1);
+    TEST_ASSERT_TRUE(parseText(text, cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("start 999999999", cmd) == CommandParser::Result::BadArgument);
+    TEST_ASSERT_TRUE(parseText("start 999999999ml", cmd) == CommandParser::Result::Ok); // 水量不受时长上限约束
+}
+
+void run_shared_command_parser_tests() {
+    RUN_TEST(test_parser_basic_verbs);
+    RUN_TEST(test_parser_arguments);
+    RUN_TEST(test_parser_rejects);
+}
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef FLOW_TESTS_H
+#define FLOW_TESTS_H
+
+#include <unity.h>
+#include <string.h>
+#include "FlowDose.h"
+#include "FlowMeter.h"
+#include "WateringSystem.h"
+#include "system_tests.h" // createTime / runUntilIdle
+
+static char fl_lastMsg[72];
+
+static void fl_capture(WateringSystem &sys) {
+    fl_lastMsg[0] = '\0';
+    sys.setNotifier([](const char *msg) {
+        strncpy(fl_lastMsg, msg, sizeof(fl_lastMsg) - 1);
+        fl_lastMsg[sizeof(fl_lastMsg) - 1] = '\0';
+    });
+}
+
+// 像控制任务一样运行：睡到 msUntilPumpDeadline() 再 loop()，返回醒来的次数
+static uint32_t fl_runPaced(WateringSystem &sys, uint32_t timeoutMs = 60000) {
+    uint32_t wakes = 0;
+    unsigned long start = millis();
+    while (sys.isBusy() && millis() - start < timeoutMs) {
+        uint32_t wait = sys.msUntilPumpDeadline();
+        delay(wait > 1000 ? 1000 : wait);
+        sys.loop();
+        wakes++;
+    }
+    return wakes;
+}
+
+// === 测试用例 1: 计量逻辑：目标换算成脉冲、到量判断、计数器回绕、越接近越密地检查 ===
+void test_flow_dose_logic(void) {
+    FlowDose d;
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, d.msUntilCheck(0));
+
+    // 1. 计数器从快回绕的位置开始：差值照样正确
+    const uint32_t base = UINT32_MAX - 100;
+    d.begin(450, 1000, base, 0);
+    TEST_ASSERT_TRUE(d.targeted());
+    TEST_ASSERT_EQUAL_UINT32(1000, d.targetMl());
+    TEST_ASSERT_EQUAL_UINT32(FLOW_MAX_POLL_MS / 4, d.msUntilCheck(0)); // 流速未知
+
+    // 2. 30 脉冲/秒：每 1s 一个读数，流速估计出来以后检查间隔随剩余量缩短
+    uint32_t lastWait = UINT32_MAX;
+    for (uint32_t t = 1; t <= 14; t++) {
+        d.update(base + 30 * t, t * 1000);
+        TEST_ASSERT_FALSE(d.reached());
+        uint32_t wait = d.msUntilCheck(t * 1000);
+        TEST_ASSERT_TRUE(wait <= lastWait);
+        TEST_ASSERT_TRUE(wait >= FLOW_MIN_POLL_MS);
+        lastWait = wait;
+    }
+    TEST_ASSERT_EQUAL_UINT32(30 * 60 * 1000 / 450, d.flowMlPerMin()); // 4 L/min
+    TEST_ASSERT_EQUAL_UINT32(420 * 1000 / 450, d.deliveredMl());
+    TEST_ASSERT_TRUE(lastWait <= 500); // 剩 30 个脉冲 (1 秒)：只睡一半
+
+    // 3. 到量
+    d.update(base + 450, 15000);
+    TEST_ASSERT_TRUE(d.reached());
+    TEST_ASSERT_EQUAL_UINT32(1000, d.deliveredMl());
+    TEST_ASSERT_EQUAL_UINT32(0, d.msUntilCheck(15000));
+
+    // 4. 只计量不控制：不会到量，只按断流截止时刻检查
+    d.begin(450, 0, 0, 0);
+    TEST_ASSERT_FALSE(d.targeted());
+    d.update(100, 2000);
+    TEST_ASSERT_FALSE(d.reached());
+    TEST_ASSERT_EQUAL_UINT32(FLOW_STALL_MS, d.msUntilCheck(2000));
+    TEST_ASSERT_FALSE(d.stalled(2000 + FLOW_STALL_MS - 1));
+    TEST_ASSERT_TRUE(d.stalled(2000 + FLOW_STALL_MS));
+    d.end();
+    TEST_ASSERT_FALSE(d.stalled(100000));
+}
+
+// === 测试用例 2: 状态机提前正常结束 (量够了)：继电器立即断开，结算为 Finished ===
+void test_flow_pump_complete(void) {
+    PumpStateMachine pump;
+    pump.complete(0); // Idle：忽略
+    TEST_ASSERT_TRUE(pump.isIdle());
+    pump.start(60000);
+    pump.tick(1000);
+    pump.complete(4000);
+    TEST_ASSERT_FALSE(pump.relayOn());
+    TEST_ASSERT_EQUAL_UINT32(3000, pump.getElapsedMs());
+    TEST_ASSERT_TRUE(pump.tick(4001) == PumpEvent::Finished);
+    TEST_ASSERT_TRUE(pump.isIdle());
+}
+
+// === 测试用例 3: 按量浇水：浇够就停 (过冲不到一个检查间隔)，控制任务只醒几十次；通知和状态带实际水量 ===
+void test_flow_dose_run(void) {
+    WateringSystem sys(false);
+    sys.addZone(4, 60, 2, 0, 1, 18);
+    MockPulseCounter meter(4, 100000); // 100 脉冲/秒 (约 13 L/min)
+    sys.setFlowMeter(0, &meter, 450);
+    sys.setDose(0, 500, 30);
+    sys.begin();
+    fl_capture(sys);
+
+    // 1. 计划运行按量：500mL = 225 个脉冲，约 2.25 秒
+    struct tm t = createTime(100, 2, 0);
+    sys.update(t);
+    TEST_ASSERT_TRUE(sys.isBusy(0));
+    TEST_ASSERT_EQUAL_STRING("Auto Start [1/18] 500mL", fl_lastMsg);
+    unsigned long started = millis();
+    uint32_t wakes = fl_runPaced(sys);
+    TEST_ASSERT_FALSE(sys.isBusy());
+    TEST_ASSERT_TRUE(wakes < 40); // 10ms 轮询要 220 次
+    int32_t ml = sys.getLastVolumeMl(0);
+    TEST_ASSERT_TRUE(ml >= 500 && ml <= 510);
+    TEST_ASSERT_UINT32_WITHIN(100, 2250, millis() - started); // 远早于 60s 的时长
+    char expect[48];
+    snprintf(expect, sizeof(expect), "Done [1/18] %ld/500mL", (long)ml);
+    TEST_ASSERT_EQUAL_STRING(expect, fl_lastMsg);
+    TEST_ASSERT_EQUAL_INT(1, sys.getWateredCount(0));
+
+    // 2. 手动按时长运行：只计量，时长到了才停
+    sys.forceWatering(0, 3);
+    runUntilIdle(sys);
+    TEST_ASSERT_INT_WITHIN(3, 666, sys.getLastVolumeMl(0)); // 300 个脉冲
+    snprintf(expect, sizeof(expect), "Done [2/18] %ldmL", (long)sys.getLastVolumeMl(0));
+    TEST_ASSERT_EQUAL_STRING(expect, fl_lastMsg);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)ml + (uint32_t)sys.getLastVolumeMl(0), sys.getTotalVolumeMl(0));
+
+    // 3. 状态 JSON
+    static char json[1024];
+    BufferSink sink(json, sizeof(json));
+    JsonWriter w(sink);
+    static SystemStatus status;
+    sys.captureStatus(status);
+    status.write(w);
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"dose_ml\":500"));
+    snprintf(expect, sizeof(expect), "\"volume_ml\":%ld", (long)sys.getLastVolumeMl(0));
+    TEST_ASSERT_NOT_NULL(strstr(json, expect));
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"capped\":0"));
+}
+
+// === 测试用例 4: 安全保护：流速太小到时长上限停泵；完全没水按断流中止；没有流量计时拒绝按量 ===
+void test_flow_safety(void) {
+    WateringSystem sys(false);
+    sys.addZone(4, 60, 2, 0, 1, 18);
+    sys.addZone(5, 60, 2, 0, 1, 18); // 没有流量计
+    MockPulseCounter meter(4, 10000); // 10 脉冲/秒 (堵了一半)
+    sys.setFlowMeter(0, &meter, 450);
+    sys.setDose(0, 500, 3);
+    sys.begin();
+    fl_capture(sys);
+
+    // 1. 3 秒只出来 30 个脉冲：到上限停下，算浇过一次，但记为 capped
+    sys.forceWatering(0);
+    fl_runPaced(sys);
+    TEST_ASSERT_EQUAL_INT(1, sys.getWateredCount(0));
+    TEST_ASSERT_EQUAL_UINT32(1, sys.getCappedCount(0));
+    TEST_ASSERT_INT_WITHIN(3, 66, sys.getLastVolumeMl(0));
+    TEST_ASSERT_NOT_NULL(strstr(fl_lastMsg, "/500mL (time cap)"));
+
+    // 2. 水箱空了：FLOW_STALL_MS 没有脉冲，按断流中止 (不等时长上限)
+    meter.setFlow(0);
+    sys.setDose(0, 500, 60);
+    sys.forceWatering(0, 0, 800);
+    TEST_ASSERT_EQUAL_STRING("Zone 0: Manual Start [2/18] 800mL", fl_lastMsg);
+    fl_runPaced(sys);
+    TEST_ASSERT_FALSE(sys.isBusy());
+    TEST_ASSERT_EQUAL_INT(0, sys.getLastVolumeMl(0));
+    char expect[64];
+    snprintf(expect, sizeof(expect), "Zone 0: Aborted: No flow (Run %ds) [2/18] 0/800mL", FLOW_STALL_MS / 1000);
+    TEST_ASSERT_EQUAL_STRING(expect, fl_lastMsg);
+    TEST_ASSERT_EQUAL_UINT32(1, sys.getCappedCount(0));
+
+    // 3. 没有流量计的区域：按量拒绝，按时长照常，消息不带水量
+    sys.forceWatering(1, 0, 500);
+    TEST_ASSERT_EQUAL_STRING("Ignored: No flow meter", fl_lastMsg);
+    TEST_ASSERT_FALSE(sys.isBusy(1));
+    sys.forceWatering(1, 1);
+    runUntilIdle(sys);
+    TEST_ASSERT_EQUAL_STRING("Zone 1: Done [1/18]", fl_lastMsg);
+    TEST_ASSERT_EQUAL_INT32(-1, sys.getLastVolumeMl(1));
+}
+
+void run_shared_flow_tests() {
+    RUN_TEST(test_flow_dose_logic);
+    RUN_TEST(test_flow_pump_complete);
+    RUN_TEST(test_flow_dose_run);
+    RUN_TEST(test_flow_safety);
+}
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef HEAP_TESTS_H
+#define HEAP_TESTS_H
+
+#include <unity.h>
+#include <string.h>
+#include "HeapStats.h"
+#include "ControlBus.h"
+#include "CommandParser.h"
+#include "WireProtocol.h"
+#include "WateringSystem.h"
+#include "system_tests.h" // testSys / createTime / runUntilIdle
+
+// 两个测试入口都包含了 HeapCountNew.h：Heap::NewScope 统计的是真实的 operator new 次数
+
+static ControlBus hp_bus;
+static char hp_lastMsg[72];
+
+// === 测试用例 1: 按模块计数：次数 / 在用字节 / 峰值 / 失败；快照和 JSON 一次取齐 ===
+void test_heap_module_accounting(void) {
+    Heap::ModuleStats &s = Heap::stats(Heap::Other);
+    uint32_t allocs = s.allocs.load(), live = s.liveBytes.load();
+    Heap::Snapshot before = Heap::snapshot();
+
+    void *a = Heap::alloc(Heap::Other, 4096);
+    void *b = Heap::alloc(Heap::Other, 1024);
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_EQUAL_UINT32(allocs + 2, s.allocs.load());
+    TEST_ASSERT_EQUAL_UINT32(live + 5120, s.liveBytes.load());
+    TEST_ASSERT_TRUE(s.peakBytes.load() >= live + 5120);
+#ifndef ARDUINO
+    // 模拟的堆：空闲字节正好少了这么多，最低空闲跟着走
+    TEST_ASSERT_EQUAL_UINT32(before.freeBytes - 5120, Heap::snapshot().freeBytes);
+    TEST_ASSERT_TRUE(Heap::snapshot().minFree <= before.freeBytes - 5120);
+#endif
+    Heap::release(Heap::Other, a, 4096);
+    Heap::release(Heap::Other, b, 1024);
+    TEST_ASSERT_EQUAL_UINT32(live, s.liveBytes.load());
+    TEST_ASSERT_TRUE(s.peakBytes.load() >= live + 5120); // 峰值不回落
+
+    // 分配不到：记失败，不算次数
+    uint32_t failed = s.failed.load();
+    void *huge = Heap::alloc(Heap::Other, 0x7FFFFFFF);
+    TEST_ASSERT_NULL(huge);
+    TEST_ASSERT_EQUAL_UINT32(failed + 1, s.failed.load());
+    TEST_ASSERT_EQUAL_UINT32(allocs + 2, s.allocs.load());
+
+    Heap::Snapshot now = Heap::snapshot();
+    TEST_ASSERT_TRUE(now.largestBlock <= now.freeBytes);
+    TEST_ASSERT_TRUE(now.minFree <= now.freeBytes);
+
+    static char json[512];
+    Heap::Report report;
+    report.take();
+    BufferSink sink(json, sizeof(json));
+    JsonWriter w(sink);
+    report.write(w);
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"largest\":"));
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"min_free\":"));
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"arenas\":{\"allocs\":"));
+    char expect[48];
+    snprintf(expect, sizeof(expect), "\"other\":{\"allocs\":%lu,", (unsigned long)(allocs + 2));
+    TEST_ASSERT_NOT_NULL(strstr(json, expect));
+}
+
+// 一个完整的稳态周期：计划运行、手动运行、按量运行、被拒的指令、文本 / 二进制指令解析、
+// 控制总线往返、状态 JSON 和二进制状态帧
+static void hp_cycle(WateringSystem &dosed, int day) {
+    static char json[1024];
+    static uint8_t frame[128];
+    Command cmd;
+    Event ev;
+
+    struct tm t = createTime(day, 2, 0);
+    testSys.update(t);
+    runUntilIdle(testSys);
+    testSys.forceWatering(0, 1);
+    runUntilIdle(testSys);
+    testSys.stopWatering(0); // 被拒：Not watering
+
+    dosed.forceWatering(0, 0, 300);
+    runUntilIdle(dosed);
+
+    const char *text = "zone 0 start 30";
+    TEST_ASSERT_TRUE(CommandParser::parse((const uint8_t *)text, strlen(text), cmd) == CommandParser::Result::Ok);
+    TEST_ASSERT_TRUE(hp_bus.postCommand(cmd));
+    Wire::Encoder ce(frame, sizeof(frame));
+    Wire::writeCommand(ce, (uint32_t)day, Wire::Verb::Info);
+    uint32_t seq = 0;
+    TEST_ASSERT_TRUE(Wire::parseCommand(frame, ce.length(), seq, cmd) == Wire::ParseResult::Ok);
+    while (hp_bus.commands.pop(cmd)) {
+    }
+    while (hp_bus.events.pop(ev)) {
+        if (ev.type == EventType::Run) {
+            Wire::Encoder ee(frame, sizeof(frame));
+            Wire::writeEvent(ee, seq, 0, ev.run);
+        }
+    }
+
+    static SystemStatus status;
+    testSys.captureStatus(status);
+    BufferSink sink(json, sizeof(json));
+    JsonWriter w(sink);
+    status.write(w);
+    Wire::Encoder se(frame, sizeof(frame));
+    se.header(Wire::MsgType::Status, seq);
+    status.write(se);
+    TEST_ASSERT_TRUE(se.ok());
+}
+
+// === 测试用例 2: 稳态零分配：回调、存档和流量计都接好、跑过一轮之后，再跑几天不应该有任何 operator new ===
+void test_heap_steady_state(void) {
+    WateringSystem dosed(false);
+    dosed.addZone(5, 30, 3, 0, 1, 18);
+    static MockPulseCounter meter(5, 100000);
+    dosed.setFlowMeter(0, &meter, 450);
+    dosed.begin();
+
+    // 回调只在启动时注册一次 (不捕获变量的 lambda，std::function 不分配)
+    testSys.setNotifier([](const char *m) {
+        strncpy(hp_lastMsg, m, sizeof(hp_lastMsg) - 1);
+        hp_bus.postEvent(EventType::Notify, m);
+    });
+    testSys.setEventSink([](const RunEvent &e) { hp_bus.postRun(e); });
+    dosed.setNotifier([](const char *m) { hp_bus.postEvent(EventType::Notify, m); });
+
+    hp_cycle(dosed, 100); // 预热：第一次用到的静态缓冲区、日志扇区等
+
+    Heap::NewScope scope;
+    for (int day = 101; day < 104; day++)
+        hp_cycle(dosed, day);
+    TEST_ASSERT_EQUAL_UINT32(0, scope.count());
+
+    TEST_ASSERT_EQUAL_STRING("Ignored: Not watering", hp_lastMsg);
+    TEST_ASSERT_EQUAL_INT(6, testSys.getWateredCount(0)); // 计划 2 次 (每 3 天：第 100、103 天) + 手动 4 次
+    TEST_ASSERT_TRUE(dosed.getTotalVolumeMl(0) >= 4 * 300);
+
+    testSys.setNotifier(nullptr);
+    testSys.setEventSink(nullptr);
+}
+
+void run_shared_heap_tests() {
+    RUN_TEST(test_heap_module_accounting);
+    RUN_TEST(test_heap_steady_state);
+}
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef HISTORY_TESTS_H
+#define HISTORY_TESTS_H
+
+#include <unity.h>
+#include "HistoryLog.h"
+#include "FlashSim.h"
+
+typedef HistoryLog<FlashSim, 8> TestHistory;
+static const int64_t HT_T0 = 1704067200; // 2024-01-01 00:00
+
+static RunRecord ht_run(int i) {
+    RunRecord r;
+    r.start = HT_T0 + (int64_t)i * 86400 + 7200; // 每天 02:00
+    r.durationSec = 60 + i % 5;
+    r.zone = (uint16_t)(i % 3);
+    r.aborted = (i % 7) == 0;
+    r.trigger = (i % 4) == 0 ? RunTrigger::Manual : RunTrigger::Auto;
+    return r;
+}
+
+static void ht_assert_run(int i, const RunRecord &r) {
+    RunRecord e = ht_run(i);
+    TEST_ASSERT_TRUE(e.start == r.start);
+    TEST_ASSERT_EQUAL_UINT32(e.durationSec, r.durationSec);
+    TEST_ASSERT_EQUAL_UINT16(e.zone, r.zone);
+    TEST_ASSERT_TRUE(e.aborted == r.aborted);
+    TEST_ASSERT_TRUE(e.trigger == r.trigger);
+}
+
+// === 测试用例 1: 写入后分页读回 (第 0 页最新)，重启后仍在 ===
+void test_history_pages(void) {
+    FlashSim flash(512, 8);
+    {
+        TestHistory h(flash);
+        TEST_ASSERT_TRUE(h.begin());
+        for (int i = 0; i < 45; i++)
+            TEST_ASSERT_TRUE(h.append(ht_run(i)));
+    }
+
+    TestHistory h(flash);
+    TEST_ASSERT_TRUE(h.begin());
+    TEST_ASSERT_EQUAL_UINT32(45, h.size());
+
+    RunRecord page[20];
+    TEST_ASSERT_EQUAL_UINT16(20, h.readPage(0, 20, page));
+    for (int k = 0; k < 20; k++)
+        ht_assert_run(44 - k, page[k]);
+
+    TEST_ASSERT_EQUAL_UINT16(20, h.readPage(1, 20, page));
+    ht_assert_run(24, page[0]);
+
+    // 最后一页不满
+    TEST_ASSERT_EQUAL_UINT16(5, h.readPage(2, 20, page));
+    ht_assert_run(4, page[0]);
+    ht_assert_run(0, page[4]);
+
+    TEST_ASSERT_EQUAL_UINT16(0, h.readPage(3, 20, page));
+}
+
+// === 测试用例 2: 差分编码后每条记录足够小 ===
+void test_history_compact_encoding(void) {
+    FlashSim flash(4096, 4);
+    TestHistory h(flash);
+    h.begin();
+    for (int i = 0; i < 200; i++)
+        h.append(ht_run(i));
+    TestHistory::Stats s = h.getStats();
+    // 每天一条：Δstart 3 字节 + 其它字段 4 字节左右
+    TEST_ASSERT_TRUE(s.bytesUsed < 200 * 9 + 4096);
+    TEST_ASSERT_EQUAL_UINT32(1, s.sectors);
+    TEST_ASSERT_TRUE(s.bytesUsed / 200 <= 8);
+}
+
+// === 测试用例 3: 写满后滚动，丢掉最旧的一个扇区 ===
+void test_history_rollover(void) {
+    FlashSim flash(256, 4);
+    TestHistory h(flash);
+    h.begin();
+    for (int i = 0; i < 500; i++)
+        TEST_ASSERT_TRUE(h.append(ht_run(i)));
+
+    TestHistory::Stats s = h.getStats();
+    TEST_ASSERT_TRUE(s.evicted > 0);
+    TEST_ASSERT_EQUAL_UINT32(500, s.records + s.evicted);
+    TEST_ASSERT_EQUAL_UINT32(4, s.sectors);
+
+    // 剩下的是连续的最新记录，重启后一致
+    TestHistory r(flash);
+    r.begin();
+    TEST_ASSERT_EQUAL_UINT32(s.records, r.size());
+    RunRecord page[10];
+    TEST_ASSERT_EQUAL_UINT16(10, r.readPage(0, 10, page));
+    for (int k = 0; k < 10; k++)
+        ht_assert_run(499 - k, page[k]);
+
+    // 最旧的一页
+    uint32_t lastPage = (s.records - 1) / 10;
+    uint16_t n = r.readPage(lastPage, 10, page);
+    ht_assert_run(500 - (int)s.records, page[n - 1]);
+    TEST_ASSERT_EQUAL_UINT32(0, flash.norViolations);
+}
+
+// === 测试用例 4: 写到一半掉电，断尾被丢弃，之后继续正常追加 ===
+void test_history_torn_write(void) {
+    for (uint32_t cut = 0; cut < 8; cut++) {
+        FlashSim flash(512, 4);
+        {
+            TestHistory h(flash);
+            h.begin();
+            for (int i = 0; i < 10; i++)
+                h.append(ht_run(i));
+            flash.cutPowerAfter(cut);
+            h.append(ht_run(10));
+        }
+        flash.powerCycle();
+
+        TestHistory r(flash);
+        r.begin();
+        uint32_t n = r.size();
+        TEST_ASSERT_TRUE(n == 10 || n == 11);
+        TEST_ASSERT_TRUE(r.append(ht_run(11)));
+
+        RunRecord page[1];
+        TestHistory r2(flash);
+        r2.begin();
+        TEST_ASSERT_EQUAL_UINT16(1, r2.readPage(0, 1, page));
+        ht_assert_run(11, page[0]);
+        TEST_ASSERT_EQUAL_UINT32(0, flash.norViolations);
+    }
+}
+
+void run_shared_history_tests() {
+    RUN_TEST(test_history_pages);
+    RUN_TEST(test_history_compact_encoding);
+    RUN_TEST(test_history_rollover);
+    RUN_TEST(test_history_torn_write);
+}
+
+#endif
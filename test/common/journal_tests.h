@@ -0,0 +1,143 @@
+#ifndef JOURNAL_TESTS_H
+#define JOURNAL_TESTS_H
+
+#include <unity.h>
+#include "StateJournal.h"
+#include "FlashSim.h"
+
+// 小扇区让换扇区 / 掉电点遍历都跑得很快
+typedef StateJournal<FlashSim, 8> TestJournal;
+static const uint32_t JT_SECTOR = 256;
+static const uint32_t JT_SECTORS = 4;
+
+// === 测试用例 1: 写入后 "重启" (新对象重放同一块 Flash) 能恢复 ===
+void test_journal_recover(void) {
+    FlashSim flash(JT_SECTOR, JT_SECTORS);
+    {
+        TestJournal j(flash);
+        TEST_ASSERT_TRUE(j.begin());
+        TEST_ASSERT_TRUE(j.isBlank());
+        j.stage(1, 42);
+        j.stage(2, -999);
+        TEST_ASSERT_TRUE(j.commit());
+        TEST_ASSERT_TRUE(j.set(1, 43));
+    }
+
+    TestJournal j(flash);
+    TEST_ASSERT_TRUE(j.begin());
+    TEST_ASSERT_FALSE(j.isBlank());
+    TEST_ASSERT_EQUAL_INT32(43, j.get(1, 0));
+    TEST_ASSERT_EQUAL_INT32(-999, j.get(2, 0));
+    TEST_ASSERT_EQUAL_INT32(7, j.get(3, 7)); // 不存在的键给默认值
+    TEST_ASSERT_EQUAL_UINT32(0, j.getStats().corruptTails);
+}
+
+// === 测试用例 2: 值没变就不写 Flash ===
+void test_journal_skip_unchanged(void) {
+    FlashSim flash(JT_SECTOR, JT_SECTORS);
+    TestJournal j(flash);
+    j.begin();
+    j.set(1, 5);
+    uint64_t before = flash.bytesWritten;
+    TEST_ASSERT_TRUE(j.set(1, 5));
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)before, (uint32_t)flash.bytesWritten);
+    TEST_ASSERT_EQUAL_UINT32(1, j.getStats().skipped);
+}
+
+// === 测试用例 3: 写满后轮换扇区，数据不丢，擦除均匀 ===
+void test_journal_compaction(void) {
+    FlashSim flash(JT_SECTOR, JT_SECTORS);
+    TestJournal j(flash);
+    j.begin();
+    for (int32_t i = 1; i <= 500; i++) {
+        j.stage(1, i);
+        j.stage(2, -i);
+        j.stage(3, 1);
+        TEST_ASSERT_TRUE(j.commit());
+    }
+    TEST_ASSERT_TRUE(j.getStats().compactions > JT_SECTORS);
+    TEST_ASSERT_TRUE(flash.maxEraseCount() - flash.minEraseCount() <= 1);
+    TEST_ASSERT_EQUAL_UINT32(0, flash.norViolations);
+
+    TestJournal r(flash);
+    r.begin();
+    TEST_ASSERT_EQUAL_INT32(500, r.get(1, 0));
+    TEST_ASSERT_EQUAL_INT32(-500, r.get(2, 0));
+    TEST_ASSERT_EQUAL_INT32(1, r.get(3, 0));
+}
+
+// === 测试用例 4: 多字段提交在任意掉电点都是原子的 ===
+// 逐字节遍历掉电位置，恢复后要么全是旧值，要么全是新值
+// fill = 9：最后一次提交是普通追加；fill = 11：当前扇区刚好写满，最后一次提交走换扇区
+// (擦除 + 快照 + 扇区头) 的路径
+static void journal_power_loss_sweep(int32_t fill) {
+    for (uint32_t cut = 0; cut < JT_SECTOR + 128; cut++) {
+        FlashSim flash(JT_SECTOR, 2);
+        {
+            TestJournal j(flash);
+            j.begin();
+            for (int32_t i = 0; i < fill; i++) {
+                j.stage(1, i);
+                j.stage(2, i);
+                j.commit();
+            }
+            j.stage(1, 100);
+            j.stage(2, 200);
+            j.commit();
+
+            flash.cutPowerAfter(cut);
+            j.stage(1, 101);
+            j.stage(2, 201);
+            j.commit();
+        }
+        flash.powerCycle();
+
+        TestJournal r(flash);
+        TEST_ASSERT_TRUE(r.begin());
+        int32_t a = r.get(1, -1);
+        int32_t b = r.get(2, -1);
+        bool oldState = (a == 100 && b == 200);
+        bool newState = (a == 101 && b == 201);
+        TEST_ASSERT_TRUE(oldState || newState);
+
+        // 恢复后继续写入也必须正常 (不会写到脏区域上)
+        TEST_ASSERT_TRUE(r.set(1, 300));
+        TestJournal r2(flash);
+        r2.begin();
+        TEST_ASSERT_EQUAL_INT32(300, r2.get(1, -1));
+        TEST_ASSERT_EQUAL_UINT32(0, flash.norViolations);
+    }
+}
+
+void test_journal_power_loss_append(void) {
+    journal_power_loss_sweep(9);
+}
+
+void test_journal_power_loss_rotate(void) {
+    journal_power_loss_sweep(11);
+}
+
+// === 测试用例 5: 格式化后是空白状态 ===
+void test_journal_format(void) {
+    FlashSim flash(JT_SECTOR, JT_SECTORS);
+    TestJournal j(flash);
+    j.begin();
+    j.set(1, 1);
+    TEST_ASSERT_TRUE(j.format());
+
+    TestJournal r(flash);
+    r.begin();
+    TEST_ASSERT_TRUE(r.isBlank());
+    TEST_ASSERT_EQUAL_UINT16(0, r.keyCount());
+}
+
+void run_shared_journal_tests() {
+    RUN_TEST(test_journal_recover);
+    RUN_TEST(test_journal_skip_unchanged);
+    RUN_TEST(test_journal_compaction);
+    RUN_TEST(test_journal_power_loss_append);
+    RUN_TEST(test_journal_power_loss_rotate);
+    RUN_TEST(test_journal_format);
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef JSON_WRITER_TESTS_H
+#define JSON_WRITER_TESTS_H
+
+#include <unity.h>
+#include "JsonWriter.h"
+
+// === 测试用例 1: 嵌套对象/数组的逗号与冒号 ===
+void test_json_nesting(void) {
+    char buf[128];
+    BufferSink sink(buf, sizeof(buf));
+    JsonWriter w(sink);
+    w.beginObject();
+    w.field("status", "ACTIVE");
+    w.field("busy", false);
+    w.beginArray("zones");
+    w.beginObject();
+    w.field("id", 0);
+    w.field("last", -999);
+    w.endObject();
+    w.beginObject();
+    w.field("id", 1);
+    w.endObject();
+    w.endArray();
+    w.field("big", (unsigned long long)18446744073709551615ULL);
+    w.endObject();
+
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"status\":\"ACTIVE\",\"busy\":false,\"zones\":[{\"id\":0,\"last\":-999},{\"id\":1}],\"big\":18446744073709551615}",
+        sink.c_str());
+    TEST_ASSERT_FALSE(sink.overflow());
+    TEST_ASSERT_EQUAL_size_t(sink.length(), w.written());
+}
+
+// === 测试用例 2: 字符串转义 ===
+void test_json_escaping(void) {
+    char buf[64];
+    BufferSink sink(buf, sizeof(buf));
+    JsonWriter w(sink);
+    w.beginArray();
+    w.value("a\"b\\c\n\x01");
+    w.value((const char *)nullptr);
+    w.endArray();
+    TEST_ASSERT_EQUAL_STRING("[\"a\\\"b\\\\c\\n\\u0001\",null]", sink.c_str());
+}
+
+// === 测试用例 3: 定长缓冲区溢出时截断，计数器长度与真实输出一致 ===
+void test_json_overflow_and_count(void) {
+    CountingSink counter;
+    JsonWriter wc(counter);
+    char small[16];
+    BufferSink sink(small, sizeof(small));
+    JsonWriter wb(sink);
+
+    JsonWriter *writers[] = {&wc, &wb};
+    for (JsonWriter *w : writers) {
+        w->beginObject();
+        w->field("message", "Aborted (Run 12s) [3/18]");
+        w->endObject();
+    }
+
+    TEST_ASSERT_EQUAL_size_t(38, counter.count);
+    TEST_ASSERT_TRUE(sink.overflow());
+    TEST_ASSERT_EQUAL_size_t(15, sink.length());
+}
+
+void run_shared_json_writer_tests() {
+    RUN_TEST(test_json_nesting);
+    RUN_TEST(test_json_escaping);
+    RUN_TEST(test_json_overflow_and_count);
+}
+
+#endif
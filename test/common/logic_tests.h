@@ -7,45 +7,84 @@
 // 实例化逻辑对象 (静态，防止冲突)
 static WateringLogic logic(2, 0, 3, 18);
 
+// year 年第 yday 天 (0 起算) 的 hour:min -> 本地 epoch 秒
+static int64_t logic_at(int year, int yday, int hour, int min) {
+    return ((int64_t)EpochTime::daysFromCivil(year, 1, 1) + yday) * EpochTime::SECONDS_PER_DAY + hour * 3600 + min * 60;
+}
+
+static int32_t logic_day(int year, int yday) {
+    return EpochTime::daysFromCivil(year, 1, 1) + yday;
+}
+
 // === 测试用例 1: 时间未到 ===
 void test_time_not_reached(void) {
     // 1:59, 第100天 -> 期望: false
-    bool result = logic.shouldStart(1, 59, 100, 0, -999, false);
+    bool result = logic.shouldStart(logic_at(2024, 100, 1, 59), 0, -999, false);
     TEST_ASSERT_FALSE(result); 
 }
 
 // === 测试用例 2: 首次运行 ===
 void test_first_run(void) {
     // 2:00, 第100天, 上次-999 -> 期望: true
-    bool result = logic.shouldStart(2, 0, 100, 0, -999, false);
+    bool result = logic.shouldStart(logic_at(2024, 100, 2, 0), 0, -999, false);
     TEST_ASSERT_TRUE(result);
 }
 
 // === 测试用例 3: 间隔满足 ===
 void test_interval_ok(void) {
     // 2:00, 第103天, 上次100 (差3天) -> 期望: true
-    bool result = logic.shouldStart(2, 0, 103, 1, 100, false);
+    bool result = logic.shouldStart(logic_at(2024, 103, 2, 0), 1, logic_day(2024, 100), false);
     TEST_ASSERT_TRUE(result);
 }
 
 // === 测试用例 4: 间隔不足 ===
 void test_interval_short(void) {
     // 2:00, 第102天, 上次100 (差2天) -> 期望: false
-    bool result = logic.shouldStart(2, 0, 102, 1, 100, false);
+    bool result = logic.shouldStart(logic_at(2024, 102, 2, 0), 1, logic_day(2024, 100), false);
     TEST_ASSERT_FALSE(result);
 }
 
 // === 测试用例 5: 跨年逻辑 ===
 void test_new_year(void) {
     // 2:00, 今年第2天, 上次去年第364天 (间隔3天) -> 期望: true
-    bool result = logic.shouldStart(2, 0, 2, 5, 364, false);
+    bool result = logic.shouldStart(logic_at(2025, 2, 2, 0), 5, logic_day(2024, 364), false);
     TEST_ASSERT_TRUE(result);
 }
 
+// === 测试用例 5b: 闰年跨年 ===
+void test_leap_year_boundary(void) {
+    // 2024 是闰年，最后一天是第 365 天 (12-31)；2025 第 1 天 (01-02) 已经隔了 2 天
+    // 旧算法按 "+365" 补偿得到 1 天，会漏掉这一次
+    WateringLogic every2(2, 0, 2, 18);
+    TEST_ASSERT_TRUE(every2.shouldStart(logic_at(2025, 1, 2, 0), 5, logic_day(2024, 365), false));
+    TEST_ASSERT_FALSE(every2.shouldStart(logic_at(2025, 0, 2, 0), 5, logic_day(2024, 365), false));
+}
+
+// === 测试用例 5c: 停顿后的结算 ===
+void test_catch_up(void) {
+    WateringLogic daily(2, 0, 1, 18);
+    uint32_t missed = 0;
+    int64_t fire = logic_at(2024, 100, 2, 0);
+
+    // 目标分钟之内：准时
+    TEST_ASSERT_EQUAL_INT64(fire, daily.catchUp(fire, fire + 59, 0, -999, WateringLogic::NEVER, missed));
+    TEST_ASSERT_EQUAL_UINT32(0, missed);
+    // 停顿 30 分钟，补跑窗口 1 小时：补跑
+    TEST_ASSERT_EQUAL_INT64(fire, daily.catchUp(fire, fire + 1800, 0, -999, fire + 1800 - 3600, missed));
+    TEST_ASSERT_EQUAL_UINT32(0, missed);
+    // 不补跑：记为错过，排到明天
+    TEST_ASSERT_EQUAL_INT64(logic_at(2024, 101, 2, 0), daily.catchUp(fire, fire + 1800, 0, -999, WateringLogic::NEVER, missed));
+    TEST_ASSERT_EQUAL_UINT32(1, missed);
+    // 停机 3 天多：前面 3 次错过，最后一次在窗口内补跑
+    int64_t now = logic_at(2024, 103, 2, 30);
+    TEST_ASSERT_EQUAL_INT64(logic_at(2024, 103, 2, 0), daily.catchUp(fire, now, 0, -999, now - 3600, missed));
+    TEST_ASSERT_EQUAL_UINT32(3, missed);
+}
+
 // === 测试用例 6: 次数超限 ===
 void test_max_cycles(void) {
     // 已执行18次 -> 期望: false
-    bool result = logic.shouldStart(2, 0, 200, 18, 150, false);
+    bool result = logic.shouldStart(logic_at(2024, 200, 2, 0), 18, logic_day(2024, 150), false);
     TEST_ASSERT_FALSE(result);
 }
 
@@ -56,7 +95,7 @@ void test_should_fail_on_wrong_time(void) {
     // 当前输入是 14:00 (下午2点)
     
     // 逻辑类应该返回: false (绝对不应该启动)
-    bool result = logic.shouldStart(14, 0, 100, 0, -999, false);
+    bool result = logic.shouldStart(logic_at(2024, 100, 14, 0), 0, -999, false);
     
     // 这里的逻辑是：result 实际上是 false。
     // 但我们强制断言它是 TRUE (我们告诉测试框架：如果不返回 true，就算失败)。
@@ -72,6 +111,8 @@ void run_shared_logic_tests() {
     RUN_TEST(test_interval_ok);
     RUN_TEST(test_interval_short);
     RUN_TEST(test_new_year);
+    RUN_TEST(test_leap_year_boundary);
+    RUN_TEST(test_catch_up);
     RUN_TEST(test_max_cycles);
     // RUN_TEST(test_should_fail_on_wrong_time); // 故意失败的测试
 }
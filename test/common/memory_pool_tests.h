@@ -0,0 +1,134 @@
+#ifndef MEMORY_POOL_TESTS_H
+#define MEMORY_POOL_TESTS_H
+
+#include <unity.h>
+#include <string.h>
+#include "MemoryPool.h"
+
+// === 测试用例 1: 分区：对齐切分、切不出来记失败、PSRAM 要不到退回内部 RAM、整块记在 Heap::Arenas 名下 ===
+void test_arena_take_and_fallback(void) {
+    Heap::ModuleStats &s = Heap::stats(Heap::Arenas);
+    uint32_t live = s.liveBytes.load();
+    {
+        MemArena arena;
+        TEST_ASSERT_TRUE(arena.begin("t", 1024, Heap::Where::Internal));
+        TEST_ASSERT_FALSE(arena.inPsram());
+        TEST_ASSERT_EQUAL_UINT32(live + 1024, s.liveBytes.load());
+
+        uint8_t *a = (uint8_t *)arena.take(3, 1);
+        uint8_t *b = (uint8_t *)arena.take(16, 8);
+        TEST_ASSERT_NOT_NULL(a);
+        TEST_ASSERT_NOT_NULL(b);
+        TEST_ASSERT_EQUAL_UINT32(0, ((uintptr_t)b - (uintptr_t)a) % 8);
+        TEST_ASSERT_EQUAL_UINT32(24, arena.usedBytes());
+
+        TEST_ASSERT_NULL(arena.take(arena.remaining() + 1, 1));
+        TEST_ASSERT_EQUAL_UINT32(1, arena.failures());
+        TEST_ASSERT_NOT_NULL(arena.take(arena.remaining(), 1)); // 正好切完
+        TEST_ASSERT_EQUAL_UINT32(0, arena.remaining());
+    }
+    TEST_ASSERT_EQUAL_UINT32(live, s.liveBytes.load()); // 析构时归还整块
+
+    // 要的比 PSRAM 总量还大：退回内部 RAM 的小块
+    MemArena big;
+    TEST_ASSERT_TRUE(big.begin("big", 0x7FFFFFFF, Heap::Where::Psram, 2048));
+    TEST_ASSERT_FALSE(big.inPsram());
+    TEST_ASSERT_EQUAL_UINT32(2048, big.capacity());
+    big.end();
+    TEST_ASSERT_FALSE(big.begin("none", 0x7FFFFFFF, Heap::Where::Psram));
+    TEST_ASSERT_EQUAL_UINT32(0, big.capacity());
+    TEST_ASSERT_NULL(big.take(1));
+    TEST_ASSERT_EQUAL_UINT32(live, s.liveBytes.load());
+
+#ifndef ARDUINO
+    // native 模拟了 PSRAM：放得下时整块在 PSRAM，只占 PSRAM 的空闲
+    uint32_t internalFree = Heap::snapshot().freeBytes;
+    MemArena ps;
+    TEST_ASSERT_TRUE(ps.begin("ps", 64 * 1024, Heap::Where::Psram, 1024));
+    TEST_ASSERT_TRUE(ps.inPsram());
+    TEST_ASSERT_EQUAL_UINT32(internalFree, Heap::snapshot().freeBytes);
+    ps.end();
+#endif
+}
+
+struct MpThing {
+    uint32_t a;
+    double b;
+    MpThing(uint32_t x, double y) : a(x), b(y) {}
+};
+
+// === 测试用例 2: 定长槽：借完记失败、重复 / 外来归还被拒、反复借还只在固定的几个地址间轮转 ===
+void test_slot_pool_churn(void) {
+    MemArena arena;
+    TEST_ASSERT_TRUE(arena.begin("t", 1024, Heap::Where::Internal));
+    MpThing *thing = arena.make<MpThing>(7u, 2.5);
+    TEST_ASSERT_NOT_NULL(thing);
+    TEST_ASSERT_EQUAL_UINT32(7, thing->a);
+
+    SlotPool pool;
+    TEST_ASSERT_FALSE(pool.begin("zero", arena, 10, 0)); // 非法参数不占分区
+    uint32_t used = arena.usedBytes();
+    TEST_ASSERT_TRUE(pool.begin("p", arena, 10, 3));
+    TEST_ASSERT_EQUAL_UINT32(16, pool.slotBytes());
+    TEST_ASSERT_TRUE(arena.usedBytes() > used);
+    TEST_ASSERT_FALSE(pool.begin("huge", arena, 4096, 2)); // 分区不够
+
+    TEST_ASSERT_TRUE(pool.begin("p", arena, 10, 3));
+    void *s[3];
+    for (int i = 0; i < 3; i++) {
+        s[i] = pool.acquire();
+        TEST_ASSERT_NOT_NULL(s[i]);
+        TEST_ASSERT_EQUAL_UINT32(0, (uintptr_t)s[i] % 8);
+    }
+    TEST_ASSERT_NULL(pool.acquire());
+    TEST_ASSERT_EQUAL_UINT32(1, pool.failures());
+    TEST_ASSERT_EQUAL_UINT16(3, pool.peakInUse());
+
+    TEST_ASSERT_TRUE(pool.release(s[1]));
+    TEST_ASSERT_FALSE(pool.release(s[1]));                 // 重复归还
+    TEST_ASSERT_FALSE(pool.release((uint8_t *)s[0] + 4));  // 槽中间
+    TEST_ASSERT_FALSE(pool.release(thing));                // 不是本池的
+    TEST_ASSERT_FALSE(pool.release(nullptr));
+    TEST_ASSERT_EQUAL_UINT32(4, pool.badReleases());
+    TEST_ASSERT_EQUAL_UINT16(2, pool.inUse());
+    TEST_ASSERT_TRUE(pool.release(s[0]));
+    TEST_ASSERT_TRUE(pool.release(s[2]));
+
+    // 反复借还：地址总在那三个槽里，分区用量不变
+    used = arena.usedBytes();
+    for (int round = 0; round < 100; round++) {
+        PoolSlot a(pool), b(pool);
+        TEST_ASSERT_TRUE(a.ok() && b.ok());
+        void *pa = a.as<void>(), *pb = b.as<void>();
+        TEST_ASSERT_TRUE(pa != pb);
+        TEST_ASSERT_TRUE(pa == s[0] || pa == s[1] || pa == s[2]);
+        TEST_ASSERT_TRUE(pb == s[0] || pb == s[1] || pb == s[2]);
+    }
+    TEST_ASSERT_EQUAL_UINT16(0, pool.inUse());
+    TEST_ASSERT_EQUAL_UINT32(used, arena.usedBytes());
+    TEST_ASSERT_EQUAL_UINT32(4, pool.badReleases());
+
+    {
+        PoolSlot x(pool), y(pool), z(pool), w(pool); // 第 4 个借不到，析构时也不该算错误归还
+        TEST_ASSERT_FALSE(w.ok());
+    }
+    TEST_ASSERT_EQUAL_UINT32(2, pool.failures());
+    TEST_ASSERT_EQUAL_UINT32(4, pool.badReleases());
+
+    static char json[256];
+    BufferSink sink(json, sizeof(json));
+    JsonWriter jw(sink);
+    jw.beginArray();
+    arena.write(jw);
+    pool.write(jw);
+    jw.endArray();
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"name\":\"t\",\"where\":\"internal\",\"bytes\":1024,"));
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"name\":\"p\",\"slot\":16,\"slots\":3,\"used\":0,\"peak\":3,\"failed\":2"));
+}
+
+void run_shared_memory_pool_tests() {
+    RUN_TEST(test_arena_take_and_fallback);
+    RUN_TEST(test_slot_pool_churn);
+}
+
+#endif
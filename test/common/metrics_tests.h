@@ -0,0 +1,83 @@
+#ifndef METRICS_TESTS_H
+#define METRICS_TESTS_H
+
+#include <unity.h>
+#include "LatencyHistogram.h"
+#include "Metrics.h"
+
+// 测试用的直方图 (静态，约 800 字节，不放在栈上)
+static LatencyHistogram testHist;
+
+// === 测试用例 1: 分桶连续、单调，相对误差 <= 12.5% ===
+void test_histogram_buckets(void) {
+    TEST_ASSERT_EQUAL_UINT32(0, LatencyHistogram::bucketOf(0));
+    TEST_ASSERT_EQUAL_UINT32(7, LatencyHistogram::bucketOf(7));
+    TEST_ASSERT_EQUAL_UINT32(LatencyHistogram::BUCKETS - 1, LatencyHistogram::bucketOf(UINT32_MAX));
+
+    for (uint16_t b = 0; b + 1 < LatencyHistogram::BUCKETS; b++) {
+        uint32_t low = LatencyHistogram::bucketLow(b);
+        uint32_t high = LatencyHistogram::bucketHigh(b);
+        TEST_ASSERT_EQUAL_UINT32(b, LatencyHistogram::bucketOf(low));
+        TEST_ASSERT_EQUAL_UINT32(b, LatencyHistogram::bucketOf(high));
+        TEST_ASSERT_EQUAL_UINT32(high + 1, LatencyHistogram::bucketLow(b + 1));
+        TEST_ASSERT_TRUE((uint64_t)(high - low) * 8 <= low || low < 8);
+    }
+}
+
+// === 测试用例 2: 百分位与读取清零 ===
+void test_histogram_percentiles(void) {
+    testHist.reset();
+    // 1..1000us 各一个样本
+    for (uint32_t us = 1; us <= 1000; us++)
+        testHist.record(us);
+
+    LatencyHistogram::Summary s = testHist.takeSnapshot();
+    TEST_ASSERT_EQUAL_UINT32(1000, s.count);
+    TEST_ASSERT_EQUAL_UINT32(1000, s.max);
+    // 报告的是所在桶的上界：不小于真实值，最多大 12.5%
+    TEST_ASSERT_TRUE(s.p50 >= 500 && s.p50 <= 500 * 9 / 8);
+    TEST_ASSERT_TRUE(s.p90 >= 900 && s.p90 <= 900 * 9 / 8);
+    TEST_ASSERT_TRUE(s.p99 >= 990 && s.p99 <= 1000);
+
+    // 快照之后清零
+    LatencyHistogram::Summary empty = testHist.takeSnapshot();
+    TEST_ASSERT_EQUAL_UINT32(0, empty.count);
+    TEST_ASSERT_EQUAL_UINT32(0, empty.max);
+
+    // 超出范围的值进最后一个桶，max 仍然精确
+    testHist.record(100000000);
+    s = testHist.takeSnapshot();
+    TEST_ASSERT_EQUAL_UINT32(100000000, s.max);
+    TEST_ASSERT_EQUAL_UINT32(100000000, s.p99);
+}
+
+// === 测试用例 3: 作用域计时与 JSON 报告 ===
+void test_metrics_report(void) {
+    Metrics::histogram(Metrics::NvsCommit).reset();
+    {
+        Metrics::ScopedTimer t(Metrics::NvsCommit);
+        delayMicroseconds(300);
+    }
+    Metrics::Report report;
+    report.take(60000);
+    TEST_ASSERT_EQUAL_UINT32(1, report.items[Metrics::NvsCommit].count);
+    TEST_ASSERT_TRUE(report.items[Metrics::NvsCommit].max >= 300);
+
+    char buf[512];
+    BufferSink sink(buf, sizeof(buf));
+    {
+        JsonWriter w(sink);
+        report.write(w);
+    }
+    TEST_ASSERT_TRUE(strstr(buf, "\"window_ms\":60000") != nullptr);
+    TEST_ASSERT_TRUE(strstr(buf, "\"nvs_commit\":{\"n\":1,") != nullptr);
+}
+
+// ================= 共享的运行清单 =================
+void run_shared_metrics_tests() {
+    RUN_TEST(test_histogram_buckets);
+    RUN_TEST(test_histogram_percentiles);
+    RUN_TEST(test_metrics_report);
+}
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef MOISTURE_TESTS_H
+#define MOISTURE_TESTS_H
+
+#include <unity.h>
+#include <algorithm>
+#include "MoistureAdc.h"
+#include "WateringSystem.h"
+#include "system_tests.h" // createTime / runUntilIdle
+
+// 合成的探头读数：真实值 + 小噪声 + 每隔 period 个样本一个继电器干扰尖峰 (满量程或接近 0)
+static uint32_t ms_seed = 1;
+static uint16_t ms_sample(uint16_t level, uint32_t i, uint32_t spikePeriod) {
+    ms_seed = ms_seed * 1103515245u + 12345u;
+    if (spikePeriod && i % spikePeriod == spikePeriod / 2)
+        return (ms_seed >> 16) & 1 ? 4095 : 20;
+    return (uint16_t)(level + (int)((ms_seed >> 16) % 41) - 20); // ±20
+}
+
+static uint16_t ms_trace[600];
+
+// === 测试用例 1: 排序网络取中值，5 个数的所有排列 (含重复值) ===
+void test_moisture_median(void) {
+    static const uint16_t sets[][5] = {{100, 200, 300, 400, 500}, {700, 700, 300, 900, 300}, {1000, 1000, 1000, 50, 4000}};
+    for (const uint16_t *set : sets) {
+        uint16_t v[5];
+        std::copy(set, set + 5, v);
+        std::sort(v, v + 5);
+        uint16_t expect = v[2];
+        do {
+            MoistureFilter f;
+            f.process(v, 5);
+            TEST_ASSERT_TRUE(f.valid());
+            TEST_ASSERT_EQUAL_UINT16(expect, f.level());
+        } while (std::next_permutation(v, v + 5));
+    }
+}
+
+// === 测试用例 2: 尖峰被中值丢掉，噪声被 EMA 压住；换算成千分比 ===
+void test_moisture_filter_trace(void) {
+    ms_seed = 1;
+    for (uint32_t i = 0; i < 600; i++)
+        ms_trace[i] = ms_sample(2100, i, 7); // 每 7 个样本一个尖峰
+    MoistureFilter f;
+    TEST_ASSERT_EQUAL_INT16(MoistureFilter::UNKNOWN, f.permille());
+    f.process(ms_trace, 600);
+    TEST_ASSERT_EQUAL_UINT32(120, f.medianCount());
+    TEST_ASSERT_EQUAL_UINT32(0, f.faultCount());
+    TEST_ASSERT_UINT16_WITHIN(8, 2100, f.level());
+    TEST_ASSERT_INT16_WITHIN(6, 500, f.permille()); // (2900 - 2100) / (2900 - 1300)
+
+    // 土变干：读数升高，几十个中值之内跟上
+    for (uint32_t i = 0; i < 600; i++)
+        ms_trace[i] = ms_sample(2700, i, 7);
+    f.process(ms_trace, 600);
+    TEST_ASSERT_UINT16_WITHIN(8, 2700, f.level());
+    TEST_ASSERT_INT16_WITHIN(6, 125, f.permille());
+}
+
+// === 测试用例 3: 同一串样本按不同的块大小喂，结果完全一样 ===
+void test_moisture_block_invariance(void) {
+    ms_seed = 7;
+    for (uint32_t i = 0; i < 600; i++)
+        ms_trace[i] = ms_sample((uint16_t)(1500 + i), i, 11);
+    MoistureFilter whole;
+    whole.process(ms_trace, 600);
+
+    static const size_t chunks[] = {1, 3, 4, 7, 60, 599};
+    for (size_t c : chunks) {
+        MoistureFilter f;
+        for (size_t off = 0; off < 600; off += c)
+            f.process(ms_trace + off, std::min(c, (size_t)600 - off));
+        TEST_ASSERT_EQUAL_UINT16(whole.level(), f.level());
+        TEST_ASSERT_EQUAL_UINT32(whole.medianCount(), f.medianCount());
+    }
+}
+
+// === 测试用例 4: 探头断线 / 短路变为 UNKNOWN，恢复后重新开始；标定范围外钳位 ===
+void test_moisture_fault(void) {
+    MoistureFilter f;
+    for (uint32_t i = 0; i < 60; i++)
+        ms_trace[i] = 2100;
+    f.process(ms_trace, 60);
+    TEST_ASSERT_TRUE(f.valid());
+
+    // 1. 两组悬空读数还不算故障 (可能是干扰)，第三组起无效
+    for (uint32_t i = 0; i < 15; i++)
+        ms_trace[i] = 4095;
+    f.process(ms_trace, 10);
+    TEST_ASSERT_TRUE(f.valid());
+    TEST_ASSERT_EQUAL_UINT16(2100, f.level());
+    f.process(ms_trace + 10, 5);
+    TEST_ASSERT_FALSE(f.valid());
+    TEST_ASSERT_EQUAL_INT16(MoistureFilter::UNKNOWN, f.permille());
+    TEST_ASSERT_EQUAL_UINT32(3, f.faultCount());
+
+    // 2. 接回来：直接从新读数开始，不和断线前的 EMA 混合
+    for (uint32_t i = 0; i < 5; i++)
+        ms_trace[i] = 1200;
+    f.process(ms_trace, 5);
+    TEST_ASSERT_TRUE(f.valid());
+    TEST_ASSERT_EQUAL_UINT16(1200, f.level());
+    TEST_ASSERT_EQUAL_INT16(1000, f.permille()); // 比 "泡在水里" 还湿：钳到 1000
+
+    // 3. 反向标定 (越湿读数越高的探头) 同样可用
+    MoistureFilter::Config cfg;
+    cfg.dryRaw = 1000;
+    cfg.wetRaw = 3000;
+    MoistureFilter r(cfg);
+    for (uint32_t i = 0; i < 5; i++)
+        ms_trace[i] = 2500;
+    r.process(ms_trace, 5);
+    TEST_ASSERT_EQUAL_INT16(750, r.permille());
+}
+
+// === 测试用例 5: DMA 结果按通道分拣；整轮滤波后发布；没有样本的通道为 UNKNOWN ===
+void test_moisture_adc_demux(void) {
+    static MoistureAdc adc; // 块缓冲区 ~1KB，不放在栈上
+    TEST_ASSERT_EQUAL(0, adc.addChannel(3));
+    TEST_ASSERT_EQUAL(1, adc.addChannel(4));
+    TEST_ASSERT_EQUAL(2, adc.addChannel(6));
+    TEST_ASSERT_EQUAL_INT16(MoistureFilter::UNKNOWN, adc.permille(0));
+
+    // 1. 模式表 3, 4 轮流转换 (通道 6 的探头没接上 ADC：一个样本都没有)，夹着别的通道
+    ms_seed = 3;
+    for (uint32_t i = 0; !adc.full() && i < 1000; i++) {
+        adc.collect(3, ms_sample(2100, i, 9));
+        adc.collect(4, ms_sample(1700, i, 9));
+        adc.collect(9, 100); // 不认识的通道：丢掉
+        if (i == 200)
+            break;
+    }
+    TEST_ASSERT_FALSE(adc.full());
+    adc.flush();
+    TEST_ASSERT_EQUAL_UINT32(1, adc.burstCount());
+    TEST_ASSERT_EQUAL_UINT32(1, adc.shortBurstCount());
+    TEST_ASSERT_INT16_WITHIN(8, 500, adc.permille(0));
+    TEST_ASSERT_INT16_WITHIN(8, 750, adc.permille(1));
+    TEST_ASSERT_EQUAL_INT16(MoistureFilter::UNKNOWN, adc.permille(2));
+    TEST_ASSERT_EQUAL_INT16(MoistureFilter::UNKNOWN, adc.permille(7));
+
+    // 2. 每个通道只收 MOISTURE_BURST_SAMPLES 个，多出来的丢掉
+    for (uint32_t i = 0; i < 3 * MOISTURE_BURST_SAMPLES; i++) {
+        adc.collect(3, 2100);
+        adc.collect(4, 1700);
+        adc.collect(6, 2900);
+    }
+    TEST_ASSERT_TRUE(adc.full());
+    uint32_t before = adc.filter(0).medianCount();
+    adc.flush();
+    TEST_ASSERT_EQUAL_UINT32(before + MOISTURE_BURST_SAMPLES / MoistureFilter::MEDIAN, adc.filter(0).medianCount());
+    TEST_ASSERT_EQUAL_UINT32(1, adc.shortBurstCount());
+    TEST_ASSERT_EQUAL_INT16(0, adc.permille(2));
+}
+
+// === 测试用例 6: 湿度条件：阈值以上跳过；关闭 / 读不到时只看时钟 ===
+void test_moisture_gate_logic(void) {
+    WateringLogic l(2, 0, 1, 18);
+    TEST_ASSERT_TRUE(l.soilNeedsWater(900)); // 默认关闭
+    l.moistureThreshold = 400;
+    TEST_ASSERT_TRUE(l.soilNeedsWater(399));
+    TEST_ASSERT_FALSE(l.soilNeedsWater(400));
+    TEST_ASSERT_FALSE(l.soilNeedsWater(1000));
+    TEST_ASSERT_TRUE(l.soilNeedsWater(WateringLogic::MOISTURE_UNKNOWN)); // 探头坏了：宁可多浇
+}
+
+// === 测试用例 7: 计划到点时土还湿：跳过、不计次数，第二天再看；变干后照常浇 ===
+void test_moisture_skips_watering(void) {
+    WateringSystem sys(false);
+    sys.addZone(4, 1, 2, 0, 1, 18); // 每天 2:00
+    sys.addZone(5, 1, 2, 0, 1, 18); // 没有探头
+    sys.setMoistureThreshold(0, 400);
+    sys.setMoistureThreshold(1, 400);
+    sys.begin();
+    sys.setMaxConcurrentRuns(2);
+
+    // 1. 第 100 天 2:00：区域 0 湿度 62%，跳过；区域 1 读不到湿度，照常浇
+    sys.setMoisture(0, 620);
+    struct tm t = createTime(100, 2, 0);
+    sys.update(t);
+    TEST_ASSERT_FALSE(sys.isBusy(0));
+    TEST_ASSERT_TRUE(sys.isBusy(1));
+    runUntilIdle(sys);
+    TEST_ASSERT_EQUAL_INT(0, sys.getWateredCount(0));
+    TEST_ASSERT_EQUAL_UINT32(1, sys.getSkippedCount(0));
+    TEST_ASSERT_EQUAL_UINT32(0, sys.getMissedCount(0));
+    TEST_ASSERT_EQUAL_INT32(WateringLogic::NEVER_WATERED, sys.getLastWateredDay(0));
+
+    // 2. 同一分钟再看一次：不会重复判断
+    sys.update(t);
+    TEST_ASSERT_EQUAL_UINT32(1, sys.getSkippedCount(0));
+
+    // 3. 第 101 天土干了 (30%)：照常浇
+    sys.setMoisture(0, 300);
+    struct tm t2 = createTime(101, 2, 0);
+    sys.update(t2);
+    TEST_ASSERT_TRUE(sys.isBusy(0));
+    runUntilIdle(sys);
+    TEST_ASSERT_EQUAL_INT(1, sys.getWateredCount(0));
+    TEST_ASSERT_EQUAL_UINT32(1, sys.getSkippedCount(0));
+
+    // 4. 关闭湿度条件：只看时钟
+    sys.setMoisture(0, 900);
+    sys.setMoistureThreshold(0, WateringLogic::MOISTURE_OFF);
+    struct tm t3 = createTime(102, 2, 0);
+    sys.update(t3);
+    TEST_ASSERT_TRUE(sys.isBusy(0));
+    runUntilIdle(sys);
+    TEST_ASSERT_EQUAL_INT(2, sys.getWateredCount(0));
+}
+
+void run_shared_moisture_tests() {
+    RUN_TEST(test_moisture_median);
+    RUN_TEST(test_moisture_filter_trace);
+    RUN_TEST(test_moisture_block_invariance);
+    RUN_TEST(test_moisture_fault);
+    RUN_TEST(test_moisture_adc_demux);
+    RUN_TEST(test_moisture_gate_logic);
+    RUN_TEST(test_moisture_skips_watering);
+}
+
+#endif
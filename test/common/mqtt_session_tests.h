@@ -0,0 +1,646 @@
+#ifndef MQTT_SESSION_TESTS_H
+#define MQTT_SESSION_TESTS_H
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "MqttCodec.h"
+#include "MqttSession.h"
+
+// 内存里的 "TCP"：测试充当 broker，直接读写两个方向的字节
+struct FakeLink : public MqttTransport {
+    Status st = Status::Closed;
+    bool slowConnect = false; // open() 后停在 Connecting，直到测试调用 accept()
+    int writeBudget = -1;     // 还能收多少字节 (-1 = 不限)，模拟 TCP 发送窗口满
+    int opens = 0;
+    uint8_t down[1536];       // broker -> 设备
+    size_t downLen = 0;
+    uint8_t up[2048];         // 设备 -> broker
+    size_t upLen = 0;
+
+    bool open(const char *, uint16_t) override {
+        opens++;
+        downLen = upLen = 0;
+        st = slowConnect ? Status::Connecting : Status::Open;
+        return true;
+    }
+    Status status() override { return st; }
+    int write(const uint8_t *data, size_t len) override {
+        if (st != Status::Open) return -1;
+        size_t n = sizeof(up) - upLen;
+        if (n > len) n = len;
+        if (writeBudget >= 0 && n > (size_t)writeBudget) n = writeBudget;
+        memcpy(up + upLen, data, n);
+        upLen += n;
+        if (writeBudget >= 0) writeBudget -= n;
+        return (int)n;
+    }
+    int read(uint8_t *data, size_t len) override {
+        if (st != Status::Open) return -1;
+        size_t n = downLen < len ? downLen : len;
+        memcpy(data, down, n);
+        memmove(down, down + n, downLen - n);
+        downLen -= n;
+        return (int)n;
+    }
+    void close() override { st = Status::Closed; }
+
+    void reset() {
+        st = Status::Closed;
+        slowConnect = false;
+        writeBudget = -1;
+        opens = 0;
+        downLen = upLen = 0;
+    }
+    void accept() { st = Status::Open; }
+    void inject(const uint8_t *data, size_t len) {
+        memcpy(down + downLen, data, len);
+        downLen += len;
+    }
+};
+
+// 嵌入式上测试跑在 loopTask 的小栈里：大块缓冲都用静态的
+static FakeLink &ms_link() {
+    static FakeLink link;
+    link.reset();
+    return link;
+}
+
+// broker 收到的一个报文
+struct SentPacket {
+    uint8_t type;
+    uint8_t flags;
+    uint8_t body[128];
+    uint32_t len;
+    uint16_t pid() const { return (uint16_t)(body[0] << 8 | body[1]); }
+    // PUBLISH：topic 之后的报文标识 / 负载
+    uint16_t topicLen() const { return (uint16_t)(body[0] << 8 | body[1]); }
+    uint16_t publishPid() const { return (uint16_t)(body[2 + topicLen()] << 8 | body[3 + topicLen()]); }
+    const uint8_t *payload() const { return body + 2 + topicLen() + ((flags & 0x06) ? 2 : 0); }
+};
+
+// 把设备发出的字节解成报文 (取走)，返回个数
+static int ms_take(FakeLink &link, SentPacket *out, int max) {
+    static Mqtt::Decoder<128> dec;
+    dec.reset();
+    int n = 0;
+    size_t at = 0;
+    while (at < link.upLen && n < max) {
+        size_t used = 0;
+        Mqtt::Decoder<128>::Result r = dec.feed(link.up + at, link.upLen - at, used);
+        at += used;
+        if (r != Mqtt::Decoder<128>::Result::Packet) break;
+        out[n].type = dec.type();
+        out[n].flags = dec.flags();
+        out[n].len = dec.bodyLen();
+        memcpy(out[n].body, dec.body(), dec.bodyLen());
+        n++;
+    }
+    memmove(link.up, link.up + at, link.upLen - at);
+    link.upLen -= at;
+    return n;
+}
+
+static void ms_connack(FakeLink &link, bool sessionPresent, uint8_t rc = 0) {
+    uint8_t p[4] = {Mqtt::CONNACK << 4, 2, (uint8_t)(sessionPresent ? 1 : 0), rc};
+    link.inject(p, sizeof(p));
+}
+
+static void ms_puback(FakeLink &link, uint16_t pid) {
+    uint8_t p[4];
+    Mqtt::Writer w(p, sizeof(p));
+    Mqtt::encodeAck(w, Mqtt::PUBACK, pid);
+    link.inject(p, w.len);
+}
+
+static const char *MS_CMD = "watering/cmd";
+static const char *MS_STATUS = "watering/status";
+
+static MqttSession::Config ms_config() {
+    MqttSession::Config c;
+    c.host = "127.0.0.1";
+    c.connect.clientId = "ESP32-Watering-A1B2C3D4E5F6";
+    c.connect.keepAliveSec = 10;
+    c.connect.willTopic = MS_STATUS;
+    c.connect.willPayload = "Offline";
+    c.maxInflight = 8;
+    c.retryBaseMs = 1000;
+    return c;
+}
+
+// 建立连接到 Connected (丢掉 CONNECT / SUBSCRIBE)
+static void ms_connect(MqttSession &s, FakeLink &link, uint32_t now, bool sessionPresent) {
+    s.start(now);
+    s.loop(now);
+    ms_connack(link, sessionPresent);
+    s.loop(now);
+    static SentPacket pk[4];
+    ms_take(link, pk, 4);
+}
+
+// === 测试用例 1: 编解码往返；逐字节喂也能拼出报文；超长报文跳过，不影响后面的 ===
+void test_mqtt_codec_roundtrip(void) {
+    uint8_t buf[400];
+    uint8_t payload[200];
+    for (int i = 0; i < 200; i++) payload[i] = (uint8_t)i;
+    Mqtt::Writer w(buf, sizeof(buf));
+    TEST_ASSERT_TRUE(Mqtt::encodePublishHeader(w, MS_CMD, sizeof(payload), 1, true, true, 0x1234));
+    TEST_ASSERT_EQUAL_UINT32(Mqtt::publishHeaderSize(MS_CMD, sizeof(payload), 1), w.len);
+    w.bytes(payload, sizeof(payload));
+    TEST_ASSERT_TRUE(w.ok);
+    TEST_ASSERT_EQUAL_HEX8(0x3B, buf[0]); // PUBLISH | DUP | QoS1 | retain
+    TEST_ASSERT_EQUAL_HEX8(0xD8, buf[1]); // 剩余长度 216：两字节变长整数
+    TEST_ASSERT_EQUAL_HEX8(0x01, buf[2]);
+
+    Mqtt::Decoder<256> dec;
+    Mqtt::Publish p;
+    size_t used = 0;
+    for (size_t i = 0; i < w.len; i++) {
+        Mqtt::Decoder<256>::Result r = dec.feed(buf + i, 1, used);
+        TEST_ASSERT_EQUAL_UINT32(1, used);
+        if (i + 1 < w.len) TEST_ASSERT_EQUAL(Mqtt::Decoder<256>::Result::NeedMore, r);
+        else TEST_ASSERT_EQUAL(Mqtt::Decoder<256>::Result::Packet, r);
+    }
+    TEST_ASSERT_TRUE(dec.parsePublish(p));
+    TEST_ASSERT_EQUAL_UINT16(strlen(MS_CMD), p.topicLen);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(MS_CMD, p.topic, p.topicLen));
+    TEST_ASSERT_EQUAL_UINT16(0x1234, p.packetId);
+    TEST_ASSERT_EQUAL_UINT8(1, p.qos);
+    TEST_ASSERT_TRUE(p.retained && p.dup);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(payload), p.payloadLen);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(payload, p.payload, sizeof(payload)));
+
+    // 同一段数据后面紧跟一个 PUBACK：容量 64 的解码器跳过 PUBLISH，照样解出 PUBACK
+    Mqtt::Writer ack(buf + w.len, sizeof(buf) - w.len);
+    Mqtt::encodeAck(ack, Mqtt::PUBACK, 7);
+    Mqtt::Decoder<64> small;
+    size_t total = w.len + ack.len, at = 0;
+    TEST_ASSERT_EQUAL(Mqtt::Decoder<64>::Result::Skipped, small.feed(buf, total, used));
+    at += used;
+    TEST_ASSERT_EQUAL(Mqtt::Decoder<64>::Result::Packet, small.feed(buf + at, total - at, used));
+    TEST_ASSERT_EQUAL_UINT8(Mqtt::PUBACK, small.type());
+    TEST_ASSERT_EQUAL_UINT16(7, small.packetId());
+
+    // 剩余长度超过 4 字节：格式错误
+    uint8_t bad[6] = {0x30, 0xFF, 0xFF, 0xFF, 0xFF, 0x01};
+    TEST_ASSERT_EQUAL(Mqtt::Decoder<64>::Result::Error, small.feed(bad, sizeof(bad), used));
+}
+
+// === 测试用例 2: 非阻塞连接；CONNECT 带固定 client id + 持久会话 + 遗嘱；每次连上都订阅 ===
+void test_mqtt_session_connect(void) {
+    FakeLink &link = ms_link();
+    link.slowConnect = true;
+    static uint8_t tx[1024];
+    OutboundQueue outbox;
+    static uint8_t storage[512];
+    outbox.attach(storage, sizeof(storage));
+    MqttSession s(link);
+    s.begin(ms_config(), tx, sizeof(tx), &outbox, nullptr);
+    TEST_ASSERT_TRUE(s.subscribe(MS_CMD, 1));
+
+    s.start(0);
+    TEST_ASSERT_EQUAL(MqttSession::State::TcpConnecting, s.state());
+    s.loop(100);
+    TEST_ASSERT_EQUAL_UINT32(0, link.upLen); // TCP 还没连上：什么都不发，也不阻塞
+
+    link.accept();
+    s.loop(200);
+    TEST_ASSERT_EQUAL(MqttSession::State::Handshake, s.state());
+    static SentPacket pk[4];
+    TEST_ASSERT_EQUAL_INT(1, ms_take(link, pk, 4));
+    TEST_ASSERT_EQUAL_UINT8(Mqtt::CONNECT, pk[0].type);
+    uint8_t flags = pk[0].body[7];
+    TEST_ASSERT_EQUAL_HEX8(0x00, flags & 0x02);  // cleanSession = 0
+    TEST_ASSERT_EQUAL_HEX8(0x0C, flags & 0x1C);  // 遗嘱，QoS1
+    TEST_ASSERT_EQUAL_UINT16(10, pk[0].body[8] << 8 | pk[0].body[9]);
+    const char *id = "ESP32-Watering-A1B2C3D4E5F6";
+    TEST_ASSERT_EQUAL_UINT16(strlen(id), pk[0].body[10] << 8 | pk[0].body[11]);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(id, pk[0].body + 12, strlen(id)));
+
+    // 新会话：连上后订阅 (QoS1)
+    ms_connack(link, false);
+    s.loop(300);
+    TEST_ASSERT_TRUE(s.isConnected());
+    TEST_ASSERT_EQUAL_INT(1, ms_take(link, pk, 4));
+    TEST_ASSERT_EQUAL_UINT8(Mqtt::SUBSCRIBE, pk[0].type);
+    TEST_ASSERT_EQUAL_HEX8(0x02, pk[0].flags);
+    TEST_ASSERT_EQUAL_UINT8(1, pk[0].body[pk[0].len - 1]);
+
+    // 掉线重连，broker 还保留着会话：照样重发 SUBSCRIBE (旧会话里可能没有后来加的主题)
+    link.close();
+    s.loop(400);
+    TEST_ASSERT_EQUAL(MqttSession::State::Backoff, s.state());
+    link.slowConnect = false;
+    s.loop(400 + 1000);
+    TEST_ASSERT_EQUAL_INT(2, link.opens);
+    s.loop(1500);
+    ms_take(link, pk, 4);
+    ms_connack(link, true);
+    s.loop(1600);
+    TEST_ASSERT_TRUE(s.isConnected());
+    TEST_ASSERT_EQUAL_INT(1, ms_take(link, pk, 4));
+    TEST_ASSERT_EQUAL_UINT8(Mqtt::SUBSCRIBE, pk[0].type);
+    TEST_ASSERT_EQUAL_UINT32(2, s.stats().connects);
+    TEST_ASSERT_EQUAL_UINT32(1, s.stats().resumed);
+
+    // 拒绝连接 (认证失败)：断开并退避
+    link.close();
+    s.loop(1700);
+    s.loop(1700 + 2000);
+    s.loop(3800);
+    ms_connack(link, false, 5);
+    s.loop(3900);
+    TEST_ASSERT_EQUAL(MqttSession::State::Backoff, s.state());
+}
+
+// === 测试用例 3: 发送窗口：最多 8 条在途，不等确认连续发出；按顺序确认后出队 ===
+void test_mqtt_session_inflight_window(void) {
+    FakeLink &link = ms_link();
+    static uint8_t tx[2048];
+    static uint8_t storage[1024];
+    OutboundQueue outbox;
+    outbox.attach(storage, sizeof(storage));
+    MqttSession s(link);
+    s.begin(ms_config(), tx, sizeof(tx), &outbox, nullptr);
+    ms_connect(s, link, 0, true);
+
+    char msg[16];
+    for (int i = 0; i < 20; i++) {
+        snprintf(msg, sizeof(msg), "event-%02d", i);
+        TEST_ASSERT_TRUE(outbox.push(MS_STATUS, msg));
+    }
+    TEST_ASSERT_EQUAL_UINT16(8, s.loop(10));
+    TEST_ASSERT_EQUAL_UINT8(8, s.inflight());
+    static SentPacket pk[16];
+    TEST_ASSERT_EQUAL_INT(8, ms_take(link, pk, 16));
+    uint16_t pids[8];
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT_EQUAL_UINT8(Mqtt::PUBLISH, pk[i].type);
+        TEST_ASSERT_EQUAL_HEX8(0x02, pk[i].flags); // QoS1，无 DUP
+        pids[i] = pk[i].publishPid();
+        snprintf(msg, sizeof(msg), "event-%02d", i);
+        TEST_ASSERT_EQUAL_INT(0, memcmp(msg, pk[i].payload(), strlen(msg)));
+        for (int j = 0; j < i; j++) TEST_ASSERT_TRUE(pids[i] != pids[j]);
+    }
+    TEST_ASSERT_EQUAL_UINT16(0, s.loop(20)); // 窗口满了
+    TEST_ASSERT_EQUAL_UINT32(20, outbox.size());
+
+    // 确认前三条：出队，窗口空出三格
+    for (int i = 0; i < 3; i++) ms_puback(link, pids[i]);
+    TEST_ASSERT_EQUAL_UINT16(3, s.loop(30));
+    TEST_ASSERT_EQUAL_UINT32(17, outbox.size());
+    ms_take(link, pk, 16);
+
+    // 乱序：先确认第 5 条，队首 (第 4 条) 没确认之前不出队
+    ms_puback(link, pids[4]);
+    s.loop(40);
+    TEST_ASSERT_EQUAL_UINT32(17, outbox.size());
+    ms_puback(link, pids[3]);
+    s.loop(50);
+    TEST_ASSERT_EQUAL_UINT32(15, outbox.size());
+    TEST_ASSERT_EQUAL_UINT32(5, s.stats().acked);
+
+    // 空出的两格在同一次 loop 里补上
+    TEST_ASSERT_EQUAL_INT(2, ms_take(link, pk, 16));
+    TEST_ASSERT_EQUAL_UINT8(8, s.inflight());
+}
+
+// === 测试用例 4: 掉线时在途的消息重连后带 DUP 重发，确认后才出队 ===
+void test_mqtt_session_retransmit(void) {
+    FakeLink &link = ms_link();
+    static uint8_t tx[1024];
+    static uint8_t storage[512];
+    OutboundQueue outbox;
+    outbox.attach(storage, sizeof(storage));
+    MqttSession s(link);
+    s.begin(ms_config(), tx, sizeof(tx), &outbox, nullptr);
+    ms_connect(s, link, 0, true);
+
+    outbox.push(MS_STATUS, "Auto Start [1/3]");
+    outbox.push(MS_STATUS, "Done [1/3]");
+    TEST_ASSERT_EQUAL_UINT16(1, s.loop(10, 1)); // budget = 1
+    TEST_ASSERT_EQUAL_UINT16(1, s.loop(20, 1));
+    static SentPacket pk[8];
+    TEST_ASSERT_EQUAL_INT(2, ms_take(link, pk, 8));
+    uint16_t pid0 = pk[0].publishPid();
+    uint16_t pid1 = pk[1].publishPid();
+
+    // 确认丢在路上，连接断了
+    link.close();
+    s.loop(30);
+    TEST_ASSERT_EQUAL(MqttSession::State::Backoff, s.state());
+    TEST_ASSERT_EQUAL_UINT32(2, outbox.size());
+
+    s.loop(30 + 1000);
+    s.loop(1100);
+    ms_take(link, pk, 8); // CONNECT
+    ms_connack(link, true);
+    s.loop(1200);
+    TEST_ASSERT_EQUAL_INT(2, ms_take(link, pk, 8));
+    TEST_ASSERT_EQUAL_HEX8(0x0A, pk[0].flags); // DUP | QoS1
+    TEST_ASSERT_EQUAL_UINT16(pid0, pk[0].publishPid());
+    TEST_ASSERT_EQUAL_UINT16(pid1, pk[1].publishPid());
+    TEST_ASSERT_EQUAL_UINT32(2, s.stats().retransmits);
+
+    ms_puback(link, pid0);
+    ms_puback(link, pid1);
+    s.loop(1300);
+    TEST_ASSERT_TRUE(outbox.empty());
+    TEST_ASSERT_EQUAL_UINT8(0, s.inflight());
+}
+
+static char ms_gotTopic[64];
+static char ms_gotPayload[64];
+static int ms_gotCount = 0;
+
+// === 测试用例 5: 收到 QoS1 指令：先回调，再回 PUBACK；超长报文丢弃不断线 ===
+void test_mqtt_session_inbound_qos1(void) {
+    FakeLink &link = ms_link();
+    static uint8_t tx[1024];
+    MqttSession s(link);
+    ms_gotCount = 0;
+    s.begin(ms_config(), tx, sizeof(tx), nullptr, [](char *topic, uint8_t *payload, unsigned int len) {
+        snprintf(ms_gotTopic, sizeof(ms_gotTopic), "%s", topic);
+        memcpy(ms_gotPayload, payload, len);
+        ms_gotPayload[len] = '\0';
+        ms_gotCount++;
+    });
+    ms_connect(s, link, 0, false);
+
+    uint8_t p[64];
+    Mqtt::Writer w(p, sizeof(p));
+    Mqtt::encodePublishHeader(w, MS_CMD, 4, 1, false, false, 77);
+    w.bytes("stop", 4);
+    link.inject(p, w.len);
+    s.loop(10);
+    TEST_ASSERT_EQUAL_INT(1, ms_gotCount);
+    TEST_ASSERT_EQUAL_STRING(MS_CMD, ms_gotTopic);
+    TEST_ASSERT_EQUAL_STRING("stop", ms_gotPayload);
+    static SentPacket pk[4];
+    TEST_ASSERT_EQUAL_INT(1, ms_take(link, pk, 4));
+    TEST_ASSERT_EQUAL_UINT8(Mqtt::PUBACK, pk[0].type);
+    TEST_ASSERT_EQUAL_UINT16(77, pk[0].pid());
+
+    // 超过 MQTT_RX_BYTES 的报文：整个跳过
+    static uint8_t big[MQTT_RX_BYTES + 64];
+    Mqtt::Writer bw(big, sizeof(big));
+    Mqtt::encodePublishHeader(bw, MS_CMD, MQTT_RX_BYTES, 0, false, false, 0);
+    bw.len += MQTT_RX_BYTES;
+    for (size_t at = 0; at < bw.len; at += 512) {
+        link.inject(big + at, bw.len - at < 512 ? bw.len - at : 512);
+        s.loop(20);
+    }
+    TEST_ASSERT_TRUE(s.isConnected());
+    TEST_ASSERT_EQUAL_UINT32(1, s.stats().oversized);
+    TEST_ASSERT_EQUAL_INT(1, ms_gotCount);
+}
+
+// === 测试用例 6: 心跳：空闲一个周期发 PINGREQ；1.5 个周期收不到任何东西就断开重连 ===
+void test_mqtt_session_keepalive(void) {
+    FakeLink &link = ms_link();
+    static uint8_t tx[512];
+    MqttSession s(link);
+    s.begin(ms_config(), tx, sizeof(tx), nullptr, nullptr);
+    ms_connect(s, link, 0, true);
+
+    static SentPacket pk[4];
+    s.loop(9999);
+    TEST_ASSERT_EQUAL_INT(0, ms_take(link, pk, 4));
+    s.loop(10000);
+    TEST_ASSERT_EQUAL_INT(1, ms_take(link, pk, 4));
+    TEST_ASSERT_EQUAL_UINT8(Mqtt::PINGREQ, pk[0].type);
+    s.loop(11000); // 等 PINGRESP 期间不重复发
+    TEST_ASSERT_EQUAL_INT(0, ms_take(link, pk, 4));
+
+    uint8_t resp[2] = {Mqtt::PINGRESP << 4, 0};
+    link.inject(resp, sizeof(resp));
+    s.loop(12000);
+    TEST_ASSERT_TRUE(s.isConnected());
+
+    // broker 没了回音：12000 + 15000 时断开
+    s.loop(20000);
+    ms_take(link, pk, 4);
+    s.loop(26999);
+    TEST_ASSERT_TRUE(s.isConnected());
+    s.loop(27000);
+    TEST_ASSERT_EQUAL(MqttSession::State::Backoff, s.state());
+
+    // 握手超时：CONNACK 一直不来 (从发起 TCP 连接算起)
+    s.loop(40000);
+    s.loop(40000);
+    TEST_ASSERT_EQUAL(MqttSession::State::Handshake, s.state());
+    s.loop(49999);
+    TEST_ASSERT_EQUAL(MqttSession::State::Handshake, s.state());
+    s.loop(50000);
+    TEST_ASSERT_EQUAL(MqttSession::State::Backoff, s.state());
+}
+
+// === 测试用例 7: TCP 发送窗口很小：报文分多次写出，内容不乱；QoS0 放不下时拒绝 ===
+void test_mqtt_session_partial_writes(void) {
+    FakeLink &link = ms_link();
+    static uint8_t tx[256];
+    static uint8_t storage[512];
+    OutboundQueue outbox;
+    outbox.attach(storage, sizeof(storage));
+    MqttSession s(link);
+    s.begin(ms_config(), tx, sizeof(tx), &outbox, nullptr);
+    ms_connect(s, link, 0, true);
+
+    link.writeBudget = 3;
+    outbox.push(MS_STATUS, "Auto Start [1/3]");
+    uint8_t *json = s.beginPublish(MS_STATUS, 11, false);
+    TEST_ASSERT_NOT_NULL(json);
+    memcpy(json, "{\"ok\":true}", 11);
+    s.endPublish(5);
+    TEST_ASSERT_NULL(s.beginPublish(MS_STATUS, 300, false)); // 比整个缓冲区还大
+    outbox.push(MS_STATUS, "Done [1/3]");
+
+    int rounds = 0;
+    for (uint32_t t = 10; t < 2000 && (s.pendingTxBytes() > 0 || s.inflight() < 2); t += 10, rounds++) {
+        link.writeBudget = 3; // 每轮 socket 只收 3 字节
+        s.loop(t);
+    }
+    TEST_ASSERT_TRUE(rounds > 10);
+    TEST_ASSERT_EQUAL_UINT32(0, s.pendingTxBytes());
+
+    static SentPacket pk[4];
+    TEST_ASSERT_EQUAL_INT(3, ms_take(link, pk, 4));
+    TEST_ASSERT_EQUAL_HEX8(0x00, pk[0].flags); // QoS0 JSON 先写进缓冲区
+    TEST_ASSERT_EQUAL_INT(0, memcmp("{\"ok\":true}", pk[0].payload(), 11));
+    TEST_ASSERT_EQUAL_INT(0, memcmp("Auto Start [1/3]", pk[1].payload(), 16));
+    TEST_ASSERT_EQUAL_INT(0, memcmp("Done [1/3]", pk[2].payload(), 10));
+}
+
+static MqttSession *ms_replying = nullptr;
+static int ms_replies = 0;
+
+// === 测试用例 8: 发送缓冲区快满 / socket 写不出去：只读回得过来确认的量，执行过的指令一条不漏都回确认；
+//     回调里发的回复挤不掉确认；超长被丢弃的 QoS1 报文也确认 (否则每次重连都会重发) ===
+void test_mqtt_session_ack_reserve(void) {
+    FakeLink &link = ms_link();
+    static uint8_t tx[96];
+    MqttSession s(link);
+    ms_gotCount = 0;
+    ms_replies = 0;
+    ms_replying = &s;
+    s.begin(ms_config(), tx, sizeof(tx), nullptr, [](char *, uint8_t *, unsigned int) {
+        ms_gotCount++;
+        if (ms_replying->publishNow(0, MS_STATUS, (const uint8_t *)"Ignored", 7, false)) ms_replies++;
+    });
+    ms_connect(s, link, 0, true);
+
+    const int COMMANDS = 40;
+    uint8_t p[32];
+    for (int i = 0; i < COMMANDS; i++) {
+        Mqtt::Writer w(p, sizeof(p));
+        Mqtt::encodePublishHeader(w, MS_CMD, 4, 1, false, false, (uint16_t)(100 + i));
+        w.bytes("stop", 4);
+        link.inject(p, w.len);
+    }
+
+    // socket 一个字节都写不出去：执行了几条就必须有几个确认排在发送缓冲区里
+    link.writeBudget = 0;
+    for (uint32_t t = 10; t < 100; t += 10) s.loop(t);
+    TEST_ASSERT_TRUE(ms_gotCount > 0);
+    TEST_ASSERT_TRUE(ms_gotCount < COMMANDS);   // 其余的还留在 socket 里
+    TEST_ASSERT_TRUE(ms_replies < ms_gotCount); // 回复放不下就不发，确认照样有位置
+    TEST_ASSERT_EQUAL_UINT32(ms_gotCount * 4 + ms_replies * (Mqtt::publishHeaderSize(MS_STATUS, 7, 0) + 7), s.pendingTxBytes());
+
+    // socket 恢复：剩下的读进来，每条指令正好一个确认
+    link.writeBudget = -1;
+    for (uint32_t t = 100; t < 300 && ms_gotCount < COMMANDS; t += 10) s.loop(t);
+    s.loop(300);
+    TEST_ASSERT_EQUAL_INT(COMMANDS, ms_gotCount);
+    static SentPacket pk[64];
+    int n = ms_take(link, pk, 64);
+    int acks = 0;
+    for (int i = 0; i < n; i++) {
+        if (pk[i].type != Mqtt::PUBACK) continue;
+        TEST_ASSERT_EQUAL_UINT16(100 + acks, pk[i].pid());
+        acks++;
+    }
+    TEST_ASSERT_EQUAL_INT(COMMANDS, acks);
+
+    // 超长的 QoS1 报文：丢弃，但回确认
+    static uint8_t big[MQTT_RX_BYTES + 64];
+    Mqtt::Writer bw(big, sizeof(big));
+    Mqtt::encodePublishHeader(bw, MS_CMD, MQTT_RX_BYTES, 1, false, false, 555);
+    bw.len += MQTT_RX_BYTES;
+    for (size_t at = 0; at < bw.len; at += 512) {
+        link.inject(big + at, bw.len - at < 512 ? bw.len - at : 512);
+        s.loop(400);
+    }
+    TEST_ASSERT_TRUE(s.isConnected());
+    TEST_ASSERT_EQUAL_UINT32(1, s.stats().oversized);
+    TEST_ASSERT_EQUAL_INT(COMMANDS, ms_gotCount);
+    TEST_ASSERT_EQUAL_INT(1, ms_take(link, pk, 64));
+    TEST_ASSERT_EQUAL_UINT8(Mqtt::PUBACK, pk[0].type);
+    TEST_ASSERT_EQUAL_UINT16(555, pk[0].pid());
+    ms_replying = nullptr;
+}
+
+static int ms_streamCalls = 0;
+
+// 分段发布的数据源：第 i 个字节是 i * 7 + 3，哪一段都能单独算出来
+static void ms_streamSource(const void *, uint8_t *out, size_t offset, size_t len) {
+    ms_streamCalls++;
+    for (size_t i = 0; i < len; i++) out[i] = (uint8_t)((offset + i) * 7 + 3);
+}
+
+// === 测试用例 9: QoS0 分段发布：比发送缓冲区大得多的报文随 socket 的进度写出，内容完整；
+//     写完之前不读 socket、不插别的报文，也不接受新的发布；之后确认和 QoS1 消息照常发出 ===
+void test_mqtt_session_stream(void) {
+    FakeLink &link = ms_link();
+    static uint8_t tx[256];
+    static uint8_t storage[512];
+    OutboundQueue outbox;
+    outbox.attach(storage, sizeof(storage));
+    MqttSession s(link);
+    ms_gotCount = 0;
+    ms_streamCalls = 0;
+    s.begin(ms_config(), tx, sizeof(tx), &outbox, [](char *, uint8_t *, unsigned int) { ms_gotCount++; });
+    ms_connect(s, link, 0, true);
+
+    // 前面的 QoS1 消息还堵在发送缓冲区里
+    link.writeBudget = 0;
+    outbox.push(MS_STATUS, "Auto Start [1/3]");
+    s.loop(10);
+    TEST_ASSERT_TRUE(s.pendingTxBytes() > 0);
+
+    const size_t PAYLOAD = 1500;
+    TEST_ASSERT_TRUE(s.beginStream(20, MS_STATUS, PAYLOAD, false, &ms_streamSource, nullptr));
+    TEST_ASSERT_TRUE(s.streaming());
+    TEST_ASSERT_FALSE(s.beginStream(20, MS_STATUS, 10, false, &ms_streamSource, nullptr));
+    TEST_ASSERT_NULL(s.beginPublish(MS_STATUS, 11, false));
+
+    // 写出期间到达的指令和新的 QoS1 消息
+    uint8_t p[32];
+    Mqtt::Writer w(p, sizeof(p));
+    Mqtt::encodePublishHeader(w, MS_CMD, 4, 1, false, false, 88);
+    w.bytes("stop", 4);
+    link.inject(p, w.len);
+    outbox.push(MS_STATUS, "Done [1/3]");
+
+    // socket 每轮只收 40 字节，发出的字节攒到 wire 里
+    static uint8_t wire[4096];
+    size_t wireLen = 0;
+    uint32_t t = 30;
+    for (; t < 5000 && (s.streaming() || s.pendingTxBytes() > 0 || s.inflight() < 2); t += 10) {
+        link.writeBudget = 40;
+        s.loop(t);
+        if (s.streaming()) TEST_ASSERT_EQUAL_INT(0, ms_gotCount); // 写完之前不读 socket
+        memcpy(wire + wireLen, link.up, link.upLen);
+        wireLen += link.upLen;
+        link.upLen = 0;
+    }
+    TEST_ASSERT_TRUE(t < 5000);
+    TEST_ASSERT_TRUE(ms_streamCalls > (int)(PAYLOAD / sizeof(tx)));
+    TEST_ASSERT_EQUAL_INT(1, ms_gotCount);
+
+    // 线路上：堵着的 QoS1 -> 完整的分段报文 -> 确认 -> 新的 QoS1
+    static Mqtt::Decoder<2048> dec;
+    dec.reset();
+    size_t at = 0;
+    uint8_t types[8];
+    int n = 0;
+    while (at < wireLen && n < 8) {
+        size_t used = 0;
+        Mqtt::Decoder<2048>::Result r = dec.feed(wire + at, wireLen - at, used);
+        at += used;
+        if (r != Mqtt::Decoder<2048>::Result::Packet) break;
+        types[n] = dec.type();
+        if (n == 1) {
+            TEST_ASSERT_EQUAL_HEX8(0x00, dec.flags());
+            uint16_t topicLen = (uint16_t)(dec.body()[0] << 8 | dec.body()[1]);
+            TEST_ASSERT_EQUAL_UINT32(2 + topicLen + PAYLOAD, dec.bodyLen());
+            const uint8_t *payload = dec.body() + 2 + topicLen;
+            for (size_t i = 0; i < PAYLOAD; i++) TEST_ASSERT_EQUAL_HEX8((uint8_t)(i * 7 + 3), payload[i]);
+        } else if (n == 0 || n == 3) {
+            TEST_ASSERT_EQUAL_HEX8(0x02, dec.flags()); // QoS1
+        } else if (n == 2) {
+            TEST_ASSERT_EQUAL_UINT16(88, (uint16_t)(dec.body()[0] << 8 | dec.body()[1]));
+        }
+        n++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(wireLen, at);
+    TEST_ASSERT_EQUAL_INT(4, n);
+    TEST_ASSERT_EQUAL_UINT8(Mqtt::PUBLISH, types[0]);
+    TEST_ASSERT_EQUAL_UINT8(Mqtt::PUBLISH, types[1]);
+    TEST_ASSERT_EQUAL_UINT8(Mqtt::PUBACK, types[2]);
+    TEST_ASSERT_EQUAL_UINT8(Mqtt::PUBLISH, types[3]);
+}
+
+// ================= 共享的运行清单 =================
+void run_shared_mqtt_session_tests() {
+    RUN_TEST(test_mqtt_codec_roundtrip);
+    RUN_TEST(test_mqtt_session_connect);
+    RUN_TEST(test_mqtt_session_inflight_window);
+    RUN_TEST(test_mqtt_session_retransmit);
+    RUN_TEST(test_mqtt_session_inbound_qos1);
+    RUN_TEST(test_mqtt_session_keepalive);
+    RUN_TEST(test_mqtt_session_partial_writes);
+    RUN_TEST(test_mqtt_session_ack_reserve);
+    RUN_TEST(test_mqtt_session_stream);
+}
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef OTA_DELTA_TESTS_H
+#define OTA_DELTA_TESTS_H
+
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "PullOta.h"
+#include "ota_pull_tests.h" // MemSource / MemSink
+
+// 大缓冲区都是 static：embedded 测试跑在 loopTask 的小栈上
+static const size_t OD_OLD_BYTES = 10 * 1024 + 77;
+static const size_t OD_INSERT = 211;
+static const size_t OD_NEW_BYTES = OD_OLD_BYTES + OD_INSERT;
+static uint8_t od_old[OD_OLD_BYTES];
+static uint8_t od_new[OD_NEW_BYTES];
+static uint8_t od_out[OD_NEW_BYTES];
+static uint8_t od_packed[OD_NEW_BYTES];
+static std::vector<uint8_t> od_patch;
+
+struct OdImage : public Delta::OldImage {
+    const uint8_t *data = od_old;
+    uint32_t len = OD_OLD_BYTES;
+    uint32_t reads = 0;
+    bool failReads = false;
+
+    uint32_t size() const override { return len; }
+    bool read(uint32_t offset, uint8_t *buf, size_t n) override {
+        reads++;
+        if (failReads || offset + n > len)
+            return false;
+        memcpy(buf, data + offset, n);
+        return true;
+    }
+};
+
+// 旧版本：指令模式 + 指向后面代码的 "绝对地址"；新版本在 1/3 处插入一段代码，之后的地址整体 +OD_INSERT，再改两个常量
+static void od_makeImages() {
+    uint32_t seed = 777;
+    for (size_t i = 0; i < OD_OLD_BYTES; i++) {
+        seed = seed * 1103515245u + 12345u;
+        od_old[i] = (uint8_t)("\x36\x41\x00\x0c\x02\x1d\xf0\x91"[i % 8] ^ (seed >> 28));
+    }
+    const size_t at = OD_OLD_BYTES / 3;
+    memcpy(od_new, od_old, at);
+    for (size_t i = 0; i < OD_INSERT; i++)
+        od_new[at + i] = (uint8_t)(i * 7 + 3);
+    memcpy(od_new + at + OD_INSERT, od_old + at, OD_OLD_BYTES - at);
+    for (size_t i = 0; i + 4 <= OD_OLD_BYTES; i += 64) {
+        uint32_t a = 0x42000000u + (uint32_t)(i * 3 % OD_OLD_BYTES);
+        memcpy(od_old + i, &a, 4);
+        if (a - 0x42000000u >= at)
+            a += OD_INSERT;
+        size_t j = i < at ? i : i + OD_INSERT;
+        memcpy(od_new + j, &a, 4);
+    }
+    od_new[100] ^= 0x55;
+    od_new[OD_NEW_BYTES - 9] ^= 0x01;
+
+    static Delta::Encoder enc;
+    enc.diff(od_old, OD_OLD_BYTES, od_new, OD_NEW_BYTES, od_patch);
+}
+
+static Delta::Applier od_applier;
+
+// 按不同的切片大小喂补丁，返回最后的状态
+static Delta::Status od_apply(const uint8_t *patch, size_t len, OdImage &base, size_t chunk, uint32_t &outLen) {
+    od_applier.reset(&base);
+    outLen = 0;
+    Delta::Status s = Delta::Status::More;
+    auto emit = [&](const uint8_t *data, size_t n) {
+        if (outLen + n > sizeof(od_out))
+            return false;
+        memcpy(od_out + outLen, data, n);
+        outLen += (uint32_t)n;
+        return true;
+    };
+    for (size_t off = 0; off < len && s == Delta::Status::More; off += chunk)
+        s = od_applier.feed(patch + off, len - off < chunk ? len - off : chunk, emit);
+    return s;
+}
+
+// === 测试用例 1: 插入 + 地址平移 + 改常量：补丁远小于镜像，任意切片都还原出逐字节一致的新镜像 ===
+void test_delta_roundtrip(void) {
+    od_makeImages();
+    TEST_ASSERT_TRUE(od_patch.size() < OD_NEW_BYTES / 4);
+
+    static const size_t chunks[] = {1, 7, 44, 45, 300, 4096, 100000};
+    for (size_t c : chunks) {
+        OdImage base;
+        uint32_t outLen = 0;
+        memset(od_out, 0, sizeof(od_out));
+        TEST_ASSERT_EQUAL(Delta::Status::Done, od_apply(od_patch.data(), od_patch.size(), base, c, outLen));
+        TEST_ASSERT_TRUE(od_applier.done());
+        TEST_ASSERT_EQUAL_UINT32(OD_NEW_BYTES, od_applier.size());
+        TEST_ASSERT_EQUAL_UINT32(OD_NEW_BYTES, outLen);
+        TEST_ASSERT_EQUAL_MEMORY(od_new, od_out, OD_NEW_BYTES);
+    }
+
+    // 完全相同的镜像：只有头部 + 一个 COPY
+    static Delta::Encoder enc;
+    std::vector<uint8_t> same;
+    enc.diff(od_old, OD_OLD_BYTES, od_old, OD_OLD_BYTES, same);
+    TEST_ASSERT_TRUE(same.size() <= Delta::HEADER_BYTES + 3);
+}
+
+// === 测试用例 2: 基线不对、越界操作、截断、尾部多余数据、读 Flash 失败都拒绝 ===
+void test_delta_rejects(void) {
+    od_makeImages();
+    uint32_t outLen = 0;
+
+    // 1. 设备上跑的是别的版本 / 旧镜像比补丁要求的短 / 没有基线
+    OdImage other;
+    other.data = od_new;
+    TEST_ASSERT_EQUAL(Delta::Status::BaseMismatch, od_apply(od_patch.data(), od_patch.size(), other, 512, outLen));
+    TEST_ASSERT_EQUAL_UINT32(0, outLen);
+    OdImage shorter;
+    shorter.len = OD_OLD_BYTES - 1;
+    TEST_ASSERT_EQUAL(Delta::Status::BaseMismatch, od_apply(od_patch.data(), od_patch.size(), shorter, 512, outLen));
+    od_applier.reset(nullptr);
+    TEST_ASSERT_EQUAL(Delta::Status::BaseMismatch, od_applier.feed(od_patch.data(), od_patch.size(), [](const uint8_t *, size_t) { return true; }));
+
+    // 2. 手工构造的补丁：头部来自真补丁，后面接越界操作
+    static uint8_t bad[Delta::HEADER_BYTES + 8];
+    memcpy(bad, od_patch.data(), Delta::HEADER_BYTES);
+    OdImage base;
+    uint8_t *op = bad + Delta::HEADER_BYTES;
+    uint32_t tooFar = (uint32_t)(OD_OLD_BYTES + 1) << 2 | 0; // COPY 超出旧镜像
+    op[0] = (uint8_t)(tooFar | 0x80);
+    op[1] = (uint8_t)(tooFar >> 7 | 0x80);
+    op[2] = (uint8_t)(tooFar >> 14);
+    TEST_ASSERT_EQUAL(Delta::Status::BadFormat, od_apply(bad, Delta::HEADER_BYTES + 3, base, 512, outLen));
+    op[0] = (1 << 2) | 3; // SEEK -1 (zigzag 1)：退到 0 之前
+    op[1] = 0;
+    TEST_ASSERT_EQUAL(Delta::Status::BadFormat, od_apply(bad, Delta::HEADER_BYTES + 1, base, 512, outLen));
+    op[0] = 0; // COPY 0
+    TEST_ASSERT_EQUAL(Delta::Status::BadFormat, od_apply(bad, Delta::HEADER_BYTES + 1, base, 512, outLen));
+    memset(op, 0xFF, 6); // varint 超过 32 位
+    TEST_ASSERT_EQUAL(Delta::Status::BadFormat, od_apply(bad, Delta::HEADER_BYTES + 6, base, 512, outLen));
+    memcpy(bad, "WDP2", 4);
+    TEST_ASSERT_EQUAL(Delta::Status::BadFormat, od_apply(bad, Delta::HEADER_BYTES, base, 512, outLen));
+
+    // 3. 截断：停在 More，不算完成；尾部多一个字节：BadFormat
+    TEST_ASSERT_EQUAL(Delta::Status::More, od_apply(od_patch.data(), od_patch.size() - 1, base, 512, outLen));
+    TEST_ASSERT_FALSE(od_applier.done());
+    od_patch.push_back(0);
+    TEST_ASSERT_EQUAL(Delta::Status::BadFormat, od_apply(od_patch.data(), od_patch.size(), base, 512, outLen));
+    od_patch.pop_back();
+
+    // 4. 读旧镜像失败
+    base.failReads = true;
+    TEST_ASSERT_EQUAL(Delta::Status::ReadFailed, od_apply(od_patch.data(), od_patch.size(), base, 512, outLen));
+}
+
+// === 测试用例 3: 拉取升级自动识别压缩后的差分补丁，断线续传；基线不对时 abort，不切换分区 ===
+void test_pull_delta(void) {
+    od_makeImages();
+    static Lzss::Encoder lz;
+    size_t packedLen = lz.compress(od_patch.data(), od_patch.size(), od_packed, sizeof(od_packed));
+    TEST_ASSERT_TRUE(packedLen > 0);
+    uint8_t sha[Sha256::DIGEST_BYTES];
+    Sha256 s;
+    s.update(od_new, OD_NEW_BYTES);
+    s.finish(sha);
+
+    MemSource src;
+    src.data = od_packed;
+    src.len = (uint32_t)packedLen;
+    src.failAfter = 200;
+    MemSink sink;
+    sink.buf = od_out;
+    sink.cap = sizeof(od_out);
+    Ota::Hooks hooks;
+    hooks.sleep = [](uint32_t) {};
+    uint32_t lastTotal = 0;
+    hooks.block = [&](uint32_t, uint32_t total) { lastTotal = total; };
+
+    OdImage base;
+    op_updater.setBase(&base);
+    TEST_ASSERT_EQUAL(Ota::Result::Ok, op_updater.run(src, sink, sha, hooks));
+    TEST_ASSERT_TRUE(sink.committed);
+    TEST_ASSERT_EQUAL_UINT32(OD_NEW_BYTES, sink.len);
+    TEST_ASSERT_EQUAL_MEMORY(od_new, od_out, OD_NEW_BYTES);
+    TEST_ASSERT_EQUAL_UINT32(OD_NEW_BYTES, lastTotal); // 进度按新镜像长度算
+    const Ota::Stats &st = op_updater.stats();
+    TEST_ASSERT_TRUE(st.delta);
+    TEST_ASSERT_EQUAL_UINT32(OD_NEW_BYTES, st.rawBytes);
+    TEST_ASSERT_EQUAL_UINT32(packedLen, st.compressedBytes);
+    TEST_ASSERT_TRUE(st.connects > 1);
+
+    // 基线不对：在写 Flash 之前就失败
+    OdImage other;
+    other.data = od_new;
+    op_updater.setBase(&other);
+    MemSink sink2;
+    sink2.buf = od_out;
+    sink2.cap = sizeof(od_out);
+    src.failAfter = 0;
+    TEST_ASSERT_EQUAL(Ota::Result::BaseMismatch, op_updater.run(src, sink2, sha, hooks));
+    TEST_ASSERT_FALSE(sink2.begun);
+    TEST_ASSERT_FALSE(sink2.committed);
+
+    // 没有基线 (不支持差分的平台)：同样拒绝
+    op_updater.setBase(nullptr);
+    TEST_ASSERT_EQUAL(Ota::Result::BaseMismatch, op_updater.run(src, sink2, sha, hooks));
+    TEST_ASSERT_FALSE(sink2.committed);
+}
+
+void run_shared_ota_delta_tests(void) {
+    RUN_TEST(test_delta_roundtrip);
+    RUN_TEST(test_delta_rejects);
+    RUN_TEST(test_pull_delta);
+}
+
+#endif
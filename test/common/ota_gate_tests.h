@@ -0,0 +1,96 @@
+#ifndef OTA_GATE_TESTS_H
+#define OTA_GATE_TESTS_H
+
+#include <unity.h>
+#include "OtaGate.h"
+
+// === 测试用例 1: 三个任务之间的握手顺序 ===
+void test_ota_gate_handshake(void) {
+    OtaGate g;
+    uint16_t seen = 0;
+    OtaGate::Phase p;
+    uint8_t pct;
+    TEST_ASSERT_FALSE(g.holdWanted());
+    TEST_ASSERT_FALSE(g.poll(seen, p, pct));
+
+    // 控制任务没收到请求时 grant 无效
+    g.grant();
+    TEST_ASSERT_EQUAL(OtaGate::Phase::Idle, g.phase());
+
+    g.request();
+    TEST_ASSERT_TRUE(g.holdWanted());
+    TEST_ASSERT_FALSE(g.granted()); // 水泵停稳之前不许写 Flash
+    g.progress(10);                 // 没放行时进度被忽略
+    TEST_ASSERT_EQUAL(OtaGate::Phase::Requested, g.phase());
+    g.grant();
+    TEST_ASSERT_TRUE(g.granted());
+
+    // 网络任务只看到最新的快照，序号保证不漏掉变化
+    g.progress(5);
+    g.progress(5); // 相同进度不算变化
+    g.progress(10);
+    TEST_ASSERT_TRUE(g.poll(seen, p, pct));
+    TEST_ASSERT_EQUAL(OtaGate::Phase::Receiving, p);
+    TEST_ASSERT_EQUAL_UINT8(10, pct);
+    TEST_ASSERT_EQUAL_UINT16(4, seen);
+    TEST_ASSERT_FALSE(g.poll(seen, p, pct));
+
+    // 失败：放开控制任务，进度停在失败时
+    g.finish(false);
+    TEST_ASSERT_FALSE(g.holdWanted());
+    TEST_ASSERT_TRUE(g.poll(seen, p, pct));
+    TEST_ASSERT_EQUAL(OtaGate::Phase::Failed, p);
+    TEST_ASSERT_EQUAL_UINT8(10, pct);
+
+    // 成功：保持暂停直到重启
+    g.request();
+    g.grant();
+    g.finish(true);
+    TEST_ASSERT_TRUE(g.holdWanted());
+    TEST_ASSERT_TRUE(g.poll(seen, p, pct));
+    TEST_ASSERT_EQUAL(OtaGate::Phase::Done, p);
+    TEST_ASSERT_EQUAL_UINT8(100, pct);
+}
+
+// === 测试用例 2: 写入限速与进度抽稀 ===
+void test_ota_throttle(void) {
+    OtaThrottle::Config c;
+    c.maxBytesPerSec = 50000;
+    c.minGapMs = 2;
+    c.reportStepPct = 5;
+    OtaThrottle t(c);
+    t.start(1000);
+
+    // 100ms 内收到 50KB：要睡到第 1 秒
+    TEST_ASSERT_EQUAL_UINT32(900, t.onChunk(1100, 50000));
+    // 落后于限速时也至少让出 minGapMs
+    TEST_ASSERT_EQUAL_UINT32(2, t.onChunk(5000, 50000));
+
+    // 模拟 1MB 固件、1460 字节一块：平均速率不超过上限
+    uint32_t now = 1000, total = 1000000;
+    t.start(now);
+    uint32_t reports = 0;
+    uint8_t pct, last = 0;
+    for (uint32_t written = 0; written < total;) {
+        written += written + 1460 > total ? total - written : 1460;
+        if (t.stepReached(written, total, pct)) {
+            TEST_ASSERT_TRUE(reports == 0 || pct >= last + 5 || pct == 100);
+            last = pct;
+            reports++;
+        }
+        now += 1 + t.onChunk(now + 1, written); // 每块收发耗时 1ms
+    }
+    TEST_ASSERT_EQUAL_UINT8(100, last);
+    TEST_ASSERT_TRUE(reports <= 21);
+    uint32_t rate = (uint32_t)((uint64_t)total * 1000 / (now - 1000));
+    TEST_ASSERT_TRUE(rate <= 50000);
+    TEST_ASSERT_TRUE(rate >= 45000);
+}
+
+// ================= 共享的运行清单 =================
+void run_shared_ota_gate_tests() {
+    RUN_TEST(test_ota_gate_handshake);
+    RUN_TEST(test_ota_throttle);
+}
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef OTA_PULL_TESTS_H
+#define OTA_PULL_TESTS_H
+
+#include <unity.h>
+#include <string.h>
+#include "PullOta.h"
+
+// 大缓冲区都是 static：embedded 测试跑在 loopTask 的小栈上
+static const size_t OP_RAW_BYTES = 12 * 1024 + 123; // 故意不是 4KB 的整数倍
+static uint8_t op_raw[OP_RAW_BYTES];
+static uint8_t op_packed[OP_RAW_BYTES + OP_RAW_BYTES / 8 + 64];
+static size_t op_packedLen = 0;
+static uint8_t op_sha[Sha256::DIGEST_BYTES];
+
+// 像固件一样的数据：大段重复的指令模式 + 随机常量 + 0xFF 填充
+static void op_makeImage() {
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < OP_RAW_BYTES; i++) {
+        seed = seed * 1103515245u + 12345u;
+        if (i % 2048 < 1200)
+            op_raw[i] = (uint8_t)("\x36\x41\x00\x0c\x02\x1d\xf0\x91"[i % 8] ^ (i / 256));
+        else if (i % 2048 < 1700)
+            op_raw[i] = (uint8_t)(seed >> 16);
+        else
+            op_raw[i] = 0xFF;
+    }
+    static Lzss::Encoder enc;
+    op_packedLen = enc.compress(op_raw, OP_RAW_BYTES, op_packed, sizeof(op_packed));
+    Sha256 sha;
+    sha.update(op_raw, OP_RAW_BYTES);
+    sha.finish(op_sha);
+}
+
+// 内存里的镜像；每次 open 之后最多给 failAfter 字节就 "断线"
+struct MemSource : public Ota::Source {
+    const uint8_t *data = nullptr;
+    uint32_t len = 0;
+    uint32_t pos = 0;
+    uint32_t failAfter = 0; // 0 = 不断线
+    uint32_t sent = 0;
+    uint16_t failOpens = 0; // 前几次 open 直接失败
+    uint16_t opens = 0;
+
+    bool open(uint32_t offset, uint32_t &total) override {
+        opens++;
+        if (failOpens > 0) {
+            failOpens--;
+            return false;
+        }
+        pos = offset;
+        sent = 0;
+        total = len;
+        return offset <= len;
+    }
+    int read(uint8_t *buf, size_t n) override {
+        if (failAfter && sent >= failAfter)
+            return -1;
+        if (pos >= len)
+            return 0;
+        size_t k = len - pos < n ? len - pos : n;
+        if (k > 300)
+            k = 300; // 分片大小和 4KB 扇区错开
+        if (failAfter && sent + k > failAfter)
+            k = failAfter - sent;
+        memcpy(buf, data + pos, k);
+        pos += (uint32_t)k;
+        sent += (uint32_t)k;
+        return (int)k;
+    }
+    void close() override {}
+};
+
+struct MemSink : public Ota::Sink {
+    uint8_t *buf = nullptr;
+    uint32_t cap = 0;
+    uint32_t len = 0;
+    uint16_t writes = 0;
+    bool begun = false, committed = false, aborted = false;
+
+    uint32_t capacity() const override { return cap; }
+    bool begin(uint32_t size) override {
+        begun = true;
+        len = 0;
+        return size <= cap;
+    }
+    bool write(const uint8_t *data, size_t n) override {
+        if (len + n > cap)
+            return false;
+        memcpy(buf + len, data, n);
+        len += (uint32_t)n;
+        writes++;
+        return true;
+    }
+    bool commit() override {
+        committed = true;
+        return true;
+    }
+    void abort() override { aborted = true; }
+};
+
+static uint8_t op_out[OP_RAW_BYTES];
+static Ota::PullUpdater op_updater;
+
+// === 测试用例 1: SHA-256 标准向量，分段 update 与一次 update 结果一致 ===
+void test_sha256_vectors(void) {
+    uint8_t d[32], e[32];
+    Sha256 s;
+    s.finish(d);
+    TEST_ASSERT_TRUE(Sha256::parseHex("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", 64, e));
+    TEST_ASSERT_EQUAL_MEMORY(e, d, 32);
+
+    s.begin();
+    s.update((const uint8_t *)"abc", 3);
+    s.finish(d);
+    TEST_ASSERT_TRUE(Sha256::parseHex("BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD", 64, e));
+    TEST_ASSERT_EQUAL_MEMORY(e, d, 32);
+
+    const char *two = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"; // 56 字节：填充跨块
+    s.begin();
+    s.update((const uint8_t *)two, strlen(two));
+    s.finish(d);
+    TEST_ASSERT_TRUE(Sha256::parseHex("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", 64, e));
+    TEST_ASSERT_EQUAL_MEMORY(e, d, 32);
+
+    // 1000 个 'a'，按 1 / 63 / 64 / 65 字节交替喂
+    static uint8_t as[1000];
+    memset(as, 'a', sizeof(as));
+    s.begin();
+    const size_t steps[] = {1, 63, 64, 65};
+    for (size_t off = 0, k = 0; off < sizeof(as); k++) {
+        size_t n = steps[k % 4] < sizeof(as) - off ? steps[k % 4] : sizeof(as) - off;
+        s.update(as + off, n);
+        off += n;
+    }
+    s.finish(d);
+    TEST_ASSERT_TRUE(Sha256::parseHex("41edece42d63e8d9bf515a9ba6932e1c20cbc9f5a5d134645adb5db1b9737ea3", 64, e));
+    TEST_ASSERT_EQUAL_MEMORY(e, d, 32);
+
+    TEST_ASSERT_FALSE(Sha256::parseHex("zz", 2, e));
+    TEST_ASSERT_FALSE(Sha256::parseHex("g3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", 64, e));
+}
+
+// === 测试用例 2: 压缩 -> 任意切分喂给解压器 -> 每 4KB 输出一次，内容一致 ===
+void test_lzss_roundtrip(void) {
+    op_makeImage();
+    TEST_ASSERT_TRUE(op_packedLen > Lzss::HEADER_BYTES);
+    TEST_ASSERT_TRUE(op_packedLen < OP_RAW_BYTES * 2 / 3); // 重复模式和填充能压下去
+
+    static Lzss::Decoder dec;
+    dec.reset();
+    size_t outLen = 0;
+    uint16_t blocks = 0;
+    bool aligned = true;
+    auto emit = [&](const uint8_t *p, size_t n) {
+        if (n != Lzss::WINDOW && outLen + n != OP_RAW_BYTES)
+            aligned = false; // 只有最后一块可以不满 4KB
+        memcpy(op_out + outLen, p, n);
+        outLen += n;
+        blocks++;
+        return true;
+    };
+    Lzss::Status s = Lzss::Status::More;
+    for (size_t off = 0, k = 1; off < op_packedLen; k = k % 37 + 1) {
+        size_t n = k < op_packedLen - off ? k : op_packedLen - off;
+        s = dec.feed(op_packed + off, n, emit);
+        off += n;
+        if (off < op_packedLen)
+            TEST_ASSERT_EQUAL(Lzss::Status::More, s);
+    }
+    TEST_ASSERT_EQUAL(Lzss::Status::Done, s);
+    TEST_ASSERT_TRUE(aligned);
+    TEST_ASSERT_EQUAL_UINT16(4, blocks);
+    TEST_ASSERT_EQUAL_UINT32(OP_RAW_BYTES, outLen);
+    TEST_ASSERT_EQUAL_MEMORY(op_raw, op_out, OP_RAW_BYTES);
+
+    // 重复模式 (距离 1)，长度正好 4KB
+    static uint8_t same[Lzss::WINDOW];
+    memset(same, 0x5A, sizeof(same));
+    static Lzss::Encoder enc;
+    static uint8_t packed[1024];
+    size_t n = enc.compress(same, sizeof(same), packed, sizeof(packed));
+    TEST_ASSERT_TRUE(n > 0 && n < 600);
+    dec.reset();
+    outLen = 0;
+    blocks = 0;
+    TEST_ASSERT_EQUAL(Lzss::Status::Done, dec.feed(packed, n, emit));
+    TEST_ASSERT_EQUAL_UINT16(1, blocks);
+    TEST_ASSERT_EQUAL_MEMORY(same, op_out, sizeof(same));
+}
+
+// === 测试用例 3: 损坏的输入被拒绝，不会越界读写 ===
+void test_lzss_rejects(void) {
+    static Lzss::Decoder dec;
+    auto emit = [](const uint8_t *, size_t) { return true; };
+
+    // 魔数错
+    dec.reset();
+    TEST_ASSERT_EQUAL(Lzss::Status::BadFormat, dec.feed((const uint8_t *)"WLZ2\x10\0\0\0", 8, emit));
+
+    // 第一项就回溯 (窗口里还没有数据)
+    const uint8_t backref[] = {'W', 'L', 'Z', '1', 16, 0, 0, 0, 0x00, 0x00, 0x00};
+    dec.reset();
+    TEST_ASSERT_EQUAL(Lzss::Status::BadFormat, dec.feed(backref, sizeof(backref), emit));
+
+    // 回溯长度超出原始长度
+    const uint8_t overrun[] = {'W', 'L', 'Z', '1', 4, 0, 0, 0, 0x01, 'x', 0x00, 0x0F};
+    dec.reset();
+    TEST_ASSERT_EQUAL(Lzss::Status::BadFormat, dec.feed(overrun, sizeof(overrun), emit));
+
+    // 已经完整还有多余字节
+    const uint8_t trailing[] = {'W', 'L', 'Z', '1', 1, 0, 0, 0, 0x01, 'x', 'y'};
+    dec.reset();
+    TEST_ASSERT_EQUAL(Lzss::Status::BadFormat, dec.feed(trailing, sizeof(trailing), emit));
+    dec.reset();
+    TEST_ASSERT_EQUAL(Lzss::Status::Done, dec.feed(trailing, sizeof(trailing) - 1, emit));
+
+    // 输出端写失败
+    dec.reset();
+    TEST_ASSERT_EQUAL(Lzss::Status::SinkFailed, dec.feed(trailing, sizeof(trailing) - 1, [](const uint8_t *, size_t) { return false; }));
+}
+
+// === 测试用例 4: 连接反复断开，从已消费的偏移续传，结果逐字节一致 ===
+void test_pull_resume(void) {
+    op_makeImage();
+    MemSource src;
+    src.data = op_packed;
+    src.len = (uint32_t)op_packedLen;
+    src.failAfter = 400; // 每个连接只给 400 字节
+    src.failOpens = 2;    // 一开始服务器不可达
+    MemSink sink;
+    sink.buf = op_out;
+    sink.cap = sizeof(op_out);
+
+    uint32_t slept = 0, lastWritten = 0, blocks = 0;
+    Ota::Hooks hooks;
+    hooks.sleep = [&](uint32_t ms) { slept += ms; };
+    hooks.block = [&](uint32_t written, uint32_t total) {
+        TEST_ASSERT_TRUE(written > lastWritten);
+        TEST_ASSERT_EQUAL_UINT32(OP_RAW_BYTES, total);
+        lastWritten = written;
+        blocks++;
+    };
+
+    TEST_ASSERT_EQUAL(Ota::Result::Ok, op_updater.run(src, sink, op_sha, hooks));
+    TEST_ASSERT_TRUE(sink.committed);
+    TEST_ASSERT_FALSE(sink.aborted);
+    TEST_ASSERT_EQUAL_UINT32(OP_RAW_BYTES, sink.len);
+    TEST_ASSERT_EQUAL_MEMORY(op_raw, op_out, OP_RAW_BYTES);
+    TEST_ASSERT_EQUAL_UINT32(4, blocks);
+
+    // 每个字节只下载一次；断线的次数远多于 maxAttempts 也没放弃 (每次都有进展)
+    const Ota::Stats &st = op_updater.stats();
+    TEST_ASSERT_EQUAL_UINT32(op_packedLen, st.compressedBytes);
+    TEST_ASSERT_EQUAL_UINT16((op_packedLen + 399) / 400, st.connects);
+    TEST_ASSERT_EQUAL_UINT16(st.connects - 1, st.resumes);
+    TEST_ASSERT_TRUE(st.connects > 8);
+    TEST_ASSERT_EQUAL_UINT32(1000 + 2000 + 1000 * (st.connects - 1), slept); // 两次连不上：退避翻倍；之后每次断线等 base
+}
+
+// === 测试用例 5: 失败路径都会 abort，不会切换启动分区 ===
+void test_pull_failures(void) {
+    op_makeImage();
+    MemSource src;
+    src.data = op_packed;
+    src.len = (uint32_t)op_packedLen;
+    MemSink sink;
+    sink.buf = op_out;
+    sink.cap = sizeof(op_out);
+    Ota::Hooks hooks;
+    hooks.sleep = [](uint32_t) {};
+
+    // 1. 哈希不一致
+    uint8_t wrong[32];
+    memcpy(wrong, op_sha, sizeof(wrong));
+    wrong[31] ^= 1;
+    TEST_ASSERT_EQUAL(Ota::Result::HashMismatch, op_updater.run(src, sink, wrong, hooks));
+    TEST_ASSERT_TRUE(sink.aborted);
+    TEST_ASSERT_FALSE(sink.committed);
+
+    // 2. 分区放不下：一个字节都不写
+    sink = MemSink();
+    sink.buf = op_out;
+    sink.cap = OP_RAW_BYTES - 1;
+    TEST_ASSERT_EQUAL(Ota::Result::TooLarge, op_updater.run(src, sink, op_sha, hooks));
+    TEST_ASSERT_FALSE(sink.begun);
+    TEST_ASSERT_EQUAL_UINT16(0, sink.writes);
+
+    // 3. 文件被截断
+    sink = MemSink();
+    sink.buf = op_out;
+    sink.cap = sizeof(op_out);
+    src.len = (uint32_t)op_packedLen - 10;
+    TEST_ASSERT_EQUAL(Ota::Result::BadFormat, op_updater.run(src, sink, op_sha, hooks));
+    TEST_ASSERT_TRUE(sink.aborted);
+
+    // 4. 服务器一直不可达：maxAttempts 次之后放弃
+    src.len = (uint32_t)op_packedLen;
+    src.failOpens = 100;
+    src.opens = 0;
+    TEST_ASSERT_EQUAL(Ota::Result::SourceFailed, op_updater.run(src, sink, op_sha, hooks));
+    TEST_ASSERT_EQUAL_UINT16(Ota::Config().maxAttempts, src.opens);
+}
+
+// === 测试用例 6: MQTT 指令 "ota <url> <sha256>" ===
+void test_pull_request_parse(void) {
+    static Ota::Request req;
+    const char *ok = " OTA  http://10.0.0.5:8080/fw/v0.3.wlz  e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855\n";
+    TEST_ASSERT_EQUAL(Ota::ParseResult::Ok, Ota::parseRequest((const uint8_t *)ok, strlen(ok), req));
+    TEST_ASSERT_EQUAL_STRING("http://10.0.0.5:8080/fw/v0.3.wlz", req.url);
+    TEST_ASSERT_EQUAL_HEX8(0xe3, req.sha256[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x55, req.sha256[31]);
+
+    // 不是 ota 指令：交给 CommandParser
+    const char *other[] = {"start 30", "otax http://a/b 00", "", "zone 1 ota"};
+    for (const char *s : other)
+        TEST_ASSERT_EQUAL(Ota::ParseResult::NotOta, Ota::parseRequest((const uint8_t *)s, strlen(s), req));
+
+    const char *bad[] = {
+        "ota",
+        "ota http://a/b.wlz",
+        "ota https://a/b.wlz e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+        "ota http://a/b.wlz e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b85",
+        "ota http://a/b.wlz e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855 extra",
+    };
+    for (const char *s : bad)
+        TEST_ASSERT_EQUAL(Ota::ParseResult::BadArgument, Ota::parseRequest((const uint8_t *)s, strlen(s), req));
+}
+
+void run_shared_ota_pull_tests(void) {
+    RUN_TEST(test_sha256_vectors);
+    RUN_TEST(test_lzss_roundtrip);
+    RUN_TEST(test_lzss_rejects);
+    RUN_TEST(test_pull_resume);
+    RUN_TEST(test_pull_failures);
+    RUN_TEST(test_pull_request_parse);
+}
+
+#endif
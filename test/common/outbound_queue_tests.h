@@ -0,0 +1,202 @@
+#ifndef OUTBOUND_QUEUE_TESTS_H
+#define OUTBOUND_QUEUE_TESTS_H
+
+#include <unity.h>
+#include <stdio.h>
+#include "OutboundQueue.h"
+
+static const char *OQ_TOPIC_A = "watering/status";
+static const char *OQ_TOPIC_B = "watering/event";
+
+// 读出队首并出队，返回内容 (写进 out，以 '\0' 结尾)
+static bool oq_take(OutboundQueue &q, const char *&topic, char *out, uint16_t cap, bool &retained) {
+    uint16_t len;
+    if (!q.front(topic, (uint8_t *)out, cap - 1, len, retained)) return false;
+    out[len] = '\0';
+    q.pop();
+    return true;
+}
+
+// === 测试用例 1: 先进先出，topic / retained 原样保留 ===
+void test_outbox_fifo(void) {
+    uint8_t storage[256];
+    OutboundQueue q;
+    q.attach(storage, sizeof(storage));
+
+    TEST_ASSERT_TRUE(q.push(OQ_TOPIC_A, "Auto Start [1/3]"));
+    TEST_ASSERT_TRUE(q.push(OQ_TOPIC_B, "Done [1/3]", true));
+    TEST_ASSERT_EQUAL_UINT32(2, q.size());
+
+    const char *topic;
+    char buf[64];
+    bool retained;
+    TEST_ASSERT_TRUE(oq_take(q, topic, buf, sizeof(buf), retained));
+    TEST_ASSERT_EQUAL_PTR(OQ_TOPIC_A, topic);
+    TEST_ASSERT_EQUAL_STRING("Auto Start [1/3]", buf);
+    TEST_ASSERT_FALSE(retained);
+
+    TEST_ASSERT_TRUE(oq_take(q, topic, buf, sizeof(buf), retained));
+    TEST_ASSERT_EQUAL_PTR(OQ_TOPIC_B, topic);
+    TEST_ASSERT_EQUAL_STRING("Done [1/3]", buf);
+    TEST_ASSERT_TRUE(retained);
+
+    TEST_ASSERT_TRUE(q.empty());
+    TEST_ASSERT_EQUAL_UINT32(2, q.getStats().sent);
+}
+
+// === 测试用例 2: 记录跨越缓冲区末尾时内容完整 ===
+void test_outbox_wraparound(void) {
+    uint8_t storage[100];
+    OutboundQueue q;
+    q.attach(storage, sizeof(storage));
+
+    char msg[16];
+    char buf[32];
+    const char *topic;
+    bool retained;
+    // 反复进出，让写指针绕好几圈
+    for (int i = 0; i < 50; i++) {
+        snprintf(msg, sizeof(msg), "msg-%d", i);
+        TEST_ASSERT_TRUE(q.push(OQ_TOPIC_A, msg));
+        TEST_ASSERT_TRUE(oq_take(q, topic, buf, sizeof(buf), retained));
+        TEST_ASSERT_EQUAL_STRING(msg, buf);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, q.getStats().dropped);
+}
+
+// === 测试用例 3: DropOldest 挤掉最旧的，保留最新的 ===
+void test_outbox_drop_oldest(void) {
+    uint8_t storage[128];
+    OutboundQueue q(OutboundQueue::OverflowPolicy::DropOldest);
+    q.attach(storage, sizeof(storage));
+
+    char msg[16];
+    for (int i = 0; i < 20; i++) {
+        snprintf(msg, sizeof(msg), "event-%02d", i);
+        TEST_ASSERT_TRUE(q.push(OQ_TOPIC_A, msg));
+    }
+
+    OutboundQueue::Stats s = q.getStats();
+    TEST_ASSERT_TRUE(s.dropped > 0);
+    TEST_ASSERT_EQUAL_UINT32(20, s.depth + s.dropped);
+    TEST_ASSERT_TRUE(s.bytes <= s.capacity);
+
+    // 剩下的是连续的最后几条
+    const char *topic;
+    char buf[32];
+    bool retained;
+    for (uint32_t i = 20 - s.depth; i < 20; i++) {
+        snprintf(msg, sizeof(msg), "event-%02u", (unsigned)i);
+        TEST_ASSERT_TRUE(oq_take(q, topic, buf, sizeof(buf), retained));
+        TEST_ASSERT_EQUAL_STRING(msg, buf);
+    }
+    TEST_ASSERT_TRUE(q.empty());
+}
+
+// === 测试用例 4: DropNewest 保留最早的，新消息被拒绝 ===
+void test_outbox_drop_newest(void) {
+    uint8_t storage[128];
+    OutboundQueue q(OutboundQueue::OverflowPolicy::DropNewest);
+    q.attach(storage, sizeof(storage));
+
+    char msg[16];
+    uint32_t accepted = 0;
+    for (int i = 0; i < 20; i++) {
+        snprintf(msg, sizeof(msg), "event-%02d", i);
+        if (q.push(OQ_TOPIC_A, msg)) accepted++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(accepted, q.size());
+    TEST_ASSERT_EQUAL_UINT32(20 - accepted, q.getStats().dropped);
+
+    const char *topic;
+    char buf[32];
+    bool retained;
+    TEST_ASSERT_TRUE(oq_take(q, topic, buf, sizeof(buf), retained));
+    TEST_ASSERT_EQUAL_STRING("event-00", buf);
+
+    // 单条超过总容量：直接拒绝
+    uint8_t big[200] = {};
+    TEST_ASSERT_FALSE(q.push(OQ_TOPIC_A, big, sizeof(big)));
+}
+
+// === 测试用例 5: 重连后限速刷新 ===
+void test_outbox_flush_pacing(void) {
+    FlushPacer pacer(100, 5);
+    pacer.reset(1000);
+
+    // 同一个窗口内最多 5 条
+    uint16_t sent = 0;
+    for (uint32_t t = 1000; t < 1100; t += 10) {
+        uint16_t b = pacer.budget(t);
+        while (b-- > 0) {
+            pacer.consume();
+            sent++;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT16(5, sent);
+
+    // 下一个窗口额度恢复
+    TEST_ASSERT_EQUAL_UINT16(5, pacer.budget(1100));
+
+    // millis 回绕也正常
+    pacer.reset(0xFFFFFFF0u);
+    pacer.consume();
+    TEST_ASSERT_EQUAL_UINT16(4, pacer.budget(0xFFFFFFF8u));
+    TEST_ASSERT_EQUAL_UINT16(5, pacer.budget(0x60u));
+}
+
+// === 测试用例 6: peek 读任意位置；已发出未确认的队首不会被 DropOldest 挤掉 ===
+void test_outbox_peek_pinned(void) {
+    uint8_t storage[128];
+    OutboundQueue q(OutboundQueue::OverflowPolicy::DropOldest);
+    q.attach(storage, sizeof(storage));
+
+    char msg[16];
+    for (int i = 0; i < 3; i++) {
+        snprintf(msg, sizeof(msg), "event-%02d", i);
+        TEST_ASSERT_TRUE(q.push(OQ_TOPIC_A, msg));
+    }
+    const char *topic;
+    char buf[32];
+    uint16_t len;
+    bool retained;
+    TEST_ASSERT_TRUE(q.peek(2, topic, (uint8_t *)buf, sizeof(buf) - 1, len, retained));
+    buf[len] = '\0';
+    TEST_ASSERT_EQUAL_STRING("event-02", buf);
+    TEST_ASSERT_FALSE(q.peek(3, topic, (uint8_t *)buf, sizeof(buf), len, retained));
+
+    // 前两条在途：一直塞到满，在途的两条必须还在，挤掉的是它们后面最旧的
+    q.setPinned(2);
+    for (int i = 3; i < 20; i++) {
+        snprintf(msg, sizeof(msg), "event-%02d", i);
+        q.push(OQ_TOPIC_A, msg);
+    }
+    TEST_ASSERT_TRUE(q.getStats().dropped > 0);
+    TEST_ASSERT_TRUE(oq_take(q, topic, buf, sizeof(buf), retained));
+    TEST_ASSERT_EQUAL_STRING("event-00", buf);
+    TEST_ASSERT_TRUE(oq_take(q, topic, buf, sizeof(buf), retained));
+    TEST_ASSERT_EQUAL_STRING("event-01", buf);
+    TEST_ASSERT_TRUE(q.peek(q.size() - 1, topic, (uint8_t *)buf, sizeof(buf) - 1, len, retained));
+    buf[len] = '\0';
+    TEST_ASSERT_EQUAL_STRING("event-19", buf);
+    TEST_ASSERT_TRUE(q.front(topic, (uint8_t *)buf, sizeof(buf) - 1, len, retained));
+    buf[len] = '\0';
+    TEST_ASSERT_TRUE(strcmp(buf, "event-02") > 0);
+
+    // 确认完之后恢复正常的 DropOldest
+    uint32_t depth = q.size();
+    snprintf(msg, sizeof(msg), "event-%02d", 99);
+    for (uint32_t i = 0; i <= depth + 2; i++)
+        TEST_ASSERT_TRUE(q.push(OQ_TOPIC_A, msg));
+}
+
+void run_shared_outbound_queue_tests() {
+    RUN_TEST(test_outbox_fifo);
+    RUN_TEST(test_outbox_wraparound);
+    RUN_TEST(test_outbox_drop_oldest);
+    RUN_TEST(test_outbox_drop_newest);
+    RUN_TEST(test_outbox_flush_pacing);
+    RUN_TEST(test_outbox_peek_pinned);
+}
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef POWER_LEASE_TESTS_H
+#define POWER_LEASE_TESTS_H
+
+#include <unity.h>
+#include <string.h>
+#include "PowerLease.h"
+#include "WateringSystem.h"
+#include "system_tests.h" // createTime / runUntilIdle
+
+// 内存里的 "broker"：每台设备一条保留消息，发布后按订阅顺序投递给所有在线设备 (包括自己)
+// 投递在下一拍才发生 (模拟网络延迟)；上线时先收到全部保留消息
+#define PL_DEVICES 4
+#define PL_INBOX 32
+
+struct PlMsg {
+    uint8_t from;
+    char payload[48];
+};
+
+struct PlBus {
+    PowerLease lease[PL_DEVICES];
+    bool online[PL_DEVICES];
+    bool want[PL_DEVICES];
+    bool granted[PL_DEVICES];
+    char retained[PL_DEVICES][48];
+    PlMsg inbox[PL_DEVICES][PL_INBOX];
+    uint8_t inCount[PL_DEVICES];
+    uint8_t maxHolders;
+};
+
+static PlBus pl_bus;
+static const char *const pl_ids[PL_DEVICES] = {"a", "b", "c", "d"};
+
+static void pl_reset(const PowerLease::Config &cfg) {
+    memset(pl_bus.online, 0, sizeof(pl_bus.online));
+    memset(pl_bus.want, 0, sizeof(pl_bus.want));
+    memset(pl_bus.granted, 0, sizeof(pl_bus.granted));
+    memset(pl_bus.retained, 0, sizeof(pl_bus.retained));
+    memset(pl_bus.inCount, 0, sizeof(pl_bus.inCount));
+    pl_bus.maxHolders = 0;
+    for (int d = 0; d < PL_DEVICES; d++) {
+        pl_bus.lease[d] = PowerLease();
+        pl_bus.lease[d].begin(pl_ids[d], cfg);
+    }
+}
+
+static void pl_send(int to, int from, const char *payload) {
+    if (pl_bus.inCount[to] >= PL_INBOX) return;
+    PlMsg &m = pl_bus.inbox[to][pl_bus.inCount[to]++];
+    m.from = (uint8_t)from;
+    strncpy(m.payload, payload, sizeof(m.payload) - 1);
+    m.payload[sizeof(m.payload) - 1] = '\0';
+}
+
+static void pl_publish(int from, const char *payload) {
+    strncpy(pl_bus.retained[from], payload, sizeof(pl_bus.retained[from]) - 1);
+    for (int d = 0; d < PL_DEVICES; d++)
+        if (pl_bus.online[d]) pl_send(d, from, payload);
+}
+
+static void pl_connect(int d) {
+    pl_bus.online[d] = true;
+    for (int j = 0; j < PL_DEVICES; j++)
+        if (pl_bus.retained[j][0]) pl_send(d, j, pl_bus.retained[j]);
+}
+
+static void pl_disconnect(int d) {
+    pl_bus.online[d] = false;
+    pl_bus.inCount[d] = 0;
+}
+
+// 一秒：先收上一拍发出的消息，再推进每台设备；统计同时持有名额的设备数
+static void pl_step(int64_t now) {
+    for (int d = 0; d < PL_DEVICES; d++) {
+        for (uint8_t i = 0; i < pl_bus.inCount[d]; i++) {
+            const PlMsg &m = pl_bus.inbox[d][i];
+            pl_bus.lease[d].onMessage(pl_ids[m.from], strlen(pl_ids[m.from]), (const uint8_t *)m.payload, strlen(m.payload), now);
+        }
+        pl_bus.inCount[d] = 0;
+    }
+    uint8_t holders = 0;
+    for (int d = 0; d < PL_DEVICES; d++) {
+        uint32_t next = 0;
+        pl_bus.granted[d] = pl_bus.lease[d].tick(now, pl_bus.want[d], pl_bus.online[d],
+                                                 [d](const char *p) { pl_publish(d, p); }, next);
+        if (pl_bus.granted[d]) holders++;
+    }
+    if (holders > pl_bus.maxHolders) pl_bus.maxHolders = holders;
+}
+
+static void pl_run(int64_t from, int64_t to) {
+    for (int64_t t = from; t < to; t++) pl_step(t);
+}
+
+static PowerLease::Config pl_config(uint8_t slots) {
+    PowerLease::Config cfg;
+    cfg.slots = slots;
+    cfg.leaseSec = 30;
+    cfg.settleSec = 3;
+    cfg.offlineGrantSec = 60;
+    return cfg;
+}
+
+// === 测试用例 1: 排队：先申请先得，同一秒按 id；释放后下一个接上；任何时刻不超过名额 ===
+void test_power_lease_queue(void) {
+    pl_reset(pl_config(1));
+    for (int d = 0; d < 3; d++) pl_connect(d);
+
+    // 1. a / b / c 依次申请：回显 + settle 之后只有 a 开泵
+    pl_bus.want[0] = true;
+    pl_step(100);
+    pl_bus.want[1] = true;
+    pl_step(101);
+    pl_bus.want[2] = true;
+    pl_run(102, 110);
+    TEST_ASSERT_TRUE(pl_bus.granted[0]);
+    TEST_ASSERT_FALSE(pl_bus.granted[1] || pl_bus.granted[2]);
+    TEST_ASSERT_TRUE(pl_bus.lease[0].state() == PowerLease::State::Holding);
+    TEST_ASSERT_EQUAL_INT(1, pl_bus.lease[1].position(110)); // 前面是 a
+    TEST_ASSERT_EQUAL_INT(2, pl_bus.lease[2].position(110));
+    TEST_ASSERT_EQUAL_UINT8(1, pl_bus.lease[2].holders(110));
+
+    // 2. a 用完释放 (保留消息被删掉)：b 接上，c 还在等
+    pl_bus.want[0] = false;
+    pl_run(110, 113);
+    TEST_ASSERT_EQUAL_STRING("", pl_bus.retained[0]);
+    TEST_ASSERT_TRUE(pl_bus.granted[1]);
+    TEST_ASSERT_FALSE(pl_bus.granted[2]);
+    pl_bus.want[1] = false;
+    pl_run(113, 116);
+    TEST_ASSERT_TRUE(pl_bus.granted[2]);
+    pl_bus.want[2] = false;
+    pl_run(116, 120);
+    TEST_ASSERT_EQUAL_UINT8(1, pl_bus.maxHolders);
+    TEST_ASSERT_EQUAL_UINT32(1, pl_bus.lease[2].getStats().grants);
+    TEST_ASSERT_TRUE(pl_bus.lease[2].getStats().maxWaitSec >= 12);
+
+    // 3. 两个名额、同一秒申请：所有设备算出同一个顺序 (id 小的在前)，长时间持有靠续约维持
+    pl_reset(pl_config(2));
+    for (int d = 0; d < 3; d++) pl_connect(d);
+    pl_bus.want[2] = pl_bus.want[1] = pl_bus.want[0] = true;
+    pl_run(200, 400);
+    TEST_ASSERT_TRUE(pl_bus.granted[0] && pl_bus.granted[1]);
+    TEST_ASSERT_FALSE(pl_bus.granted[2]);
+    TEST_ASSERT_EQUAL_INT(2, pl_bus.lease[2].position(400)); // 前面两台都在运行
+    TEST_ASSERT_EQUAL_UINT8(2, pl_bus.maxHolders);
+    TEST_ASSERT_EQUAL_UINT32(0, pl_bus.lease[0].getStats().lost);
+}
+
+// === 测试用例 2: 持有者掉线：它自己先停泵，别人等它的租约到期才接手；重启后清掉残留的保留消息 ===
+void test_power_lease_expiry(void) {
+    pl_reset(pl_config(1));
+    pl_connect(0);
+    pl_connect(1);
+    pl_bus.want[0] = true;
+    pl_run(0, 5);
+    TEST_ASSERT_TRUE(pl_bus.granted[0]);
+    pl_bus.want[1] = true;
+    pl_run(5, 20);
+
+    // 1. a 断网 (没来得及释放)：a 在最后一次回显的到期前 settle 秒放手，b 在到期后才开泵
+    pl_disconnect(0);
+    int64_t aStopped = -1, bStarted = -1;
+    for (int64_t t = 20; t < 60; t++) {
+        pl_step(t);
+        if (aStopped < 0 && !pl_bus.granted[0]) aStopped = t;
+        if (bStarted < 0 && pl_bus.granted[1]) bStarted = t;
+    }
+    TEST_ASSERT_TRUE(aStopped > 20 && bStarted > 20);
+    TEST_ASSERT_TRUE(bStarted - aStopped >= 3);
+    TEST_ASSERT_TRUE(bStarted <= 20 + 30); // 最多等一个租约
+    TEST_ASSERT_EQUAL_UINT8(1, pl_bus.maxHolders);
+    TEST_ASSERT_EQUAL_UINT32(1, pl_bus.lease[0].getStats().lost);
+
+    // 2. a 重启 (新对象) 上线：broker 上还留着它以前的 R，不需要名额也要删掉
+    pl_bus.lease[0] = PowerLease();
+    pl_bus.lease[0].begin("a", pl_config(1));
+    pl_bus.want[0] = false;
+    pl_connect(0);
+    TEST_ASSERT_EQUAL_INT('R', pl_bus.retained[0][strlen(pl_bus.retained[0]) - 1]);
+    pl_run(60, 62);
+    TEST_ASSERT_EQUAL_STRING("", pl_bus.retained[0]);
+
+    // 3. 再要名额：排在正在运行的 b 后面
+    pl_bus.want[0] = true;
+    pl_run(62, 70);
+    TEST_ASSERT_FALSE(pl_bus.granted[0]);
+    TEST_ASSERT_EQUAL_INT(1, pl_bus.lease[0].position(70));
+    TEST_ASSERT_EQUAL_UINT8(1, pl_bus.maxHolders);
+}
+
+// === 测试用例 3: 连不上 broker：等 offlineGrantSec (加按 id 错开的时间) 后自己放行；重连后以 R 公布 ===
+void test_power_lease_offline(void) {
+    pl_reset(pl_config(1));
+    pl_bus.want[0] = true;
+    int64_t localAt = -1;
+    for (int64_t t = 1000; t < 1400 && localAt < 0; t++) {
+        pl_step(t);
+        if (pl_bus.granted[0]) localAt = t;
+    }
+    TEST_ASSERT_TRUE(localAt >= 1000 + 60 && localAt < 1000 + 60 + 300);
+    TEST_ASSERT_TRUE(pl_bus.lease[0].state() == PowerLease::State::Local);
+    TEST_ASSERT_EQUAL_UINT32(1, pl_bus.lease[0].getStats().localGrants);
+
+    // 重连：水泵不停，马上把自己公布成 R，后来的设备排在它后面
+    pl_connect(0);
+    pl_connect(1);
+    pl_step(localAt + 1);
+    TEST_ASSERT_TRUE(pl_bus.granted[0]);
+    TEST_ASSERT_TRUE(pl_bus.lease[0].state() == PowerLease::State::Holding);
+    TEST_ASSERT_EQUAL_INT('R', pl_bus.retained[0][strlen(pl_bus.retained[0]) - 1]);
+    pl_bus.want[1] = true;
+    pl_run(localAt + 2, localAt + 20);
+    TEST_ASSERT_TRUE(pl_bus.granted[0]);
+    TEST_ASSERT_FALSE(pl_bus.granted[1]);
+}
+
+// === 测试用例 4: 浇水系统按名额运行：没名额时计划和手动指令排队，拿到后手动先走；名额丢了立即停泵 ===
+void test_power_permit_system(void) {
+    static char msg[64];
+    WateringSystem sys(false);
+    sys.addZone(4, 2, 2, 0, 1, 18);
+    sys.addZone(5, 2, 3, 0, 1, 18); // 3:00，这次只手动运行
+    sys.setPowerPermit(false);
+    sys.begin();
+    sys.setNotifier([](const char *m) { strncpy(msg, m, sizeof(msg) - 1); });
+    TEST_ASSERT_FALSE(sys.needsPower());
+
+    // 1. 计划到点、没名额：不开泵，但需要名额
+    struct tm t = createTime(100, 2, 0);
+    sys.update(t);
+    TEST_ASSERT_FALSE(sys.isBusy());
+    TEST_ASSERT_TRUE(sys.needsPower());
+
+    // 2. 手动指令排队 (只排一个)；拿到名额后手动的先走，计划的接着
+    sys.forceWatering(1, 1);
+    TEST_ASSERT_EQUAL_STRING("Queued: Waiting for power", msg);
+    sys.forceWatering(0);
+    TEST_ASSERT_EQUAL_STRING("Ignored: System is Busy", msg);
+    sys.setPowerPermit(true);
+    sys.update(t);
+    TEST_ASSERT_TRUE(sys.isBusy(1));
+    TEST_ASSERT_FALSE(sys.isBusy(0)); // 同时运行上限 1
+    TEST_ASSERT_EQUAL_STRING("Zone 1: Manual Start [1/18]", msg);
+    runUntilIdle(sys);
+    sys.update(t);
+    TEST_ASSERT_TRUE(sys.isBusy(0));
+
+    // 3. 名额丢了 (租约没续上)：正在运行的立即停，记为中止
+    sys.setPowerPermit(false);
+    TEST_ASSERT_FALSE(sys.isRelayOn(0));
+    runUntilIdle(sys);
+    TEST_ASSERT_NOT_NULL(strstr(msg, "Zone 0: Aborted"));
+    TEST_ASSERT_FALSE(sys.needsPower());
+
+    // 4. stop 取消排队的手动运行
+    sys.forceWatering(0);
+    TEST_ASSERT_TRUE(sys.needsPower());
+    sys.stopWatering(0);
+    TEST_ASSERT_EQUAL_STRING("Cancelled: Queued run", msg);
+    TEST_ASSERT_FALSE(sys.needsPower());
+}
+
+void run_shared_power_lease_tests() {
+    RUN_TEST(test_power_lease_queue);
+    RUN_TEST(test_power_lease_expiry);
+    RUN_TEST(test_power_lease_offline);
+    RUN_TEST(test_power_permit_system);
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef PUMP_TESTS_H
+#define PUMP_TESTS_H
+
+#include <unity.h>
+#include "PumpStateMachine.h"
+
+// === 测试用例 1: 完整跑满时长 ===
+void test_pump_full_run(void) {
+    PumpStateMachine pump;
+    TEST_ASSERT_TRUE(pump.start(3000));
+    TEST_ASSERT_TRUE(pump.getState() == PumpState::Starting);
+    TEST_ASSERT_FALSE(pump.relayOn());
+
+    // 第一拍：吸合
+    TEST_ASSERT_TRUE(pump.tick(1000) == PumpEvent::Started);
+    TEST_ASSERT_TRUE(pump.relayOn());
+
+    // 时长未到
+    TEST_ASSERT_TRUE(pump.tick(3999) == PumpEvent::None);
+    TEST_ASSERT_TRUE(pump.relayOn());
+
+    // 时长到：断开，下一拍结算
+    pump.tick(4000);
+    TEST_ASSERT_FALSE(pump.relayOn());
+    TEST_ASSERT_TRUE(pump.getState() == PumpState::Stopping);
+    TEST_ASSERT_TRUE(pump.tick(4010) == PumpEvent::Finished);
+    TEST_ASSERT_TRUE(pump.isIdle());
+    TEST_ASSERT_EQUAL_UINT32(3000, pump.getElapsedMs());
+}
+
+// === 测试用例 2: 忙碌时拒绝重复启动 ===
+void test_pump_busy_lock(void) {
+    PumpStateMachine pump;
+    TEST_ASSERT_TRUE(pump.start(1000));
+    pump.tick(0);
+    TEST_ASSERT_FALSE(pump.start(1000));
+}
+
+// === 测试用例 3: stop 立即断开继电器 ===
+void test_pump_stop_immediate(void) {
+    PumpStateMachine pump;
+    pump.start(60000);
+    pump.tick(0);
+    pump.tick(1500);
+
+    pump.requestStop(1520);
+    // 不需要等下一拍，继电器状态已经是断开
+    TEST_ASSERT_FALSE(pump.relayOn());
+    TEST_ASSERT_TRUE(pump.tick(1530) == PumpEvent::Aborted);
+    TEST_ASSERT_EQUAL_UINT32(1520, pump.getElapsedMs());
+}
+
+// === 测试用例: 下一次需要 tick 的时刻 (控制任务据此睡眠) ===
+void test_pump_next_deadline(void) {
+    PumpStateMachine pump;
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, pump.msUntilNextTick(0)); // 空闲：没有工作
+
+    pump.start(30000);
+    TEST_ASSERT_EQUAL_UINT32(0, pump.msUntilNextTick(100)); // Starting：马上推进
+    pump.tick(100);
+    TEST_ASSERT_EQUAL_UINT32(30000, pump.msUntilNextTick(100));
+    TEST_ASSERT_EQUAL_UINT32(10000, pump.msUntilNextTick(20100));
+    TEST_ASSERT_EQUAL_UINT32(0, pump.msUntilNextTick(40000)); // 睡过头也立刻处理
+
+    // 睡到截止时刻正好一拍就结束
+    TEST_ASSERT_TRUE(pump.tick(30100) == PumpEvent::None);
+    TEST_ASSERT_EQUAL_UINT32(0, pump.msUntilNextTick(30100)); // Stopping：马上结算
+    TEST_ASSERT_TRUE(pump.tick(30100) == PumpEvent::Finished);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, pump.msUntilNextTick(30100));
+}
+
+// === 测试用例 4: millis() 溢出 ===
+void test_pump_millis_wrap(void) {
+    PumpStateMachine pump;
+    pump.start(2000);
+    pump.tick(0xFFFFFC00UL); // 溢出前 1024ms 启动
+    pump.tick(0x00000100UL); // 溢出后 256ms (已运行 1280ms)
+    TEST_ASSERT_TRUE(pump.relayOn());
+    pump.tick(0x000003D0UL); // 已运行 2000ms
+    TEST_ASSERT_FALSE(pump.relayOn());
+}
+
+// === 测试用例 5: 60 秒运行按 10ms 节拍推进：每一拍只看时间戳，截止时刻正好断开 ===
+// 旧实现里 activatePump 会把 loop 卡住整整 60 秒；这里只用传进去的时间戳，不测真实耗时
+void test_pump_loop_latency_60s(void) {
+    const uint32_t TICK_MS = 10;
+    const uint32_t RUN_MS = 60000;
+    PumpStateMachine pump;
+    bool relay = false;
+    int relaySwitches = 0;
+    uint32_t offAt = 0;
+
+    pump.start(RUN_MS);
+    for (uint32_t now = 0; now <= RUN_MS + 2 * TICK_MS; now += TICK_MS) {
+        pump.tick(now);
+        if (pump.relayOn() != relay) {
+            relay = pump.relayOn();
+            relaySwitches++;
+            if (!relay) offAt = now;
+        }
+        // 运行中：下一次要推进的时刻正好是剩余时长，不会让调用方多睡
+        if (pump.relayOn())
+            TEST_ASSERT_EQUAL_UINT32(RUN_MS - now, pump.msUntilNextTick(now));
+    }
+
+    TEST_ASSERT_TRUE(pump.isIdle());
+    TEST_ASSERT_EQUAL_INT(2, relaySwitches); // 一开一关
+    TEST_ASSERT_EQUAL_UINT32(RUN_MS, offAt);
+    TEST_ASSERT_EQUAL_UINT32(RUN_MS, pump.getElapsedMs());
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, pump.msUntilNextTick(RUN_MS + 2 * TICK_MS));
+}
+
+void run_shared_pump_tests() {
+    RUN_TEST(test_pump_full_run);
+    RUN_TEST(test_pump_busy_lock);
+    RUN_TEST(test_pump_stop_immediate);
+    RUN_TEST(test_pump_next_deadline);
+    RUN_TEST(test_pump_millis_wrap);
+    RUN_TEST(test_pump_loop_latency_60s);
+}
+
+#endif
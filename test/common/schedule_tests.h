@@ -0,0 +1,106 @@
+#ifndef SCHEDULE_TESTS_H
+#define SCHEDULE_TESTS_H
+
+#include <unity.h>
+#include "WateringCore.h"
+#include "Schedule.h"
+
+// 编译期展开：写错的 build flag 计划在这里就会报错
+static_assert(Schedule::parse("06:00,18:30 mon-fri /2d").isValid(), "valid spec");
+static_assert(!Schedule::parse("25:00").isValid(), "bad hour");
+static_assert(Schedule::daily(2, 0).every(3).intervalDays() == 3, "builder");
+
+static int64_t sch_at(int y, int m, int d, int hour, int min) {
+    return (int64_t)EpochTime::daysFromCivil(y, m, d) * EpochTime::SECONDS_PER_DAY + hour * 3600 + min * 60;
+}
+
+// === 测试用例 1: 解析 ===
+void test_schedule_parse(void) {
+    Schedule s = Schedule::parse("06:00,18:30 Mon-Fri apr-oct /3d");
+    TEST_ASSERT_TRUE(s.isValid());
+    TEST_ASSERT_EQUAL_INT(2, s.timesPerDay());
+    TEST_ASSERT_TRUE(s.hasMinute(6 * 60));
+    TEST_ASSERT_TRUE(s.hasMinute(18 * 60 + 30));
+    TEST_ASSERT_EQUAL_HEX8(0x3E, s.weekdays());
+    TEST_ASSERT_TRUE(s.hasSeason());
+    TEST_ASSERT_EQUAL_INT(3, s.intervalDays());
+
+    TEST_ASSERT_EQUAL_HEX8(0x41, Schedule::parse("07:15 sat,sun").weekdays());
+    TEST_ASSERT_EQUAL_HEX8(0x7F, Schedule::parse("07:15 daily").weekdays());
+
+    // 无效：缺时刻 / 越界 / 未知名字 / 不同类型混用 / 多余字符
+    TEST_ASSERT_FALSE(Schedule::parse("mon-fri").isValid());
+    TEST_ASSERT_FALSE(Schedule::parse("06:60").isValid());
+    TEST_ASSERT_FALSE(Schedule::parse("06:00 funday").isValid());
+    TEST_ASSERT_FALSE(Schedule::parse("06:00 mon-oct").isValid());
+    TEST_ASSERT_FALSE(Schedule::parse("06:00 02-30..03-01").isValid());
+    TEST_ASSERT_FALSE(Schedule::parse("06:00x").isValid());
+    TEST_ASSERT_FALSE(Schedule::parse("06:00 /0d").isValid());
+}
+
+// === 测试用例 2: 一天多次 ===
+void test_schedule_multiple_times(void) {
+    WateringLogic l(Schedule::parse("06:00,18:30"), 100);
+    int32_t day = EpochTime::daysFromCivil(2024, 4, 10);
+
+    TEST_ASSERT_EQUAL_INT64(sch_at(2024, 4, 10, 6, 0), l.nextFireTime(sch_at(2024, 4, 10, 0, 0), 0, WateringLogic::NEVER_WATERED));
+    // 早上浇过，晚上那次不受间隔限制
+    TEST_ASSERT_EQUAL_INT64(sch_at(2024, 4, 10, 18, 30), l.nextFireTime(sch_at(2024, 4, 10, 6, 5), 1, day));
+    TEST_ASSERT_TRUE(l.shouldStart(sch_at(2024, 4, 10, 18, 30), 1, day, false));
+    // 同一分钟只触发一次
+    TEST_ASSERT_FALSE(l.shouldStart(sch_at(2024, 4, 10, 18, 30), 2, day, true));
+    TEST_ASSERT_EQUAL_INT64(sch_at(2024, 4, 11, 6, 0), l.nextFireTime(sch_at(2024, 4, 10, 18, 30) + 20, 2, day));
+}
+
+// === 测试用例 3: 星期 ===
+void test_schedule_weekdays(void) {
+    // 2024-04-10 是周三
+    TEST_ASSERT_EQUAL_INT(3, EpochTime::weekday(EpochTime::daysFromCivil(2024, 4, 10)));
+
+    WateringLogic l(Schedule::parse("07:00 sat,sun"), 100);
+    TEST_ASSERT_EQUAL_INT64(sch_at(2024, 4, 13, 7, 0), l.nextFireTime(sch_at(2024, 4, 10, 12, 0), 0, WateringLogic::NEVER_WATERED));
+    TEST_ASSERT_FALSE(l.shouldStart(sch_at(2024, 4, 10, 7, 0), 0, WateringLogic::NEVER_WATERED, false));
+    TEST_ASSERT_TRUE(l.shouldStart(sch_at(2024, 4, 14, 7, 0), 1, EpochTime::daysFromCivil(2024, 4, 13), false));
+}
+
+// === 测试用例 4: 季节窗口 (含跨年) ===
+void test_schedule_season(void) {
+    WateringLogic summer(Schedule::parse("05:00 05-15..09-30"), 100);
+    TEST_ASSERT_EQUAL_INT64(sch_at(2024, 5, 15, 5, 0), summer.nextFireTime(sch_at(2024, 1, 1, 0, 0), 0, WateringLogic::NEVER_WATERED));
+    TEST_ASSERT_EQUAL_INT64(sch_at(2025, 5, 15, 5, 0), summer.nextFireTime(sch_at(2024, 9, 30, 6, 0), 1, EpochTime::daysFromCivil(2024, 9, 30)));
+
+    WateringLogic winter(Schedule::parse("12:00 nov-feb"), 100);
+    TEST_ASSERT_EQUAL_INT64(sch_at(2024, 11, 1, 12, 0), winter.nextFireTime(sch_at(2024, 6, 1, 0, 0), 0, WateringLogic::NEVER_WATERED));
+    TEST_ASSERT_EQUAL_INT64(sch_at(2025, 1, 1, 12, 0), winter.nextFireTime(sch_at(2024, 12, 31, 13, 0), 1, EpochTime::daysFromCivil(2024, 12, 31)));
+    TEST_ASSERT_TRUE(winter.shouldStart(sch_at(2025, 2, 28, 12, 0), 1, EpochTime::daysFromCivil(2025, 2, 27), false));
+    TEST_ASSERT_FALSE(winter.shouldStart(sch_at(2025, 3, 1, 12, 0), 1, EpochTime::daysFromCivil(2025, 2, 28), false));
+
+    // 只有 2 月 29 日：下一次在闰年
+    WateringLogic leap(Schedule::daily(8, 0).season(2, 29, 2, 29), 100);
+    TEST_ASSERT_EQUAL_INT64(sch_at(2028, 2, 29, 8, 0), leap.nextFireTime(sch_at(2024, 3, 1, 0, 0), 0, WateringLogic::NEVER_WATERED));
+}
+
+// === 测试用例 5: 间隔跨月 / 跨年 ===
+void test_schedule_interval(void) {
+    WateringLogic l(Schedule::parse("02:00 /3d"), 100);
+    int32_t last = EpochTime::daysFromCivil(2024, 12, 30);
+    TEST_ASSERT_EQUAL_INT64(sch_at(2025, 1, 2, 2, 0), l.nextFireTime(sch_at(2024, 12, 30, 3, 0), 1, last));
+    TEST_ASSERT_FALSE(l.shouldStart(sch_at(2025, 1, 1, 2, 0), 1, last, false));
+    TEST_ASSERT_TRUE(l.shouldStart(sch_at(2025, 1, 2, 2, 0), 1, last, false));
+
+    // 间隔 + 星期：间隔满足后还要等到允许的星期
+    WateringLogic weekly(Schedule::parse("02:00 mon /2d"), 100);
+    int32_t mon = EpochTime::daysFromCivil(2024, 4, 8);
+    TEST_ASSERT_EQUAL_INT64(sch_at(2024, 4, 15, 2, 0), weekly.nextFireTime(sch_at(2024, 4, 8, 3, 0), 1, mon));
+}
+
+// ================= 共享的运行清单 =================
+void run_shared_schedule_tests() {
+    RUN_TEST(test_schedule_parse);
+    RUN_TEST(test_schedule_multiple_times);
+    RUN_TEST(test_schedule_weekdays);
+    RUN_TEST(test_schedule_season);
+    RUN_TEST(test_schedule_interval);
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef SCHEDULER_TESTS_H
+#define SCHEDULER_TESTS_H
+
+#include <unity.h>
+#include "WateringCore.h"
+#include "ZoneScheduler.h"
+#include "WakePlanner.h"
+
+// 2024-04-10 (第 100 天) 的 epoch 天
+static const int32_t SCHED_DAY = EpochTime::daysFromCivil(2024, 4, 10);
+
+static int64_t at(int32_t day, int hour, int min) {
+    return (int64_t)day * EpochTime::SECONDS_PER_DAY + hour * 3600 + min * 60;
+}
+
+// === 测试用例 1: epoch 天换算 ===
+void test_epoch_day_conversion(void) {
+    TEST_ASSERT_EQUAL_INT32(0, EpochTime::daysFromCivil(1970, 1, 1));
+    TEST_ASSERT_EQUAL_INT32(19723, EpochTime::daysFromCivil(2024, 1, 1));
+
+    struct tm t = {};
+    t.tm_year = 124;
+    t.tm_yday = 100;
+    t.tm_hour = 2;
+    TEST_ASSERT_EQUAL_INT32(19823, EpochTime::epochDay(t));
+    TEST_ASSERT_EQUAL_INT64(at(19823, 2, 0), EpochTime::toLocalEpoch(t));
+}
+
+// === 测试用例 2: 下一次触发时刻 ===
+void test_next_fire_time(void) {
+    WateringLogic l(2, 0, 3, 18);
+
+    // 首次运行，当天还没到 2:00 -> 今天 2:00
+    TEST_ASSERT_EQUAL_INT64(at(SCHED_DAY, 2, 0), l.nextFireTime(at(SCHED_DAY, 1, 0), 0, WateringLogic::NEVER_WATERED));
+    // 已经过了 2:00 -> 明天 2:00
+    TEST_ASSERT_EQUAL_INT64(at(SCHED_DAY + 1, 2, 0), l.nextFireTime(at(SCHED_DAY, 3, 0), 0, WateringLogic::NEVER_WATERED));
+    // 目标分钟之内 -> 立即
+    TEST_ASSERT_EQUAL_INT64(at(SCHED_DAY, 2, 0) + 30, l.nextFireTime(at(SCHED_DAY, 2, 0) + 30, 0, WateringLogic::NEVER_WATERED));
+    // 间隔 3 天
+    TEST_ASSERT_EQUAL_INT64(at(SCHED_DAY + 3, 2, 0), l.nextFireTime(at(SCHED_DAY, 2, 1), 1, SCHED_DAY));
+    // 次数用完
+    TEST_ASSERT_TRUE(l.nextFireTime(at(SCHED_DAY, 1, 0), 18, SCHED_DAY - 5) == WateringLogic::NEVER);
+}
+
+// === 测试用例 3: 堆顶总是最早到期的区域 ===
+void test_zone_scheduler_order(void) {
+    ZoneScheduler<8> s;
+    s.schedule(3, 300);
+    s.schedule(1, 100);
+    s.schedule(5, 500);
+    s.schedule(2, 100); // 同一时刻，编号小的优先
+    TEST_ASSERT_EQUAL_INT64(100, s.nextFireAt());
+
+    uint16_t zone;
+    TEST_ASSERT_FALSE(s.popDue(99, zone));
+    TEST_ASSERT_TRUE(s.popDue(100, zone));
+    TEST_ASSERT_EQUAL_UINT16(1, zone);
+    TEST_ASSERT_TRUE(s.popDue(100, zone));
+    TEST_ASSERT_EQUAL_UINT16(2, zone);
+    TEST_ASSERT_FALSE(s.popDue(100, zone));
+
+    // 重新排期 (提前) 与取消
+    s.schedule(5, 50);
+    TEST_ASSERT_EQUAL_INT64(50, s.nextFireAt());
+    s.cancel(5);
+    TEST_ASSERT_EQUAL_INT64(300, s.nextFireAt());
+    TEST_ASSERT_EQUAL_UINT16(1, s.size());
+}
+
+// === 测试用例: 控制任务的睡眠时长 ===
+void test_wake_planner(void) {
+    const uint32_t MAX = 10000;
+    const int64_t now = at(SCHED_DAY, 1, 59) + 58; // 01:59:58
+    const int64_t fire = at(SCHED_DAY, 2, 0);
+
+    // 空闲、计划还远：睡满上限
+    TEST_ASSERT_EQUAL_UINT32(MAX, WakePlanner::sleepMs(true, now - 3600, 0, fire, UINT32_MAX, MAX));
+
+    // 计划快到了：对齐到整秒边界醒来 (已经过了这一秒的 250ms)
+    TEST_ASSERT_EQUAL_UINT32(1750, WakePlanner::sleepMs(true, now, 250, fire, UINT32_MAX, MAX));
+
+    // 水泵截止时刻更早
+    TEST_ASSERT_EQUAL_UINT32(800, WakePlanner::sleepMs(true, now, 250, fire, 800, MAX));
+
+    // 已过期的触发 (在等并发名额) 不会造成忙等
+    TEST_ASSERT_EQUAL_UINT32(5000, WakePlanner::sleepMs(true, fire + 3, 0, fire, 5000, MAX));
+
+    // 没有计划 / 时间未知：只看水泵和上限
+    TEST_ASSERT_EQUAL_UINT32(MAX, WakePlanner::sleepMs(true, now, 0, WateringLogic::NEVER, UINT32_MAX, MAX));
+    TEST_ASSERT_EQUAL_UINT32(MAX, WakePlanner::sleepMs(false, 0, 0, fire, UINT32_MAX, MAX));
+}
+
+void run_shared_scheduler_tests() {
+    RUN_TEST(test_epoch_day_conversion);
+    RUN_TEST(test_next_fire_time);
+    RUN_TEST(test_zone_scheduler_order);
+    RUN_TEST(test_wake_planner);
+}
+
+#endif
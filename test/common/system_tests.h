@@ -0,0 +1,403 @@
+#ifndef SYSTEM_TESTS_H
+#define SYSTEM_TESTS_H
+
+#include <unity.h>
+#include <string.h>
+#include "WateringSystem.h"
+
+// 系统集成测试：ESP32 上跑真实的 GPIO / Flash；native 上跑 HostHal (虚拟时钟，delay() 不占用真实时间)
+
+// 实例化一个测试专用的系统
+// GPIO 4, 时长 2秒 (短一点方便测), 2:00, 间隔 3天, 18次, 开启NVS
+WateringSystem testSys(4, 2, 2, 0, 3, 18, true);
+
+// 辅助：构造一个时间结构体
+struct tm createTime(int day, int hour, int min)
+{
+    struct tm t;
+    t.tm_year = 124; // 2024 年 (update 按 tm_year + tm_yday 换算 epoch 天)
+    t.tm_yday = day;
+    t.tm_hour = hour;
+    t.tm_min = min;
+    t.tm_sec = 0;
+    return t;
+}
+
+// 辅助：以 10ms 节拍推进状态机，直到本次浇水结束 (或超时)
+void runUntilIdle(WateringSystem &sys, unsigned long timeoutMs = 10000)
+{
+    unsigned long start = millis();
+    while (sys.isBusy() && millis() - start < timeoutMs)
+    {
+        sys.loop();
+        delay(10);
+    }
+}
+
+// === 测试前准备：清空环境 ===
+void setUp_System(void)
+{
+    testSys.begin();
+    testSys.factoryReset(); // 确保每次测试都是干净的起点
+}
+
+// === 测试用例 1: NVS 断电记忆功能 ===
+void test_nvs_persistence(void)
+{
+    // 1. 模拟第一次运行
+    struct tm t1 = createTime(100, 2, 0); // 第100天 2:00
+    testSys.update(t1);                   // 这应该会触发一次浇水
+    runUntilIdle(testSys);
+
+    TEST_ASSERT_EQUAL_INT(1, testSys.getWateredCount()); // 验证计数+1
+
+    // 2. 模拟重启 (重新执行 begin，会从 NVS 读取)
+    // 我们新建一个对象来模拟"重启后的系统"
+    WateringSystem rebootedSys(4, 2, 2, 0, 3, 18, true);
+    rebootedSys.begin(); // 读取 Flash
+
+    // 3. 验证数据是否恢复
+    TEST_ASSERT_EQUAL_INT(1, rebootedSys.getWateredCount());
+}
+
+// === 测试用例 2: Kill 功能 (彻底终止) ===
+void test_kill_function(void)
+{
+    // 1. 杀死系统
+    testSys.killSystem();
+    TEST_ASSERT_FALSE(testSys.isEnabled());
+
+    // 2. 尝试触发 (第100天 2:00)
+    struct tm t1 = createTime(100, 2, 0);
+    testSys.update(t1);
+
+    // 3. 验证：应该完全无视，计数器依然是 0
+    TEST_ASSERT_EQUAL_INT(0, testSys.getWateredCount());
+
+    // 4. 模拟重启：验证 Kill 状态是否被保存
+    WateringSystem rebootedSys(4, 2, 2, 0, 3, 18, true);
+    rebootedSys.begin();
+    TEST_ASSERT_FALSE(rebootedSys.isEnabled()); // 重启后应该依然是死的
+}
+
+// === 测试用例 3: Revive 功能 (复活) ===
+void test_revive_function(void)
+{
+    // 1. 先杀死
+    testSys.killSystem();
+
+    // 2. 再复活
+    testSys.reviveSystem();
+    TEST_ASSERT_TRUE(testSys.isEnabled());
+
+    // 3. 尝试触发
+    struct tm t1 = createTime(200, 2, 0);
+    testSys.update(t1);
+    runUntilIdle(testSys);
+
+    // 4. 验证：应该正常工作了
+    TEST_ASSERT_EQUAL_INT(1, testSys.getWateredCount());
+}
+
+// === 测试用例 4: Stop 功能 (中途打断) ===
+void test_stop_interruption(void)
+{
+    // 设置时长为 5 秒
+    WateringSystem longSys(4, 5, 2, 0, 3, 18, false);
+    longSys.begin();
+
+    unsigned long start = millis();
+    longSys.forceWatering(); // 非阻塞：立即返回，继电器已吸合
+    TEST_ASSERT_TRUE(longSys.isBusy());
+    TEST_ASSERT_TRUE(longSys.isRelayOn());
+
+    // 跑 1 秒后发送 stop
+    while (millis() - start < 1000)
+    {
+        longSys.loop();
+        delay(10);
+    }
+    Serial.println("[Test] Injecting STOP command...");
+    unsigned long stopAt = micros();
+    longSys.stopWatering();
+    unsigned long stopLatency = micros() - stopAt;
+
+    // 验证：继电器在 stopWatering() 返回时已经断开
+    TEST_ASSERT_FALSE(longSys.isRelayOn());
+    Serial.printf("[Test] Stop latency: %lu us\n", stopLatency);
+    TEST_ASSERT_LESS_THAN(50000, stopLatency);
+
+    // 下一拍结算为 Aborted 并解锁
+    longSys.loop();
+    TEST_ASSERT_FALSE(longSys.isBusy());
+
+    // 如果 stop 没生效，这里会跑满 5000ms
+    unsigned long duration = millis() - start;
+    Serial.printf("[Test] Actual duration: %lu ms\n", duration);
+    TEST_ASSERT_LESS_THAN(4500, duration);
+}
+// === 测试用例 5: Reset 功能 ===
+void test_reset_function(void)
+{
+    // 1. 先制造一些脏数据
+    // 我们手动把 NVS 里的数据改掉，模拟已经浇了 10 次
+    // (由于 WateringSystem 没有 setWateredCount 接口，我们通过 NVS 后门修改)
+    // 或者更简单：运行一次 update 让它变成 1，验证能变回 0 即可
+
+    testSys.factoryReset(); // 归零
+
+    // 触发一次浇水 -> Count 变 1
+    struct tm t1 = createTime(100, 2, 0);
+    testSys.update(t1);
+    runUntilIdle(testSys);
+    TEST_ASSERT_EQUAL_INT(1, testSys.getWateredCount());
+
+    // 2. 执行 Reset
+    testSys.resetSystem();
+
+    // 3. 验证内存变量
+    TEST_ASSERT_EQUAL_INT(0, testSys.getWateredCount());
+
+    // 4. 验证 NVS 持久化 (模拟重启)
+    WateringSystem rebootedSys(4, 2, 2, 0, 3, 18, true);
+    rebootedSys.begin();
+    TEST_ASSERT_EQUAL_INT(0, rebootedSys.getWateredCount());
+}
+
+// === 测试用例 6: 多区域各自计数、各自存档 ===
+void test_multi_zone(void)
+{
+    WateringSystem multiSys(true);
+    multiSys.addZone(4, 1, 2, 0, 3, 18);
+    multiSys.addZone(5, 1, 2, 0, 3, 18);
+    multiSys.addZone(6, 1, 3, 0, 3, 18); // 3:00 才触发
+    multiSys.begin();
+    multiSys.factoryReset();
+
+    // 2:00：区域 0、1 到期，但同时运行上限为 1，先跑区域 0
+    struct tm t1 = createTime(100, 2, 0);
+    multiSys.update(t1);
+    TEST_ASSERT_TRUE(multiSys.isBusy(0));
+    TEST_ASSERT_FALSE(multiSys.isBusy(1));
+    runUntilIdle(multiSys);
+
+    // 区域 0 结束后再次 update，轮到区域 1
+    multiSys.update(t1);
+    TEST_ASSERT_TRUE(multiSys.isBusy(1));
+    runUntilIdle(multiSys);
+
+    TEST_ASSERT_EQUAL_INT(1, multiSys.getWateredCount(0));
+    TEST_ASSERT_EQUAL_INT(1, multiSys.getWateredCount(1));
+    TEST_ASSERT_EQUAL_INT(0, multiSys.getWateredCount(2));
+
+    // 模拟重启：每个区域的计数独立恢复
+    WateringSystem rebootedSys(true);
+    rebootedSys.addZone(4, 1, 2, 0, 3, 18);
+    rebootedSys.addZone(5, 1, 2, 0, 3, 18);
+    rebootedSys.addZone(6, 1, 3, 0, 3, 18);
+    rebootedSys.begin();
+    TEST_ASSERT_EQUAL_INT(1, rebootedSys.getWateredCount(0));
+    TEST_ASSERT_EQUAL_INT(1, rebootedSys.getWateredCount(1));
+    TEST_ASSERT_EQUAL_INT(0, rebootedSys.getWateredCount(2));
+}
+
+// === 测试用例 7: 控制循环停顿跨过开始时刻 (补跑 / 跳过) ===
+void test_missed_fire_policy(void)
+{
+    // 1. 1:59 检查过一次，下一次检查已经是 2:30 (联网 / 对时卡住)：补跑窗口内，迟到也执行
+    struct tm before = createTime(100, 1, 59);
+    struct tm stalled = createTime(100, 2, 30);
+    testSys.update(before);
+    testSys.update(stalled);
+    TEST_ASSERT_TRUE(testSys.isBusy());
+    runUntilIdle(testSys);
+    TEST_ASSERT_EQUAL_INT(1, testSys.getWateredCount());
+    TEST_ASSERT_EQUAL_UINT32(0, testSys.getMissedCount());
+
+    // 2. Skip 策略：同样的停顿 (间隔满足后的第 103 天) 只记为错过
+    testSys.setMissedFirePolicy(MissedFirePolicy::Skip);
+    struct tm before2 = createTime(103, 1, 59);
+    struct tm stalled2 = createTime(103, 2, 30);
+    testSys.update(before2);
+    testSys.update(stalled2);
+    TEST_ASSERT_FALSE(testSys.isBusy());
+    TEST_ASSERT_EQUAL_INT(1, testSys.getWateredCount());
+    TEST_ASSERT_EQUAL_UINT32(1, testSys.getMissedCount());
+
+    // 3. RunLate 也有窗口：超过窗口的记为错过 (错过后第二天照常触发)
+    testSys.setMissedFirePolicy(MissedFirePolicy::RunLate, 600);
+    struct tm before3 = createTime(104, 1, 59);
+    struct tm stalled3 = createTime(104, 2, 30);
+    testSys.update(before3);
+    testSys.update(stalled3);
+    TEST_ASSERT_FALSE(testSys.isBusy());
+    TEST_ASSERT_EQUAL_UINT32(2, testSys.getMissedCount());
+
+    testSys.setMissedFirePolicy(MissedFirePolicy::RunLate);
+}
+
+// === 测试用例 8: 断电期间的计划在重启对时后补上，且不会重复 ===
+void test_catch_up_after_reboot(void)
+{
+    // 1. 1:00 对过一次时 (写下检查点)，随后断电
+    struct tm t1 = createTime(100, 1, 0);
+    testSys.update(t1);
+
+    // 2. 3:00 才重新上电对时：2:00 的计划在 2 小时窗口内，补跑
+    WateringSystem rebootedSys(4, 2, 2, 0, 3, 18, true);
+    rebootedSys.begin();
+    struct tm t2 = createTime(100, 3, 0);
+    rebootedSys.update(t2);
+    TEST_ASSERT_TRUE(rebootedSys.isBusy());
+    runUntilIdle(rebootedSys);
+    TEST_ASSERT_EQUAL_INT(1, rebootedSys.getWateredCount());
+
+    // 3. 再重启一次：已经结算过的计划不会再跑
+    WateringSystem rebootedAgain(4, 2, 2, 0, 3, 18, true);
+    rebootedAgain.begin();
+    struct tm t3 = createTime(100, 4, 0);
+    rebootedAgain.update(t3);
+    TEST_ASSERT_FALSE(rebootedAgain.isBusy());
+    TEST_ASSERT_EQUAL_UINT32(0, rebootedAgain.getMissedCount());
+
+    // 4. 断电 3 天多 (第 103 天 2:00 的计划已经过去 5 小时)：超出窗口，记为错过
+    WateringSystem longOutage(4, 2, 2, 0, 3, 18, true);
+    longOutage.begin();
+    struct tm t4 = createTime(103, 7, 0);
+    longOutage.update(t4);
+    TEST_ASSERT_FALSE(longOutage.isBusy());
+    TEST_ASSERT_EQUAL_UINT32(1, longOutage.getMissedCount());
+    TEST_ASSERT_EQUAL_INT(1, longOutage.getWateredCount());
+}
+
+// === 测试用例 9: 固件升级暂停：正在运行的区域经状态机停泵，到期的计划等恢复后再跑 ===
+void test_ota_hold(void)
+{
+    WateringSystem holdSys(true);
+    holdSys.addZone(4, 1, 2, 0, 3, 18);
+    holdSys.addZone(5, 5, 2, 0, 3, 18);
+    holdSys.begin();
+    holdSys.factoryReset();
+
+    // 区域 1 手动运行中，升级请求到来
+    holdSys.forceWatering(1);
+    TEST_ASSERT_TRUE(holdSys.isRelayOn(1));
+    holdSys.setHold(true);
+    TEST_ASSERT_FALSE(holdSys.isRelayOn(1)); // 同步断开继电器，不再直接拉引脚
+    holdSys.loop();
+    TEST_ASSERT_FALSE(holdSys.isBusy()); // 控制任务据此放行写 Flash
+
+    // 暂停期间：手动指令被拒绝，到期的计划不启动
+    holdSys.forceWatering(0);
+    TEST_ASSERT_FALSE(holdSys.isBusy());
+    struct tm t = createTime(100, 2, 0);
+    holdSys.update(t);
+    TEST_ASSERT_FALSE(holdSys.isBusy());
+
+    // 升级失败、恢复：排队的计划照常运行，不算错过
+    holdSys.setHold(false);
+    holdSys.update(t);
+    TEST_ASSERT_TRUE(holdSys.isBusy(0));
+    runUntilIdle(holdSys);
+    TEST_ASSERT_EQUAL_INT(1, holdSys.getWateredCount(0));
+    TEST_ASSERT_EQUAL_UINT32(0, holdSys.getMissedCount());
+}
+
+// === 测试用例 10: 手动时长上限：正好等于 WATERING_MAX_MANUAL_SEC 照常运行，再长的直接拒绝 (不吸合继电器) ===
+static char st_lastMsg[64];
+
+void test_manual_duration_limit(void)
+{
+    WateringSystem limitSys(false);
+    limitSys.addZone(4, 2, 2, 0, 3, 18);
+    limitSys.begin();
+    limitSys.setNotifier([](const char *m)
+                         { strncpy(st_lastMsg, m, sizeof(st_lastMsg) - 1); });
+
+    limitSys.forceWatering(0, WATERING_MAX_MANUAL_SEC + 1);
+    TEST_ASSERT_FALSE(limitSys.isBusy());
+    TEST_ASSERT_FALSE(limitSys.isRelayOn(0));
+    TEST_ASSERT_EQUAL_STRING("Ignored: Duration too long", st_lastMsg);
+    limitSys.forceWatering(0, 999999999); // 换算成毫秒在 32 位上会回绕
+    TEST_ASSERT_FALSE(limitSys.isBusy());
+
+    limitSys.forceWatering(0, WATERING_MAX_MANUAL_SEC);
+    TEST_ASSERT_TRUE(limitSys.isRelayOn(0));
+    unsigned long start = millis();
+    while (millis() - start < 3000) // 比配置的 2 秒长：按指令的时长在跑
+    {
+        limitSys.loop();
+        delay(10);
+    }
+    TEST_ASSERT_TRUE(limitSys.isRelayOn(0));
+    limitSys.stopWatering(0);
+    limitSys.loop();
+    TEST_ASSERT_FALSE(limitSys.isBusy());
+}
+
+// === 测试用例 11: 60 秒手动运行：loop() 不阻塞，控制任务按 msUntilPumpDeadline() 睡到截止时刻就够 ===
+// native 上时间只由 delay() 推进：loop() 前后 millis() 不变，说明它没有在里面等；真机上缩短运行时长
+#ifdef ARDUINO
+const int LOOP_RUN_SEC = 5;
+#else
+const int LOOP_RUN_SEC = 60;
+#endif
+
+void test_loop_never_blocks(void)
+{
+    WateringSystem runSys(false);
+    runSys.addZone(4, 2, 2, 0, 3, 18);
+    runSys.begin();
+
+    runSys.forceWatering(0, LOOP_RUN_SEC);
+    TEST_ASSERT_TRUE(runSys.isRelayOn(0));
+    unsigned long start = millis();
+    int wakes = 0;
+    while (runSys.isBusy() && wakes < 10)
+    {
+        unsigned long before = millis();
+        runSys.loop();
+#ifndef ARDUINO
+        TEST_ASSERT_EQUAL_UINT32(before, millis());
+#endif
+        uint32_t wait = runSys.msUntilPumpDeadline();
+        if (!runSys.isBusy())
+            break;
+        TEST_ASSERT_TRUE(wait <= (uint32_t)LOOP_RUN_SEC * 1000);
+        if (runSys.isRelayOn(0))
+            TEST_ASSERT_TRUE(millis() - start + wait <= (uint32_t)LOOP_RUN_SEC * 1000 + 10); // 不会睡过截止时刻
+        delay(wait);
+        wakes++;
+    }
+    TEST_ASSERT_FALSE(runSys.isBusy());
+    TEST_ASSERT_TRUE(wakes <= 3); // 按截止时刻醒来，而不是每 10ms 轮询
+    TEST_ASSERT_TRUE(millis() - start >= (uint32_t)LOOP_RUN_SEC * 1000);
+
+    // 运行中途 stop：同一次调用里继电器就断开，不等下一次 loop()
+    runSys.forceWatering(0, LOOP_RUN_SEC);
+    delay(1000);
+    runSys.loop();
+    TEST_ASSERT_TRUE(runSys.isRelayOn(0));
+    runSys.stopWatering(0);
+    TEST_ASSERT_FALSE(runSys.isRelayOn(0));
+    runSys.loop();
+    TEST_ASSERT_FALSE(runSys.isBusy());
+}
+
+// === 运行入口 ===
+void run_shared_system_tests()
+{
+    RUN_TEST(test_nvs_persistence);
+    RUN_TEST(test_kill_function);
+    RUN_TEST(test_revive_function);
+    RUN_TEST(test_stop_interruption);
+    RUN_TEST(test_reset_function);
+    RUN_TEST(test_multi_zone);
+    RUN_TEST(test_missed_fire_policy);
+    RUN_TEST(test_catch_up_after_reboot);
+    RUN_TEST(test_ota_hold);
+    RUN_TEST(test_manual_duration_limit);
+    RUN_TEST(test_loop_never_blocks);
+}
+
+#endif
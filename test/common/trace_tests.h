@@ -0,0 +1,141 @@
+#ifndef TRACE_TESTS_H
+#define TRACE_TESTS_H
+
+#include <unity.h>
+#include <string.h>
+#include "Trace.h"
+
+// 编译期：参数个数检查、哈希
+static_assert(Trace::formatArgs("Zone %d (Cycle %d / %d)") == 3, "three args");
+static_assert(Trace::formatArgs("100%% done, %02x") == 1, "escaped percent / flags");
+static_assert(Trace::formatArgs("name %s") == -1, "strings rejected");
+static_assert(Trace::formatArgs("%5.2f") == -1, "floats rejected");
+static_assert(Trace::formatId("") == 2166136261u, "FNV-1a offset basis");
+static_assert(Trace::formatId("a") == 0xe40c292cu, "FNV-1a reference value");
+
+// 测试用的小环 (满的情况容易构造)
+static Trace::Ring<8> smallRing;
+
+// 把 drain 的输出收进内存
+struct TraceCapture {
+    uint8_t bytes[Trace::FRAME_BYTES * 16];
+    size_t len = 0;
+    void operator()(const uint8_t *p, size_t n) {
+        if (len + n <= sizeof(bytes)) {
+            memcpy(bytes + len, p, n);
+            len += n;
+        }
+    }
+};
+
+static uint32_t trace_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 解码第 i 帧 (校验同步头和 CRC)
+static bool trace_frame(const TraceCapture &cap, size_t i, Trace::Record &r) {
+    const uint8_t *f = cap.bytes + i * Trace::FRAME_BYTES;
+    if ((i + 1) * Trace::FRAME_BYTES > cap.len || f[0] != Trace::SYNC0 || f[1] != Trace::SYNC1)
+        return false;
+    const uint8_t *p = f + 2;
+    if (Trace::crc8(p, Trace::RECORD_BYTES) != f[2 + Trace::RECORD_BYTES])
+        return false;
+    r.timestampUs = trace_get32(p);
+    r.formatId = trace_get32(p + 4);
+    r.seq = (uint16_t)(p[8] | (p[9] << 8));
+    r.level = p[10];
+    r.argc = p[11];
+    for (uint8_t k = 0; k < Trace::MAX_ARGS; k++)
+        r.args[k] = trace_get32(p + 12 + 4 * k);
+    return true;
+}
+
+// === 测试用例 1: 记录 -> 帧 -> 解码 ===
+void test_trace_roundtrip(void) {
+    Trace::ring().clear();
+    enum class Color : uint8_t { Red = 7 };
+    TRACE_I("[Test] zone %d cycle %u late %ds", 3, 42u, -5);
+    TRACE_W("[Test] color %d flag %d", Color::Red, true);
+    TRACE_E("[Test] no args");
+
+    TraceCapture cap;
+    TEST_ASSERT_EQUAL_UINT32(3, Trace::drain(cap, 16));
+    TEST_ASSERT_EQUAL_UINT32(3 * Trace::FRAME_BYTES, cap.len);
+    TEST_ASSERT_TRUE(Trace::ring().empty());
+
+    Trace::Record r;
+    TEST_ASSERT_TRUE(trace_frame(cap, 0, r));
+    TEST_ASSERT_EQUAL_HEX32(Trace::formatId("[Test] zone %d cycle %u late %ds"), r.formatId);
+    TEST_ASSERT_EQUAL_UINT8(TRACE_LEVEL_INFO, r.level);
+    TEST_ASSERT_EQUAL_UINT8(3, r.argc);
+    TEST_ASSERT_EQUAL_UINT32(3, r.args[0]);
+    TEST_ASSERT_EQUAL_UINT32(42, r.args[1]);
+    TEST_ASSERT_EQUAL_INT32(-5, (int32_t)r.args[2]);
+
+    Trace::Record r2;
+    TEST_ASSERT_TRUE(trace_frame(cap, 1, r2));
+    TEST_ASSERT_EQUAL_UINT8(TRACE_LEVEL_WARN, r2.level);
+    TEST_ASSERT_EQUAL_UINT32(7, r2.args[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, r2.args[1]);
+    TEST_ASSERT_EQUAL_UINT16((uint16_t)(r.seq + 1), r2.seq);
+
+    TEST_ASSERT_TRUE(trace_frame(cap, 2, r));
+    TEST_ASSERT_EQUAL_UINT8(0, r.argc);
+
+    // 帧被改动一个字节后 CRC 不再匹配
+    cap.bytes[Trace::FRAME_BYTES + 6] ^= 0x01;
+    TEST_ASSERT_FALSE(trace_frame(cap, 1, r));
+}
+
+// === 测试用例 2: 满了丢新记录，drain 先报告丢了多少 ===
+void test_trace_overflow(void) {
+    smallRing.clear();
+    for (uint32_t i = 0; i < 11; i++) {
+        Trace::Record r = {};
+        r.formatId = 1;
+        r.argc = 1;
+        r.args[0] = i;
+        TEST_ASSERT_EQUAL(i < 8, smallRing.push(r));
+    }
+
+    TraceCapture cap;
+    TEST_ASSERT_EQUAL_UINT32(5, Trace::drain(smallRing, cap, 5)); // 丢弃记录 + 4 条
+    Trace::Record r;
+    TEST_ASSERT_TRUE(trace_frame(cap, 0, r));
+    TEST_ASSERT_EQUAL_UINT32(Trace::DROPPED_ID, r.formatId);
+    TEST_ASSERT_EQUAL_UINT32(3, r.args[0]);
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(trace_frame(cap, 1 + i, r));
+        TEST_ASSERT_EQUAL_UINT32(i, r.args[0]); // 最早的留下，顺序不变
+    }
+
+    // 腾出空间后又能写；丢弃计数只报告一次
+    Trace::Record again = {};
+    again.formatId = 1;
+    TEST_ASSERT_TRUE(smallRing.push(again));
+    cap.len = 0;
+    TEST_ASSERT_EQUAL_UINT32(5, Trace::drain(smallRing, cap, 16));
+    TEST_ASSERT_TRUE(trace_frame(cap, 0, r));
+    TEST_ASSERT_EQUAL_UINT32(4, r.args[0]);
+    TEST_ASSERT_TRUE(smallRing.empty());
+}
+
+// === 测试用例 3: 低于 TRACE_LEVEL 的调用点不求值、不记录 ===
+void test_trace_level_compiled_out(void) {
+#if TRACE_LEVEL < TRACE_LEVEL_DEBUG
+    Trace::ring().clear();
+    int evaluated = 0;
+    TRACE_D("[Test] debug %d", ++evaluated);
+    TEST_ASSERT_EQUAL_INT(0, evaluated);
+    TEST_ASSERT_TRUE(Trace::ring().empty());
+#endif
+}
+
+// ================= 共享的运行清单 =================
+void run_shared_trace_tests() {
+    RUN_TEST(test_trace_roundtrip);
+    RUN_TEST(test_trace_overflow);
+    RUN_TEST(test_trace_level_compiled_out);
+}
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef WIFI_LINK_TESTS_H
+#define WIFI_LINK_TESTS_H
+
+#include <unity.h>
+#include <stdio.h>
+#include "WifiLink.h"
+
+static const uint8_t WL_BSSID[6] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60};
+
+// === 测试用例 1: 退避窗口翻倍、有上限、有抖动 ===
+void test_wifi_backoff_window(void) {
+    WifiLink l(12345);
+    // 掉线后的第一次：[0, base]
+    for (int i = 0; i < 50; i++)
+        TEST_ASSERT_TRUE(l.retryDelayMs(0) <= 2000);
+    // 第 n 次失败：[w/2, w]，w = 2000 * 2^(n-1)，上限 300s
+    uint32_t w = 2000;
+    for (uint8_t n = 1; n <= 12; n++, w = w * 2 > 300000 ? 300000 : w * 2) {
+        uint32_t lo = UINT32_MAX, hi = 0;
+        for (int i = 0; i < 50; i++) {
+            uint32_t d = l.retryDelayMs(n);
+            lo = d < lo ? d : lo;
+            hi = d > hi ? d : hi;
+        }
+        TEST_ASSERT_TRUE(lo >= w / 2);
+        TEST_ASSERT_TRUE(hi <= w);
+        TEST_ASSERT_TRUE(hi > lo); // 不是固定值
+    }
+    TEST_ASSERT_TRUE(l.retryDelayMs(255) <= 300000);
+}
+
+// === 测试用例 2: 非阻塞状态机：发起 / 失败退避 / 超时放弃 ===
+void test_wifi_link_state_machine(void) {
+    WifiLink l(7);
+    TEST_ASSERT_EQUAL(WifiLink::Action::Connect, l.poll(0)); // 启动立即连
+    TEST_ASSERT_EQUAL(WifiLink::Action::None, l.poll(100));
+    TEST_ASSERT_EQUAL_UINT32(14900, l.msUntilAction(100));
+
+    // 失败：进入退避，窗口到之前什么都不做
+    l.onDisconnected(3000);
+    TEST_ASSERT_EQUAL(WifiLink::State::Waiting, l.state());
+    uint32_t wait = l.msUntilAction(3000);
+    TEST_ASSERT_TRUE(wait >= 1000 && wait <= 2000);
+    TEST_ASSERT_EQUAL(WifiLink::Action::None, l.poll(3000 + wait - 1));
+    TEST_ASSERT_EQUAL(WifiLink::Action::Connect, l.poll(3000 + wait));
+
+    // 超时没有结果：放弃这次尝试，失败计数累加
+    uint32_t t = 3000 + wait + 15000;
+    TEST_ASSERT_EQUAL(WifiLink::Action::Abort, l.poll(t));
+    TEST_ASSERT_EQUAL_UINT8(2, l.failureStreak());
+    l.onDisconnected(t + 5); // Abort 之后驱动报上来的断开不算第二次失败
+    TEST_ASSERT_EQUAL_UINT8(2, l.failureStreak());
+    wait = l.msUntilAction(t);
+    TEST_ASSERT_TRUE(wait >= 2000 && wait <= 4000);
+
+    // 连上：统计耗时，重置失败计数
+    TEST_ASSERT_EQUAL(WifiLink::Action::Connect, l.poll(t + wait));
+    l.onConnected(t + wait + 2500, 6, WL_BSSID);
+    TEST_ASSERT_TRUE(l.isConnected());
+    TEST_ASSERT_EQUAL_UINT8(0, l.failureStreak());
+    TEST_ASSERT_EQUAL_UINT32(WifiLink::FOREVER, l.msUntilAction(t + wait + 2500));
+    TEST_ASSERT_EQUAL_UINT32(3, l.stats().attempts);
+    TEST_ASSERT_EQUAL_UINT32(2, l.stats().failures);
+    TEST_ASSERT_EQUAL_UINT32(2500, l.stats().lastConnectMs);
+}
+
+// === 测试用例 3: 记住信道 / BSSID 快速重连，失败一次就退回完整扫描 ===
+void test_wifi_fast_reconnect(void) {
+    WifiLink l(99);
+    l.poll(0);
+    l.onConnected(4000, 11, WL_BSSID);
+    TEST_ASSERT_TRUE(l.hint().valid);
+    TEST_ASSERT_EQUAL_INT32(11, l.hint().channel);
+    TEST_ASSERT_EQUAL_HEX8(0x60, l.hint().bssid[5]);
+
+    // 掉线：第一次重试用快速重连
+    l.onDisconnected(100000);
+    uint32_t at = 100000 + l.msUntilAction(100000);
+    TEST_ASSERT_EQUAL(WifiLink::Action::ConnectFast, l.poll(at));
+    l.onConnected(at + 300, 11, WL_BSSID);
+    TEST_ASSERT_EQUAL_UINT32(1, l.stats().fastConnects);
+    TEST_ASSERT_EQUAL_UINT32(1, l.stats().disconnects);
+    TEST_ASSERT_EQUAL_UINT32(at + 300 - 100000, l.stats().lastOutageMs);
+
+    // AP 换了信道：快速重连失败后改回完整扫描
+    l.onDisconnected(200000);
+    at = 200000 + l.msUntilAction(200000);
+    TEST_ASSERT_EQUAL(WifiLink::Action::ConnectFast, l.poll(at));
+    l.onDisconnected(at + 1000);
+    TEST_ASSERT_FALSE(l.hint().valid);
+    at += 1000 + l.msUntilAction(at + 1000);
+    TEST_ASSERT_EQUAL(WifiLink::Action::Connect, l.poll(at));
+    TEST_ASSERT_EQUAL_UINT32((4000 + 300) / 2, l.avgConnectMs());
+}
+
+// === 测试用例 4: 路由器重启，整栋楼的设备不会同时重试 ===
+// 200 台设备同一时刻掉线，AP 60 秒后恢复；每次尝试 3 秒后失败 (扫描不到 AP)
+// 统计 AP 恢复后每秒发起的连接数峰值，对比原来的固定 60 秒冷却
+void test_wifi_herd_spread(void) {
+    const int DEVICES = 200;
+    const uint32_t AP_BACK_MS = 60000;
+    static WifiLink links[DEVICES];
+    uint32_t failAt[DEVICES];
+    const uint32_t HORIZON_SEC = 300;
+    uint16_t perSecond[HORIZON_SEC] = {};
+    for (int d = 0; d < DEVICES; d++) {
+        links[d] = WifiLink(0xA5A5u + d * 7919u);
+        links[d].poll(0);
+        links[d].onConnected(1000, 1, WL_BSSID);
+        links[d].onDisconnected(10000); // 同一时刻掉线
+        failAt[d] = 0;
+    }
+
+    int connected = 0;
+    uint32_t lastUpMs = 0;
+    for (uint32_t t = 10000; t < 10000 + HORIZON_SEC * 1000 && connected < DEVICES; t += 10) {
+        for (int d = 0; d < DEVICES; d++) {
+            WifiLink &l = links[d];
+            if (l.isConnected())
+                continue;
+            if (failAt[d] && t >= failAt[d]) {
+                failAt[d] = 0;
+                if (t >= 10000 + AP_BACK_MS) {
+                    l.onConnected(t, 1, WL_BSSID);
+                    connected++;
+                    lastUpMs = t;
+                    continue;
+                }
+                l.onDisconnected(t);
+            }
+            WifiLink::Action a = l.poll(t);
+            if (a == WifiLink::Action::Connect || a == WifiLink::Action::ConnectFast) {
+                failAt[d] = t + 3000;
+                uint32_t sec = (t - 10000) / 1000;
+                if (sec >= AP_BACK_MS / 1000 && sec < HORIZON_SEC)
+                    perSecond[sec]++;
+            }
+        }
+    }
+
+    uint16_t peak = 0;
+    for (uint32_t s = 0; s < HORIZON_SEC; s++)
+        peak = perSecond[s] > peak ? perSecond[s] : peak;
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "herd: %d/%d back %us after AP return, peak %u attempts/s (fixed cooldown: %d)",
+             connected, DEVICES, (unsigned)((lastUpMs - 10000 - AP_BACK_MS) / 1000), peak, DEVICES);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL_INT(DEVICES, connected);
+    TEST_ASSERT_TRUE(peak <= DEVICES / 5);
+}
+
+// ================= 共享的运行清单 =================
+void run_shared_wifi_link_tests() {
+    RUN_TEST(test_wifi_backoff_window);
+    RUN_TEST(test_wifi_link_state_machine);
+    RUN_TEST(test_wifi_fast_reconnect);
+    RUN_TEST(test_wifi_herd_spread);
+}
+
+#endif
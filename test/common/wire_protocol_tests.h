@@ -0,0 +1,312 @@
+#ifndef WIRE_PROTOCOL_TESTS_H
+#define WIRE_PROTOCOL_TESTS_H
+
+#include <unity.h>
+#include <string.h>
+#include "WireProtocol.h"
+#include "WateringSystem.h"
+#include "system_tests.h" // createTime / runUntilIdle
+
+#define WP_MAX_EVENTS 16
+
+static RunEvent wp_events[WP_MAX_EVENTS];
+static int wp_eventCount = 0;
+
+static void wp_capture(WateringSystem &sys) {
+    wp_eventCount = 0;
+    sys.setEventSink([](const RunEvent &e) {
+        if (wp_eventCount < WP_MAX_EVENTS) wp_events[wp_eventCount++] = e;
+    });
+}
+
+static Wire::ParseResult wp_parse(const uint8_t *frame, size_t len, Command &cmd) {
+    uint32_t seq = 0;
+    return Wire::parseCommand(frame, len, seq, cmd);
+}
+
+// === 测试用例 1: 指令帧：每个 verb 都能往返；坏帧 / 新版本 / 未知 verb / 坏参数被拒；帧尾追加的字段被忽略 ===
+void test_wire_command_frames(void) {
+    uint8_t frame[32];
+    Command cmd;
+    uint32_t seq = 0;
+
+    // 1. 往返：15 字节，seq 原样带回
+    Wire::Encoder e(frame, sizeof(frame));
+    Wire::writeCommand(e, 0x01020304, Wire::Verb::Dose, 2, 1500);
+    TEST_ASSERT_EQUAL_UINT32(15, e.length());
+    TEST_ASSERT_TRUE(Wire::parseCommand(frame, e.length(), seq, cmd) == Wire::ParseResult::Ok);
+    TEST_ASSERT_EQUAL_HEX32(0x01020304, seq);
+    TEST_ASSERT_EQUAL_HEX8(0x04, frame[4]); // 小端
+    TEST_ASSERT_TRUE(cmd.type == CommandType::Dose);
+    TEST_ASSERT_EQUAL_INT(2, cmd.zone);
+    TEST_ASSERT_EQUAL_INT(1500, cmd.arg);
+
+    const CommandType types[] = {CommandType::Start, CommandType::Stop, CommandType::Reset, CommandType::Kill,
+                                 CommandType::Revive, CommandType::Info, CommandType::History};
+    for (uint8_t v = 1; v <= 7; v++) {
+        Wire::Encoder ev(frame, sizeof(frame));
+        Wire::writeCommand(ev, v, (Wire::Verb)v);
+        TEST_ASSERT_TRUE(wp_parse(frame, ev.length(), cmd) == Wire::ParseResult::Ok);
+        TEST_ASSERT_TRUE(cmd.type == types[v - 1]);
+        TEST_ASSERT_EQUAL_INT(-1, cmd.zone);
+    }
+
+    // 2. 同一版本在帧尾追加的字段：旧设备照常解码
+    Wire::Encoder ext(frame, sizeof(frame));
+    Wire::writeCommand(ext, 9, Wire::Verb::Start, 0, 30);
+    ext.u32(0xDEADBEEF);
+    TEST_ASSERT_TRUE(wp_parse(frame, ext.length(), cmd) == Wire::ParseResult::Ok);
+    TEST_ASSERT_EQUAL_INT(30, cmd.arg);
+
+    // 3. 拒绝：文本指令、下一个版本、未知 verb、截断、非法参数
+    TEST_ASSERT_TRUE(wp_parse((const uint8_t *)"start", 5, cmd) == Wire::ParseResult::NotWire);
+    TEST_ASSERT_TRUE(wp_parse((const uint8_t *)"start 30 zone", 13, cmd) == Wire::ParseResult::NotWire);
+    Wire::Encoder ok(frame, sizeof(frame));
+    Wire::writeCommand(ok, 10, Wire::Verb::Start, 0, 30);
+    frame[1] = Wire::VERSION + 1;
+    TEST_ASSERT_TRUE(wp_parse(frame, 15, cmd) == Wire::ParseResult::BadVersion);
+    frame[1] = Wire::VERSION;
+    TEST_ASSERT_TRUE(wp_parse(frame, 14, cmd) == Wire::ParseResult::BadArgument);
+    frame[8] = 99;
+    TEST_ASSERT_TRUE(Wire::parseCommand(frame, 15, seq, cmd) == Wire::ParseResult::BadType);
+    TEST_ASSERT_EQUAL_UINT32(10, seq); // 还能应答
+    frame[2] = (uint8_t)Wire::MsgType::Event;
+    TEST_ASSERT_TRUE(wp_parse(frame, 15, cmd) == Wire::ParseResult::BadType);
+
+    Wire::Encoder bad(frame, sizeof(frame));
+    Wire::writeCommand(bad, 11, Wire::Verb::Dose, 0, 0);
+    TEST_ASSERT_TRUE(wp_parse(frame, bad.length(), cmd) == Wire::ParseResult::BadArgument);
+    Wire::Encoder neg(frame, sizeof(frame));
+    Wire::writeCommand(neg, 12, Wire::Verb::Start, -2, 30);
+    TEST_ASSERT_TRUE(wp_parse(frame, neg.length(), cmd) == Wire::ParseResult::BadArgument);
+
+    // 手动时长上限和文本指令一致：正好等于上限可以，再长 (一直到 INT32_MAX) 都拒绝；水量不受约束
+    Wire::Encoder atMax(frame, sizeof(frame));
+    Wire::writeCommand(atMax, 13, Wire::Verb::Start, 0, WATERING_MAX_MANUAL_SEC);
+    TEST_ASSERT_TRUE(wp_parse(frame, atMax.length(), cmd) == Wire::ParseResult::Ok);
+    TEST_ASSERT_EQUAL_INT(WATERING_MAX_MANUAL_SEC, cmd.arg);
+    Wire::Encoder tooLong(frame, sizeof(frame));
+    Wire::writeCommand(tooLong, 14, Wire::Verb::Start, 0, WATERING_MAX_MANUAL_SEC + 1);
+    TEST_ASSERT_TRUE(wp_parse(frame, tooLong.length(), cmd) == Wire::ParseResult::BadArgument);
+    Wire::Encoder huge(frame, sizeof(frame));
+    Wire::writeCommand(huge, 15, Wire::Verb::Start, 0, INT32_MAX);
+    TEST_ASSERT_TRUE(wp_parse(frame, huge.length(), cmd) == Wire::ParseResult::BadArgument);
+    Wire::Encoder dose(frame, sizeof(frame));
+    Wire::writeCommand(dose, 16, Wire::Verb::Dose, 0, WATERING_MAX_MANUAL_SEC + 1);
+    TEST_ASSERT_TRUE(wp_parse(frame, dose.length(), cmd) == Wire::ParseResult::Ok);
+
+    // 4. 去重：最近 8 条，更早的被挤出
+    Wire::CommandDedup dedup;
+    for (uint32_t s = 100; s < 108; s++) {
+        TEST_ASSERT_FALSE(dedup.seen(s));
+        dedup.remember(s);
+    }
+    TEST_ASSERT_TRUE(dedup.seen(100));
+    dedup.remember(108);
+    TEST_ASSERT_FALSE(dedup.seen(100));
+    TEST_ASSERT_TRUE(dedup.seen(101));
+
+    // 5. 设备序号：第一帧带 FLAG_BOOT
+    Wire::Sequencer sq;
+    uint8_t flags = 0;
+    TEST_ASSERT_EQUAL_UINT32(0, sq.next(flags));
+    TEST_ASSERT_EQUAL_HEX8(Wire::FLAG_BOOT, flags);
+    TEST_ASSERT_EQUAL_UINT32(1, sq.next(flags));
+    TEST_ASSERT_EQUAL_HEX8(0, flags);
+}
+
+// === 测试用例 2: 运行事件：和文本通知同时产生，字段齐全；编码成 25 字节的帧后原样解回 ===
+void test_wire_run_events(void) {
+    WateringSystem sys(false);
+    sys.addZone(4, 2, 2, 0, 1, 18);
+    sys.begin();
+    wp_capture(sys);
+
+    // 1. 手动运行：Started + Done，第几次 / 时长 / 没有流量计
+    sys.forceWatering(0, 1);
+    runUntilIdle(sys);
+    TEST_ASSERT_EQUAL_INT(2, wp_eventCount);
+    TEST_ASSERT_TRUE(wp_events[0].kind == RunEventKind::Started);
+    TEST_ASSERT_EQUAL_HEX8(RunEvent::FLAG_MANUAL, wp_events[0].flags);
+    TEST_ASSERT_EQUAL_UINT16(1, wp_events[0].cycle);
+    TEST_ASSERT_EQUAL_UINT16(18, wp_events[0].maxCycles);
+    const RunEvent done = wp_events[1];
+    TEST_ASSERT_TRUE(done.kind == RunEventKind::Done);
+    TEST_ASSERT_EQUAL_UINT8(0, done.zone);
+    TEST_ASSERT_EQUAL_UINT16(1, done.cycle);
+    TEST_ASSERT_EQUAL_UINT16(1, done.durationSec);
+    TEST_ASSERT_EQUAL_INT32(-1, done.volumeMl);
+
+    // 2. 被拒的指令带原因码；kill / revive 没有区域
+    sys.forceWatering(3);
+    sys.stopWatering(0);
+    sys.killSystem();
+    sys.reviveSystem();
+    TEST_ASSERT_EQUAL_INT(6, wp_eventCount);
+    TEST_ASSERT_TRUE(wp_events[2].kind == RunEventKind::Rejected);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)RejectReason::UnknownZone, wp_events[2].aux);
+    TEST_ASSERT_EQUAL_UINT8(RunEvent::NO_ZONE, wp_events[2].zone);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)RejectReason::NotWatering, wp_events[3].aux);
+    TEST_ASSERT_EQUAL_UINT8(0, wp_events[3].zone);
+    TEST_ASSERT_TRUE(wp_events[4].kind == RunEventKind::Killed);
+    TEST_ASSERT_TRUE(wp_events[5].kind == RunEventKind::Revived);
+
+    // 3. 编码 / 解码
+    uint8_t frame[32];
+    Wire::Encoder e(frame, sizeof(frame));
+    Wire::writeEvent(e, 7, Wire::FLAG_BOOT, done);
+    TEST_ASSERT_EQUAL_UINT32(25, e.length());
+    Wire::Header h;
+    RunEvent back;
+    TEST_ASSERT_TRUE(Wire::parseEvent(frame, e.length(), h, back));
+    TEST_ASSERT_EQUAL_UINT32(7, h.seq);
+    TEST_ASSERT_EQUAL_HEX8(Wire::FLAG_BOOT, h.flags);
+    TEST_ASSERT_TRUE(back.kind == RunEventKind::Done);
+    TEST_ASSERT_EQUAL_UINT16(done.cycle, back.cycle);
+    TEST_ASSERT_EQUAL_UINT16(done.durationSec, back.durationSec);
+    TEST_ASSERT_EQUAL_INT32(-1, back.volumeMl);
+    TEST_ASSERT_FALSE(Wire::parseEvent(frame, 20, h, back)); // 截断
+}
+
+// === 测试用例 3: 状态帧：长度 = 18 + 28 × 区域数，从快照先数长度再写；字段和 JSON 状态一致，体积小得多 ===
+void test_wire_status_frame(void) {
+    WateringSystem sys(false);
+    sys.addZone(4, 38, 2, 0, 3, 14);
+    sys.addZone(5, 20, 18, 30, 1, 9);
+    sys.begin();
+    static SystemStatus status;
+    sys.captureStatus(status);
+
+    Wire::Encoder counter;
+    counter.header(Wire::MsgType::Status, 0);
+    status.write(counter);
+    TEST_ASSERT_EQUAL_UINT32(18 + 28 * 2, counter.length());
+
+    static uint8_t frame[128];
+    Wire::Encoder e(frame, counter.length());
+    e.header(Wire::MsgType::Status, 0);
+    status.write(e);
+    TEST_ASSERT_TRUE(e.ok());
+
+    Wire::Reader r(frame, e.length());
+    Wire::Header h;
+    TEST_ASSERT_TRUE(Wire::parseHeader(r, e.length(), h) == Wire::ParseResult::Ok);
+    TEST_ASSERT_TRUE(h.type == Wire::MsgType::Status);
+    TEST_ASSERT_EQUAL_HEX8(Wire::STATUS_ENABLED | Wire::STATUS_POWER, r.u8());
+    TEST_ASSERT_EQUAL_UINT8(2, r.u8());
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFFFFF, r.u32()); // 还没对时
+    TEST_ASSERT_EQUAL_UINT32(0, r.u32());
+    r.u32(); r.u32(); r.u32(); r.u32(); r.u32(); r.u32(); r.u32(); // 区域 0
+    TEST_ASSERT_EQUAL_HEX8(0, r.u8());
+    TEST_ASSERT_EQUAL_UINT8(1, r.u8());
+    TEST_ASSERT_EQUAL_UINT16(0, r.u16());
+    TEST_ASSERT_EQUAL_UINT16(9, r.u16());
+    TEST_ASSERT_EQUAL_UINT16(20, r.u16());
+    r.i16();
+    TEST_ASSERT_EQUAL_UINT16(18 * 60 + 30, r.u16());
+    TEST_ASSERT_EQUAL_INT32(WateringLogic::NEVER_WATERED, r.i32());
+    TEST_ASSERT_TRUE(r.complete());
+
+    // 快照拍好之后区域开始浇水：从快照再编码一遍，逐字节相同 (两遍发布看到的是同一份数据)
+    sys.forceWatering(0, 5);
+    TEST_ASSERT_TRUE(sys.isBusy());
+    static uint8_t again[128];
+    Wire::Encoder e2(again, sizeof(again));
+    e2.header(Wire::MsgType::Status, 0);
+    status.write(e2);
+    TEST_ASSERT_EQUAL_UINT32(e.length(), e2.length());
+    TEST_ASSERT_EQUAL_MEMORY(frame, again, e.length());
+    sys.stopWatering(0);
+
+    // 缓冲区不够：不越界，报告溢出
+    Wire::Encoder small(frame, 20);
+    status.write(small);
+    TEST_ASSERT_FALSE(small.ok());
+
+    // 同样的信息 JSON 要大得多
+    static char json[1024];
+    BufferSink sink(json, sizeof(json));
+    JsonWriter w(sink);
+    status.write(w);
+    TEST_ASSERT_TRUE(strlen(json) > 4 * e.length());
+}
+
+// === 测试用例 4: 历史页和应答帧 ===
+void test_wire_history_and_ack(void) {
+    RunRecord runs[2];
+    runs[0].start = 1700000000;
+    runs[0].durationSec = 38;
+    runs[0].zone = 1;
+    runs[0].trigger = RunTrigger::Manual;
+    runs[1].start = 0;
+    runs[1].durationSec = 100000;
+    runs[1].aborted = true;
+
+    uint8_t frame[64];
+    Wire::Encoder e(frame, sizeof(frame));
+    Wire::writeHistory(e, 3, 0, 1, 25, runs, 2);
+    TEST_ASSERT_EQUAL_UINT32(17 + 8 * 2, e.length());
+    Wire::Reader r(frame, e.length());
+    Wire::Header h;
+    TEST_ASSERT_TRUE(Wire::parseHeader(r, e.length(), h) == Wire::ParseResult::Ok);
+    TEST_ASSERT_TRUE(h.type == Wire::MsgType::History);
+    TEST_ASSERT_EQUAL_UINT32(1, r.u32());
+    TEST_ASSERT_EQUAL_UINT32(25, r.u32());
+    TEST_ASSERT_EQUAL_UINT8(2, r.u8());
+    TEST_ASSERT_EQUAL_UINT32(1700000000, r.u32());
+    TEST_ASSERT_EQUAL_UINT16(38, r.u16());
+    TEST_ASSERT_EQUAL_UINT8(1, r.u8());
+    TEST_ASSERT_EQUAL_HEX8(Wire::RUN_MANUAL, r.u8());
+    TEST_ASSERT_EQUAL_UINT32(0, r.u32());
+    TEST_ASSERT_EQUAL_UINT16(0xFFFF, r.u16()); // 封顶
+    r.u8();
+    TEST_ASSERT_EQUAL_HEX8(Wire::RUN_ABORTED, r.u8());
+
+    Wire::Encoder a(frame, sizeof(frame));
+    Wire::writeAck(a, 4, 0, 0x11223344, Wire::AckResult::Duplicate);
+    TEST_ASSERT_EQUAL_UINT32(13, a.length());
+    TEST_ASSERT_EQUAL_HEX8(0x44, frame[8]);
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)Wire::AckResult::Duplicate, frame[12]);
+}
+
+// === 测试用例 5: 分段编码：每段都从头编码、只留 [skip, skip+cap) 这一段，拼起来和整帧逐字节相同 (状态分段发布靠它) ===
+void test_wire_encoder_window(void) {
+    WateringSystem sys(false);
+    sys.addZone(4, 38, 2, 0, 3, 14);
+    sys.addZone(5, 20, 18, 30, 1, 9);
+    sys.addZone(6, 10, 1, 45, 2, 7);
+    sys.begin();
+    static SystemStatus status;
+    sys.captureStatus(status);
+
+    static uint8_t whole[128];
+    Wire::Encoder e(whole, sizeof(whole));
+    e.header(Wire::MsgType::Status, 42);
+    status.write(e);
+    TEST_ASSERT_TRUE(e.ok());
+    const size_t total = e.length();
+
+    // 段长 7：段边界会落在多字节字段中间
+    static uint8_t joined[128];
+    memset(joined, 0xAA, sizeof(joined));
+    for (size_t at = 0; at < total; at += 7) {
+        size_t n = total - at < 7 ? total - at : 7;
+        Wire::Encoder s(joined + at, n, at);
+        s.header(Wire::MsgType::Status, 42);
+        status.write(s);
+        TEST_ASSERT_EQUAL_UINT32(total, s.length()); // 段外的字节只计数
+        TEST_ASSERT_FALSE(s.ok() && at + n < total); // 段后还有字节时记为溢出
+    }
+    TEST_ASSERT_EQUAL_MEMORY(whole, joined, total);
+    TEST_ASSERT_EQUAL_HEX8(0xAA, joined[total]); // 不写出段外
+}
+
+void run_shared_wire_protocol_tests() {
+    RUN_TEST(test_wire_command_frames);
+    RUN_TEST(test_wire_run_events);
+    RUN_TEST(test_wire_status_frame);
+    RUN_TEST(test_wire_history_and_ack);
+    RUN_TEST(test_wire_encoder_window);
+}
+
+#endif
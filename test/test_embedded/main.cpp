@@ -1,8 +1,30 @@
 #include <Arduino.h>
 #include <unity.h>
 #include "TestIndicator.h"
+#include "HeapCountNew.h" // 稳态零分配测试：统计 operator new (整个测试程序只能包含一次)
 #include "../common/logic_tests.h"
-#include "tests_system.h"
+#include "../common/schedule_tests.h"
+#include "../common/pump_tests.h"
+#include "../common/scheduler_tests.h"
+#include "../common/command_parser_tests.h"
+#include "../common/json_writer_tests.h"
+#include "../common/outbound_queue_tests.h"
+#include "../common/mqtt_session_tests.h"
+#include "../common/journal_tests.h"
+#include "../common/history_tests.h"
+#include "../common/metrics_tests.h"
+#include "../common/trace_tests.h"
+#include "../common/wifi_link_tests.h"
+#include "../common/ota_gate_tests.h"
+#include "../common/ota_pull_tests.h"
+#include "../common/ota_delta_tests.h"
+#include "../common/moisture_tests.h"
+#include "../common/flow_tests.h"
+#include "../common/power_lease_tests.h"
+#include "../common/wire_protocol_tests.h"
+#include "../common/heap_tests.h"
+#include "../common/memory_pool_tests.h"
+#include "../common/system_tests.h"
 
 // 实例化灯光工具
 TestIndicator indicator(48, 20000); // 引脚48，展示时间20秒以加快测试反馈
@@ -26,9 +48,30 @@ void setup()
 
     // 1. 跑纯逻辑测试(复用 common)
     run_shared_logic_tests();
+    run_shared_schedule_tests();
+    run_shared_pump_tests();
+    run_shared_scheduler_tests();
+    run_shared_command_parser_tests();
+    run_shared_json_writer_tests();
+    run_shared_outbound_queue_tests();
+    run_shared_mqtt_session_tests();
+    run_shared_journal_tests();
+    run_shared_history_tests();
+    run_shared_metrics_tests();
+    run_shared_trace_tests();
+    run_shared_wifi_link_tests();
+    run_shared_ota_gate_tests();
+    run_shared_ota_pull_tests();
+    run_shared_ota_delta_tests();
+    run_shared_moisture_tests();
+    run_shared_flow_tests();
+    run_shared_power_lease_tests();
+    run_shared_wire_protocol_tests();
+    run_shared_heap_tests();
+    run_shared_memory_pool_tests();
 
     // 2. 跑系统集成测试 (新写的)
-    run_system_tests();
+    run_shared_system_tests();
 
     // 如果未来你有系统测试，可以加：
     // run_system_tests();
@@ -1,7 +0,0 @@
-#ifndef TESTS_SYSTEM_H
-#define TESTS_SYSTEM_H
-
-void setUp_System(void);
-void run_system_tests();
-
-#endif
\ No newline at end of file
@@ -0,0 +1,4 @@
+#include "alloc_counter.h"
+#include "HeapCountNew.h" // 替换全局 operator new，统计堆分配次数，用于验证 "稳态零分配"
+
+size_t allocCount() { return Heap::newCalls().load(); }
@@ -0,0 +1,9 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <stddef.h>
+
+// native 测试专用：统计全局 operator new 的调用次数 (实现见 alloc_counter.cpp)
+size_t allocCount();
+
+#endif
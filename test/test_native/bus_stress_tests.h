@@ -0,0 +1,278 @@
+#ifndef BUS_STRESS_TESTS_H
+#define BUS_STRESS_TESTS_H
+
+#include <unity.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "ControlBus.h"
+#include "SeqLock.h"
+#include "PeriodicTask.h"
+#include "WakeableTask.h"
+#include "Trace.h"
+
+// === 测试用例 1: 队列基本语义 (满/空/回绕) ===
+void test_spsc_bounds(void) {
+    SpscQueue<int, 4> q;
+    int v = 0;
+    TEST_ASSERT_FALSE(q.pop(v));
+    for (int i = 0; i < 4; i++)
+        TEST_ASSERT_TRUE(q.push(i));
+    TEST_ASSERT_FALSE(q.push(99)); // 满了不覆盖
+    for (int round = 0; round < 10; round++) {
+        TEST_ASSERT_TRUE(q.pop(v));
+        TEST_ASSERT_EQUAL_INT(round, v);
+        TEST_ASSERT_TRUE(q.push(round + 4));
+    }
+    TEST_ASSERT_EQUAL_UINT32(4, q.size());
+}
+
+// === 测试用例 2: 事件文本截断，队列满时计数 ===
+void test_bus_event_drop_counter(void) {
+    ControlBus bus;
+    for (uint32_t i = 0; i < ControlBus::EVENT_DEPTH; i++)
+        TEST_ASSERT_TRUE(bus.postEvent(EventType::Notify, "Done [1/18]"));
+    TEST_ASSERT_FALSE(bus.postEvent(EventType::Notify, "overflow"));
+    TEST_ASSERT_EQUAL_UINT32(1, bus.droppedEvents.load());
+
+    Event ev;
+    TEST_ASSERT_TRUE(bus.events.pop(ev));
+    TEST_ASSERT_EQUAL_STRING("Done [1/18]", ev.text);
+}
+
+// === 测试用例 3: 两个线程版任务对跑压测 ===
+// "网络任务" 连续投递带序号的指令，"控制任务" 按序消费并回投事件；
+// 验证没有丢失、没有乱序，且生产者在队列满时从不阻塞消费者。
+void test_bus_two_task_stress(void) {
+    const int32_t TOTAL = 200000;
+    ControlBus bus;
+    std::atomic<int32_t> sent{0};
+    std::atomic<int32_t> received{0};
+    std::atomic<int32_t> outOfOrder{0};
+    std::atomic<int32_t> eventsSeen{0};
+    std::atomic<uint32_t> fullHits{0};
+
+    PeriodicTask network;
+    PeriodicTask control;
+
+    network.start("network", [&]() {
+        // 每拍最多投递 64 条，满了就留到下一拍 (与真实网络任务一致)
+        for (int k = 0; k < 64 && sent.load() < TOTAL; k++) {
+            Command cmd{CommandType::Start, 0, sent.load()};
+            if (!bus.commands.push(cmd)) {
+                fullHits.fetch_add(1);
+                break;
+            }
+            sent.fetch_add(1);
+        }
+        Event ev;
+        while (bus.events.pop(ev))
+            eventsSeen.fetch_add(1);
+    }, 0, 0, 1, 0);
+
+    control.start("control", [&]() {
+        Command cmd;
+        while (bus.commands.pop(cmd)) {
+            if (cmd.arg != received.load())
+                outOfOrder.fetch_add(1);
+            received.fetch_add(1);
+            if (cmd.arg % 100 == 0)
+                bus.postEvent(EventType::Notify, "tick");
+        }
+    }, 0, 0, 3, 1);
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    while (received.load() < TOTAL &&
+           std::chrono::steady_clock::now() - t0 < std::chrono::seconds(20))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // 再给网络任务一点时间收完事件
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    control.stop();
+    network.stop();
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "stress: %ld cmds, %ld events, queue-full hits %lu, dropped events %lu",
+             (long)received.load(), (long)eventsSeen.load(),
+             (unsigned long)fullHits.load(), (unsigned long)bus.droppedEvents.load());
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL_INT32(TOTAL, received.load());
+    TEST_ASSERT_EQUAL_INT32(0, outOfOrder.load());
+    TEST_ASSERT_EQUAL_INT32(TOTAL / 100, eventsSeen.load() + (int32_t)bus.droppedEvents.load());
+}
+
+// === 测试用例 4: 事件驱动任务：睡到截止时刻，或被 wake() 立即叫醒 ===
+void test_wakeable_task(void) {
+    using namespace std::chrono;
+    std::atomic<int> runs{0};
+    std::atomic<uint32_t> nextWait{WakeableTask::FOREVER};
+
+    WakeableTask task;
+    TEST_ASSERT_TRUE(task.start("ctl", [&]() -> uint32_t {
+        runs.fetch_add(1);
+        return nextWait.load();
+    }, 60000, 4096, 3, 1));
+
+    // 启动时跑一次，然后无限期阻塞 (不会空转)
+    std::this_thread::sleep_for(milliseconds(50));
+    TEST_ASSERT_EQUAL_INT(1, runs.load());
+    std::this_thread::sleep_for(milliseconds(100));
+    TEST_ASSERT_EQUAL_INT(1, runs.load());
+
+    // wake()：立即再跑一次
+    steady_clock::time_point t0 = steady_clock::now();
+    task.wake();
+    while (runs.load() < 2 && steady_clock::now() - t0 < seconds(1))
+        std::this_thread::yield();
+    long latencyUs = (long)duration_cast<microseconds>(steady_clock::now() - t0).count();
+    TEST_ASSERT_EQUAL_INT(2, runs.load());
+
+    // 有截止时刻：到点自己醒
+    nextWait.store(20);
+    task.wake();
+    std::this_thread::sleep_for(milliseconds(110));
+    int timed = runs.load();
+    nextWait.store(WakeableTask::FOREVER);
+    task.stop();
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "wake latency %ld us, %d timed wakeups in 110ms @20ms", latencyUs, timed - 2);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE(latencyUs < 100000);
+    TEST_ASSERT_TRUE(timed - 2 >= 3 && timed - 2 <= 7);
+}
+
+// === 测试用例 5: 跟踪环多生产者压测 ===
+// 4 个线程同时写，1 个线程边写边读：每个生产者的记录按序到达，收到 + 丢弃 = 写入总数
+static Trace::Ring<256> stressRing;
+
+void test_trace_ring_mpsc(void) {
+    const int PRODUCERS = 4;
+    const uint32_t PER_PRODUCER = 100000;
+    stressRing.clear();
+    std::atomic<int> done{0};
+    std::atomic<uint64_t> pushNs{0};
+
+    std::thread producers[PRODUCERS];
+    for (int p = 0; p < PRODUCERS; p++) {
+        producers[p] = std::thread([&, p]() {
+            uint64_t ns = 0;
+            for (uint32_t i = 0; i < PER_PRODUCER; i += 16) {
+                // 每 16 条让出一次 (真实的调用点之间还有别的工作)，只计 push 本身的时间
+                std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+                for (uint32_t k = i; k < i + 16 && k < PER_PRODUCER; k++) {
+                    Trace::Record r = {};
+                    r.formatId = 1;
+                    r.argc = 2;
+                    r.args[0] = (uint32_t)p;
+                    r.args[1] = k;
+                    stressRing.push(r);
+                }
+                ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - t0).count();
+                std::this_thread::yield();
+            }
+            pushNs.fetch_add(ns);
+            done.fetch_add(1);
+        });
+    }
+
+    uint32_t received = 0, dropped = 0, outOfOrder = 0;
+    int64_t last[PRODUCERS];
+    for (int p = 0; p < PRODUCERS; p++)
+        last[p] = -1;
+    for (;;) {
+        bool finished = done.load() == PRODUCERS; // 先读标志再读队列，避免漏掉最后几条
+        Trace::Record r;
+        while (stressRing.pop(r)) {
+            uint32_t p = r.args[0];
+            if (p >= (uint32_t)PRODUCERS || (int64_t)r.args[1] <= last[p])
+                outOfOrder++;
+            else
+                last[p] = r.args[1];
+            received++;
+        }
+        dropped += stressRing.takeDropped();
+        if (finished)
+            break;
+        std::this_thread::yield();
+    }
+    for (int p = 0; p < PRODUCERS; p++)
+        producers[p].join();
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "trace ring: %lu received, %lu dropped, %.1f ns/push",
+             (unsigned long)received, (unsigned long)dropped,
+             (double)pushNs.load() / (PRODUCERS * PER_PRODUCER));
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(PRODUCERS * PER_PRODUCER, received + dropped);
+    TEST_ASSERT_TRUE(stressRing.empty());
+}
+
+// === 测试用例 6: 状态快照的顺序锁：写者不停地改，读者拷到的每一份都是完整的 (所有字段来自同一次写) ===
+struct SlStatus {
+    uint32_t words[256]; // 和真实的状态快照一个量级 (1KB)，拷贝期间很容易撞上写者
+};
+static SeqLock<SlStatus> stressBoard;
+
+void test_seqlock_snapshot(void) {
+    SlStatus copy;
+    TEST_ASSERT_FALSE(stressBoard.read(copy)); // 还没写过
+
+    std::atomic<bool> stop{false};
+    // 写者连着写、每 8 次让出一下 (真实的控制任务只在收到 info 时写一次)：读者很容易撞上半截的写入，
+    // 但不会一直拿不到完整的一份
+    std::thread writer([&]() {
+        for (uint32_t k = 1; !stop.load(); k++) {
+            stressBoard.write([k](SlStatus &s) {
+                for (uint32_t &w : s.words)
+                    w = k;
+            });
+            if (k % 8 == 0)
+                std::this_thread::yield();
+        }
+    });
+
+    uint32_t reads = 0, gaveUp = 0, torn = 0, last = 0, backwards = 0;
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    while (std::chrono::steady_clock::now() < end) {
+        if (!stressBoard.read(copy)) {
+            gaveUp++;
+            continue;
+        }
+        reads++;
+        for (uint32_t w : copy.words)
+            if (w != copy.words[0])
+                torn++;
+        if (copy.words[0] < last)
+            backwards++;
+        last = copy.words[0];
+    }
+    stop.store(true);
+    writer.join();
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "seqlock: %lu reads, %lu gave up, %lu writes",
+             (unsigned long)reads, (unsigned long)gaveUp, (unsigned long)stressBoard.writes());
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE(reads > 0);
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, backwards);
+    TEST_ASSERT_TRUE(stressBoard.read(copy));
+    TEST_ASSERT_EQUAL_UINT32(stressBoard.writes(), copy.words[0]);
+}
+
+void run_bus_stress_tests() {
+    RUN_TEST(test_spsc_bounds);
+    RUN_TEST(test_bus_event_drop_counter);
+    RUN_TEST(test_bus_two_task_stress);
+    RUN_TEST(test_wakeable_task);
+    RUN_TEST(test_trace_ring_mpsc);
+    RUN_TEST(test_seqlock_snapshot);
+}
+
+#endif
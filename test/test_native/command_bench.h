@@ -0,0 +1,104 @@
+#ifndef COMMAND_BENCH_H
+#define COMMAND_BENCH_H
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "CommandParser.h"
+#include "alloc_counter.h"
+
+// 旧路径的等价实现：模拟 Arduino String 逐字符 += (每次都按新长度重新分配)、
+// toLowerCase() 再逐个 == 比较
+class LegacyString {
+    char *buf = nullptr;
+    size_t len = 0;
+
+public:
+    LegacyString() {}
+    LegacyString(const LegacyString &) = delete;
+    ~LegacyString() { delete[] buf; }
+
+    void append(char c) {
+        char *next = new char[len + 2];
+        if (buf)
+            memcpy(next, buf, len);
+        next[len++] = c;
+        next[len] = '\0';
+        delete[] buf;
+        buf = next;
+    }
+    void toLowerCase() {
+        for (size_t i = 0; i < len; i++)
+            if (buf[i] >= 'A' && buf[i] <= 'Z')
+                buf[i] += 'a' - 'A';
+    }
+    bool operator==(const char *s) const { return buf && strcmp(buf, s) == 0; }
+};
+
+static int legacy_dispatch(const uint8_t *payload, unsigned int length) {
+    LegacyString msg;
+    for (unsigned int i = 0; i < length; i++)
+        msg.append((char)payload[i]);
+    msg.toLowerCase();
+    if (msg == "start" || msg == "on") return (int)CommandType::Start;
+    else if (msg == "stop" || msg == "off") return (int)CommandType::Stop;
+    else if (msg == "reset") return (int)CommandType::Reset;
+    else if (msg == "kill") return (int)CommandType::Kill;
+    else if (msg == "revive") return (int)CommandType::Revive;
+    else if (msg == "info" || msg == "status") return (int)CommandType::Info;
+    return -1;
+}
+
+static int parser_dispatch(const uint8_t *payload, unsigned int length) {
+    Command cmd;
+    if (CommandParser::parse(payload, length, cmd) != CommandParser::Result::Ok)
+        return -1;
+    return (int)cmd.type;
+}
+
+// === 基准测试: 新解析器 vs 旧 String 路径 ===
+void bench_command_dispatch(void) {
+    using namespace std::chrono;
+    static const char *INPUTS[] = {"start", "STOP", "status", "revive", "off", "info", "kill", "reset", "bogus"};
+    const int N = sizeof(INPUTS) / sizeof(INPUTS[0]);
+    const int ROUNDS = 200000;
+    volatile int sink = 0;
+
+    // 两条路径结果一致
+    for (int i = 0; i < N; i++) {
+        const uint8_t *p = (const uint8_t *)INPUTS[i];
+        TEST_ASSERT_EQUAL_INT(legacy_dispatch(p, strlen(INPUTS[i])), parser_dispatch(p, strlen(INPUTS[i])));
+    }
+
+    size_t a0 = allocCount();
+    steady_clock::time_point t0 = steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 0; i < N; i++)
+            sink += legacy_dispatch((const uint8_t *)INPUTS[i], strlen(INPUTS[i]));
+    double legacyNs = (double)duration_cast<nanoseconds>(steady_clock::now() - t0).count() / (ROUNDS * N);
+    size_t legacyAllocs = allocCount() - a0;
+
+    a0 = allocCount();
+    t0 = steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 0; i < N; i++)
+            sink += parser_dispatch((const uint8_t *)INPUTS[i], strlen(INPUTS[i]));
+    double parserNs = (double)duration_cast<nanoseconds>(steady_clock::now() - t0).count() / (ROUNDS * N);
+    size_t parserAllocs = allocCount() - a0;
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "command dispatch: legacy %.1f ns/msg (%.1f allocs/msg), parser %.1f ns/msg (%zu allocs total)",
+             legacyNs, (double)legacyAllocs / (ROUNDS * N), parserNs, parserAllocs);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL_UINT32(0, parserAllocs);
+    TEST_ASSERT_TRUE(legacyAllocs > 0);
+    TEST_ASSERT_TRUE(parserNs < legacyNs);
+}
+
+void run_command_bench() {
+    RUN_TEST(bench_command_dispatch);
+}
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef DELTA_BENCH_H
+#define DELTA_BENCH_H
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "PullOta.h"
+
+// 差分升级的带宽基准 (仅 native)
+// 合成两个版本的 "固件"：几千个函数，函数之间是 PC 相对调用，字面量池里是函数的绝对地址，后面是只读数据。
+// v2 在中间某个函数里加了 300 字节代码、改了几个常量和版本字符串 —— 典型的 "只改了 WateringSystem 里一点逻辑"。
+// 插入点之后的函数地址全部平移：跨过插入点的相对调用、指向后面的绝对地址都会变，这正是差分要处理的难点。
+
+struct DbFunc {
+    uint16_t ops;                   // 普通指令条数
+    std::vector<uint16_t> calls;    // 调用的函数 (插在指令之间)
+    std::vector<uint16_t> literals; // 字面量池里的函数地址
+    uint32_t seed;
+};
+
+static const uint32_t DB_CODE_BASE = 0x42000020;
+
+static uint32_t db_rand(uint32_t &s) { return s = s * 1664525u + 1013904223u; }
+
+// 同一份 "源码" 按版本渲染成镜像
+static std::vector<uint8_t> db_build(const std::vector<DbFunc> &fns, int version) {
+    const uint16_t CHANGED_FN = (uint16_t)(fns.size() / 2);
+    static const uint8_t vocab[][3] = {{0x36, 0x41, 0x00}, {0x1d, 0xf0, 0x00}, {0x0c, 0x02, 0x00}, {0x81, 0x00, 0x00},
+                                       {0xe0, 0x08, 0x00}, {0x22, 0xa0, 0x00}, {0x32, 0x03, 0x00}, {0xa2, 0xc1, 0x00}};
+    auto sizeOf = [&](size_t i) {
+        size_t n = fns[i].literals.size() * 4 + (fns[i].ops + fns[i].calls.size()) * 3;
+        if (version == 2 && i == CHANGED_FN) n += 300;
+        return (n + 3) & ~(size_t)3;
+    };
+
+    // 1. 布局
+    std::vector<uint32_t> addr(fns.size());
+    uint32_t a = DB_CODE_BASE;
+    for (size_t i = 0; i < fns.size(); i++) {
+        addr[i] = a;
+        a += (uint32_t)sizeOf(i);
+    }
+
+    // 2. 代码段
+    std::vector<uint8_t> img;
+    for (size_t i = 0; i < fns.size(); i++) {
+        const DbFunc &f = fns[i];
+        size_t start = img.size();
+        for (uint16_t t : f.literals)
+            for (int k = 0; k < 4; k++) img.push_back((uint8_t)(addr[t] >> (8 * k)));
+        uint32_t s = f.seed;
+        size_t nextCall = 0;
+        uint16_t ops = f.ops;
+        if (version == 2 && i == CHANGED_FN) ops += 100; // 新增的代码
+        for (uint16_t k = 0; k < ops; k++) {
+            const uint8_t *op = vocab[db_rand(s) % 8];
+            uint8_t operand = (uint8_t)(db_rand(s) >> 28);
+            if (version == 2 && i == (size_t)CHANGED_FN + 7 && k == 3) operand ^= 0x5; // 改了一个常量
+            img.push_back(op[0]);
+            img.push_back(op[1]);
+            img.push_back(operand);
+            if (nextCall < f.calls.size() && k % 5 == 4) {
+                uint32_t pc = DB_CODE_BASE + (uint32_t)img.size();
+                int32_t off = ((int32_t)addr[f.calls[nextCall++]] - (int32_t)(pc & ~3u)) >> 2;
+                img.push_back((uint8_t)(0x25 | (off & 0x3) << 6));
+                img.push_back((uint8_t)(off >> 2));
+                img.push_back((uint8_t)(off >> 10));
+            }
+        }
+        while (nextCall < f.calls.size()) {
+            uint32_t pc = DB_CODE_BASE + (uint32_t)img.size();
+            int32_t off = ((int32_t)addr[f.calls[nextCall++]] - (int32_t)(pc & ~3u)) >> 2;
+            img.push_back((uint8_t)(0x25 | (off & 0x3) << 6));
+            img.push_back((uint8_t)(off >> 2));
+            img.push_back((uint8_t)(off >> 10));
+        }
+        while (img.size() - start < sizeOf(i)) img.push_back(0);
+    }
+
+    // 3. 只读数据：日志字符串、查找表、版本号
+    uint32_t s = 99;
+    for (int k = 0; k < 1500; k++) {
+        char line[48];
+        int n = snprintf(line, sizeof(line), "[WATER] Zone %%u event %d state %u", k, db_rand(s) % 7);
+        img.insert(img.end(), line, line + n + 1);
+    }
+    for (int k = 0; k < 40000; k++) img.push_back((uint8_t)(db_rand(s) >> 24));
+    const char *ver = version == 2 ? "v0.3.0 build 2026-10-18" : "v0.2.1 build 2026-09-02";
+    img.insert(img.end(), ver, ver + strlen(ver) + 1);
+    return img;
+}
+
+static std::vector<DbFunc> db_program(size_t count) {
+    std::vector<DbFunc> fns(count);
+    uint32_t s = 1;
+    for (size_t i = 0; i < count; i++) {
+        DbFunc &f = fns[i];
+        f.ops = (uint16_t)(10 + db_rand(s) % 120);
+        f.seed = db_rand(s);
+        for (uint32_t k = db_rand(s) % 6; k > 0; k--) f.calls.push_back((uint16_t)(db_rand(s) % count));
+        for (uint32_t k = db_rand(s) % 4; k > 0; k--) f.literals.push_back((uint16_t)(db_rand(s) % count));
+    }
+    return fns;
+}
+
+struct DbImage : public Delta::OldImage {
+    const std::vector<uint8_t> *img;
+    uint32_t size() const override { return (uint32_t)img->size(); }
+    bool read(uint32_t offset, uint8_t *buf, size_t len) override {
+        if (offset + len > img->size()) return false;
+        memcpy(buf, img->data() + offset, len);
+        return true;
+    }
+};
+
+struct DbMemSource : public Ota::Source {
+    const std::vector<uint8_t> *data;
+    uint32_t pos = 0;
+    bool open(uint32_t offset, uint32_t &total) override {
+        pos = offset;
+        total = (uint32_t)data->size();
+        return true;
+    }
+    int read(uint8_t *buf, size_t n) override {
+        size_t k = data->size() - pos < n ? data->size() - pos : n;
+        memcpy(buf, data->data() + pos, k);
+        pos += (uint32_t)k;
+        return (int)k;
+    }
+    void close() override {}
+};
+
+struct DbVecSink : public Ota::Sink {
+    std::vector<uint8_t> data;
+    uint32_t capacity() const override { return 4 * 1024 * 1024; }
+    bool begin(uint32_t) override { return true; }
+    bool write(const uint8_t *p, size_t n) override {
+        data.insert(data.end(), p, p + n);
+        return true;
+    }
+    bool commit() override { return true; }
+    void abort() override {}
+};
+
+static Ota::PullUpdater db_updater;
+
+// === 基准: 一次小改动，差分补丁 vs 完整镜像 (压缩后) 的下载量；补丁在设备端流程里还原出逐字节相同的镜像 ===
+void bench_delta_patch(void) {
+    std::vector<DbFunc> fns = db_program(3000);
+    std::vector<uint8_t> v1 = db_build(fns, 1), v2 = db_build(fns, 2);
+
+    static Lzss::Encoder lz;
+    std::vector<uint8_t> full(v2.size() + v2.size() / 8 + 64);
+    full.resize(lz.compress(v2.data(), v2.size(), full.data(), full.size()));
+
+    auto t0 = std::chrono::steady_clock::now();
+    static Delta::Encoder enc;
+    std::vector<uint8_t> patch;
+    enc.diff(v1.data(), (uint32_t)v1.size(), v2.data(), (uint32_t)v2.size(), patch);
+    std::vector<uint8_t> packed(patch.size() + patch.size() / 8 + 64);
+    packed.resize(lz.compress(patch.data(), patch.size(), packed.data(), packed.size()));
+    double diffMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    // 设备端流程：解压 -> 应用补丁 (随机读旧镜像) -> 哈希 -> 写入
+    DbImage base;
+    base.img = &v1;
+    db_updater.setBase(&base);
+    DbMemSource src;
+    src.data = &packed;
+    DbVecSink sink;
+    uint8_t sha[32];
+    Sha256 s;
+    s.update(v2.data(), v2.size());
+    s.finish(sha);
+    Ota::Result r = db_updater.run(src, sink, sha);
+    db_updater.setBase(nullptr);
+
+    TEST_ASSERT_EQUAL(Ota::Result::Ok, r);
+    TEST_ASSERT_TRUE(db_updater.stats().delta);
+    TEST_ASSERT_TRUE(sink.data == v2);
+
+    char msg[200];
+    snprintf(msg, sizeof(msg), "delta ota: image %u bytes, full compressed %u, patch %u raw / %u compressed (%.1fx less than full, %.1fx less than raw), diff %.0f ms",
+             (unsigned)v2.size(), (unsigned)full.size(), (unsigned)patch.size(), (unsigned)packed.size(),
+             (double)full.size() / packed.size(), (double)v2.size() / packed.size(), diffMs);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE(packed.size() * 10 <= full.size()); // 目标：比现在发的完整压缩镜像少 10 倍以上
+}
+
+void run_delta_bench() {
+    RUN_TEST(bench_delta_patch);
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef FLEET_SIM_H
+#define FLEET_SIM_H
+
+#include <unity.h>
+#include <stdio.h>
+#include "FleetSimulator.h"
+
+// 机队规模可以在 build_flags 里覆盖 (-D FLEET_SIM_DEVICES=1000)
+#ifndef FLEET_SIM_DEVICES
+#define FLEET_SIM_DEVICES 10000
+#endif
+#ifndef FLEET_SIM_YEARS
+#define FLEET_SIM_YEARS 5
+#endif
+
+// === 测试用例 1: 不注入故障时，每次触发都和参考模型一致，没有错过 ===
+void test_fleet_sim_matches_reference(void) {
+    FleetSimConfig cfg;
+    cfg.devices = 200;
+    cfg.years = 2;
+    cfg.outagesPerYear = 0;
+    FleetSimReport r = FleetSimulator::run(cfg);
+
+    // 用同样的种子重建每台设备的区域，按 WateringLogic 逐次推算
+    uint64_t fires = 0, relayMs = 0;
+    const int64_t from = FleetSimulator::startEpoch();
+    const int64_t to = from + (int64_t)cfg.years * 365 * EpochTime::SECONDS_PER_DAY;
+    for (uint32_t id = 0; id < cfg.devices; id++) {
+        FleetSimulator::Rng rng((uint64_t)cfg.seed * 0x100000001B3ULL + id);
+        SimZone zones[WATERING_MAX_ZONES];
+        uint8_t n = FleetSimulator::makeZones(cfg, rng, zones);
+        for (uint8_t i = 0; i < n; i++) {
+            uint32_t f = FleetSimulator::expectedFires(zones[i], from, to);
+            fires += f;
+            relayMs += (uint64_t)f * zones[i].durationSec * 1000;
+        }
+    }
+
+    TEST_ASSERT_TRUE(fires > 0);
+    TEST_ASSERT_TRUE(r.fires == fires);
+    TEST_ASSERT_TRUE(r.relayOnMs == relayMs);
+    TEST_ASSERT_TRUE(r.misses == 0);
+    TEST_ASSERT_TRUE(r.cutRuns == 0);
+    TEST_ASSERT_TRUE(r.reboots == 0);
+}
+
+// === 测试用例 2: 断电后计数从 Flash 恢复，不会在间隔内重复浇水 ===
+void test_fleet_sim_outages(void) {
+    FleetSimConfig cfg;
+    cfg.devices = 200;
+    cfg.years = 2;
+    cfg.outagesPerYear = 24;
+    FleetSimReport r = FleetSimulator::run(cfg);
+
+    TEST_ASSERT_TRUE(r.reboots > 0);
+    TEST_ASSERT_TRUE(r.misses > 0);
+
+    // 结果与线程数无关 (每台设备的随机数只由种子和编号决定)
+    cfg.threads = 3;
+    FleetSimReport p = FleetSimulator::run(cfg);
+    TEST_ASSERT_TRUE(p.fires == r.fires);
+    TEST_ASSERT_TRUE(p.misses == r.misses);
+    TEST_ASSERT_TRUE(p.relayOnMs == r.relayOnMs);
+
+    // 每次断电最多让每个区域少跑 (断电时长 / 间隔) 次；多出来的启动只能来自重复浇水
+    cfg.outagesPerYear = 0;
+    FleetSimReport clean = FleetSimulator::run(cfg);
+    TEST_ASSERT_TRUE(r.fires <= clean.fires);
+    TEST_ASSERT_TRUE(r.fires + r.misses + r.cutRuns >= clean.fires * 99 / 100);
+}
+
+// === 测试用例 3: 补跑策略 ===
+// 断电 / 未对时期间的计划在对时后结算：RunLate 补跑窗口内的，Skip 全部记为错过
+// 两种策略下每个计划都有去处 (启动 / 错过 / 切断)，总数与无故障时一致
+void test_fleet_sim_catch_up(void) {
+    FleetSimConfig cfg;
+    cfg.devices = 200;
+    cfg.years = 2;
+    cfg.outagesPerYear = 24;
+    cfg.policy = MissedFirePolicy::Skip;
+    FleetSimReport skip = FleetSimulator::run(cfg);
+    cfg.policy = MissedFirePolicy::RunLate;
+    FleetSimReport late = FleetSimulator::run(cfg);
+    cfg.outagesPerYear = 0;
+    FleetSimReport clean = FleetSimulator::run(cfg);
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "clean %llu fires; skip %llu fires / %llu missed; run-late %llu fires / %llu missed",
+             (unsigned long long)clean.fires, (unsigned long long)skip.fires, (unsigned long long)skip.misses,
+             (unsigned long long)late.fires, (unsigned long long)late.misses);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_TRUE(late.misses < skip.misses);
+    TEST_ASSERT_TRUE(late.fires > skip.fires);
+    TEST_ASSERT_TRUE(late.fires <= clean.fires);
+    TEST_ASSERT_TRUE(skip.fires + skip.misses + skip.cutRuns >= clean.fires * 999 / 1000);
+    TEST_ASSERT_TRUE(late.fires + late.misses + late.cutRuns >= clean.fires * 999 / 1000);
+}
+
+// === 基准: 默认 1 万台设备 x 5 年 ===
+void bench_fleet_sim(void) {
+    FleetSimConfig cfg;
+    cfg.devices = FLEET_SIM_DEVICES;
+    cfg.years = FLEET_SIM_YEARS;
+    FleetSimReport r = FleetSimulator::run(cfg);
+
+    char msg[200];
+    snprintf(msg, sizeof(msg), "%u devices x %u years in %.0f ms (%u threads): %llu fires, %llu misses, %llu cut, %llu reboots",
+             (unsigned)cfg.devices, (unsigned)cfg.years, r.wallMs, (unsigned)r.threads, (unsigned long long)r.fires,
+             (unsigned long long)r.misses, (unsigned long long)r.cutRuns, (unsigned long long)r.reboots);
+    TEST_MESSAGE(msg);
+    snprintf(msg, sizeof(msg), "relay on %.1f h/device/year, %.1f wakeups/device/day, miss rate %.3f%%",
+             (double)r.relayOnMs / 3600000.0 / cfg.devices / cfg.years,
+             (double)r.wakeups / r.deviceDays,
+             100.0 * r.misses / (double)(r.fires + r.misses));
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_TRUE(r.fires > 0);
+    TEST_ASSERT_TRUE(r.cutRuns <= r.reboots);
+}
+
+void run_fleet_sim() {
+    RUN_TEST(test_fleet_sim_matches_reference);
+    RUN_TEST(test_fleet_sim_outages);
+    RUN_TEST(test_fleet_sim_catch_up);
+    RUN_TEST(bench_fleet_sim);
+}
+
+#endif
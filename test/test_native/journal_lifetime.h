@@ -0,0 +1,67 @@
+#ifndef JOURNAL_LIFETIME_H
+#define JOURNAL_LIFETIME_H
+
+#include <unity.h>
+#include <stdio.h>
+#include "StateJournal.h"
+#include "FlashSim.h"
+
+// === 寿命估算: 按不同浇水计划模拟一年的存档写入，统计擦除次数 ===
+// 几何参数与设备一致：64KB 分区 (16 x 4KB)，64 区域的键容量
+// 每次自动浇水结束提交一条 (计数 + 日期) 记录，和 WateringSystem::saveZone 一样
+
+static const uint32_t FLASH_ENDURANCE = 100000; // 典型 NOR 擦写寿命 (次/扇区)
+static const uint16_t LIFETIME_KEYS = 64 * 2 + 16;
+
+struct LifetimePlan {
+    const char *name;
+    int zones;
+    int runsPerDay;
+};
+
+static double project_lifetime_years(const LifetimePlan &plan, uint32_t &erasesPerYear) {
+    FlashSim flash(4096, 16);
+    StateJournal<FlashSim, LIFETIME_KEYS> j(flash);
+    j.begin();
+
+    int32_t counts[64] = {};
+    for (int day = 0; day < 365; day++) {
+        for (int run = 0; run < plan.runsPerDay; run++) {
+            for (int z = 0; z < plan.zones; z++) {
+                counts[z]++;
+                j.stage((uint16_t)(0x0100 + z * 2), counts[z]);
+                j.stage((uint16_t)(0x0100 + z * 2 + 1), 19733 + day);
+                j.commit();
+            }
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, flash.norViolations);
+    erasesPerYear = (uint32_t)flash.totalErases();
+    uint32_t worst = flash.maxEraseCount();
+    return worst == 0 ? 1e9 : (double)FLASH_ENDURANCE / worst;
+}
+
+void bench_journal_lifetime(void) {
+    const LifetimePlan plans[] = {
+        {"1 zone daily", 1, 1},
+        {"16 zones x4/day", 16, 4},
+        {"64 zones hourly", 64, 24},
+    };
+
+    for (const LifetimePlan &plan : plans) {
+        uint32_t erases = 0;
+        double years = project_lifetime_years(plan, erases);
+        char msg[128];
+        snprintf(msg, sizeof(msg), "%s: %d commits/year, %u sector erases/year, projected lifetime %.0f years",
+                 plan.name, plan.zones * plan.runsPerDay * 365, (unsigned)erases, years);
+        TEST_MESSAGE(msg);
+        TEST_ASSERT_TRUE(years > 10.0);
+    }
+}
+
+void run_journal_lifetime() {
+    RUN_TEST(bench_journal_lifetime);
+}
+
+#endif
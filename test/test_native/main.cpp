@@ -1,9 +1,42 @@
 #include <unity.h>
 // 引入上一级目录的 common
-#include "../common/logic_tests.h" 
+#include "../common/logic_tests.h"
+#include "../common/schedule_tests.h"
+#include "../common/pump_tests.h"
+#include "../common/scheduler_tests.h"
+#include "../common/command_parser_tests.h"
+#include "../common/json_writer_tests.h"
+#include "../common/outbound_queue_tests.h"
+#include "../common/mqtt_session_tests.h"
+#include "../common/journal_tests.h"
+#include "../common/history_tests.h"
+#include "../common/metrics_tests.h"
+#include "../common/trace_tests.h"
+#include "../common/wifi_link_tests.h"
+#include "../common/ota_gate_tests.h"
+#include "../common/ota_pull_tests.h"
+#include "../common/ota_delta_tests.h"
+#include "../common/moisture_tests.h"
+#include "../common/flow_tests.h"
+#include "../common/power_lease_tests.h"
+#include "../common/wire_protocol_tests.h"
+#include "../common/heap_tests.h"
+#include "../common/memory_pool_tests.h"
+#include "../common/system_tests.h"
+#include "zone_bench.h"
+#include "bus_stress_tests.h"
+#include "command_bench.h"
+#include "journal_lifetime.h"
+#include "fleet_sim.h"
+#include "mqtt_loopback_tests.h"
+#include "ota_http_tests.h"
+#include "delta_bench.h"
+#include "moisture_sim.h"
+#include "power_fleet_tests.h"
 
 // Native 环境必须显式定义这两个钩子
-void setUp(void) {}
+// 和 embedded 一样，每个用例前重置系统测试用的存档 (HostHal 的虚拟 Flash)
+void setUp(void) { setUp_System(); }
 void tearDown(void) {}
 
 int main(int argc, char **argv) {
@@ -11,7 +44,41 @@ int main(int argc, char **argv) {
 
     // 直接运行共享清单
     run_shared_logic_tests();
+    run_shared_schedule_tests();
+    run_shared_pump_tests();
+    run_shared_scheduler_tests();
+    run_shared_command_parser_tests();
+    run_shared_json_writer_tests();
+    run_shared_outbound_queue_tests();
+    run_shared_mqtt_session_tests();
+    run_shared_journal_tests();
+    run_shared_history_tests();
+    run_shared_metrics_tests();
+    run_shared_trace_tests();
+    run_shared_wifi_link_tests();
+    run_shared_ota_gate_tests();
+    run_shared_ota_pull_tests();
+    run_shared_ota_delta_tests();
+    run_shared_moisture_tests();
+    run_shared_flow_tests();
+    run_shared_power_lease_tests();
+    run_shared_wire_protocol_tests();
+    run_shared_heap_tests();
+    run_shared_memory_pool_tests();
+    run_shared_system_tests();
+
+    // 仅 native: 性能基准 / 多线程压测
+    run_zone_bench();
+    run_bus_stress_tests();
+    run_command_bench();
+    run_journal_lifetime();
+    run_fleet_sim();
+    run_mqtt_loopback_tests();
+    run_ota_http_tests();
+    run_delta_bench();
+    run_moisture_sim();
+    run_power_fleet_tests();
 
     UNITY_END();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,138 @@
+#ifndef MOISTURE_SIM_H
+#define MOISTURE_SIM_H
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "MoistureAdc.h"
+#include "WateringSystem.h"
+
+// 土壤湿度闭环仿真 (仅 native)：两个区域、同一块地、同样的天气，每天 6:00 的计划
+// - 区域 0：湿度条件 40%，计划到点时土还湿就跳过
+// - 区域 1：只看时钟 (现在的行为)
+// 土壤模型：每小时按天气蒸发 (晴天多、阴天少)，偶尔下雨，一次浇水 +25%
+// 探头读数由土壤湿度按标定反推，加上噪声和继电器干扰尖峰，每小时一轮 DMA 样本过 MoistureAdc
+// 整条链 (样本 -> 中值 / EMA -> 千分比 -> WateringSystem 的决策) 都是设备上的代码
+
+struct MsSoil {
+    int32_t m = 600;           // 真实湿度 (千分比)
+    uint32_t runs = 0;
+    int32_t minM = 1000;
+    uint32_t dryHours = 0;     // 低于 20% (开始萎蔫) 的小时数
+    uint32_t soggyHours = 0;   // 高于 90% (积水烂根) 的小时数
+};
+
+static uint32_t msim_seed = 42;
+static uint32_t msim_rand() { return msim_seed = msim_seed * 1664525u + 1013904223u; }
+
+// 湿度 -> 探头原始读数 (干 2900 / 湿 1300)，加噪声和偶发尖峰
+static uint16_t msim_probe(int32_t m) {
+    uint32_t r = msim_rand();
+    if (r % 13 == 0)
+        return (r >> 8) & 1 ? 4095 : 10;
+    int32_t raw = MOISTURE_DRY_RAW - m * (MOISTURE_DRY_RAW - MOISTURE_WET_RAW) / 1000 + (int32_t)((r >> 16) % 61) - 30;
+    return (uint16_t)raw;
+}
+
+// === 测试用例 1: 30 天闭环：湿度条件少浇水，且土壤不会干到萎蔫 ===
+void test_moisture_closed_loop(void) {
+    static MoistureAdc adc;
+    adc.addChannel(3);
+    adc.addChannel(4);
+    WateringSystem sys(false);
+    sys.addZone(4, 60, 6, 0, 1, 1000);
+    sys.addZone(5, 60, 6, 0, 1, 1000);
+    sys.setMoistureThreshold(0, 400);
+    sys.setMaxConcurrentRuns(2);
+    sys.begin();
+
+    MsSoil soil[2];
+    const int64_t start = (int64_t)EpochTime::daysFromCivil(2026, 6, 1) * EpochTime::SECONDS_PER_DAY;
+    int32_t evap = 0;
+    for (int hour = 0; hour < 30 * 24; hour++) {
+        int64_t now = start + (int64_t)hour * 3600;
+        int hod = hour % 24;
+        if (hod == 0)
+            evap = 40 + (int32_t)((msim_rand() >> 16) % 100); // 今天蒸发多少 (4% ~ 14%)
+        bool rain = hod == 15 && (msim_rand() >> 16) % 6 == 0;
+
+        // 1. 土壤变化：白天蒸发，偶尔下雨
+        for (MsSoil &s : soil) {
+            if (hod >= 8 && hod < 20)
+                s.m -= evap * s.m / (12 * 700);
+            if (rain)
+                s.m += 200;
+            if (s.m > 1000)
+                s.m = 1000;
+        }
+
+        // 2. 一轮 DMA 样本：两个通道交替
+        for (uint32_t i = 0; i < MOISTURE_BURST_SAMPLES; i++) {
+            adc.collect(3, msim_probe(soil[0].m));
+            adc.collect(4, msim_probe(soil[1].m));
+        }
+        adc.flush();
+
+        // 3. 控制任务：写入湿度、按时钟判断
+        sys.setMoisture(0, adc.permille(0));
+        sys.setMoisture(1, adc.permille(1));
+        sys.update(now);
+        for (int z = 0; z < 2; z++) {
+            if (sys.isBusy(z)) {
+                soil[z].runs++;
+                soil[z].m = soil[z].m + 250 > 1000 ? 1000 : soil[z].m + 250;
+            }
+        }
+        runUntilIdle(sys, 120000);
+
+        for (MsSoil &s : soil) {
+            if (s.m < s.minM)
+                s.minM = s.m;
+            if (s.m < 200)
+                s.dryHours++;
+            if (s.m > 900)
+                s.soggyHours++;
+        }
+    }
+
+    char msg[192];
+    snprintf(msg, sizeof(msg), "moisture loop 30d: gated %u runs (%u skipped, min %d%%, %u h >90%%), clock-only %u runs (min %d%%, %u h >90%%)",
+             soil[0].runs, sys.getSkippedCount(0), soil[0].minM / 10, soil[0].soggyHours,
+             soil[1].runs, soil[1].minM / 10, soil[1].soggyHours);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL_UINT32(30, soil[1].runs);
+    TEST_ASSERT_EQUAL_UINT32(30, soil[0].runs + sys.getSkippedCount(0));
+    TEST_ASSERT_TRUE(soil[0].runs * 2 < soil[1].runs); // 至少少浇一半
+    TEST_ASSERT_EQUAL_UINT32(0, soil[0].dryHours);
+    TEST_ASSERT_TRUE(soil[0].soggyHours < soil[1].soggyHours);
+    TEST_ASSERT_EQUAL_UINT32(0, adc.shortBurstCount());
+}
+
+// === 测试用例 2: 块滤波吞吐 (一轮 60 个样本的开销远小于 DMA 采样本身) ===
+void test_moisture_filter_throughput(void) {
+    static uint16_t samples[60 * 1000];
+    for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++)
+        samples[i] = msim_probe(500);
+    MoistureFilter f;
+    const int rounds = 50;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (size_t off = 0; off < sizeof(samples) / sizeof(samples[0]); off += 60)
+            f.process(samples + off, 60);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    double perSample = ns / (rounds * (double)(sizeof(samples) / sizeof(samples[0])));
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "moisture filter: %.2f ns/sample (median5 + EMA, 60-sample blocks)", perSample);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_INT_WITHIN(20, 500, f.permille());
+    TEST_ASSERT_TRUE(perSample < 200);
+}
+
+void run_moisture_sim() {
+    RUN_TEST(test_moisture_closed_loop);
+    RUN_TEST(test_moisture_filter_throughput);
+}
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef MQTT_LOOPBACK_TESTS_H
+#define MQTT_LOOPBACK_TESTS_H
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include "MqttSession.h"
+#include "SocketTransport.h"
+
+// 真实 socket 上的端到端测试 (仅 native)
+// 1. 进程内的迷你 broker (只认识客户端用到的报文)，在 127.0.0.1 的临时端口上监听
+// 2. 设置了环境变量 MQTT_TEST_BROKER=host[:port] 时，再对真实的 mosquitto 跑一遍持久会话：
+//    mosquitto -p 1883 &  MQTT_TEST_BROKER=127.0.0.1 .pio/build/native/program
+
+static uint32_t lb_now() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// 驱动会话直到 done() 或超时
+template <typename Done>
+static bool lb_drive(MqttSession &s, uint32_t timeoutMs, Done done) {
+    uint32_t start = lb_now();
+    while (!done()) {
+        if (lb_now() - start > timeoutMs) return false;
+        s.loop(lb_now());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+class MiniBroker {
+private:
+    int lfd = -1;
+    std::thread th;
+    std::atomic<bool> quit{false};
+    bool sessionKnown = false;
+
+    static void sendAll(int fd, const uint8_t *p, size_t n) {
+        while (n > 0) {
+            ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+            if (w <= 0) return;
+            p += w;
+            n -= w;
+        }
+    }
+
+    // 一条连接：返回时连接已关闭
+    void serve(int fd) {
+        static Mqtt::Decoder<2048> dec;
+        dec.reset();
+        uint8_t in[512];
+        uint8_t out[256];
+        uint16_t cmdPid = 900;
+        while (!quit.load()) {
+            if (sendCommand.exchange(false)) {
+                Mqtt::Writer w(out, sizeof(out));
+                Mqtt::encodePublishHeader(w, "watering/cmd", 4, 1, false, false, cmdPid);
+                w.bytes("stop", 4);
+                sendAll(fd, out, w.len);
+            }
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 5) <= 0) continue;
+            ssize_t n = recv(fd, in, sizeof(in), 0);
+            if (n <= 0) break;
+            size_t at = 0;
+            while (at < (size_t)n) {
+                size_t used = 0;
+                Mqtt::Decoder<2048>::Result r = dec.feed(in + at, n - at, used);
+                at += used;
+                if (r != Mqtt::Decoder<2048>::Result::Packet) continue;
+                Mqtt::Writer w(out, sizeof(out));
+                if (dec.type() == Mqtt::CONNECT) {
+                    uint8_t ack[4] = {Mqtt::CONNACK << 4, 2, (uint8_t)(sessionKnown ? 1 : 0), 0};
+                    sessionKnown = true; // 客户端用 cleanSession = 0：记住它
+                    connects++;
+                    w.bytes(ack, 4);
+                } else if (dec.type() == Mqtt::SUBSCRIBE) {
+                    uint8_t ack[5] = {Mqtt::SUBACK << 4, 3, dec.body()[0], dec.body()[1], 1};
+                    subscribes++;
+                    w.bytes(ack, 5);
+                } else if (dec.type() == Mqtt::PUBLISH) {
+                    Mqtt::Publish p;
+                    if (!dec.parsePublish(p)) continue;
+                    if (dropAt.load() > 0 && received.size() + 1 == (size_t)dropAt.load()) {
+                        dropAt = 0; // 收到这条时 "网络断了"：不记录、不确认
+                        ::close(fd);
+                        return;
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(m);
+                        received.push_back(std::string((const char *)p.payload, p.payloadLen));
+                    }
+                    if (p.dup) dups++;
+                    Mqtt::encodeAck(w, Mqtt::PUBACK, p.packetId);
+                } else if (dec.type() == Mqtt::PUBACK) {
+                    if (dec.packetId() == cmdPid) commandAcked = true;
+                } else if (dec.type() == Mqtt::PINGREQ) {
+                    Mqtt::encodeEmpty(w, Mqtt::PINGRESP);
+                }
+                sendAll(fd, out, w.len);
+            }
+        }
+        ::close(fd);
+    }
+
+public:
+    uint16_t port = 0;
+    std::mutex m;
+    std::vector<std::string> received;
+    std::atomic<int> connects{0};
+    std::atomic<int> subscribes{0};
+    std::atomic<int> dups{0};
+    std::atomic<int> dropAt{0}; // 收到第 n 条 PUBLISH 时断开连接
+    std::atomic<bool> sendCommand{false};
+    std::atomic<bool> commandAcked{false};
+
+    bool start() {
+        lfd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in a;
+        memset(&a, 0, sizeof(a));
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        a.sin_port = 0;
+        if (bind(lfd, (struct sockaddr *)&a, sizeof(a)) != 0 || listen(lfd, 4) != 0) return false;
+        socklen_t len = sizeof(a);
+        getsockname(lfd, (struct sockaddr *)&a, &len);
+        port = ntohs(a.sin_port);
+        th = std::thread([this]() {
+            while (!quit.load()) {
+                struct pollfd pfd = {lfd, POLLIN, 0};
+                if (poll(&pfd, 1, 20) <= 0) continue;
+                int fd = accept(lfd, nullptr, nullptr);
+                if (fd >= 0) serve(fd);
+            }
+        });
+        return true;
+    }
+
+    void stop() {
+        quit = true;
+        if (th.joinable()) th.join();
+        ::close(lfd);
+    }
+
+    size_t count() {
+        std::lock_guard<std::mutex> lock(m);
+        return received.size();
+    }
+};
+
+// === 测试用例 1: 迷你 broker：流水线发送、连接中断后 DUP 重发、收 QoS1 指令 ===
+void test_mqtt_loopback_pipeline(void) {
+    const int TOTAL = 200;
+    MiniBroker broker;
+    TEST_ASSERT_TRUE(broker.start());
+    broker.dropAt = 70;
+
+    SocketTransport net;
+    MqttSession s(net);
+    static uint8_t tx[4096];
+    static uint8_t storage[16384];
+    OutboundQueue outbox;
+    outbox.attach(storage, sizeof(storage));
+    MqttSession::Config cfg;
+    cfg.host = "127.0.0.1";
+    cfg.port = broker.port;
+    cfg.connect.clientId = "loopback-test";
+    cfg.retryBaseMs = 20;
+    std::atomic<int> commands{0};
+    s.begin(cfg, tx, sizeof(tx), &outbox, [&](char *topic, uint8_t *payload, unsigned int len) {
+        if (strcmp(topic, "watering/cmd") == 0 && len == 4 && memcmp(payload, "stop", 4) == 0) commands++;
+    });
+    s.subscribe("watering/cmd", 1);
+
+    char msg[32];
+    for (int i = 0; i < TOTAL; i++) {
+        snprintf(msg, sizeof(msg), "event-%04d", i);
+        TEST_ASSERT_TRUE(outbox.push("watering/status", msg));
+    }
+    uint32_t t0 = lb_now();
+    s.start(t0);
+    TEST_ASSERT_TRUE(lb_drive(s, 5000, [&]() { return outbox.empty() && broker.count() == (size_t)TOTAL; }));
+    uint32_t elapsed = lb_now() - t0;
+
+    // 按顺序、不丢、不重 (断开时没确认的那几条重发了一次)
+    {
+        std::lock_guard<std::mutex> lock(broker.m);
+        for (int i = 0; i < TOTAL; i++) {
+            snprintf(msg, sizeof(msg), "event-%04d", i);
+            TEST_ASSERT_EQUAL_STRING(msg, broker.received[i].c_str());
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(2, broker.connects.load());
+    TEST_ASSERT_EQUAL_INT(2, broker.subscribes.load()); // 第二次 session present 也重新订阅 (幂等)
+    TEST_ASSERT_TRUE(broker.dups.load() >= 1);
+    TEST_ASSERT_EQUAL_UINT32(1, s.stats().resumed);
+
+    broker.sendCommand = true;
+    TEST_ASSERT_TRUE(lb_drive(s, 2000, [&]() { return broker.commandAcked.load(); }));
+    TEST_ASSERT_EQUAL_INT(1, commands.load());
+
+    char line[128];
+    snprintf(line, sizeof(line), "loopback: %d QoS1 publishes (window 8, 1 reconnect, %d dup) in %u ms",
+             TOTAL, broker.dups.load(), elapsed);
+    TEST_MESSAGE(line);
+    s.stop(lb_now());
+    broker.stop();
+}
+
+// === 测试用例 2: 真实 mosquitto：持久会话在离线期间替设备保存 QoS1 指令 ===
+void test_mqtt_mosquitto_persistent_session(void) {
+    const char *env = getenv("MQTT_TEST_BROKER");
+    if (!env || !*env) {
+        TEST_IGNORE_MESSAGE("MQTT_TEST_BROKER not set (e.g. 127.0.0.1:1883), skipping");
+        return;
+    }
+    static char host[64];
+    snprintf(host, sizeof(host), "%s", env);
+    uint16_t port = 1883;
+    char *colon = strchr(host, ':');
+    if (colon) {
+        *colon = '\0';
+        port = (uint16_t)atoi(colon + 1);
+    }
+    static char deviceId[40];
+    static char topic[64];
+    snprintf(deviceId, sizeof(deviceId), "watering-test-%u", lb_now());
+    snprintf(topic, sizeof(topic), "watering-test/%u/cmd", lb_now());
+
+    static uint8_t txA[2048], txB[2048], storage[4096];
+    std::atomic<int> got{0};
+    SocketTransport netA, netB;
+    MqttSession device(netA), sender(netB);
+    MqttSession::Config cfg;
+    cfg.host = host;
+    cfg.port = port;
+    cfg.connect.clientId = deviceId;
+
+    // 1. 设备第一次上线：新会话，订阅 QoS1，然后正常下线
+    device.begin(cfg, txA, sizeof(txA), nullptr, [&](char *, uint8_t *, unsigned int) { got++; });
+    device.subscribe(topic, 1);
+    device.start(lb_now());
+    TEST_ASSERT_TRUE(lb_drive(device, 5000, [&]() { return device.isConnected(); }));
+    lb_drive(device, 300, [&]() { return false; }); // 留时间给 SUBACK
+    device.stop(lb_now());
+
+    // 2. 设备离线期间，另一个客户端发 3 条 QoS1 指令
+    OutboundQueue outbox;
+    outbox.attach(storage, sizeof(storage));
+    MqttSession::Config cfgB = cfg;
+    static char senderId[48];
+    snprintf(senderId, sizeof(senderId), "%s-sender", deviceId);
+    cfgB.connect.clientId = senderId;
+    cfgB.connect.cleanSession = true;
+    sender.begin(cfgB, txB, sizeof(txB), &outbox, nullptr);
+    for (int i = 0; i < 3; i++) outbox.push(topic, "stop");
+    sender.start(lb_now());
+    TEST_ASSERT_TRUE(lb_drive(sender, 5000, [&]() { return outbox.empty(); }));
+    sender.stop(lb_now());
+
+    // 3. 设备重新上线：broker 保留了会话，补发离线期间的指令
+    MqttSession again(netA);
+    again.begin(cfg, txA, sizeof(txA), nullptr, [&](char *, uint8_t *, unsigned int) { got++; });
+    again.subscribe(topic, 1);
+    again.start(lb_now());
+    TEST_ASSERT_TRUE(lb_drive(again, 5000, [&]() { return got.load() == 3; }));
+    TEST_ASSERT_EQUAL_UINT32(1, again.stats().resumed);
+
+    // 清掉 broker 上的测试会话
+    again.stop(lb_now());
+    MqttSession::Config clean = cfg;
+    clean.connect.cleanSession = true;
+    MqttSession wipe(netA);
+    wipe.begin(clean, txA, sizeof(txA), nullptr, nullptr);
+    wipe.start(lb_now());
+    lb_drive(wipe, 2000, [&]() { return wipe.isConnected(); });
+    wipe.stop(lb_now());
+}
+
+void run_mqtt_loopback_tests() {
+    RUN_TEST(test_mqtt_loopback_pipeline);
+    RUN_TEST(test_mqtt_mosquitto_persistent_session);
+}
+
+#endif
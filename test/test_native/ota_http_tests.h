@@ -0,0 +1,278 @@
+#ifndef OTA_HTTP_TESTS_H
+#define OTA_HTTP_TESTS_H
+
+#include <unity.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include "PullOta.h"
+#include "HttpSource.h"
+
+// 真实 socket 上的拉取升级 (仅 native)：进程内的迷你 HTTP 服务器，在 127.0.0.1 的临时端口上监听
+// 支持 Range，可以让前几个连接发到一半就断开，也可以假装不支持 Range (总是回 200 整个文件)
+
+class MiniHttp {
+private:
+    int lfd = -1;
+    std::thread th;
+    std::atomic<bool> quit{false};
+
+    static void sendAll(int fd, const void *p, size_t n) {
+        const uint8_t *b = (const uint8_t *)p;
+        while (n > 0) {
+            ssize_t w = send(fd, b, n, MSG_NOSIGNAL);
+            if (w <= 0) return;
+            b += w;
+            n -= w;
+        }
+    }
+
+    void serve(int fd) {
+        std::string req;
+        char in[512];
+        while (req.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = recv(fd, in, sizeof(in), 0);
+            if (n <= 0) {
+                ::close(fd);
+                return;
+            }
+            req.append(in, n);
+        }
+        unsigned long from = 0;
+        size_t r = req.find("Range: bytes=");
+        bool ranged = r != std::string::npos && sscanf(req.c_str() + r, "Range: bytes=%lu-", &from) == 1;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            offsets.push_back(ranged ? (long)from : -1);
+        }
+
+        char head[256];
+        if (notFound) {
+            int n = snprintf(head, sizeof(head), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+            sendAll(fd, head, n);
+            ::close(fd);
+            return;
+        }
+        if (!honorRange || !ranged) from = 0;
+        int n;
+        if (honorRange && ranged)
+            n = snprintf(head, sizeof(head),
+                         "HTTP/1.1 206 Partial Content\r\nContent-Type: application/octet-stream\r\n"
+                         "Content-Range: bytes %lu-%lu/%lu\r\nContent-Length: %lu\r\n\r\n",
+                         from, (unsigned long)file.size() - 1, (unsigned long)file.size(), (unsigned long)(file.size() - from));
+        else
+            n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\ncontent-length: %lu\r\n\r\n", (unsigned long)file.size());
+        sendAll(fd, head, n);
+
+        // 前 dropConnections 个连接只发 dropAfter 字节就断开
+        size_t len = file.size() - from;
+        if (dropConnections.load() > 0) {
+            dropConnections--;
+            if (len > dropAfter) len = dropAfter;
+        }
+        sendAll(fd, file.data() + from, len);
+        served += len;
+        ::close(fd);
+    }
+
+public:
+    uint16_t port = 0;
+    std::vector<uint8_t> file;
+    bool honorRange = true;
+    bool notFound = false;
+    size_t dropAfter = 0;
+    std::atomic<int> dropConnections{0};
+    std::atomic<size_t> served{0};
+    std::mutex m;
+    std::vector<long> offsets; // 每个请求的 Range 起点 (-1 = 没有 Range)
+
+    bool start() {
+        lfd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in a;
+        memset(&a, 0, sizeof(a));
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        a.sin_port = 0;
+        if (bind(lfd, (struct sockaddr *)&a, sizeof(a)) != 0 || listen(lfd, 4) != 0) return false;
+        socklen_t len = sizeof(a);
+        getsockname(lfd, (struct sockaddr *)&a, &len);
+        port = ntohs(a.sin_port);
+        th = std::thread([this]() {
+            while (!quit.load()) {
+                struct pollfd pfd = {lfd, POLLIN, 0};
+                if (poll(&pfd, 1, 20) <= 0) continue;
+                int fd = accept(lfd, nullptr, nullptr);
+                if (fd >= 0) serve(fd);
+            }
+        });
+        return true;
+    }
+
+    void stop() {
+        quit = true;
+        if (th.joinable()) th.join();
+        ::close(lfd);
+    }
+
+    std::string url(const char *path) const {
+        char u[64];
+        snprintf(u, sizeof(u), "http://127.0.0.1:%u%s", port, path);
+        return u;
+    }
+};
+
+struct VecSink : public Ota::Sink {
+    std::vector<uint8_t> data;
+    bool committed = false, aborted = false;
+    uint32_t capacity() const override { return 4 * 1024 * 1024; }
+    bool begin(uint32_t size) override {
+        data.clear();
+        data.reserve(size);
+        return true;
+    }
+    bool write(const uint8_t *p, size_t n) override {
+        data.insert(data.end(), p, p + n);
+        return true;
+    }
+    bool commit() override { return committed = true; }
+    void abort() override { aborted = true; }
+};
+
+// 像固件一样的 256KB 镜像：代码段 (少量指令模式的组合)、常量表、字符串、0xFF 填充
+static std::vector<uint8_t> oh_image() {
+    std::vector<uint8_t> img(256 * 1024, 0xFF);
+    uint32_t seed = 7;
+    auto rnd = [&]() { return seed = seed * 1664525u + 1013904223u; };
+    static const uint8_t ops[][3] = {{0x36, 0x41, 0x00}, {0x1d, 0xf0, 0x00}, {0x0c, 0x02, 0x00}, {0x81, 0x00, 0x00}, {0xe0, 0x08, 0x00}, {0x22, 0xa0, 0x00}};
+    size_t i = 0;
+    while (i < 200 * 1024) {
+        const uint8_t *op = ops[rnd() % 6];
+        img[i++] = op[0];
+        img[i++] = op[1];
+        img[i++] = (uint8_t)(rnd() % 16); // 操作数大多很小
+    }
+    while (i < 230 * 1024) img[i++] = (uint8_t)(rnd() >> 24);
+    const char *str = "[WATER] Zone %u started (%u s)\0";
+    for (; i < 240 * 1024; i++) img[i] = (uint8_t)str[i % 32];
+    return img;
+}
+
+static uint8_t oh_sha[32];
+
+static std::vector<uint8_t> oh_pack(const std::vector<uint8_t> &raw) {
+    static Lzss::Encoder enc;
+    std::vector<uint8_t> out(raw.size() + raw.size() / 8 + 64);
+    out.resize(enc.compress(raw.data(), raw.size(), out.data(), out.size()));
+    Sha256 s;
+    s.update(raw.data(), raw.size());
+    s.finish(oh_sha);
+    return out;
+}
+
+static Ota::PullUpdater oh_updater;
+
+// === 测试用例 1: 连接多次中途断开，用 Range 从断点续传，每个字节只下载一次 ===
+void test_ota_http_resume(void) {
+    std::vector<uint8_t> raw = oh_image();
+    MiniHttp http;
+    http.file = oh_pack(raw);
+    http.dropAfter = 15000;
+    http.dropConnections = 3;
+    TEST_ASSERT_TRUE(http.start());
+
+    HttpSource src;
+    TEST_ASSERT_TRUE(src.setUrl(http.url("/fw/watering.wlz").c_str()));
+    VecSink sink;
+    uint32_t slept = 0;
+    Ota::Hooks hooks;
+    hooks.sleep = [&](uint32_t ms) { slept += ms; };
+    Ota::Result r = oh_updater.run(src, sink, oh_sha, hooks);
+    http.stop();
+
+    TEST_ASSERT_EQUAL(Ota::Result::Ok, r);
+    TEST_ASSERT_TRUE(sink.committed);
+    TEST_ASSERT_TRUE(sink.data == raw);
+    const Ota::Stats &st = oh_updater.stats();
+    TEST_ASSERT_EQUAL_UINT16(4, st.connects);
+    TEST_ASSERT_EQUAL_UINT16(3, st.resumes);
+    TEST_ASSERT_EQUAL_UINT32(http.file.size(), st.compressedBytes);
+    TEST_ASSERT_EQUAL_UINT32(http.file.size(), http.served.load());
+    TEST_ASSERT_EQUAL_UINT32(3000, slept);
+    std::vector<long> expect = {0, 15000, 30000, 45000};
+    TEST_ASSERT_TRUE(http.offsets == expect);
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "pull ota: %u -> %u bytes (%.1f%%), %u connects",
+             (unsigned)raw.size(), (unsigned)http.file.size(), 100.0 * http.file.size() / raw.size(), st.connects);
+    TEST_MESSAGE(msg);
+}
+
+// === 测试用例 2: 服务器不支持 Range：回 200 时跳过已有部分，结果照样正确 ===
+void test_ota_http_no_range(void) {
+    std::vector<uint8_t> raw = oh_image();
+    MiniHttp http;
+    http.file = oh_pack(raw);
+    http.honorRange = false;
+    http.dropAfter = 50000;
+    http.dropConnections = 1;
+    TEST_ASSERT_TRUE(http.start());
+
+    HttpSource src;
+    TEST_ASSERT_TRUE(src.setUrl(http.url("/fw.wlz").c_str()));
+    VecSink sink;
+    Ota::Hooks hooks;
+    hooks.sleep = [](uint32_t) {};
+    Ota::Result r = oh_updater.run(src, sink, oh_sha, hooks);
+    http.stop();
+
+    TEST_ASSERT_EQUAL(Ota::Result::Ok, r);
+    TEST_ASSERT_TRUE(sink.data == raw);
+    TEST_ASSERT_EQUAL_UINT32(http.file.size() + 50000, http.served.load()); // 第二次从头发，多下载了一段
+}
+
+// === 测试用例 3: 404 / 连接被拒绝 / URL 不合法 ===
+void test_ota_http_errors(void) {
+    MiniHttp http;
+    http.notFound = true;
+    TEST_ASSERT_TRUE(http.start());
+
+    Ota::Config c;
+    c.maxAttempts = 3;
+    Ota::PullUpdater *u = new Ota::PullUpdater(c);
+    HttpSource src;
+    VecSink sink;
+    Ota::Hooks hooks;
+    hooks.sleep = [](uint32_t) {};
+    TEST_ASSERT_TRUE(src.setUrl(http.url("/missing.wlz").c_str()));
+    TEST_ASSERT_EQUAL(Ota::Result::SourceFailed, u->run(src, sink, oh_sha, hooks));
+    TEST_ASSERT_EQUAL(3, (int)http.offsets.size());
+    TEST_ASSERT_FALSE(sink.committed);
+
+    // 服务器关了：连接被拒绝，很快失败
+    uint16_t port = http.port;
+    http.stop();
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/fw.wlz", port);
+    TEST_ASSERT_TRUE(src.setUrl(url));
+    TEST_ASSERT_EQUAL(Ota::Result::SourceFailed, u->run(src, sink, oh_sha, hooks));
+    delete u;
+
+    TEST_ASSERT_FALSE(src.setUrl("https://example.com/fw.wlz"));
+    TEST_ASSERT_FALSE(src.setUrl("http://:80/fw.wlz"));
+    TEST_ASSERT_FALSE(src.setUrl("http://host:99999/fw.wlz"));
+    TEST_ASSERT_TRUE(src.setUrl("http://updates.local"));
+}
+
+void run_ota_http_tests() {
+    RUN_TEST(test_ota_http_resume);
+    RUN_TEST(test_ota_http_no_range);
+    RUN_TEST(test_ota_http_errors);
+}
+
+#endif
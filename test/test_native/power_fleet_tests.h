@@ -0,0 +1,340 @@
+#ifndef POWER_FLEET_TESTS_H
+#define POWER_FLEET_TESTS_H
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "PowerLease.h"
+#include "mqtt_loopback_tests.h" // lb_now / MqttSession / SocketTransport
+
+// 多台设备在真实 socket 上抢供电名额 (仅 native)
+// 1. 进程内的保留消息 broker：多连接、保留消息、'+' 通配订阅、扇出给所有订阅者
+// 2. 设置了 MQTT_TEST_BROKER=host[:port] 时，同样的场景再对真实的 mosquitto 跑一遍
+// 时间被压缩：1 "秒" = PF_MS_PER_SEC 毫秒，租约 / settle 都按这个换算
+
+#define PF_MS_PER_SEC 25
+#define PF_DEVICES 6
+#define PF_SLOTS 2
+
+class RetainedBroker {
+private:
+    struct Client {
+        int fd;
+        std::unique_ptr<Mqtt::Decoder<2048>> dec;
+        std::vector<std::string> filters;
+    };
+
+    int lfd = -1;
+    std::thread th;
+    std::atomic<bool> quit{false};
+    std::vector<Client> clients;
+    std::map<std::string, std::string> retained;
+
+    static void sendAll(int fd, const uint8_t *p, size_t n) {
+        while (n > 0) {
+            ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+            if (w <= 0) return;
+            p += w;
+            n -= w;
+        }
+    }
+
+    // 只支持精确匹配和最后一段的 '+'
+    static bool matches(const std::string &filter, const std::string &topic) {
+        if (filter.size() >= 2 && filter.compare(filter.size() - 2, 2, "/+") == 0) {
+            size_t prefix = filter.size() - 1;
+            return topic.size() > prefix && topic.compare(0, prefix, filter, 0, prefix) == 0 &&
+                   topic.find('/', prefix) == std::string::npos;
+        }
+        return filter == topic;
+    }
+
+    static void deliver(int fd, const std::string &topic, const std::string &payload, bool retain) {
+        uint8_t out[256];
+        Mqtt::Writer w(out, sizeof(out));
+        if (!Mqtt::encodePublishHeader(w, topic.c_str(), payload.size(), 0, retain, false, 0)) return;
+        w.bytes(payload.data(), payload.size());
+        sendAll(fd, out, w.len);
+    }
+
+    void onPacket(Client &c) {
+        Mqtt::Decoder<2048> &dec = *c.dec;
+        uint8_t out[64];
+        Mqtt::Writer w(out, sizeof(out));
+        if (dec.type() == Mqtt::CONNECT) {
+            uint8_t ack[4] = {Mqtt::CONNACK << 4, 2, 0, 0};
+            w.bytes(ack, 4);
+            sendAll(c.fd, out, w.len);
+        } else if (dec.type() == Mqtt::SUBSCRIBE) {
+            // 报文标识 + (长度, 主题, QoS)...；订阅成功后把匹配的保留消息发过去
+            const uint8_t *b = dec.body();
+            uint32_t at = 2;
+            std::vector<std::string> added;
+            while (at + 2 < dec.bodyLen()) {
+                uint16_t len = (uint16_t)(b[at] << 8 | b[at + 1]);
+                added.push_back(std::string((const char *)b + at + 2, len));
+                at += 2 + len + 1;
+            }
+            uint8_t ack[4] = {Mqtt::SUBACK << 4, (uint8_t)(2 + added.size()), b[0], b[1]};
+            w.bytes(ack, 4);
+            for (size_t i = 0; i < added.size(); i++) w.u8(1);
+            sendAll(c.fd, out, w.len);
+            for (const std::string &f : added) {
+                c.filters.push_back(f);
+                for (const auto &kv : retained)
+                    if (matches(f, kv.first)) deliver(c.fd, kv.first, kv.second, true);
+            }
+        } else if (dec.type() == Mqtt::PUBLISH) {
+            Mqtt::Publish p;
+            if (!dec.parsePublish(p)) return;
+            std::string topic(p.topic, p.topicLen), payload((const char *)p.payload, p.payloadLen);
+            if (p.qos == 1) {
+                Mqtt::encodeAck(w, Mqtt::PUBACK, p.packetId);
+                sendAll(c.fd, out, w.len);
+            }
+            if (p.retained) {
+                if (payload.empty()) retained.erase(topic);
+                else retained[topic] = payload;
+            }
+            publishes++;
+            for (Client &o : clients)
+                for (const std::string &f : o.filters)
+                    if (matches(f, topic)) {
+                        deliver(o.fd, topic, payload, false);
+                        break;
+                    }
+        } else if (dec.type() == Mqtt::PINGREQ) {
+            Mqtt::encodeEmpty(w, Mqtt::PINGRESP);
+            sendAll(c.fd, out, w.len);
+        }
+    }
+
+    // 返回 false：连接已关闭
+    bool serve(Client &c) {
+        uint8_t in[1024];
+        ssize_t n = recv(c.fd, in, sizeof(in), 0);
+        if (n <= 0) return false;
+        size_t at = 0;
+        while (at < (size_t)n) {
+            size_t used = 0;
+            Mqtt::Decoder<2048>::Result r = c.dec->feed(in + at, n - at, used);
+            at += used;
+            if (r != Mqtt::Decoder<2048>::Result::Packet) continue;
+            if (c.dec->type() == Mqtt::DISCONNECT) return false;
+            onPacket(c);
+        }
+        return true;
+    }
+
+public:
+    uint16_t port = 0;
+    std::atomic<int> publishes{0};
+
+    bool start() {
+        lfd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in a;
+        memset(&a, 0, sizeof(a));
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        a.sin_port = 0;
+        if (bind(lfd, (struct sockaddr *)&a, sizeof(a)) != 0 || listen(lfd, 16) != 0) return false;
+        socklen_t len = sizeof(a);
+        getsockname(lfd, (struct sockaddr *)&a, &len);
+        port = ntohs(a.sin_port);
+        th = std::thread([this]() {
+            while (!quit.load()) {
+                std::vector<struct pollfd> fds;
+                fds.push_back({lfd, POLLIN, 0});
+                for (const Client &c : clients) fds.push_back({c.fd, POLLIN, 0});
+                if (poll(fds.data(), fds.size(), 5) <= 0) continue;
+                for (size_t i = fds.size() - 1; i >= 1; i--) {
+                    if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                    if (!serve(clients[i - 1])) {
+                        ::close(clients[i - 1].fd);
+                        clients.erase(clients.begin() + (i - 1));
+                    }
+                }
+                if (fds[0].revents & POLLIN) {
+                    int fd = accept(lfd, nullptr, nullptr);
+                    if (fd >= 0) clients.push_back(Client{fd, std::unique_ptr<Mqtt::Decoder<2048>>(new Mqtt::Decoder<2048>()), {}});
+                }
+            }
+            for (Client &c : clients) ::close(c.fd);
+        });
+        return true;
+    }
+
+    void stop() {
+        quit = true;
+        if (th.joinable()) th.join();
+        ::close(lfd);
+    }
+};
+
+// 一台设备：MQTT 会话 + 租约；"水泵" 就是 tick() 的结果
+struct PfDevice {
+    SocketTransport net;
+    MqttSession session{net};
+    uint8_t tx[2048];
+    uint8_t storage[2048];
+    OutboundQueue outbox;
+    PowerLease lease;
+    char id[8];
+    char topic[64];
+    bool alive = true;
+    bool want = false;
+    bool granted = false;
+    int64_t phaseEnd = 0; // 当前这段 (想要 / 不想要) 持续到什么时候
+    uint32_t runs = 0;
+};
+
+struct PfResult {
+    uint8_t maxHolders = 0;
+    uint32_t runs = 0;
+    uint32_t minRuns = UINT32_MAX; // 活着的设备里运行次数最少的
+    uint32_t lost = 0;
+};
+
+// prefix 下每台设备一个主题；跑 simSec 秒，中途 (crashAt) 让 0 号设备在持有名额时掉线
+static PfResult pf_runFleet(const char *host, uint16_t port, const char *prefix, int64_t simSec, int64_t crashAt) {
+    static PfDevice devs[PF_DEVICES];
+    static char filter[64];
+    snprintf(filter, sizeof(filter), "%s/+", prefix);
+    const size_t prefixLen = strlen(prefix) + 1;
+    uint32_t seed = 7;
+    auto rnd = [&seed](uint32_t n) { seed = seed * 1664525u + 1013904223u; return (seed >> 16) % n; };
+
+    const uint32_t t0 = lb_now();
+    const int64_t base = 1000000;
+    auto simNow = [&]() { return base + (int64_t)((lb_now() - t0) / PF_MS_PER_SEC); };
+
+    PowerLease::Config pc;
+    pc.slots = PF_SLOTS;
+    pc.leaseSec = 30;
+    pc.settleSec = 3;
+    pc.offlineGrantSec = 0; // 掉线的设备不自己放行 (要测的是租约到期)
+    for (int i = 0; i < PF_DEVICES; i++) {
+        PfDevice &d = devs[i];
+        snprintf(d.id, sizeof(d.id), "dev%d", i);
+        snprintf(d.topic, sizeof(d.topic), "%s/%s", prefix, d.id);
+        d.lease = PowerLease();
+        d.lease.begin(d.id, pc);
+        d.outbox.attach(d.storage, sizeof(d.storage));
+        d.alive = true;
+        d.want = d.granted = false;
+        d.runs = 0;
+        d.phaseEnd = base + rnd(5);
+        MqttSession::Config cfg;
+        cfg.host = host;
+        cfg.port = port;
+        cfg.connect.clientId = d.topic;
+        cfg.connect.cleanSession = true;
+        cfg.retryBaseMs = 20;
+        d.session.begin(cfg, d.tx, sizeof(d.tx), &d.outbox, [&d, prefixLen, simNow](char *t, uint8_t *p, unsigned int len) {
+            if (strlen(t) > prefixLen) d.lease.onMessage(t + prefixLen, strlen(t + prefixLen), p, len, simNow());
+        });
+        d.session.subscribe(filter, 1);
+        d.session.start(lb_now());
+    }
+
+    PfResult r;
+    for (int64_t now = simNow(); now < base + simSec; now = simNow()) {
+        uint8_t holders = 0;
+        for (int i = 0; i < PF_DEVICES; i++) {
+            PfDevice &d = devs[i];
+            if (i == 0 && d.alive && now >= base + crashAt && d.granted) {
+                d.session.stop(lb_now()); // 拔网线：不释放，租约留在 broker 上
+                d.alive = false;
+            }
+            if (d.alive) d.session.loop(lb_now());
+
+            // 想要一会儿 (4 ~ 10 秒的运行)，再歇一会儿
+            if (d.alive && now >= d.phaseEnd) {
+                if (!d.want) {
+                    d.want = true;
+                    d.phaseEnd = INT64_MAX;
+                } else if (d.granted) {
+                    d.want = false;
+                    d.phaseEnd = now + rnd(4);
+                }
+            }
+            uint32_t next = 0;
+            bool was = d.granted;
+            d.granted = d.lease.tick(now, d.want, d.alive && d.session.isConnected(), [&d](const char *p) {
+                d.outbox.push(d.topic, p, true);
+            }, next);
+            if (d.granted && !was) {
+                d.runs++;
+                if (d.want) d.phaseEnd = now + 4 + rnd(7);
+            }
+            if (d.granted) holders++;
+        }
+        if (holders > r.maxHolders) r.maxHolders = holders;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    for (int i = 0; i < PF_DEVICES; i++) {
+        PfDevice &d = devs[i];
+        r.runs += d.runs;
+        r.lost += d.lease.getStats().lost;
+        if (i > 0 && d.runs < r.minRuns) r.minRuns = d.runs;
+        // 收尾：删掉自己的保留消息 (真实 broker 上不留垃圾)；掉线的那台先重新连上
+        if (!d.alive) d.session.start(lb_now());
+        d.outbox.push(d.topic, "", true);
+        lb_drive(d.session, 2000, [&d]() { return d.session.isConnected() && d.outbox.empty() && d.session.inflight() == 0; });
+        d.session.stop(lb_now());
+    }
+    return r;
+}
+
+// === 测试用例 1: 进程内 broker：6 台设备抢 2 个名额，任何时刻不超过 2；持有者掉线后名额在租约到期后回收 ===
+void test_power_fleet_loopback(void) {
+    RetainedBroker broker;
+    TEST_ASSERT_TRUE(broker.start());
+    PfResult r = pf_runFleet("127.0.0.1", broker.port, "watering/power", 150, 40);
+    broker.stop();
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "power fleet: %d devices / %d slots, %u runs (min %u per device), max %u concurrent, %d publishes",
+             PF_DEVICES, PF_SLOTS, r.runs, r.minRuns, r.maxHolders, broker.publishes.load());
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE(r.maxHolders <= PF_SLOTS);
+    TEST_ASSERT_EQUAL_UINT8(PF_SLOTS, r.maxHolders); // 名额确实被用满过
+    TEST_ASSERT_TRUE(r.minRuns >= 2);                // 掉线的设备没有把名额永久占住
+    TEST_ASSERT_EQUAL_UINT32(1, r.lost);             // 只有掉线的那台
+}
+
+// === 测试用例 2: 真实 mosquitto (保留消息 + 通配订阅的语义以它为准) ===
+void test_power_fleet_mosquitto(void) {
+    const char *env = getenv("MQTT_TEST_BROKER");
+    if (!env || !*env) {
+        TEST_IGNORE_MESSAGE("MQTT_TEST_BROKER not set (e.g. 127.0.0.1:1883), skipping");
+        return;
+    }
+    static char host[64];
+    snprintf(host, sizeof(host), "%s", env);
+    uint16_t port = 1883;
+    char *colon = strchr(host, ':');
+    if (colon) {
+        *colon = '\0';
+        port = (uint16_t)atoi(colon + 1);
+    }
+    static char prefix[48];
+    snprintf(prefix, sizeof(prefix), "watering-test/%u/power", lb_now());
+    PfResult r = pf_runFleet(host, port, prefix, 150, 40);
+    TEST_ASSERT_TRUE(r.maxHolders <= PF_SLOTS);
+    TEST_ASSERT_TRUE(r.minRuns >= 2);
+}
+
+void run_power_fleet_tests() {
+    RUN_TEST(test_power_fleet_loopback);
+    RUN_TEST(test_power_fleet_mosquitto);
+}
+
+#endif
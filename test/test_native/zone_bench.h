@@ -0,0 +1,105 @@
+#ifndef ZONE_BENCH_H
+#define ZONE_BENCH_H
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "WateringCore.h"
+#include "ZoneScheduler.h"
+
+// === 基准测试: 1000 个模拟区域，最小堆 vs 每秒轮询 ===
+// 两种方式按秒模拟 3 天，触发次数必须一致；打印每个 tick 的平均开销。
+
+static const uint16_t BENCH_ZONES = 1000;
+static const int32_t BENCH_START_DAY = 19733; // 2024-01-11
+static const int BENCH_DAYS = 3;
+
+struct BenchZone {
+    WateringLogic logic{0, 0, 1, 0};
+    int count = 0;
+    int32_t lastDay = WateringLogic::NEVER_WATERED;
+    int64_t firedMinute = -1; // 上次触发所在的 epoch 分钟 (同一分钟只触发一次)
+};
+
+static BenchZone benchZones[BENCH_ZONES];
+static ZoneScheduler<BENCH_ZONES> benchScheduler;
+
+static void bench_init_zones() {
+    for (uint16_t i = 0; i < BENCH_ZONES; i++) {
+        benchZones[i] = BenchZone();
+        benchZones[i].logic = WateringLogic(i % 24, (i * 7) % 60, 1 + i % 3, 1000);
+    }
+}
+
+// 旧方式：每秒对每个区域问一次 shouldStart
+static long bench_polling(double &nsPerTick) {
+    using namespace std::chrono;
+    bench_init_zones();
+    long fires = 0;
+    const int64_t begin = (int64_t)BENCH_START_DAY * EpochTime::SECONDS_PER_DAY;
+    const int64_t end = begin + (int64_t)BENCH_DAYS * EpochTime::SECONDS_PER_DAY;
+
+    steady_clock::time_point t0 = steady_clock::now();
+    for (int64_t now = begin; now < end; now++) {
+        const int64_t minute = now / 60;
+        for (uint16_t i = 0; i < BENCH_ZONES; i++) {
+            BenchZone &z = benchZones[i];
+            if (z.logic.shouldStart(now, z.count, z.lastDay, z.firedMinute == minute)) {
+                z.count++;
+                z.lastDay = EpochTime::dayOf(now);
+                z.firedMinute = minute;
+                fires++;
+            }
+        }
+    }
+    nsPerTick = (double)duration_cast<nanoseconds>(steady_clock::now() - t0).count() / (end - begin);
+    return fires;
+}
+
+// 新方式：最小堆只唤醒到期的区域
+static long bench_heap(double &nsPerTick) {
+    using namespace std::chrono;
+    bench_init_zones();
+    benchScheduler.clear();
+    long fires = 0;
+    const int64_t begin = (int64_t)BENCH_START_DAY * EpochTime::SECONDS_PER_DAY;
+    const int64_t end = begin + (int64_t)BENCH_DAYS * EpochTime::SECONDS_PER_DAY;
+
+    for (uint16_t i = 0; i < BENCH_ZONES; i++)
+        benchScheduler.schedule(i, benchZones[i].logic.nextFireTime(begin, 0, WateringLogic::NEVER_WATERED));
+
+    steady_clock::time_point t0 = steady_clock::now();
+    for (int64_t now = begin; now < end; now++) {
+        uint16_t zone;
+        while (benchScheduler.popDue(now, zone)) {
+            BenchZone &z = benchZones[zone];
+            z.count++;
+            z.lastDay = EpochTime::dayOf(now);
+            fires++;
+            benchScheduler.schedule(zone, z.logic.nextFireTime(now, z.count, z.lastDay));
+        }
+    }
+    nsPerTick = (double)duration_cast<nanoseconds>(steady_clock::now() - t0).count() / (end - begin);
+    return fires;
+}
+
+void bench_zone_scheduler_1000(void) {
+    double pollNs = 0, heapNs = 0;
+    long pollFires = bench_polling(pollNs);
+    long heapFires = bench_heap(heapNs);
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%u zones, %d days: polling %.1f ns/tick, heap %.1f ns/tick, fires %ld/%ld",
+             BENCH_ZONES, BENCH_DAYS, pollNs, heapNs, pollFires, heapFires);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_GREATER_THAN(0, heapFires);
+    TEST_ASSERT_EQUAL_INT(pollFires, heapFires);
+    TEST_ASSERT_TRUE(heapNs < pollNs);
+}
+
+void run_zone_bench() {
+    RUN_TEST(bench_zone_scheduler_1000);
+}
+
+#endif
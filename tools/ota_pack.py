@@ -0,0 +1,398 @@
+#!/usr/bin/env python3
+"""把固件打包成设备拉取升级用的 WLZ1 压缩镜像 / 差分补丁，并提供支持 Range 的 HTTP 服务器
+(格式见 lib/OtaManager/Lzss.h 和 lib/OtaManager/DeltaPatch.h)。
+
+设备收到 MQTT 指令 "ota <url> <sha256>" 后自己下载、边下边解压写入 OTA 分区、断线用 Range 续传，
+写完核对新固件的 SHA-256 才切换启动分区。下载的可以是完整镜像，也可以是针对设备当前固件的差分补丁。
+
+用法：
+  python3 tools/ota_pack.py pack .pio/build/esp32-s3-devkitc-1/firmware.bin -o firmware.wlz --url http://192.168.1.10:8000/firmware.wlz
+  python3 tools/ota_pack.py diff v0.2.1.bin firmware.bin -o v0.2.1-to-new.wlz   # 差分补丁：old 必须是设备上正在运行的那个 .bin
+  python3 tools/ota_pack.py apply v0.2.1.bin v0.2.1-to-new.wlz -o check.bin     # 在主机上应用补丁 (验证用)
+  python3 tools/ota_pack.py serve --dir . --port 8000       # 局域网 / 测试用的 HTTP 服务器 (支持 Range)
+  mosquitto_pub -t <MQTT_TOPIC_CMD> -m "ota http://192.168.1.10:8000/firmware.wlz <sha256>"
+"""
+
+import argparse
+import hashlib
+import http.server
+import os
+import re
+import struct
+import sys
+
+MAGIC = b"WLZ1"
+WINDOW = 4096
+MIN_MATCH = 3
+MAX_MATCH = 18
+
+
+def compress(data, max_chain=64):
+    """贪心 + 哈希链，和 Lzss::Encoder 输出同样的格式 (不要求逐字节相同)。"""
+    out = bytearray(MAGIC + struct.pack("<I", len(data)))
+    n = len(data)
+    chains = {}  # 3 字节 -> 位置列表 (新的在后)
+    i = 0
+    flag_pos = 0
+    bit = 8
+    while i < n:
+        if bit == 8:
+            flag_pos = len(out)
+            out.append(0)
+            bit = 0
+
+        best_len, best_pos = 0, 0
+        if i + MIN_MATCH <= n:
+            limit = min(MAX_MATCH, n - i)
+            cands = chains.get(data[i:i + MIN_MATCH])
+            if cands:
+                tried = 0
+                for cand in reversed(cands):
+                    if i - cand > WINDOW or tried >= max_chain:
+                        break
+                    tried += 1
+                    if data[cand:cand + limit] == data[i:i + limit]:
+                        best_len, best_pos = limit, cand
+                        break
+                    l = MIN_MATCH
+                    while l < limit and data[cand + l] == data[i + l]:
+                        l += 1
+                    if l > best_len:
+                        best_len, best_pos = l, cand
+
+        step = best_len if best_len >= MIN_MATCH else 1
+        if best_len >= MIN_MATCH:
+            d = i - best_pos - 1
+            out.append(d & 0xFF)
+            out.append((d >> 8) << 4 | (best_len - MIN_MATCH))
+        else:
+            out[flag_pos] |= 1 << bit
+            out.append(data[i])
+        for k in range(i, min(i + step, n - MIN_MATCH + 1)):
+            lst = chains.setdefault(data[k:k + MIN_MATCH], [])
+            lst.append(k)
+            if len(lst) > 2 * max_chain:
+                del lst[:max_chain]
+        i += step
+        bit += 1
+    return bytes(out)
+
+
+def decompress(blob):
+    if blob[:4] != MAGIC:
+        raise ValueError("not a WLZ1 image")
+    (size,) = struct.unpack("<I", blob[4:8])
+    out = bytearray()
+    i = 8
+    while len(out) < size:
+        flags = blob[i]
+        i += 1
+        for bit in range(8):
+            if len(out) >= size:
+                break
+            if flags >> bit & 1:
+                out.append(blob[i])
+                i += 1
+            else:
+                b0, b1 = blob[i], blob[i + 1]
+                i += 2
+                dist = ((b1 >> 4) << 8 | b0) + 1
+                if dist > len(out):
+                    raise ValueError("back reference before start at %d" % i)
+                for _ in range((b1 & 0x0F) + MIN_MATCH):
+                    out.append(out[-dist])
+    if i != len(blob) or len(out) != size:
+        raise ValueError("trailing or missing data")
+    return bytes(out)
+
+
+DELTA_MAGIC = b"WDP1"
+OP_COPY, OP_ADD, OP_INSERT, OP_SEEK = range(4)
+DELTA_KEY = 8
+
+
+def _varint(out, v):
+    while v >= 0x80:
+        out.append(v & 0x7F | 0x80)
+        v >>= 7
+    out.append(v)
+
+
+def _put_diff(out, new, ns, old, os_, length):
+    """差值区：连续 >= 4 个相同字节写成 COPY，其余写成 ADD (与 Delta::Encoder 相同)。"""
+    i = 0
+    while i < length:
+        z = i
+        while z < length and new[ns + z] == old[os_ + z]:
+            z += 1
+        if z - i >= 4 or z == length:
+            if z > i:
+                _varint(out, (z - i) << 2 | OP_COPY)
+            i = z
+            continue
+        e, zeros = z, 0
+        while e < length and zeros < 4:
+            zeros = zeros + 1 if new[ns + e] == old[os_ + e] else 0
+            e += 1
+        if zeros == 4:
+            e -= 4
+        _varint(out, (e - i) << 2 | OP_ADD)
+        out.extend((new[ns + k] - old[os_ + k]) & 0xFF for k in range(i, e))
+        i = e
+
+
+def make_delta(old, new):
+    """bsdiff 的主循环，最长匹配用 8 字节索引代替后缀数组 (与 Delta::Encoder 相同的算法)。"""
+    out = bytearray(DELTA_MAGIC + struct.pack("<II", len(new), len(old)) + hashlib.sha256(old).digest())
+    oldsize, newsize = len(old), len(new)
+    index = {old[i:i + DELTA_KEY]: i for i in range(oldsize - DELTA_KEY + 1)}
+
+    def search(scan):
+        if scan + DELTA_KEY > newsize:
+            return 0, 0
+        p = index.get(new[scan:scan + DELTA_KEY])
+        if p is None:
+            return 0, 0
+        l = DELTA_KEY
+        while p + l < oldsize and scan + l < newsize and old[p + l] == new[scan + l]:
+            l += 1
+        return l, p
+
+    scan = length = pos = lastscan = lastpos = lastoffset = 0
+    while scan < newsize:
+        oldscore = 0
+        scan += length
+        scsc = scan
+        while scan < newsize:
+            length, pos = search(scan)
+            while scsc < scan + length:
+                o = scsc + lastoffset
+                if 0 <= o < oldsize and old[o] == new[scsc]:
+                    oldscore += 1
+                scsc += 1
+            if (length == oldscore and length != 0) or length > oldscore + 8:
+                break
+            o = scan + lastoffset
+            if 0 <= o < oldsize and old[o] == new[scan]:
+                oldscore -= 1
+            scan += 1
+
+        if length != oldscore or scan == newsize:
+            s = sf = lenf = i = 0
+            while lastscan + i < scan and lastpos + i < oldsize:
+                if old[lastpos + i] == new[lastscan + i]:
+                    s += 1
+                i += 1
+                if s * 2 - i > sf * 2 - lenf:
+                    sf, lenf = s, i
+            lenb = 0
+            if scan < newsize:
+                s = sb = 0
+                i = 1
+                while scan >= lastscan + i and pos >= i:
+                    if old[pos - i] == new[scan - i]:
+                        s += 1
+                    if s * 2 - i > sb * 2 - lenb:
+                        sb, lenb = s, i
+                    i += 1
+            if lastscan + lenf > scan - lenb:
+                overlap = (lastscan + lenf) - (scan - lenb)
+                s = ss = lens = 0
+                for i in range(overlap):
+                    if new[lastscan + lenf - overlap + i] == old[lastpos + lenf - overlap + i]:
+                        s += 1
+                    if new[scan - lenb + i] == old[pos - lenb + i]:
+                        s -= 1
+                    if s > ss:
+                        ss, lens = s, i + 1
+                lenf += lens - overlap
+                lenb -= lens
+
+            _put_diff(out, new, lastscan, old, lastpos, lenf)
+            extra = (scan - lenb) - (lastscan + lenf)
+            if extra > 0:
+                _varint(out, extra << 2 | OP_INSERT)
+                out.extend(new[lastscan + lenf:scan - lenb])
+            if scan < newsize:
+                seek = (pos - lenb) - (lastpos + lenf)
+                if seek:
+                    _varint(out, ((seek << 1) ^ (seek >> 63)) << 2 | OP_SEEK)
+
+            lastscan = scan - lenb
+            lastpos = pos - lenb
+            lastoffset = pos - scan
+    return bytes(out)
+
+
+def apply_delta(old, patch):
+    if patch[:4] != DELTA_MAGIC:
+        raise ValueError("not a WDP1 patch")
+    newsize, oldsize = struct.unpack("<II", patch[4:12])
+    if oldsize > len(old) or hashlib.sha256(old[:oldsize]).digest() != patch[12:44]:
+        raise ValueError("patch was made against a different base image")
+    out = bytearray()
+    i, oldpos = 44, 0
+    while len(out) < newsize:
+        v = shift = 0
+        while True:
+            b = patch[i]
+            i += 1
+            v |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                break
+        op, n = v & 3, v >> 2
+        if op == OP_SEEK:
+            oldpos += (n >> 1) ^ -(n & 1)
+        elif op == OP_COPY:
+            out += old[oldpos:oldpos + n]
+            oldpos += n
+        elif op == OP_ADD:
+            out.extend((old[oldpos + k] + patch[i + k]) & 0xFF for k in range(n))
+            oldpos += n
+            i += n
+        else:
+            out += patch[i:i + n]
+            i += n
+    if i != len(patch) or len(out) != newsize:
+        raise ValueError("trailing or missing data")
+    return bytes(out)
+
+
+def _unpack(blob):
+    return decompress(blob) if blob[:4] == MAGIC else blob
+
+
+def cmd_diff(args):
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+    patch = make_delta(old, new)
+    packed = compress(patch)
+    if apply_delta(old, decompress(packed)) != new:
+        sys.exit("internal error: patch does not reproduce the new image")
+    out = args.output or os.path.splitext(args.new)[0] + ".delta.wlz"
+    with open(out, "wb") as f:
+        f.write(packed)
+    full = len(compress(new)) if args.compare else None
+    sha = hashlib.sha256(new).hexdigest()
+    print("%s: %d -> %d bytes patch (%.2f%% of the image)" % (out, len(new), len(packed), 100.0 * len(packed) / len(new)))
+    if full:
+        print("full compressed image would be %d bytes: %.1fx smaller" % (full, full / len(packed)))
+    print("base sha256 %s (device must be running this image)" % hashlib.sha256(old).hexdigest())
+    print("sha256 %s" % sha)
+    if args.url:
+        print("ota %s %s" % (args.url, sha))
+
+
+def cmd_apply(args):
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.patch, "rb") as f:
+        patch = _unpack(f.read())
+    new = apply_delta(old, patch)
+    with open(args.output, "wb") as f:
+        f.write(new)
+    print("%s: %d bytes, sha256 %s" % (args.output, len(new), hashlib.sha256(new).hexdigest()))
+
+
+def cmd_pack(args):
+    with open(args.firmware, "rb") as f:
+        raw = f.read()
+    if not raw:
+        sys.exit("empty firmware")
+    if raw[0] != 0xE9:
+        print("warning: %s does not start with the ESP image magic 0xE9" % args.firmware, file=sys.stderr)
+    packed = compress(raw)
+    if decompress(packed) != raw:
+        sys.exit("internal error: round trip mismatch")
+    out = args.output or os.path.splitext(args.firmware)[0] + ".wlz"
+    with open(out, "wb") as f:
+        f.write(packed)
+    sha = hashlib.sha256(raw).hexdigest()
+    print("%s: %d -> %d bytes (%.1f%%)" % (out, len(raw), len(packed), 100.0 * len(packed) / len(raw)))
+    print("sha256 %s" % sha)
+    if args.url:
+        print("ota %s %s" % (args.url, sha))
+
+
+class RangeHandler(http.server.SimpleHTTPRequestHandler):
+    """只支持单个 "bytes=N-" / "bytes=N-M" 区间，够设备续传用。"""
+
+    def send_head(self):
+        m = re.match(r"bytes=(\d+)-(\d*)$", self.headers.get("Range", ""))
+        path = self.translate_path(self.path)
+        if not m or not os.path.isfile(path):
+            return super().send_head()
+        size = os.path.getsize(path)
+        first = int(m.group(1))
+        last = min(int(m.group(2)), size - 1) if m.group(2) else size - 1
+        if first >= size or last < first:
+            self.send_error(416, "Range Not Satisfiable")
+            return None
+        f = open(path, "rb")
+        f.seek(first)
+        self.send_response(206)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Range", "bytes %d-%d/%d" % (first, last, size))
+        self.send_header("Content-Length", str(last - first + 1))
+        self.end_headers()
+        self.range_left = last - first + 1
+        return f
+
+    def copyfile(self, source, outputfile):
+        left = getattr(self, "range_left", None)
+        if left is None:
+            return super().copyfile(source, outputfile)
+        while left > 0:
+            chunk = source.read(min(64 * 1024, left))
+            if not chunk:
+                break
+            outputfile.write(chunk)
+            left -= len(chunk)
+
+
+def cmd_serve(args):
+    handler = lambda *a, **kw: RangeHandler(*a, directory=args.dir, **kw)
+    server = http.server.ThreadingHTTPServer((args.bind, args.port), handler)
+    print("serving %s on http://%s:%d/" % (os.path.abspath(args.dir), args.bind, args.port))
+    server.serve_forever()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("pack", help="压缩 firmware.bin，打印 sha256 和 MQTT 指令")
+    p.add_argument("firmware")
+    p.add_argument("-o", "--output")
+    p.add_argument("--url", help="镜像的下载地址 (用来拼出完整的 ota 指令)")
+    p.set_defaults(func=cmd_pack)
+
+    d = sub.add_parser("diff", help="生成差分补丁 (压缩后)，并在主机上应用一遍校验")
+    d.add_argument("old", help="设备上正在运行的 firmware.bin")
+    d.add_argument("new")
+    d.add_argument("-o", "--output")
+    d.add_argument("--url", help="补丁的下载地址 (用来拼出完整的 ota 指令)")
+    d.add_argument("--compare", action="store_true", help="同时压缩完整镜像，打印节省的倍数")
+    d.set_defaults(func=cmd_diff)
+
+    a = sub.add_parser("apply", help="在主机上应用补丁")
+    a.add_argument("old")
+    a.add_argument("patch")
+    a.add_argument("-o", "--output", required=True)
+    a.set_defaults(func=cmd_apply)
+
+    s = sub.add_parser("serve", help="支持 Range 的静态文件服务器")
+    s.add_argument("--dir", default=".")
+    s.add_argument("--bind", default="0.0.0.0")
+    s.add_argument("--port", type=int, default=8000)
+    s.set_defaults(func=cmd_serve)
+
+    args = ap.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+"""把固件串口输出里的 TRACE_x 二进制帧还原成文本日志 (格式见 lib/Trace/Trace.h)。
+
+格式串不在固件里：扫描源码中的 TRACE_E/W/I/D("...") 字面量，按 FNV-1a 32 哈希建表。
+帧以外的字节 (启动阶段的 Serial.println 等) 原样输出。
+
+用法：
+  python3 tools/trace_decode.py --port /dev/ttyUSB0          # 直接读串口 (需要 pyserial，PlatformIO 自带)
+  python3 tools/trace_decode.py < capture.bin                # 解码抓下来的原始字节
+  python3 tools/trace_decode.py --list                       # 打印 哈希 -> 格式串 表
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+SYNC = b"\xA5\x5A"
+RECORD_BYTES = 28
+FRAME_BYTES = 2 + RECORD_BYTES + 1
+DROPPED_ID = 0
+LEVELS = {1: "E", 2: "W", 3: "I", 4: "D"}
+
+CALL_RE = re.compile(r'\bTRACE_[EWID]\s*\(\s*((?:"(?:[^"\\\n]|\\.)*"\s*)+)')
+LITERAL_RE = re.compile(r'"((?:[^"\\\n]|\\.)*)"')
+SPEC_RE = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z)?([diuxXc%])")
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return 1 if h == DROPPED_ID else h
+
+
+ESCAPES = {"n": 10, "t": 9, "r": 13, "0": 0, "\\": 92, '"': 34, "'": 39, "a": 7, "b": 8, "f": 12, "v": 11, "?": 63}
+
+
+def unescape(lit):
+    """C 字符串字面量 -> 编译器看到的字节 (源码是 UTF-8)。"""
+    out = bytearray()
+    i = 0
+    while i < len(lit):
+        c = lit[i]
+        if c != "\\":
+            out += c.encode("utf-8")
+            i += 1
+            continue
+        n = lit[i + 1]
+        if n == "x":
+            m = re.match(r"[0-9a-fA-F]+", lit[i + 2 :])
+            out.append(int(m.group(0), 16) & 0xFF)
+            i += 2 + len(m.group(0))
+        elif n in "01234567":
+            m = re.match(r"[0-7]{1,3}", lit[i + 1 :])
+            out.append(int(m.group(0), 8) & 0xFF)
+            i += 1 + len(m.group(0))
+        else:
+            out.append(ESCAPES.get(n, ord(n)))
+            i += 2
+    return bytes(out)
+
+
+def build_table(roots):
+    table = {}
+    for root in roots:
+        for dirpath, _, files in os.walk(root):
+            for name in files:
+                if not name.endswith((".h", ".hpp", ".c", ".cpp")):
+                    continue
+                with open(os.path.join(dirpath, name), encoding="utf-8") as f:
+                    src = f.read()
+                for m in CALL_RE.finditer(src):
+                    # 相邻的字符串字面量在 C++ 里会拼接
+                    raw = b"".join(unescape(lit) for lit in LITERAL_RE.findall(m.group(1)))
+                    table[fnv1a(raw)] = raw.decode("utf-8", "replace")
+    return table
+
+
+def crc8(data):
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def render(fmt, args):
+    """用 32 位参数按 printf 规则格式化 (只支持整数转换)。"""
+    it = iter(args)
+
+    def sub(m):
+        flags, conv = m.group(1), m.group(2)
+        if conv == "%":
+            return "%"
+        v = next(it, 0)
+        if conv in "di":
+            v = v - (1 << 32) if v & 0x80000000 else v
+            conv = "d"
+        elif conv == "c":
+            return chr(v & 0xFF)
+        elif conv == "u":
+            conv = "d"
+        return ("%" + flags + conv) % v
+
+    return SPEC_RE.sub(sub, fmt)
+
+
+class Decoder:
+    def __init__(self, table, out):
+        self.table = table
+        self.out = out
+        self.buf = bytearray()
+        self.text = bytearray()
+        self.last_seq = None
+
+    def flush_text(self, final=False):
+        while True:
+            i = self.text.find(b"\n")
+            if i < 0:
+                break
+            self.out.write(self.text[: i + 1].decode("utf-8", "replace"))
+            del self.text[: i + 1]
+        if final and self.text:
+            self.out.write(self.text.decode("utf-8", "replace") + "\n")
+            self.text.clear()
+
+    def emit(self, rec):
+        ts, fid, seq, level, argc = struct.unpack_from("<IIHBB", rec)
+        args = struct.unpack_from("<4I", rec, 12)[: min(argc, 4)]
+        if fid == DROPPED_ID:
+            line = "<%u trace records dropped (ring full)>" % args[0]
+        else:
+            if self.last_seq is not None and seq != (self.last_seq + 1) & 0xFFFF:
+                self.line(ts, "W", "<serial lost %u frame(s)>" % ((seq - self.last_seq - 1) & 0xFFFF))
+            self.last_seq = seq
+            fmt = self.table.get(fid)
+            line = render(fmt, args) if fmt is not None else "<unknown format 0x%08x> %s" % (fid, " ".join(str(a) for a in args))
+        self.line(ts, LEVELS.get(level, "?"), line)
+
+    def line(self, ts, level, text):
+        if self.text:
+            self.flush_text(final=True)
+        self.out.write("%12.6f %s %s\n" % (ts / 1e6, level, text))
+
+    def feed(self, data):
+        self.buf += data
+        while True:
+            i = self.buf.find(SYNC)
+            if i < 0:
+                # 最后一个字节可能是下一帧的开头
+                keep = 1 if self.buf[-1:] == SYNC[:1] else 0
+                self.text += self.buf[: len(self.buf) - keep]
+                del self.buf[: len(self.buf) - keep]
+                break
+            self.text += self.buf[:i]
+            del self.buf[:i]
+            if len(self.buf) < FRAME_BYTES:
+                break
+            rec = bytes(self.buf[2 : 2 + RECORD_BYTES])
+            if crc8(rec) == self.buf[FRAME_BYTES - 1]:
+                self.emit(rec)
+                del self.buf[:FRAME_BYTES]
+            else:
+                # 不是帧 (或帧损坏)：当作普通字节，从下一个字节重新找同步头
+                self.text += self.buf[:1]
+                del self.buf[:1]
+        self.flush_text()
+        self.out.flush()
+
+    def close(self):
+        self.text += self.buf
+        self.buf.clear()
+        self.flush_text(final=True)
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    repo = os.path.dirname(here)
+    ap = argparse.ArgumentParser(description="Decode binary trace frames from the watering controller.")
+    ap.add_argument("input", nargs="?", help="raw capture file (default: stdin)")
+    ap.add_argument("--port", help="serial port to read from")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--src", action="append", help="source roots to scan (default: lib/ and src/)")
+    ap.add_argument("--list", action="store_true", help="print the format table and exit")
+    opts = ap.parse_args()
+
+    table = build_table(opts.src or [os.path.join(repo, "lib"), os.path.join(repo, "src")])
+    if opts.list:
+        for fid, fmt in sorted(table.items(), key=lambda kv: kv[1]):
+            print("0x%08x %s" % (fid, fmt))
+        return
+
+    dec = Decoder(table, sys.stdout)
+    try:
+        if opts.port:
+            import serial  # pyserial
+
+            with serial.Serial(opts.port, opts.baud, timeout=0.2) as port:
+                while True:
+                    dec.feed(port.read(4096))
+        else:
+            stream = open(opts.input, "rb") if opts.input else sys.stdin.buffer
+            with stream:
+                while True:
+                    chunk = stream.read(4096)
+                    if not chunk:
+                        break
+                    dec.feed(chunk)
+    except KeyboardInterrupt:
+        pass
+    dec.close()
+
+
+if __name__ == "__main__":
+    main()
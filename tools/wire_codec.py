@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""二进制协议的后台参考实现：编码指令帧、解码设备发出的应答 / 事件 / 状态 / 历史帧 (格式见 lib/WireProtocol/WireProtocol.h)。
+
+所有字段小端定长；同一版本内设备只会在帧尾追加字段，这里按已知长度解码、忽略多余字节。
+
+用法：
+  python3 tools/wire_codec.py cmd start --zone 1 --arg 30 --seq 7 | mosquitto_pub -t watering/cmd/bin -s
+  mosquitto_sub -t watering/status/bin -F %x | python3 tools/wire_codec.py decode      # 每行一帧 (十六进制)
+  python3 tools/wire_codec.py decode 5701100001000000...                             # 直接给十六进制
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = 0x57
+VERSION = 1
+HEADER = struct.Struct("<BBBBI")
+FLAG_BOOT = 0x01
+
+VERBS = {"start": 1, "stop": 2, "reset": 3, "kill": 4, "revive": 5, "info": 6, "history": 7, "dose": 8}
+ACKS = {0: "accepted", 1: "duplicate", 2: "queue_full", 3: "bad_argument", 4: "unsupported"}
+KINDS = {1: "started", 2: "done", 3: "aborted", 4: "skipped", 5: "missed", 6: "queued",
+         7: "cancelled", 8: "rejected", 9: "killed", 10: "revived", 11: "reset"}
+REJECTS = {1: "unknown_zone", 2: "no_flow_meter", 3: "updating", 4: "busy", 5: "not_watering", 6: "too_long"}
+
+EVENT = struct.Struct("<BBBHHHiI")
+STATUS = struct.Struct("<BBII")
+ZONE = struct.Struct("<BBHHHhHiiIHH")
+HISTORY = struct.Struct("<IIB")
+RUN = struct.Struct("<IHBB")
+
+
+def encode_command(seq, verb, zone=-1, arg=0):
+    return HEADER.pack(MAGIC, VERSION, 0x01, 0, seq) + struct.pack("<Bhi", VERBS[verb], zone, arg)
+
+
+def bits(value, names):
+    return [name for bit, name in names if value & bit]
+
+
+def decode(frame):
+    if len(frame) < HEADER.size or frame[0] != MAGIC:
+        raise ValueError("not a wire frame")
+    _, version, mtype, flags, seq = HEADER.unpack_from(frame)
+    if version != VERSION:
+        raise ValueError("unsupported version %d" % version)
+    out = {"seq": seq, "boot": bool(flags & FLAG_BOOT)}
+    body = frame[HEADER.size:]
+
+    if mtype == 0x02:
+        cmd_seq, result = struct.unpack_from("<IB", body)
+        out.update(type="ack", cmd_seq=cmd_seq, result=ACKS.get(result, result))
+    elif mtype == 0x10:
+        kind, zone, f, cycle, max_cycles, duration, volume, aux = EVENT.unpack_from(body)
+        out.update(type="event", kind=KINDS.get(kind, kind), zone=None if zone == 0xFF else zone,
+                   flags=bits(f, [(1, "manual"), (2, "capped"), (4, "no_flow")]), cycle=cycle, max=max_cycles,
+                   duration_sec=duration, volume_ml=None if volume < 0 else volume, aux=aux)
+        if kind == 8:
+            out["reason"] = REJECTS.get(aux, aux)
+    elif mtype == 0x20:
+        f, count, next_fire, missed = STATUS.unpack_from(body)
+        out.update(type="status", flags=bits(f, [(1, "enabled"), (2, "busy"), (4, "held"), (8, "power"), (16, "persistence")]),
+                   next_fire=None if next_fire == 0xFFFFFFFF else next_fire, missed=missed, zones=[])
+        for i in range(count):
+            z = ZONE.unpack_from(body, STATUS.size + i * ZONE.size)
+            out["zones"].append({
+                "flags": bits(z[0], [(1, "busy"), (2, "relay"), (4, "meter")]), "times_per_day": z[1],
+                "count": z[2], "max": z[3], "duration_sec": z[4], "moisture": z[5],
+                "start_time": "%d:%02d" % divmod(z[6], 60), "last_day": z[7],
+                "volume_ml": z[8], "volume_total_ml": z[9], "missed": z[10], "skipped": z[11]})
+    elif mtype == 0x21:
+        page, total, n = HISTORY.unpack_from(body)
+        runs = []
+        for i in range(n):
+            start, duration, zone, f = RUN.unpack_from(body, HISTORY.size + i * RUN.size)
+            runs.append({"zone": zone, "start": start, "duration_sec": duration, "aborted": bool(f & 1),
+                         "trigger": "manual" if f & 2 else "auto"})
+        out.update(type="history", page=page, total=total, runs=runs)
+    else:
+        out.update(type="unknown", msg_type=mtype)
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Encode / decode binary frames of the watering controller.")
+    sub = ap.add_subparsers(dest="mode", required=True)
+    enc = sub.add_parser("cmd", help="write a command frame to stdout")
+    enc.add_argument("verb", choices=sorted(VERBS))
+    enc.add_argument("--zone", type=int, default=-1)
+    enc.add_argument("--arg", type=int, default=0)
+    enc.add_argument("--seq", type=int, required=True, help="backend sequence number (the device dedups on it)")
+    dec = sub.add_parser("decode", help="decode hex frames (arguments, or one per line on stdin)")
+    dec.add_argument("frames", nargs="*")
+    opts = ap.parse_args()
+
+    if opts.mode == "cmd":
+        sys.stdout.buffer.write(encode_command(opts.seq, opts.verb, opts.zone, opts.arg))
+        return
+    for line in opts.frames or sys.stdin:
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            print(json.dumps(decode(bytes.fromhex(line))))
+        except (ValueError, struct.error) as e:
+            print(json.dumps({"error": str(e), "frame": line}))
+
+
+if __name__ == "__main__":
+    main()